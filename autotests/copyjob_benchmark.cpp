@@ -0,0 +1,100 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <kio/copyjob.h>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+/**
+ * Measures how long a CopyJob takes to copy a directory of many small files,
+ * one file at a time and with setMaximumParallelCopies().
+ *
+ * The files are written to a temporary directory, set KIO_BENCHMARK_SOURCE_DIR and
+ * KIO_BENCHMARK_DEST_DIR to measure between other directories, e.g. to a network share
+ * mounted with kio-fuse or to an smb:// or sftp:// URL.
+ */
+
+class CopyJobBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void copyManyFiles_data();
+    void copyManyFiles();
+
+private:
+    QTemporaryDir m_sourceTempDir;
+    QTemporaryDir m_destTempDir;
+    QString m_sourceDir;
+    QUrl m_destDir;
+};
+
+QTEST_GUILESS_MAIN(CopyJobBenchmark)
+
+void CopyJobBenchmark::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_sourceTempDir.isValid());
+    QVERIFY(m_destTempDir.isValid());
+
+    const QString sourceDir = qEnvironmentVariable("KIO_BENCHMARK_SOURCE_DIR");
+    m_sourceDir = (sourceDir.isEmpty() ? m_sourceTempDir.path() : sourceDir) + QLatin1String("/benchmark_files");
+    const QString destDir = qEnvironmentVariable("KIO_BENCHMARK_DEST_DIR");
+    m_destDir = destDir.isEmpty() ? QUrl::fromLocalFile(m_destTempDir.path()) : QUrl::fromUserInput(destDir);
+    qDebug() << "Copying from" << m_sourceDir << "to" << m_destDir;
+
+    // 1000 files from 1 to 64 KiB, like a source tree
+    QVERIFY(QDir().mkpath(m_sourceDir));
+    for (int i = 0; i < 1000; ++i) {
+        QFile file(m_sourceDir + QStringLiteral("/file%1.txt").arg(i));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        const QByteArray data(1024 * (1 + i % 64), char('a' + i % 26));
+        QCOMPARE(file.write(data), data.size());
+    }
+}
+
+void CopyJobBenchmark::copyManyFiles_data()
+{
+    QTest::addColumn<int>("parallelCopies");
+
+    QTest::newRow("sequential") << 1;
+    QTest::newRow("4 in parallel") << 4;
+    QTest::newRow("16 in parallel") << 16;
+}
+
+void CopyJobBenchmark::copyManyFiles()
+{
+    QFETCH(int, parallelCopies);
+
+    QUrl dest = m_destDir;
+    dest.setPath(dest.path() + QStringLiteral("/benchmark_copy_%1").arg(parallelCopies));
+
+    QElapsedTimer timer;
+    qint64 elapsed = 0;
+    int runs = 0;
+    QBENCHMARK {
+        timer.start();
+        KIO::CopyJob *job = KIO::copyAs(QUrl::fromLocalFile(m_sourceDir), dest, KIO::HideProgressInfo | KIO::Overwrite);
+        job->setUiDelegate(nullptr);
+        job->setUiDelegateExtension(nullptr);
+        job->setWriteIntoExistingDirectories(true);
+        job->setMaximumParallelCopies(parallelCopies);
+        QVERIFY2(job->exec(), qPrintable(job->errorString()));
+        elapsed += timer.elapsed();
+        ++runs;
+    }
+    if (elapsed > 0) {
+        qDebug() << "files/s:" << 1000.0 * runs / (double(elapsed) / 1000);
+    }
+}
+
+#include "copyjob_benchmark.moc"
@@ -0,0 +1,211 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <kio/filecopyjob.h>
+#include <kio/storedtransferjob.h>
+#include <kio/transferjob.h>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#endif
+
+/**
+ * Measures the throughput of local copies with kio_file: copy() for file_copy between
+ * two local files, put() for storedPut and get() for get.
+ *
+ * The files are written to temporary directories, set KIO_BENCHMARK_SOURCE_DIR and
+ * KIO_BENCHMARK_DEST_DIR to measure between other directories, e.g. on different disks.
+ * Reflinking filesystems (btrfs, XFS) copy within one filesystem without reading data.
+ */
+
+class FileCopyBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void copy_data();
+    void copy();
+    void put_data();
+    void put();
+    void get_data();
+    void get();
+
+private:
+    static QString directory(const char *variable, const QTemporaryDir &fallback);
+    static QByteArray content(qint64 size);
+    static void dropCache(const QString &path);
+    static void reportThroughput(qint64 size, qint64 elapsed, int runs);
+
+    QTemporaryDir m_sourceTempDir;
+    QTemporaryDir m_destTempDir;
+    QString m_sourceDir;
+    QString m_destDir;
+};
+
+QTEST_GUILESS_MAIN(FileCopyBenchmark)
+
+QString FileCopyBenchmark::directory(const char *variable, const QTemporaryDir &fallback)
+{
+    const QString dir = qEnvironmentVariable(variable);
+    return dir.isEmpty() ? fallback.path() : dir;
+}
+
+// Not compressible, and different for each size
+QByteArray FileCopyBenchmark::content(qint64 size)
+{
+    QByteArray ret(size, Qt::Uninitialized);
+    quint32 state = quint32(size);
+    for (qint64 i = 0; i < size; ++i) {
+        state = state * 1664525 + 1013904223;
+        ret[i] = char(state >> 24);
+    }
+    return ret;
+}
+
+// The first run would read from the disk, the others from memory
+void FileCopyBenchmark::dropCache(const QString &path)
+{
+#ifdef Q_OS_UNIX
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly)) {
+        posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED);
+    }
+#else
+    Q_UNUSED(path);
+#endif
+}
+
+void FileCopyBenchmark::reportThroughput(qint64 size, qint64 elapsed, int runs)
+{
+    if (elapsed > 0) {
+        qDebug() << "MB/s:" << (double(size) * runs / (1024 * 1024)) / (double(elapsed) / 1000);
+    }
+}
+
+void FileCopyBenchmark::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_sourceTempDir.isValid());
+    QVERIFY(m_destTempDir.isValid());
+    m_sourceDir = directory("KIO_BENCHMARK_SOURCE_DIR", m_sourceTempDir);
+    m_destDir = directory("KIO_BENCHMARK_DEST_DIR", m_destTempDir);
+    qDebug() << "Copying from" << m_sourceDir << "to" << m_destDir;
+}
+
+void FileCopyBenchmark::copy_data()
+{
+    QTest::addColumn<qint64>("size");
+
+    QTest::newRow("1 MB") << (qint64(1) << 20);
+    QTest::newRow("64 MB") << (qint64(64) << 20);
+    QTest::newRow("512 MB") << (qint64(512) << 20);
+}
+
+void FileCopyBenchmark::copy()
+{
+    QFETCH(qint64, size);
+
+    const QString src = m_sourceDir + QLatin1String("/benchmark_source");
+    const QString dest = m_destDir + QLatin1String("/benchmark_copy");
+    {
+        QFile file(src);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(content(size)), size);
+    }
+
+    QElapsedTimer timer;
+    qint64 elapsed = 0;
+    int runs = 0;
+    QBENCHMARK {
+        dropCache(src);
+        timer.start();
+        KIO::FileCopyJob *job = KIO::file_copy(QUrl::fromLocalFile(src), QUrl::fromLocalFile(dest), -1, KIO::Overwrite | KIO::HideProgressInfo);
+        QVERIFY2(job->exec(), qPrintable(job->errorString()));
+        elapsed += timer.elapsed();
+        ++runs;
+    }
+    reportThroughput(size, elapsed, runs);
+
+    QCOMPARE(QFileInfo(dest).size(), size);
+    QFile::remove(dest);
+    QFile::remove(src);
+}
+
+void FileCopyBenchmark::put_data()
+{
+    copy_data();
+}
+
+void FileCopyBenchmark::put()
+{
+    QFETCH(qint64, size);
+
+    const QString dest = m_destDir + QLatin1String("/benchmark_put");
+    const QByteArray data = content(size);
+
+    QElapsedTimer timer;
+    qint64 elapsed = 0;
+    int runs = 0;
+    QBENCHMARK {
+        timer.start();
+        KIO::StoredTransferJob *job = KIO::storedPut(data, QUrl::fromLocalFile(dest), -1, KIO::Overwrite | KIO::HideProgressInfo);
+        QVERIFY2(job->exec(), qPrintable(job->errorString()));
+        elapsed += timer.elapsed();
+        ++runs;
+    }
+    reportThroughput(size, elapsed, runs);
+
+    QCOMPARE(QFileInfo(dest).size(), size);
+    QFile::remove(dest);
+}
+
+void FileCopyBenchmark::get_data()
+{
+    copy_data();
+}
+
+void FileCopyBenchmark::get()
+{
+    QFETCH(qint64, size);
+
+    const QString src = m_sourceDir + QLatin1String("/benchmark_source");
+    {
+        QFile file(src);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(content(size)), size);
+    }
+
+    QElapsedTimer timer;
+    qint64 elapsed = 0;
+    int runs = 0;
+    qint64 received = 0;
+    QBENCHMARK {
+        dropCache(src);
+        timer.start();
+        received = 0;
+        KIO::TransferJob *job = KIO::get(QUrl::fromLocalFile(src), KIO::NoReload, KIO::HideProgressInfo);
+        connect(job, &KIO::TransferJob::data, this, [&received](KIO::Job *, const QByteArray &data) {
+            received += data.size();
+        });
+        QVERIFY2(job->exec(), qPrintable(job->errorString()));
+        elapsed += timer.elapsed();
+        ++runs;
+    }
+    reportThroughput(size, elapsed, runs);
+
+    QCOMPARE(received, size);
+    QFile::remove(src);
+}
+
+#include "filecopy_benchmark.moc"
@@ -0,0 +1,149 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QCryptographicHash>
+#include <QTest>
+
+#include "httpcacheevictionqueue.h"
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Measures what kio_http_cache_cleaner spends on choosing the files to evict from
+ * a cache of 200k entries.
+ *
+ * steadyState is the work per batch of commands from kio_http workers: some cache
+ * hits, some new entries and the evictions that keep the cache at its maximum size.
+ * fullSort is, for comparison, what the cleaner did before it kept its entries in
+ * order: sorting all of them, once per cleaning run.
+ */
+
+// Number of entries in the cache
+const int entryCount = 200000;
+// Commands per batch: every fourth one creates an entry, the others are cache hits
+const int commandsPerBatch = 1000;
+const qint64 entrySize = 16 * 1024;
+
+class HTTPCacheEvictionQueueBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void fill();
+    void steadyState();
+    void fullSort();
+
+private:
+    static QByteArray key(int n);
+    HTTPCacheEvictionQueue::Info info(int n) const;
+    void fillQueue(HTTPCacheEvictionQueue *queue) const;
+
+    std::vector<QByteArray> m_keys;
+};
+
+QTEST_GUILESS_MAIN(HTTPCacheEvictionQueueBenchmark)
+
+QByteArray HTTPCacheEvictionQueueBenchmark::key(int n)
+{
+    return QCryptographicHash::hash(QByteArray::number(n), QCryptographicHash::Sha1);
+}
+
+HTTPCacheEvictionQueue::Info HTTPCacheEvictionQueueBenchmark::info(int n) const
+{
+    // spread the last uses over a month, in a different order than the keys
+    HTTPCacheEvictionQueue::Info ret;
+    ret.lastUsedDate = 1600000000 + (qint64(n) * 7919) % (30 * 24 * 3600);
+    ret.useCount = n % 13;
+    ret.size = entrySize;
+    return ret;
+}
+
+void HTTPCacheEvictionQueueBenchmark::fillQueue(HTTPCacheEvictionQueue *queue) const
+{
+    for (int i = 0; i < entryCount; ++i) {
+        queue->insert(m_keys[i], info(i));
+    }
+}
+
+void HTTPCacheEvictionQueueBenchmark::initTestCase()
+{
+    // keys of the initial entries plus those created while benchmarking
+    m_keys.reserve(entryCount * 2);
+    for (int i = 0; i < entryCount * 2; ++i) {
+        m_keys.push_back(key(i));
+    }
+}
+
+void HTTPCacheEvictionQueueBenchmark::fill()
+{
+    // this is what loading the scoreboard file costs on startup
+    QBENCHMARK {
+        HTTPCacheEvictionQueue queue;
+        fillQueue(&queue);
+        QCOMPARE(queue.count(), entryCount);
+    }
+}
+
+void HTTPCacheEvictionQueueBenchmark::steadyState()
+{
+    HTTPCacheEvictionQueue queue;
+    fillQueue(&queue);
+    const qint64 maxSize = queue.totalSize();
+
+    int nextNewEntry = entryCount;
+    qint64 now = 1600000000 + 30 * 24 * 3600;
+    QBENCHMARK {
+        for (int i = 0; i < commandsPerBatch; ++i) {
+            HTTPCacheEvictionQueue::Info hit;
+            if (i % 4 == 0 && nextNewEntry < int(m_keys.size())) {
+                hit.lastUsedDate = now;
+                hit.size = entrySize;
+                queue.insert(m_keys[nextNewEntry++], hit);
+            } else {
+                // a cache hit on an entry that may or may not have been evicted
+                const QByteArray &hitKey = m_keys[(i * 104729) % nextNewEntry];
+                if (queue.find(hitKey, &hit)) {
+                    hit.useCount++;
+                    hit.lastUsedDate = now;
+                    queue.insert(hitKey, hit);
+                }
+            }
+            ++now;
+        }
+        while (queue.totalSize() > maxSize) {
+            queue.takeLeastUseful();
+        }
+    }
+    QVERIFY(queue.count() <= entryCount);
+}
+
+void HTTPCacheEvictionQueueBenchmark::fullSort()
+{
+    struct SortItem {
+        qint64 lastUsedDate;
+        qint32 useCount;
+        int index;
+    };
+    std::vector<SortItem> items;
+    items.reserve(entryCount);
+    QBENCHMARK {
+        items.clear();
+        for (int i = 0; i < entryCount; ++i) {
+            const HTTPCacheEvictionQueue::Info entryInfo = info(i);
+            items.push_back({entryInfo.lastUsedDate, entryInfo.useCount, i});
+        }
+        std::sort(items.begin(), items.end(), [](const SortItem &item1, const SortItem &item2) {
+            if (item1.lastUsedDate != item2.lastUsedDate) {
+                return item1.lastUsedDate < item2.lastUsedDate;
+            }
+            return item1.useCount < item2.useCount;
+        });
+    }
+}
+
+#include "httpcacheevictionqueue_benchmark.moc"
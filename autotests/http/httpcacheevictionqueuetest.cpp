@@ -0,0 +1,106 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QCryptographicHash>
+#include <QTest>
+
+#include "httpcacheevictionqueue.h"
+
+class HTTPCacheEvictionQueueTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testOrder();
+    void testUpdateRemove();
+    void testManyUpdates();
+
+private:
+    static QByteArray key(int n);
+    static HTTPCacheEvictionQueue::Info info(qint64 lastUsedDate, qint32 useCount, qint64 size = 1);
+};
+
+QTEST_GUILESS_MAIN(HTTPCacheEvictionQueueTest)
+
+QByteArray HTTPCacheEvictionQueueTest::key(int n)
+{
+    return QCryptographicHash::hash(QByteArray::number(n), QCryptographicHash::Sha1);
+}
+
+HTTPCacheEvictionQueue::Info HTTPCacheEvictionQueueTest::info(qint64 lastUsedDate, qint32 useCount, qint64 size)
+{
+    HTTPCacheEvictionQueue::Info ret;
+    ret.lastUsedDate = lastUsedDate;
+    ret.useCount = useCount;
+    ret.size = size;
+    return ret;
+}
+
+void HTTPCacheEvictionQueueTest::testOrder()
+{
+    HTTPCacheEvictionQueue queue;
+    queue.insert(key(1), info(300, 1, 10));
+    queue.insert(key(2), info(100, 5, 20));
+    queue.insert(key(3), info(200, 1, 30));
+    queue.insert(key(4), info(100, 2, 40));
+    QCOMPARE(queue.count(), 4);
+    QCOMPARE(queue.totalSize(), qint64(100));
+
+    // least recently used first, the use count decides between equally old entries
+    QCOMPARE(queue.takeLeastUseful(), key(4));
+    QCOMPARE(queue.takeLeastUseful(), key(2));
+    QCOMPARE(queue.takeLeastUseful(), key(3));
+    QCOMPARE(queue.totalSize(), qint64(10));
+    QCOMPARE(queue.takeLeastUseful(), key(1));
+    QCOMPARE(queue.takeLeastUseful(), QByteArray());
+    QCOMPARE(queue.count(), 0);
+    QCOMPARE(queue.totalSize(), qint64(0));
+}
+
+void HTTPCacheEvictionQueueTest::testUpdateRemove()
+{
+    HTTPCacheEvictionQueue queue;
+    queue.insert(key(1), info(100, 1, 10));
+    queue.insert(key(2), info(200, 1, 10));
+    queue.insert(key(3), info(300, 1, 10));
+
+    // the oldest entry is used again and grows
+    queue.insert(key(1), info(400, 2, 50));
+    QCOMPARE(queue.count(), 3);
+    QCOMPARE(queue.totalSize(), qint64(70));
+    HTTPCacheEvictionQueue::Info found;
+    QVERIFY(queue.find(key(1), &found));
+    QCOMPARE(found.useCount, 2);
+
+    QVERIFY(queue.remove(key(2)));
+    QVERIFY(!queue.remove(key(2)));
+    QVERIFY(!queue.contains(key(2)));
+    QCOMPARE(queue.totalSize(), qint64(60));
+
+    QCOMPARE(queue.takeLeastUseful(), key(3));
+    QCOMPARE(queue.takeLeastUseful(), key(1));
+    QCOMPARE(queue.takeLeastUseful(), QByteArray());
+}
+
+void HTTPCacheEvictionQueueTest::testManyUpdates()
+{
+    // enough updates to make the queue rebuild its heap a few times
+    HTTPCacheEvictionQueue queue;
+    const int count = 100;
+    for (int round = 0; round < 100; ++round) {
+        for (int i = 0; i < count; ++i) {
+            queue.insert(key(i), info(round * count + (count - i), round));
+        }
+    }
+    QCOMPARE(queue.count(), count);
+    // the last round made the entry with the highest number the oldest one
+    for (int i = count - 1; i >= 0; --i) {
+        QCOMPARE(queue.takeLeastUseful(), key(i));
+    }
+    QCOMPARE(queue.count(), 0);
+}
+
+#include "httpcacheevictionqueuetest.moc"
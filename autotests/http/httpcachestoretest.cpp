@@ -0,0 +1,226 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "httpcachestore.h"
+
+#include <memory>
+
+class HTTPCacheStoreTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+    void testInsertFind();
+    void testReplaceRemove();
+    void testGrowIndex();
+    void testSharedIndex();
+    void testCompact();
+    void testDamagedIndex();
+
+private:
+    static QByteArray key(int n);
+    QString writeData(const QByteArray &data);
+    QByteArray readRecord(HTTPCacheStore *store, const QByteArray &key);
+
+    std::unique_ptr<QTemporaryDir> m_dir;
+};
+
+QTEST_GUILESS_MAIN(HTTPCacheStoreTest)
+
+QByteArray HTTPCacheStoreTest::key(int n)
+{
+    return QCryptographicHash::hash(QByteArray::number(n), QCryptographicHash::Sha1);
+}
+
+QString HTTPCacheStoreTest::writeData(const QByteArray &data)
+{
+    const QString fileName = m_dir->filePath(QStringLiteral("data"));
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size()) {
+        return QString();
+    }
+    return fileName;
+}
+
+QByteArray HTTPCacheStoreTest::readRecord(HTTPCacheStore *store, const QByteArray &key)
+{
+    HTTPCacheStore::Entry entry;
+    if (!store->find(key, &entry)) {
+        return QByteArray();
+    }
+    std::unique_ptr<QIODevice> record(store->openRecord(entry));
+    return record ? record->readAll() : QByteArray();
+}
+
+void HTTPCacheStoreTest::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+}
+
+void HTTPCacheStoreTest::cleanup()
+{
+    m_dir.reset();
+}
+
+void HTTPCacheStoreTest::testInsertFind()
+{
+    HTTPCacheStore store(m_dir->path());
+    QVERIFY(store.open());
+
+    HTTPCacheStore::Entry entry;
+    QVERIFY(!store.find(key(1), &entry));
+
+    QVERIFY(store.insert(key(1), writeData("first"), 1000));
+    QVERIFY(store.insert(key(2), writeData("second"), 2000));
+    QVERIFY(store.find(key(1), &entry));
+    QCOMPARE(entry.size, qint64(5));
+    QCOMPARE(entry.expireDate, qint64(1000));
+    QCOMPARE(entry.useCount, 0);
+    QCOMPARE(readRecord(&store, key(1)), QByteArray("first"));
+    QCOMPARE(readRecord(&store, key(2)), QByteArray("second"));
+
+    // a record device behaves like the file of a cache entry
+    std::unique_ptr<QIODevice> record(store.openRecord(entry));
+    QVERIFY(record);
+    QVERIFY(record->openMode() == QIODevice::ReadOnly);
+    QVERIFY(record->seek(2));
+    QCOMPARE(record->readAll(), QByteArray("rst"));
+
+    // a stale entry pointing at the wrong record is rejected
+    HTTPCacheStore::Entry wrongKey = entry;
+    wrongKey.key = key(2);
+    QVERIFY(!store.openRecord(wrongKey));
+
+    store.touch(key(1), 1000);
+    store.touch(key(1), 3000);
+    QVERIFY(store.find(key(1), &entry));
+    QCOMPARE(entry.useCount, 2);
+    QCOMPARE(entry.expireDate, qint64(3000));
+}
+
+void HTTPCacheStoreTest::testReplaceRemove()
+{
+    HTTPCacheStore store(m_dir->path());
+    QVERIFY(store.open());
+
+    QVERIFY(store.insert(key(1), writeData("old content"), 0));
+    const qint64 liveBytesBefore = store.liveBytes();
+    QVERIFY(store.insert(key(1), writeData("new"), 0));
+    QCOMPARE(store.liveBytes(), liveBytesBefore - 8);
+    QCOMPARE(readRecord(&store, key(1)), QByteArray("new"));
+    QCOMPARE(store.entries().count(), 1);
+
+    QVERIFY(store.remove(key(1)));
+    QVERIFY(!store.remove(key(1)));
+    QCOMPARE(readRecord(&store, key(1)), QByteArray());
+    QCOMPARE(store.entries().count(), 0);
+    QCOMPARE(store.liveBytes(), qint64(0));
+}
+
+void HTTPCacheStoreTest::testGrowIndex()
+{
+    HTTPCacheStore store(m_dir->path());
+    QVERIFY(store.open());
+
+    // more than fit into the initial index
+    const int count = 5000;
+    const QString dataFile = writeData("x");
+    for (int i = 0; i < count; ++i) {
+        QVERIFY(store.insert(key(i), dataFile, i));
+    }
+    QCOMPARE(store.entries().count(), count);
+    for (int i = 0; i < count; i += 97) {
+        HTTPCacheStore::Entry entry;
+        QVERIFY(store.find(key(i), &entry));
+        QCOMPARE(entry.expireDate, qint64(i));
+    }
+}
+
+void HTTPCacheStoreTest::testSharedIndex()
+{
+    // two instances stand in for two processes
+    HTTPCacheStore writer(m_dir->path());
+    HTTPCacheStore reader(m_dir->path());
+    QVERIFY(writer.open());
+    QVERIFY(reader.open());
+
+    QVERIFY(writer.insert(key(1), writeData("shared"), 0));
+    QCOMPARE(readRecord(&reader, key(1)), QByteArray("shared"));
+
+    // the reader follows when the writer replaces the index with a bigger one
+    const QString dataFile = writeData("x");
+    for (int i = 2; i < 5000; ++i) {
+        QVERIFY(writer.insert(key(i), dataFile, 0));
+    }
+    QCOMPARE(readRecord(&reader, key(4999)), QByteArray("x"));
+    QCOMPARE(readRecord(&reader, key(1)), QByteArray("shared"));
+}
+
+void HTTPCacheStoreTest::testCompact()
+{
+    HTTPCacheStore store(m_dir->path());
+    QVERIFY(store.open());
+
+    // fill more than one segment
+    const QByteArray big(1024 * 1024, 'b');
+    const int count = 40;
+    for (int i = 0; i < count; ++i) {
+        QVERIFY(store.insert(key(i), writeData(big + QByteArray::number(i)), 0));
+    }
+    const QString storeDir = m_dir->filePath(QStringLiteral("store"));
+    const int segmentCount = QDir(storeDir).entryList({QStringLiteral("segment-*")}, QDir::Files).count();
+    QVERIFY(segmentCount > 1);
+
+    // nothing to do while all records are alive
+    QVERIFY(!store.compactSegment());
+
+    // kill most of the first segment, except for one record
+    for (int i = 1; i < count / 2; ++i) {
+        QVERIFY(store.remove(key(i)));
+    }
+    while (store.compactSegment()) { }
+    QVERIFY(QDir(storeDir).entryList({QStringLiteral("segment-*")}, QDir::Files).count() < segmentCount);
+
+    QCOMPARE(readRecord(&store, key(0)), big + QByteArray::number(0));
+    for (int i = count / 2; i < count; ++i) {
+        QCOMPARE(readRecord(&store, key(i)), big + QByteArray::number(i));
+    }
+    QCOMPARE(store.entries().count(), count - (count / 2 - 1));
+}
+
+void HTTPCacheStoreTest::testDamagedIndex()
+{
+    {
+        HTTPCacheStore store(m_dir->path());
+        QVERIFY(store.open());
+        QVERIFY(store.insert(key(1), writeData("gone"), 0));
+    }
+    QFile index(m_dir->filePath(QStringLiteral("store/index")));
+    QVERIFY(index.open(QIODevice::ReadWrite));
+    QVERIFY(index.write("garbage") == 7);
+    index.close();
+
+    // a store that can't be read is started over
+    HTTPCacheStore store(m_dir->path());
+    QVERIFY(store.open());
+    QCOMPARE(store.entries().count(), 0);
+    QVERIFY(store.insert(key(1), writeData("back"), 0));
+    QCOMPARE(readRecord(&store, key(1)), QByteArray("back"));
+
+    store.clear();
+    QCOMPARE(readRecord(&store, key(1)), QByteArray());
+}
+
+#include "httpcachestoretest.moc"
@@ -0,0 +1,135 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#include <QBuffer>
+#include <QTest>
+
+#include "httpfilter.h"
+#include <KCompressionDevice>
+
+#include <memory>
+
+#if HAVE_BROTLI_ENCODER
+#include <brotli/encode.h>
+#endif
+
+/**
+ * Measures the decode throughput of the HTTP content-encoding filters.
+ *
+ * A few MB of text that compresses about as well as typical HTML is fed
+ * to each filter in the 32 KB pieces kio_http hands over after reading
+ * from the socket. Divide the data size printed by initTestCase() by the
+ * time per iteration to get the throughput.
+ */
+
+// Amount of uncompressed data decoded per iteration
+const int uncompressedSize = 8 * 1024 * 1024;
+// Size of the pieces fed to the filter, like readBody() does
+const int inputChunkSize = 32 * 1024;
+
+class HTTPFilterBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void decode_data();
+    void decode();
+
+private:
+    QByteArray m_data;
+};
+
+QTEST_GUILESS_MAIN(HTTPFilterBenchmark)
+
+static QByteArray compressWith(KCompressionDevice::CompressionType type, const QByteArray &data)
+{
+    QBuffer buffer;
+    KCompressionDevice dev(&buffer, false, type);
+    if (!dev.open(QIODevice::WriteOnly)) {
+        return QByteArray();
+    }
+    dev.write(data);
+    dev.close();
+    return buffer.data();
+}
+
+#if HAVE_BROTLI_ENCODER
+static QByteArray brotliCompress(const QByteArray &data)
+{
+    QByteArray compressed(BrotliEncoderMaxCompressedSize(data.size()), Qt::Uninitialized);
+    size_t compressedSize = compressed.size();
+    if (!BrotliEncoderCompress(BROTLI_DEFAULT_QUALITY,
+                               BROTLI_DEFAULT_WINDOW,
+                               BROTLI_MODE_TEXT,
+                               data.size(),
+                               reinterpret_cast<const uint8_t *>(data.constData()),
+                               &compressedSize,
+                               reinterpret_cast<uint8_t *>(compressed.data()))) {
+        return QByteArray();
+    }
+    compressed.resize(compressedSize);
+    return compressed;
+}
+#endif
+
+void HTTPFilterBenchmark::initTestCase()
+{
+    // Markup-like lines with some variation, so that it neither compresses to nothing nor not at all
+    m_data.reserve(uncompressedSize);
+    for (int i = 0; m_data.size() < uncompressedSize; ++i) {
+        m_data += "<tr class=\"row" + QByteArray::number(i % 7) + "\"><td>" + QByteArray::number(i * 7919) + "</td><td><a href=\"/item/"
+            + QByteArray::number(i) + "\">Item number " + QByteArray::number(i) + "</a></td></tr>\n";
+    }
+    m_data.truncate(uncompressedSize);
+    qDebug() << "Decoding" << m_data.size() << "bytes per iteration";
+}
+
+void HTTPFilterBenchmark::decode_data()
+{
+    QTest::addColumn<QByteArray>("encoding");
+    QTest::addColumn<QByteArray>("compressed");
+
+    QTest::newRow("gzip") << QByteArray("gzip") << compressWith(KCompressionDevice::GZip, m_data);
+    if (HTTPFilterZstd::isSupported()) {
+        QTest::newRow("zstd") << QByteArray("zstd") << compressWith(KCompressionDevice::Zstd, m_data);
+    }
+#if HAVE_BROTLI && HAVE_BROTLI_ENCODER
+    QTest::newRow("br") << QByteArray("br") << brotliCompress(m_data);
+#endif
+}
+
+void HTTPFilterBenchmark::decode()
+{
+    QFETCH(QByteArray, encoding);
+    QFETCH(QByteArray, compressed);
+    QVERIFY(!compressed.isEmpty());
+    qDebug() << encoding << "compressed to" << compressed.size() << "bytes";
+
+    qint64 decodedSize = 0;
+    QBENCHMARK {
+        std::unique_ptr<HTTPFilterBase> filter;
+        if (encoding == "gzip") {
+            filter.reset(new HTTPFilterGZip);
+        } else if (encoding == "zstd") {
+            filter.reset(new HTTPFilterZstd);
+#if HAVE_BROTLI
+        } else if (encoding == "br") {
+            filter.reset(new HTTPFilterBrotli);
+#endif
+        }
+        decodedSize = 0;
+        connect(filter.get(), &HTTPFilterBase::output, this, [&decodedSize](const QByteArray &d) {
+            decodedSize += d.size();
+        });
+        for (int pos = 0; pos < compressed.size(); pos += inputChunkSize) {
+            filter->slotInput(QByteArray::fromRawData(compressed.constData() + pos, qMin(inputChunkSize, compressed.size() - pos)));
+        }
+    }
+    QCOMPARE(decodedSize, qint64(m_data.size()));
+}
+
+#include "httpfilter_benchmark.moc"
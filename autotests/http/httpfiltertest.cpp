@@ -10,11 +10,17 @@
 #include "httpfilter.h"
 #include <KCompressionDevice>
 #include <KFilterBase>
+#include <QBuffer>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
+#include <memory>
 #include <zlib.h>
 
+#if HAVE_BROTLI_ENCODER
+#include <brotli/encode.h>
+#endif
+
 class HTTPFilterTest : public QObject
 {
     Q_OBJECT
@@ -23,6 +29,10 @@ private Q_SLOTS:
     void initTestCase();
     void test_deflateWithZlibHeader();
     void test_httpFilterGzip();
+    void test_httpFilterZstd_data();
+    void test_httpFilterZstd();
+    void test_httpFilterBrotli_data();
+    void test_httpFilterBrotli();
 
 private:
     void test_block_write(const QString &fileName, const QByteArray &data);
@@ -30,6 +40,7 @@ private:
     void test_getch(const QString &fileName);
     void test_textstream(const QString &fileName);
     void test_readall(const QString &fileName, const QString &mimeType, const QByteArray &expectedData);
+    void test_filter(HTTPFilterBase *(*createFilter)(), const QByteArray &compressed, const QByteArray &expectedData);
 
 protected Q_SLOTS:
     void slotFilterOutput(const QByteArray &data);
@@ -59,6 +70,17 @@ void HTTPFilterTest::initTestCase()
     dev.close();
 }
 
+// Much larger than the buffer the filters decode into
+static QByteArray largeTestData()
+{
+    QByteArray data;
+    data.reserve(1024 * 1024);
+    for (int i = 0; data.size() < 1024 * 1024; ++i) {
+        data += "line " + QByteArray::number(i) + ": hello world\n";
+    }
+    return data;
+}
+
 static void getCompressedData(QByteArray &data, QByteArray &compressedData)
 {
     data = "Hello world, this is a test for deflate, from bug 114830 / 117683";
@@ -135,6 +157,108 @@ void HTTPFilterTest::test_httpFilterGzip()
     }
 }
 
+void HTTPFilterTest::test_filter(HTTPFilterBase *(*createFilter)(), const QByteArray &compressed, const QByteArray &expectedData)
+{
+    // Test sending the whole data in one go
+    {
+        std::unique_ptr<HTTPFilterBase> filter(createFilter());
+        QSignalSpy spyOutput(filter.get(), &HTTPFilterBase::output);
+        QSignalSpy spyError(filter.get(), &HTTPFilterBase::error);
+        filter->slotInput(compressed);
+        QByteArray output;
+        for (int i = 0; i < spyOutput.count() - 1; ++i) {
+            const QByteArray data = spyOutput[i][0].toByteArray();
+            QVERIFY(!data.isEmpty());
+            output += data;
+        }
+        QCOMPARE(output.size(), expectedData.size());
+        QVERIFY(output == expectedData);
+        QVERIFY(spyOutput.count() >= 2);
+        QCOMPARE(spyOutput[spyOutput.count() - 1][0].toByteArray(), QByteArray()); // last one was empty
+        QCOMPARE(spyError.count(), 0);
+    }
+
+    // Test sending the data byte by byte
+    {
+        m_filterOutput.clear();
+        std::unique_ptr<HTTPFilterBase> filter(createFilter());
+        QSignalSpy spyOutput(filter.get(), &HTTPFilterBase::output);
+        connect(filter.get(), &HTTPFilterBase::output, this, &HTTPFilterTest::slotFilterOutput);
+        QSignalSpy spyError(filter.get(), &HTTPFilterBase::error);
+        for (int i = 0; i < compressed.size(); ++i) {
+            filter->slotInput(QByteArray(compressed.constData() + i, 1));
+            QCOMPARE(spyError.count(), 0);
+        }
+        QVERIFY(m_filterOutput == expectedData);
+        QCOMPARE(spyOutput[spyOutput.count() - 1][0].toByteArray(), QByteArray()); // last one was empty
+    }
+}
+
+void HTTPFilterTest::test_httpFilterZstd_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("small") << testData;
+    QTest::newRow("large") << largeTestData();
+}
+
+void HTTPFilterTest::test_httpFilterZstd()
+{
+    if (!HTTPFilterZstd::isSupported()) {
+        QSKIP("KArchive was built without zstd support");
+    }
+    QFETCH(QByteArray, data);
+
+    QBuffer buffer;
+    {
+        KCompressionDevice dev(&buffer, false, KCompressionDevice::Zstd);
+        QVERIFY(dev.open(QIODevice::WriteOnly));
+        QCOMPARE(dev.write(data), data.size());
+    }
+
+    test_filter(
+        []() -> HTTPFilterBase * {
+            return new HTTPFilterZstd;
+        },
+        buffer.data(),
+        data);
+}
+
+void HTTPFilterTest::test_httpFilterBrotli_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("small") << testData;
+    QTest::newRow("large") << largeTestData();
+}
+
+void HTTPFilterTest::test_httpFilterBrotli()
+{
+#if HAVE_BROTLI && HAVE_BROTLI_ENCODER
+    QFETCH(QByteArray, data);
+
+    QByteArray compressed(BrotliEncoderMaxCompressedSize(data.size()), Qt::Uninitialized);
+    size_t compressedSize = compressed.size();
+    QVERIFY(BrotliEncoderCompress(BROTLI_DEFAULT_QUALITY,
+                                  BROTLI_DEFAULT_WINDOW,
+                                  BROTLI_MODE_TEXT,
+                                  data.size(),
+                                  reinterpret_cast<const uint8_t *>(data.constData()),
+                                  &compressedSize,
+                                  reinterpret_cast<uint8_t *>(compressed.data())));
+    compressed.resize(compressedSize);
+
+    test_filter(
+        []() -> HTTPFilterBase * {
+            return new HTTPFilterBrotli;
+        },
+        compressed,
+        data);
+#else
+    QSKIP("Built without brotli support");
+#endif
+}
+
 void HTTPFilterTest::slotFilterOutput(const QByteArray &data)
 {
     m_filterOutput += data;
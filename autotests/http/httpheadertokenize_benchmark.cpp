@@ -0,0 +1,119 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <parsinghelpers.h>
+
+#include <parsinghelpers.cpp>
+
+#include <string.h>
+
+/**
+ * Measures what kio_http spends on a response header once it has been received:
+ * tokenizing it and getting the values of the fields it looks at for every response.
+ */
+
+// A small static file from a web server
+static const char staticFileHeader[] =
+    "Server: nginx/1.24.0\r\n"
+    "Date: Tue, 14 Nov 2023 09:12:45 GMT\r\n"
+    "Content-Type: text/css\r\n"
+    "Content-Length: 4211\r\n"
+    "Last-Modified: Mon, 06 Nov 2023 16:20:11 GMT\r\n"
+    "Connection: keep-alive\r\n"
+    "Keep-Alive: timeout=20\r\n"
+    "ETag: \"65491283-1073\"\r\n"
+    "Cache-Control: max-age=2592000, public\r\n"
+    "Accept-Ranges: bytes\r\n"
+    "\r\n";
+
+// An API response through a CDN, with many fields kio_http doesn't know
+static const char cdnHeader[] =
+    "date: Tue, 14 Nov 2023 09:12:45 GMT\r\n"
+    "content-type: application/json; charset=utf-8\r\n"
+    "transfer-encoding: chunked\r\n"
+    "connection: keep-alive\r\n"
+    "vary: Accept-Encoding, Origin\r\n"
+    "cache-control: private, no-cache, no-store, must-revalidate, max-age=0\r\n"
+    "pragma: no-cache\r\n"
+    "expires: Thu, 01 Jan 1970 00:00:00 GMT\r\n"
+    "set-cookie: session=8f2b1c9d7e6a5f4b3c2d1e0f9a8b7c6d; Path=/; Secure; HttpOnly; SameSite=Lax\r\n"
+    "set-cookie: __cf_bm=Yq3pX8r2Lk9sT1vW5zB7nD4hJ6mF0cQe-1699953165-0-AVx2; path=/; expires=Tue, 14-Nov-23 09:42:45 GMT; domain=.example.com; HttpOnly; Secure\r\n"
+    "strict-transport-security: max-age=31536000; includeSubDomains; preload\r\n"
+    "x-content-type-options: nosniff\r\n"
+    "x-frame-options: SAMEORIGIN\r\n"
+    "content-security-policy: default-src 'self'; img-src * data:; script-src 'self' 'unsafe-inline' https://cdn.example.com\r\n"
+    "x-request-id: 4a3f2e1d-0c9b-8a7f-6e5d-4c3b2a1f0e9d\r\n"
+    "cf-cache-status: DYNAMIC\r\n"
+    "server: cloudflare\r\n"
+    "cf-ray: 825a1b2c3d4e5f60-FRA\r\n"
+    "content-encoding: br\r\n"
+    "alt-svc: h3=\":443\"; ma=86400\r\n"
+    "\r\n";
+
+// A redirect with folded lines, as old servers send them
+static const char foldedHeader[] =
+    "Location: http://www.example.org/some/where/index.jsp?target=page.jsp\r\n"
+    "Connection: close\r\n"
+    "Cache-Control: no-cache,\r\n"
+    " no-store\r\n"
+    "Warning: 299 - \"Deprecated\"\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n";
+
+class HeaderTokenizeBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void tokenize_data();
+    void tokenize();
+};
+
+QTEST_GUILESS_MAIN(HeaderTokenizeBenchmark)
+
+void HeaderTokenizeBenchmark::tokenize_data()
+{
+    QTest::addColumn<QByteArray>("header");
+
+    QTest::newRow("static file") << QByteArray(staticFileHeader);
+    QTest::newRow("cdn") << QByteArray(cdnHeader);
+    QTest::newRow("folded") << QByteArray(foldedHeader);
+}
+
+void HeaderTokenizeBenchmark::tokenize()
+{
+    QFETCH(QByteArray, header);
+
+    // like kio_http, tokenize a fixed size buffer in place
+    char buffer[8192];
+    QVERIFY(header.size() < int(sizeof(buffer)));
+    memset(buffer, 0, sizeof(buffer));
+    int valueCount = 0;
+
+    QBENCHMARK {
+        memcpy(buffer, header.constData(), header.size());
+        HeaderTokenizer tokenizer(buffer);
+        tokenizer.tokenize(0, sizeof(buffer));
+
+        // what readResponseHeader() looks at every time
+        static const char *const fields[] = {"accept-ranges", "keep-alive", "content-length", "content-type", "connection", "cache-control", "etag"};
+        valueCount = 0;
+        for (const char *field : fields) {
+            TokenIterator it = tokenizer.iterator(field);
+            while (it.hasNext()) {
+                valueCount += it.next().isEmpty() ? 0 : 1;
+            }
+        }
+    }
+    QVERIFY(valueCount > 0);
+
+    // Fix compiler warning
+    (void)contentDispositionParser;
+}
+
+#include "httpheadertokenize_benchmark.moc"
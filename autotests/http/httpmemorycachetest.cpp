@@ -0,0 +1,177 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QStandardPaths>
+#include <QTest>
+
+#include "httpmemorycache.h"
+
+class HTTPMemoryCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanupTestCase();
+    void testInsertFind();
+    void testVary();
+    void testRemove();
+    void testRemoveVariants();
+    void testRejections();
+    void testSharedStatistics();
+
+private:
+    // request headers, by lowercase name
+    QHash<QByteArray, QByteArray> m_requestHeaders;
+    HTTPMemoryCache::VaryValuesFunction m_varyValues;
+};
+
+QTEST_GUILESS_MAIN(HTTPMemoryCacheTest)
+
+static const uint cacheSize = 256 * 1024;
+static const uint maxEntrySize = 1024;
+
+void HTTPMemoryCacheTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    m_varyValues = [this](const QByteArray &vary, QByteArray *values) {
+        values->clear();
+        if (vary.isEmpty()) {
+            return true;
+        }
+        const QByteArrayList names = vary.split(',');
+        for (const QByteArray &name : names) {
+            if (name == "*") {
+                return false;
+            }
+            *values += name + ": " + m_requestHeaders.value(name) + '\n';
+        }
+        return true;
+    };
+}
+
+void HTTPMemoryCacheTest::init()
+{
+    HTTPMemoryCache::deleteCache();
+    m_requestHeaders.clear();
+}
+
+void HTTPMemoryCacheTest::cleanupTestCase()
+{
+    HTTPMemoryCache::deleteCache();
+}
+
+void HTTPMemoryCacheTest::testInsertFind()
+{
+    HTTPMemoryCache cache(cacheSize, maxEntrySize);
+    QByteArray entry;
+    QVERIFY(!cache.find("http://example.com/a", m_varyValues, &entry));
+
+    QVERIFY(cache.insert("http://example.com/a", QByteArray(), m_varyValues, "entry a"));
+    QVERIFY(cache.insert("http://example.com/b", QByteArray(), m_varyValues, "entry b"));
+    QVERIFY(cache.find("http://example.com/a", m_varyValues, &entry));
+    QCOMPARE(entry, QByteArray("entry a"));
+    QVERIFY(cache.find("http://example.com/b", m_varyValues, &entry));
+    QCOMPARE(entry, QByteArray("entry b"));
+
+    QVERIFY(cache.insert("http://example.com/a", QByteArray(), m_varyValues, "new entry a"));
+    QVERIFY(cache.find("http://example.com/a", m_varyValues, &entry));
+    QCOMPARE(entry, QByteArray("new entry a"));
+}
+
+void HTTPMemoryCacheTest::testVary()
+{
+    HTTPMemoryCache cache(cacheSize, maxEntrySize);
+    const QByteArray url = "http://example.com/data.json";
+
+    m_requestHeaders["accept-language"] = "de";
+    QVERIFY(cache.insert(url, " Accept-Language ,Accept-Encoding", m_varyValues, "German"));
+    m_requestHeaders["accept-language"] = "fr";
+    QVERIFY(cache.insert(url, "Accept-Language, Accept-Encoding", m_varyValues, "French"));
+
+    QByteArray entry;
+    QVERIFY(cache.find(url, m_varyValues, &entry));
+    QCOMPARE(entry, QByteArray("French"));
+    m_requestHeaders["accept-language"] = "de";
+    QVERIFY(cache.find(url, m_varyValues, &entry));
+    QCOMPARE(entry, QByteArray("German"));
+    m_requestHeaders["accept-encoding"] = "gzip";
+    QVERIFY(!cache.find(url, m_varyValues, &entry));
+}
+
+void HTTPMemoryCacheTest::testRemove()
+{
+    HTTPMemoryCache cache(cacheSize, maxEntrySize);
+    const QByteArray url = "http://example.com/icon.png";
+    QVERIFY(cache.insert(url, "accept", m_varyValues, "icon"));
+    cache.remove(url);
+    QByteArray entry;
+    QVERIFY(!cache.find(url, m_varyValues, &entry));
+
+    QVERIFY(cache.insert(url, "accept", m_varyValues, "icon again"));
+    QVERIFY(cache.find(url, m_varyValues, &entry));
+    QCOMPARE(entry, QByteArray("icon again"));
+}
+
+void HTTPMemoryCacheTest::testRemoveVariants()
+{
+    HTTPMemoryCache cache(cacheSize, maxEntrySize);
+    const QByteArray url = "http://example.com/data.json";
+    m_requestHeaders["accept-language"] = "de";
+    QVERIFY(cache.insert(url, "Accept-Language", m_varyValues, "German"));
+    m_requestHeaders["accept-language"] = "fr";
+    QVERIFY(cache.insert(url, "Accept-Language", m_varyValues, "French"));
+    cache.remove(url);
+
+    // a new vary record, even one naming the old headers again, must not lead to the removed variants
+    m_requestHeaders["accept-encoding"] = "gzip";
+    QVERIFY(cache.insert(url, "Accept-Encoding", m_varyValues, "Compressed"));
+    m_requestHeaders["accept-language"] = "en";
+    QVERIFY(cache.insert(url, "Accept-Language", m_varyValues, "English"));
+    QByteArray entry;
+    QVERIFY(cache.find(url, m_varyValues, &entry));
+    QCOMPARE(entry, QByteArray("English"));
+    m_requestHeaders["accept-language"] = "de";
+    QVERIFY(!cache.find(url, m_varyValues, &entry));
+    m_requestHeaders["accept-language"] = "fr";
+    QVERIFY(!cache.find(url, m_varyValues, &entry));
+}
+
+void HTTPMemoryCacheTest::testRejections()
+{
+    HTTPMemoryCache cache(cacheSize, maxEntrySize);
+    QVERIFY(!cache.insert("http://example.com/big", QByteArray(), m_varyValues, QByteArray(maxEntrySize + 1, 'x')));
+    QVERIFY(!cache.insert("http://example.com/any", "*", m_varyValues, "anything"));
+
+    QByteArray entry;
+    QVERIFY(!cache.find("http://example.com/big", m_varyValues, &entry));
+    QVERIFY(!cache.find("http://example.com/any", m_varyValues, &entry));
+    QCOMPARE(cache.statistics().rejections, quint32(2));
+}
+
+void HTTPMemoryCacheTest::testSharedStatistics()
+{
+    // two instances stand in for two processes
+    HTTPMemoryCache writer(cacheSize, maxEntrySize);
+    HTTPMemoryCache reader(cacheSize, maxEntrySize);
+
+    QVERIFY(writer.insert("http://example.com/shared", QByteArray(), m_varyValues, "shared"));
+    QByteArray entry;
+    QVERIFY(reader.find("http://example.com/shared", m_varyValues, &entry));
+    QCOMPARE(entry, QByteArray("shared"));
+    QVERIFY(!reader.find("http://example.com/other", m_varyValues, &entry));
+
+    const HTTPMemoryCache::Statistics stats = writer.statistics();
+    QCOMPARE(stats.insertions, quint32(1));
+    QCOMPARE(stats.hits, quint32(1));
+    QCOMPARE(stats.misses, quint32(1));
+    QCOMPARE(stats.rejections, quint32(0));
+    QVERIFY(stats.totalSize > 0);
+    QVERIFY(stats.freeSize < stats.totalSize);
+}
+
+#include "httpmemorycachetest.moc"
@@ -0,0 +1,217 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QCryptographicHash>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "httprangecache.h"
+
+#include <memory>
+
+class HTTPRangeCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+    void testParseContentRange_data();
+    void testParseContentRange();
+    void testSegments();
+    void testWriteRead();
+    void testValidatorChange();
+    void testLocking();
+    void testTrim();
+
+private:
+    static QByteArray key(int n);
+    static HTTPRangeCache::Validator validator(const QByteArray &etag);
+    static QString describe(const QList<HTTPRangeCache::Segment> &segments);
+
+    std::unique_ptr<QTemporaryDir> m_dir;
+};
+
+QTEST_GUILESS_MAIN(HTTPRangeCacheTest)
+
+QByteArray HTTPRangeCacheTest::key(int n)
+{
+    return QCryptographicHash::hash(QByteArray::number(n), QCryptographicHash::Sha1);
+}
+
+HTTPRangeCache::Validator HTTPRangeCacheTest::validator(const QByteArray &etag)
+{
+    HTTPRangeCache::Validator ret;
+    ret.etag = etag;
+    return ret;
+}
+
+// "start-end" for cached segments, "[start-end]" for missing ones
+QString HTTPRangeCacheTest::describe(const QList<HTTPRangeCache::Segment> &segments)
+{
+    QStringList ret;
+    for (const HTTPRangeCache::Segment &segment : segments) {
+        const QString range = QString::number(segment.start) + QLatin1Char('-') + QString::number(segment.end);
+        ret.append(segment.cached ? range : QStringLiteral("[%1]").arg(range));
+    }
+    return ret.join(QLatin1Char(' '));
+}
+
+void HTTPRangeCacheTest::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+}
+
+void HTTPRangeCacheTest::cleanup()
+{
+    m_dir.reset();
+}
+
+void HTTPRangeCacheTest::testParseContentRange_data()
+{
+    QTest::addColumn<QByteArray>("value");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<qint64>("first");
+    QTest::addColumn<qint64>("last");
+    QTest::addColumn<qint64>("total");
+
+    QTest::newRow("complete") << QByteArray("bytes 0-499/1234") << true << qint64(0) << qint64(499) << qint64(1234);
+    QTest::newRow("whitespace") << QByteArray(" Bytes 500-1233/1234 ") << true << qint64(500) << qint64(1233) << qint64(1234);
+    QTest::newRow("unknown total") << QByteArray("bytes 10-19/*") << true << qint64(10) << qint64(19) << qint64(-1);
+    QTest::newRow("unsatisfied") << QByteArray("bytes */1234") << false << qint64(0) << qint64(0) << qint64(0);
+    QTest::newRow("reversed") << QByteArray("bytes 20-10/100") << false << qint64(0) << qint64(0) << qint64(0);
+    QTest::newRow("beyond total") << QByteArray("bytes 0-100/100") << false << qint64(0) << qint64(0) << qint64(0);
+    QTest::newRow("other unit") << QByteArray("items 0-1/2") << false << qint64(0) << qint64(0) << qint64(0);
+}
+
+void HTTPRangeCacheTest::testParseContentRange()
+{
+    QFETCH(QByteArray, value);
+    QFETCH(bool, valid);
+
+    qint64 first = 0;
+    qint64 last = 0;
+    qint64 total = 0;
+    QCOMPARE(HTTPRangeCache::parseContentRange(value, &first, &last, &total), valid);
+    if (valid) {
+        QTEST(first, "first");
+        QTEST(last, "last");
+        QTEST(total, "total");
+    }
+}
+
+void HTTPRangeCacheTest::testSegments()
+{
+    HTTPRangeCache cache(m_dir->path());
+    QVERIFY(cache.open(key(1), true));
+    cache.setValidator(validator("\"v1\""));
+    QCOMPARE(describe(cache.segments(0, 100)), QStringLiteral("[0-100]"));
+
+    QVERIFY(cache.write(10, QByteArray(10, 'a')));
+    QVERIFY(cache.write(50, QByteArray(10, 'b')));
+    QCOMPARE(describe(cache.segments(0, 100)), QStringLiteral("[0-10] 10-20 [20-50] 50-60 [60-100]"));
+    QCOMPARE(describe(cache.segments(15, 55)), QStringLiteral("15-20 [20-50] 50-55"));
+    QCOMPARE(describe(cache.segments(20, 50)), QStringLiteral("[20-50]"));
+
+    // adjacent and overlapping writes merge
+    QVERIFY(cache.write(20, QByteArray(5, 'c')));
+    QVERIFY(cache.write(45, QByteArray(20, 'd')));
+    QCOMPARE(describe(cache.segments(0, 100)), QStringLiteral("[0-10] 10-25 [25-45] 45-65 [65-100]"));
+    QVERIFY(cache.write(0, QByteArray(100, 'e')));
+    QCOMPARE(describe(cache.segments(0, 100)), QStringLiteral("0-100"));
+    QCOMPARE(cache.cachedBytes(), qint64(100));
+}
+
+void HTTPRangeCacheTest::testWriteRead()
+{
+    {
+        HTTPRangeCache cache(m_dir->path());
+        QVERIFY(!cache.open(key(1), false));
+        QVERIFY(cache.open(key(1), true));
+        cache.setValidator(validator("\"v1\""));
+        cache.setTotalSize(1 << 20);
+        cache.setMimeType(QStringLiteral("video/webm"));
+        cache.setExpireDate(1234);
+        // far from the start, the file is sparse
+        QVERIFY(cache.write(900000, "the end"));
+        QVERIFY(cache.write(0, "the start"));
+    }
+
+    HTTPRangeCache cache(m_dir->path());
+    QVERIFY(cache.open(key(1), false));
+    QVERIFY(cache.validator() == validator("\"v1\""));
+    QCOMPARE(cache.totalSize(), qint64(1 << 20));
+    QCOMPARE(cache.mimeType(), QStringLiteral("video/webm"));
+    QCOMPARE(cache.expireDate(), qint64(1234));
+    QCOMPARE(cache.read(900000, 100), QByteArray("the end"));
+    QCOMPARE(cache.read(4, 5), QByteArray("start"));
+    QCOMPARE(describe(cache.segments(0, 1 << 20)), QStringLiteral("0-9 [9-900000] 900000-900007 [900007-1048576]"));
+}
+
+void HTTPRangeCacheTest::testValidatorChange()
+{
+    HTTPRangeCache cache(m_dir->path());
+    QVERIFY(cache.open(key(1), true));
+    cache.setValidator(validator("\"v1\""));
+    cache.setMimeType(QStringLiteral("audio/ogg"));
+    QVERIFY(cache.write(0, "version one"));
+
+    // the same validator keeps the data
+    cache.setValidator(validator("\"v1\""));
+    QCOMPARE(cache.cachedBytes(), qint64(11));
+
+    cache.setValidator(validator("\"v2\""));
+    QCOMPARE(cache.cachedBytes(), qint64(0));
+    QCOMPARE(cache.mimeType(), QString());
+    QCOMPARE(cache.read(0, 100), QByteArray());
+    cache.close();
+
+    QVERIFY(cache.open(key(1), false));
+    QVERIFY(cache.validator() == validator("\"v2\""));
+    QCOMPARE(describe(cache.segments(0, 11)), QStringLiteral("[0-11]"));
+}
+
+void HTTPRangeCacheTest::testLocking()
+{
+    HTTPRangeCache first(m_dir->path());
+    HTTPRangeCache second(m_dir->path());
+    QVERIFY(first.open(key(1), true));
+    QVERIFY(!second.open(key(1), true));
+    QVERIFY(second.open(key(2), true));
+    first.close();
+    QVERIFY(second.open(key(1), false));
+}
+
+void HTTPRangeCacheTest::testTrim()
+{
+    HTTPRangeCache cache(m_dir->path());
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(cache.open(key(i), true));
+        cache.setValidator(validator("\"v\""));
+        QVERIFY(cache.write(0, QByteArray(1000, 'x')));
+        cache.close();
+        // distinct modification times, the oldest entry goes first
+        QTest::qWait(1100);
+    }
+    // reading counts as a use
+    QVERIFY(cache.open(key(0), false));
+    QCOMPARE(cache.read(0, 10).size(), 10);
+    cache.close();
+
+    HTTPRangeCache::trim(m_dir->path(), 2000);
+    QVERIFY(cache.open(key(0), false));
+    cache.close();
+    QVERIFY(!cache.open(key(1), false));
+    QVERIFY(cache.open(key(2), false));
+    cache.close();
+
+    HTTPRangeCache::clear(m_dir->path());
+    QVERIFY(!cache.open(key(0), false));
+    QVERIFY(!cache.open(key(2), false));
+}
+
+#include "httprangecachetest.moc"
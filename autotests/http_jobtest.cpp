@@ -5,13 +5,21 @@
     SPDX-License-Identifier: LGPL-2.0-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
 */
 
+#include <QBuffer>
+#include <QDir>
 #include <QSignalSpy>
 #include <QStandardPaths>
+#include <QTemporaryDir>
 #include <QTest>
 
 #include "httpserver_p.h"
+#include <kio/filecopyjob.h>
+#include <kio/filejob.h>
+#include <kio/multigetjob.h>
 #include <kio/storedtransferjob.h>
 
+#include <memory>
+
 class HTTPJobTest : public QObject
 {
     Q_OBJECT
@@ -21,8 +29,85 @@ private Q_SLOTS:
     void testBasicGet();
     void testErrorPage();
     void testMimeTypeDetermination();
+    void testPost_data();
+    void testPost();
+    void testPostAuthRetry_data();
+    void testPostAuthRetry();
+    void testCopyFromFile_data();
+    void testCopyFromFile();
+    void testOpenReadSeek();
+    void testOpenWithoutRanges();
+    void testKeepAliveWorkerReuse();
+    void testMultiGetPipelining();
+    void testMultiGetHttp10();
+    void testMultiGetPipeliningBroken();
+    void testUncachedGet();
+    void testStaleWhileRevalidate();
+    void testStaleOutsideWindow();
+    void testStaleIfError();
+
+private:
+    static QByteArray getContent(const QString &url);
+    static QMap<long, QByteArray> multiGet(const QString &endPoint, int count);
+    static QByteArray readFileJob(KIO::FileJob *job, KIO::filesize_t size);
+    static bool seekFileJob(KIO::FileJob *job, KIO::filesize_t offset);
 };
 
+static QByteArray makeContent(int size)
+{
+    QByteArray ret;
+    ret.reserve(size);
+    for (int i = 0; i < size; ++i) {
+        ret.append(char('a' + (i * 7 + i / 26) % 26));
+    }
+    return ret;
+}
+
+// Gets url with the default cache policy, returns the content or nothing on error
+QByteArray HTTPJobTest::getContent(const QString &url)
+{
+    KIO::StoredTransferJob *job = KIO::storedGet(QUrl(url), KIO::NoReload, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    return job->exec() ? job->data() : QByteArray();
+}
+
+// Gets endPoint/0 to endPoint/<count - 1> in one multi_get, returns what was received for each id
+QMap<long, QByteArray> HTTPJobTest::multiGet(const QString &endPoint, int count)
+{
+    KIO::MetaData metaData;
+    metaData.insert(QStringLiteral("cache"), QStringLiteral("reload"));
+    KIO::MultiGetJob *job = KIO::multi_get(0, QUrl(endPoint + QLatin1String("/0")), metaData);
+    job->setUiDelegate(nullptr);
+    for (int i = 1; i < count; ++i) {
+        job->get(i, QUrl(endPoint + QLatin1Char('/') + QString::number(i)), metaData);
+    }
+    QMap<long, QByteArray> received;
+    connect(job, &KIO::MultiGetJob::dataReceived, job, [&received](long id, const QByteArray &data) {
+        received[id] += data;
+    });
+    if (!job->exec()) {
+        received.clear();
+    }
+    return received;
+}
+
+QByteArray HTTPJobTest::readFileJob(KIO::FileJob *job, KIO::filesize_t size)
+{
+    QSignalSpy dataSpy(job, &KIO::FileJob::data);
+    job->read(size);
+    if (!dataSpy.wait()) {
+        return "timeout";
+    }
+    return dataSpy.at(0).at(1).toByteArray();
+}
+
+bool HTTPJobTest::seekFileJob(KIO::FileJob *job, KIO::filesize_t offset)
+{
+    QSignalSpy positionSpy(job, &KIO::FileJob::position);
+    job->seek(offset);
+    return positionSpy.wait() && positionSpy.at(0).at(1).value<KIO::filesize_t>() == offset;
+}
+
 void HTTPJobTest::initTestCase()
 {
     QStandardPaths::setTestModeEnabled(true);
@@ -31,6 +116,8 @@ void HTTPJobTest::initTestCase()
     qputenv("KDE_FORK_SLAVES", "yes");
     // To let ctest exit, we shouldn't start kio_http_cache_cleaner
     qputenv("KIO_DISABLE_CACHE_CLEANER", "yes");
+    // the ports of the servers repeat between runs, so must not find entries from a previous one
+    QDir(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/kio_http")).removeRecursively();
 }
 
 void HTTPJobTest::testBasicGet()
@@ -106,5 +193,321 @@ void HTTPJobTest::testMimeTypeDetermination()
     QCOMPARE(mimeTypeFoundSpy.at(0).at(1).toString(), QStringLiteral("text/html"));
 }
 
+void HTTPJobTest::testPost_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("sizeKnown");
+    QTest::addColumn<bool>("http11Connection");
+
+    QTest::newRow("small") << 1000 << true << false;
+    // chunks only go to a server that answered with HTTP/1.1 on the connection before
+    QTest::newRow("small, size unknown") << 1000 << false << false;
+    QTest::newRow("small, chunked") << 1000 << false << true;
+    // kept in a temporary file for sending it again
+    QTest::newRow("large") << 3 * 1024 * 1024 << true << false;
+    QTest::newRow("large, size unknown") << 3 * 1024 * 1024 << false << false;
+    QTest::newRow("large, chunked") << 3 * 1024 * 1024 << false << true;
+}
+
+void HTTPJobTest::testPost()
+{
+    QFETCH(int, size);
+    QFETCH(bool, sizeKnown);
+    QFETCH(bool, http11Connection);
+
+    HttpServerThread server("OK", HttpServerThread::KeepAlive);
+    if (http11Connection) {
+        // the idle worker keeping this connection gets the post, see testKeepAliveWorkerReuse()
+        KIO::StoredTransferJob *getJob = KIO::storedGet(QUrl(server.endPoint()), KIO::Reload, KIO::HideProgressInfo);
+        getJob->setUiDelegate(nullptr);
+        QVERIFY(getJob->exec());
+    }
+    QByteArray postData = makeContent(size);
+    QBuffer device(&postData);
+    QVERIFY(device.open(QIODevice::ReadOnly));
+
+    KIO::StoredTransferJob *job = KIO::storedHttpPost(&device, QUrl(server.endPoint()), sizeKnown ? size : -1);
+    job->setUiDelegate(nullptr);
+    QVERIFY(job->exec());
+    QCOMPARE(job->data(), QByteArray("OK"));
+    QCOMPARE(server.header("Transfer-Encoding"), http11Connection ? QByteArray("chunked") : QByteArray());
+    QCOMPARE(server.receivedData().size(), size);
+    QVERIFY(server.receivedData() == postData);
+}
+
+void HTTPJobTest::testPostAuthRetry_data()
+{
+    QTest::addColumn<bool>("sizeKnown");
+
+    QTest::newRow("size known") << true;
+    QTest::newRow("size unknown") << false;
+}
+
+void HTTPJobTest::testPostAuthRetry()
+{
+    QFETCH(bool, sizeKnown);
+
+    // larger than what is kept in memory for sending it again
+    const int size = 3 * 1024 * 1024;
+    HttpServerThread server("OK", HttpServerThread::BasicAuth);
+    QByteArray postData = makeContent(size);
+    QBuffer device(&postData);
+    QVERIFY(device.open(QIODevice::ReadOnly));
+
+    // the body goes out before the server asks for the credentials
+    QUrl url(server.endPoint());
+    url.setUserName(QStringLiteral("kdab"));
+    url.setPassword(QStringLiteral("testpass"));
+    KIO::StoredTransferJob *job = KIO::storedHttpPost(&device, url, sizeKnown ? size : -1, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QCOMPARE(job->data(), QByteArray("OK"));
+    QCOMPARE(server.requestCount(), 2);
+    QCOMPARE(server.receivedData().size(), size);
+    QVERIFY(server.receivedData() == postData);
+}
+
+void HTTPJobTest::testCopyFromFile_data()
+{
+    QTest::addColumn<bool>("overwrite");
+
+    QTest::newRow("new") << false;
+    QTest::newRow("overwrite") << true;
+}
+
+void HTTPJobTest::testCopyFromFile()
+{
+    QFETCH(bool, overwrite);
+
+    // larger than what kio_http hands to the kernel at once
+    const QByteArray content = makeContent(3 * 1024 * 1024 + 123);
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString srcPath = tempDir.filePath(QStringLiteral("upload"));
+    QFile srcFile(srcPath);
+    QVERIFY(srcFile.open(QIODevice::WriteOnly));
+    QCOMPARE(srcFile.write(content), qint64(content.size()));
+    srcFile.close();
+
+    HttpServerThread server("OK", HttpServerThread::Public);
+    // sent by the worker itself from the file, without a put()
+    KIO::Job *job = KIO::file_copy(QUrl::fromLocalFile(srcPath), QUrl(server.endPoint()), -1, (overwrite ? KIO::Overwrite : KIO::DefaultFlags) | KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QVERIFY(server.receivedHeaders().startsWith("PUT /path "));
+    QCOMPARE(server.header("Content-Length"), QByteArray::number(content.size()));
+    QCOMPARE(server.receivedData().size(), content.size());
+    QVERIFY(server.receivedData() == content);
+}
+
+void HTTPJobTest::testOpenReadSeek()
+{
+    // larger than the first range kio_http asks for
+    const QByteArray content = makeContent(300 * 1024);
+    HttpServerThread server(content, HttpServerThread::Ranges);
+    server.setContentType("application/octet-stream");
+
+    KIO::FileJob *job = KIO::open(QUrl(server.endPoint()), QIODevice::ReadOnly);
+    job->setUiDelegate(nullptr);
+    QSignalSpy openSpy(job, &KIO::FileJob::open);
+    QSignalSpy resultSpy(job, &KJob::result);
+    QVERIFY(openSpy.wait());
+    QCOMPARE(job->size(), KIO::filesize_t(content.size()));
+    QCOMPARE(job->mimeType(), QStringLiteral("application/octet-stream"));
+    QCOMPARE(server.header("Range"), QByteArray("bytes=0-65535"));
+
+    // served from what was read while opening
+    QCOMPARE(readFileJob(job, 1000), content.left(1000));
+    QCOMPARE(server.requestCount(), 1);
+
+    // random access
+    QVERIFY(seekFileJob(job, 250000));
+    QCOMPARE(readFileJob(job, 5000), content.mid(250000, 5000));
+    QCOMPARE(server.requestCount(), 2);
+    QCOMPARE(server.header("If-Range"), QByteArray("\"version1\""));
+    QVERIFY(seekFileJob(job, 1000));
+    QCOMPARE(readFileJob(job, 10), content.mid(1000, 10));
+
+    // sequential reading takes ever larger ranges
+    QVERIFY(seekFileJob(job, 0));
+    QByteArray all;
+    const int requestsBefore = server.requestCount();
+    while (all.size() < content.size()) {
+        const QByteArray data = readFileJob(job, 4096);
+        QVERIFY(!data.isEmpty());
+        all += data;
+    }
+    QCOMPARE(all, content);
+    QVERIFY2(server.requestCount() - requestsBefore <= 4, QByteArray::number(server.requestCount() - requestsBefore).constData());
+
+    // at the end
+    QCOMPARE(readFileJob(job, 100), QByteArray());
+    QVERIFY(seekFileJob(job, content.size() - 10));
+    QCOMPARE(readFileJob(job, 100), content.right(10));
+
+    job->close();
+    QVERIFY(resultSpy.wait());
+    QCOMPARE(job->error(), 0);
+}
+
+void HTTPJobTest::testOpenWithoutRanges()
+{
+    // all of a small resource is fine
+    const QByteArray smallContent = makeContent(1000);
+    HttpServerThread server(smallContent, HttpServerThread::Public);
+    KIO::FileJob *job = KIO::open(QUrl(server.endPoint()), QIODevice::ReadOnly);
+    job->setUiDelegate(nullptr);
+    QSignalSpy openSpy(job, &KIO::FileJob::open);
+    QSignalSpy resultSpy(job, &KJob::result);
+    QVERIFY(openSpy.wait());
+    QCOMPARE(job->size(), KIO::filesize_t(smallContent.size()));
+    QVERIFY(seekFileJob(job, 500));
+    QCOMPARE(readFileJob(job, 1000), smallContent.mid(500));
+    job->close();
+    QVERIFY(resultSpy.wait());
+    QCOMPARE(job->error(), 0);
+
+    // a large one can't be read piecewise
+    server.setResponseData(makeContent(300 * 1024));
+    job = KIO::open(QUrl(server.endPoint()), QIODevice::ReadOnly);
+    job->setUiDelegate(nullptr);
+    QSignalSpy failedResultSpy(job, &KJob::result);
+    QVERIFY(failedResultSpy.wait());
+    QCOMPARE(job->error(), int(KIO::ERR_UNSUPPORTED_ACTION));
+}
+
+void HTTPJobTest::testKeepAliveWorkerReuse()
+{
+    // two servers on the same host, only the port tells them apart
+    HttpServerThread server1("first", HttpServerThread::KeepAlive);
+    HttpServerThread server2("second", HttpServerThread::KeepAlive);
+
+    // a worker for each, both running at the same time
+    KIO::StoredTransferJob *job1 = KIO::storedGet(QUrl(server1.endPoint()), KIO::Reload, KIO::HideProgressInfo);
+    KIO::StoredTransferJob *job2 = KIO::storedGet(QUrl(server2.endPoint()), KIO::Reload, KIO::HideProgressInfo);
+    job1->setUiDelegate(nullptr);
+    job2->setUiDelegate(nullptr);
+    QSignalSpy result1Spy(job1, &KJob::result);
+    QSignalSpy result2Spy(job2, &KJob::result);
+    QTRY_COMPARE(result1Spy.count() + result2Spy.count(), 2);
+    QCOMPARE(job1->data(), QByteArray("first"));
+    QCOMPARE(job2->data(), QByteArray("second"));
+
+    // the idle worker still connected to the server is the one that gets the next job
+    for (int i = 0; i < 3; ++i) {
+        for (HttpServerThread *server : {&server1, &server2}) {
+            KIO::StoredTransferJob *job = KIO::storedGet(QUrl(server->endPoint()), KIO::Reload, KIO::HideProgressInfo);
+            job->setUiDelegate(nullptr);
+            QVERIFY(job->exec());
+        }
+    }
+    QCOMPARE(server1.requestCount(), 4);
+    QCOMPARE(server2.requestCount(), 4);
+    QCOMPARE(server1.connectionCount(), 1);
+    QCOMPARE(server2.connectionCount(), 1);
+}
+
+void HTTPJobTest::testMultiGetPipelining()
+{
+    HttpServerThread server("", HttpServerThread::KeepAlive | HttpServerThread::Pipelining | HttpServerThread::EchoPath);
+    const QMap<long, QByteArray> received = multiGet(server.endPoint(), 10);
+    QCOMPARE(received.size(), 10);
+    for (long id = 0; id < 10; ++id) {
+        QCOMPARE(received.value(id), QByteArray("/path/" + QByteArray::number(int(id))));
+    }
+    QCOMPARE(server.requestCount(), 10);
+    QCOMPARE(server.connectionCount(), 1);
+    // no more requests in flight than DEFAULT_PIPELINE_DEPTH
+    QVERIFY2(server.maxQueuedRequests() > 1, QByteArray::number(server.maxQueuedRequests()).constData());
+    QVERIFY2(server.maxQueuedRequests() <= 4, QByteArray::number(server.maxQueuedRequests()).constData());
+}
+
+void HTTPJobTest::testMultiGetHttp10()
+{
+    // only HTTP/1.1 servers get pipelined requests
+    HttpServerThread server("", HttpServerThread::KeepAlive | HttpServerThread::Pipelining | HttpServerThread::EchoPath | HttpServerThread::Http10);
+    const QMap<long, QByteArray> received = multiGet(server.endPoint(), 5);
+    QCOMPARE(received.size(), 5);
+    for (long id = 0; id < 5; ++id) {
+        QCOMPARE(received.value(id), QByteArray("/path/" + QByteArray::number(int(id))));
+    }
+    QCOMPARE(server.requestCount(), 5);
+    QCOMPARE(server.maxQueuedRequests(), 1);
+}
+
+void HTTPJobTest::testMultiGetPipeliningBroken()
+{
+    // the server drops what was pipelined behind a request, kio_http sends it again
+    HttpServerThread server("", HttpServerThread::KeepAlive | HttpServerThread::BreakPipelining | HttpServerThread::EchoPath);
+    const QMap<long, QByteArray> received = multiGet(server.endPoint(), 10);
+    QCOMPARE(received.size(), 10);
+    for (long id = 0; id < 10; ++id) {
+        QCOMPARE(received.value(id), QByteArray("/path/" + QByteArray::number(int(id))));
+    }
+    QVERIFY(server.maxQueuedRequests() > 1);
+    QVERIFY(server.connectionCount() > 1);
+}
+
+void HTTPJobTest::testUncachedGet()
+{
+    HttpServerThread server("content", HttpServerThread::Public);
+    server.setContentType("text/plain");
+    server.setResponseHeaders("Cache-Control: no-store\r\n");
+    QCOMPARE(getContent(server.endPoint()), QByteArray("content"));
+    QCOMPARE(getContent(server.endPoint()), QByteArray("content"));
+    QCOMPARE(server.requestCount(), 2);
+}
+
+void HTTPJobTest::testStaleWhileRevalidate()
+{
+    HttpServerThread server("old content", HttpServerThread::Public);
+    server.setContentType("text/plain");
+    server.setResponseHeaders("Cache-Control: max-age=1, stale-while-revalidate=60\r\nETag: \"v1\"\r\n");
+    QCOMPARE(getContent(server.endPoint()), QByteArray("old content"));
+    QCOMPARE(server.requestCount(), 1);
+
+    // stale, but within the window: served from the cache, then revalidated in the background
+    QTest::qWait(2000);
+    server.setResponseData("new content");
+    QCOMPARE(getContent(server.endPoint()), QByteArray("old content"));
+    QTRY_COMPARE(server.requestCount(), 2);
+    QCOMPARE(server.header("If-None-Match"), QByteArray("\"v1\""));
+}
+
+void HTTPJobTest::testStaleOutsideWindow()
+{
+    HttpServerThread server("old content", HttpServerThread::Public);
+    server.setContentType("text/plain");
+    server.setResponseHeaders("Cache-Control: max-age=1, stale-while-revalidate=1\r\nETag: \"v1\"\r\n");
+    QCOMPARE(getContent(server.endPoint()), QByteArray("old content"));
+
+    // too stale to be served before it is validated
+    QTest::qWait(3000);
+    server.setResponseData("new content");
+    QCOMPARE(getContent(server.endPoint()), QByteArray("new content"));
+    QCOMPARE(server.requestCount(), 2);
+    QCOMPARE(server.header("If-None-Match"), QByteArray("\"v1\""));
+}
+
+void HTTPJobTest::testStaleIfError()
+{
+    auto server = std::make_unique<HttpServerThread>("old content", HttpServerThread::Public);
+    server->setContentType("text/plain");
+    server->setResponseHeaders("Cache-Control: max-age=1, stale-if-error=60\r\nETag: \"v1\"\r\n");
+    const QString endPoint = server->endPoint();
+    QCOMPARE(getContent(endPoint), QByteArray("old content"));
+    QTest::qWait(2000);
+
+    // the stale entry stands in for a server error...
+    server->setFeatures(HttpServerThread::Error503);
+    server->setResponseData("error page");
+    QCOMPARE(getContent(endPoint), QByteArray("old content"));
+    QCOMPARE(server->requestCount(), 2);
+
+    // ...and for a server that can't be reached
+    server.reset();
+    QCOMPARE(getContent(endPoint), QByteArray("old content"));
+}
+
 QTEST_MAIN(HTTPJobTest)
 #include "http_jobtest.moc"
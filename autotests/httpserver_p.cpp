@@ -23,6 +23,33 @@ static bool splitHeadersAndData(const QByteArray &request, QByteArray &header, Q
     return true;
 }
 
+// Returns false while the last chunk is missing
+static bool decodeChunkedData(const QByteArray &data, QByteArray &decoded)
+{
+    decoded.clear();
+    int pos = 0;
+    while (true) {
+        const int lineEnd = data.indexOf("\r\n", pos);
+        if (lineEnd < 0) {
+            return false;
+        }
+        bool ok = false;
+        const int size = data.mid(pos, lineEnd - pos).toInt(&ok, 16);
+        if (!ok) {
+            return false;
+        }
+        pos = lineEnd + 2;
+        if (size == 0) {
+            return data.indexOf("\r\n", pos) >= 0;
+        }
+        if (data.size() < pos + size + 2) {
+            return false;
+        }
+        decoded += data.mid(pos, size);
+        pos += size + 2;
+    }
+}
+
 typedef QMap<QByteArray, QByteArray> HeadersMap;
 static HeadersMap parseHeaders(const QByteArray &headerData)
 {
@@ -39,7 +66,7 @@ static HeadersMap parseHeaders(const QByteArray &headerData)
     const QByteArray request = firstLine[0];
     const QByteArray path = firstLine[1];
     const QByteArray httpVersion = firstLine[2];
-    if (request != "GET" && request != "POST") {
+    if (request != "GET" && request != "POST" && request != "PUT") {
         qDebug() << "Unknown HTTP request:" << firstLine;
         return headersMap;
     }
@@ -60,6 +87,26 @@ static HeadersMap parseHeaders(const QByteArray &headerData)
     return headersMap;
 }
 
+// Returns the size of the first request in @p buffer, or -1 while it isn't complete
+static int completeRequestSize(const QByteArray &buffer)
+{
+    QByteArray header;
+    QByteArray data;
+    if (!splitHeadersAndData(buffer, header, data)) {
+        return -1;
+    }
+    const HeadersMap headers = parseHeaders(header);
+    if (headers.value("Transfer-Encoding") == "chunked") {
+        QByteArray decoded;
+        return decodeChunkedData(data, decoded) ? buffer.size() : -1;
+    }
+    const int contentLength = headers.value("Content-Length").toInt();
+    if (contentLength > data.size()) {
+        return -1;
+    }
+    return buffer.size() - data.size() + contentLength;
+}
+
 enum Method { None, Basic, Plain, Login, Ntlm, CramMd5, DigestMd5 };
 
 static void parseAuthLine(const QString &str, Method *method, QString *headerVal)
@@ -84,25 +131,74 @@ static void parseAuthLine(const QString &str, Method *method, QString *headerVal
 
 QByteArray HttpServerThread::makeHttpResponse(const QByteArray &responseData) const
 {
-    QByteArray httpResponse;
+    static const QByteArray etag = "\"version1\"";
+    QByteArray body = responseData;
+    QByteArray contentRange;
+    bool unsatisfiable = false;
+    if (m_features & Ranges) {
+        // a single range, "bytes=first-last" or "bytes=first-"
+        const QByteArray range = m_headers.value("Range");
+        const QByteArray ifRange = m_headers.value("If-Range");
+        if (range.startsWith("bytes=") && (ifRange.isEmpty() || ifRange == etag)) {
+            const QList<QByteArray> bounds = range.mid(6).split('-');
+            const int first = bounds.value(0).toInt();
+            int last = responseData.size() - 1;
+            if (!bounds.value(1).isEmpty()) {
+                last = qMin(last, bounds.value(1).toInt());
+            }
+            if (first > last) {
+                unsatisfiable = true;
+                body.clear();
+                contentRange = "bytes */" + QByteArray::number(responseData.size());
+            } else {
+                body = responseData.mid(first, last - first + 1);
+                contentRange = "bytes " + QByteArray::number(first) + '-' + QByteArray::number(last) + '/' + QByteArray::number(responseData.size());
+            }
+        }
+    }
+
+    if (m_features & EchoPath) {
+        body = m_headers.value("_path");
+    }
+
+    QByteArray httpResponse = (m_features & Http10) ? "HTTP/1.0 " : "HTTP/1.1 ";
     if (m_features & Error404) {
-        httpResponse += "HTTP/1.1 404 Not Found\r\n";
+        httpResponse += "404 Not Found\r\n";
+    } else if (m_features & Error503) {
+        httpResponse += "503 Service Unavailable\r\n";
+    } else if (unsatisfiable) {
+        httpResponse += "416 Range Not Satisfiable\r\n";
+    } else if (!contentRange.isEmpty()) {
+        httpResponse += "206 Partial Content\r\n";
     } else {
-        httpResponse += "HTTP/1.1 200 OK\r\n";
+        httpResponse += "200 OK\r\n";
     }
     if (!m_contentType.isEmpty()) {
         httpResponse += "Content-Type: " + m_contentType + "\r\n";
     }
     httpResponse += "Mozilla/5.0 (X11; Linux x86_64) KHTML/5.20.0 (like Gecko) Konqueror/5.20\r\n";
+    if (m_features & Ranges) {
+        httpResponse += "Accept-Ranges: bytes\r\n";
+        httpResponse += "ETag: " + etag + "\r\n";
+    }
+    if (!contentRange.isEmpty()) {
+        httpResponse += "Content-Range: " + contentRange + "\r\n";
+    }
+    httpResponse += m_responseHeaders;
     httpResponse += "Content-Length: ";
-    httpResponse += QByteArray::number(responseData.size());
+    httpResponse += QByteArray::number(body.size());
     httpResponse += "\r\n";
 
     // We don't support multiple connections so let's ask the client
-    // to close the connection every time.
-    httpResponse += "Connection: close\r\n";
+    // to close the connection every time, unless it is to read ranges
+    // of one resource or we were asked to keep it.
+    if (!(m_features & (Ranges | KeepAlive))) {
+        httpResponse += "Connection: close\r\n";
+    } else if (m_features & Http10) {
+        httpResponse += "Connection: keep-alive\r\n";
+    }
     httpResponse += "\r\n";
-    httpResponse += responseData;
+    httpResponse += body;
     return httpResponse;
 }
 
@@ -135,13 +231,17 @@ void HttpServerThread::run()
     // Wait for first connection (we'll wait for further ones inside the loop)
     QTcpSocket *clientSocket = m_server->waitForNextConnectionSocket();
     Q_ASSERT(clientSocket);
+    lock.relock();
+    ++m_connectionCount;
+    lock.unlock();
 
     Q_FOREVER {
-        // get the "request" packet
+        // get the "request" packet, unless a pipelined one is waiting already
         if (doDebug) {
             qDebug() << "HttpServerThread: waiting for read";
         }
-        if (clientSocket->state() == QAbstractSocket::UnconnectedState || !clientSocket->waitForReadyRead(2000)) {
+        if (completeRequestSize(m_partialRequest) == -1
+            && (clientSocket->state() == QAbstractSocket::UnconnectedState || !clientSocket->waitForReadyRead(2000))) {
             if (clientSocket->state() == QAbstractSocket::UnconnectedState) {
                 delete clientSocket;
                 if (doDebug) {
@@ -149,42 +249,66 @@ void HttpServerThread::run()
                 }
                 clientSocket = m_server->waitForNextConnectionSocket();
                 Q_ASSERT(clientSocket);
+                lock.relock();
+                ++m_connectionCount;
+                lock.unlock();
                 continue; // go to "waitForReadyRead"
+            } else if (m_features & (Ranges | KeepAlive)) {
+                // an idle keep-alive connection; serve another client if there is one
+                if (QTcpSocket *nextSocket = m_server->waitForNextConnectionSocket(0)) {
+                    delete clientSocket;
+                    clientSocket = nextSocket;
+                    lock.relock();
+                    ++m_connectionCount;
+                    lock.unlock();
+                }
+                continue;
             } else {
                 const auto clientSocketError = clientSocket->error();
                 qDebug() << "HttpServerThread:" << clientSocketError << "waiting for \"request\" packet";
                 break;
             }
         }
-        const QByteArray request = m_partialRequest + clientSocket->readAll();
+        QByteArray request = m_partialRequest + clientSocket->readAll();
+        if (m_features & (Pipelining | BreakPipelining)) {
+            // give the requests sent along with this one the time to arrive
+            while (clientSocket->waitForReadyRead(100)) {
+                request += clientSocket->readAll();
+            }
+        }
         if (doDebug) {
             qDebug() << "HttpServerThread: request:" << request;
         }
 
-        // Split headers and request xml
-        lock.relock();
-        const bool splitOK = splitHeadersAndData(request, m_receivedHeaders, m_receivedData);
-        if (!splitOK) {
+        const int requestSize = completeRequestSize(request);
+        if (requestSize == -1) {
             // if (doDebug)
             //    qDebug() << "Storing partial request" << request;
             m_partialRequest = request;
             continue;
         }
+        // pipelined requests stay for the next rounds
+        m_partialRequest = request.mid(requestSize);
+        int queuedRequests = 1;
+        for (int pos = requestSize, size; (size = completeRequestSize(request.mid(pos))) != -1; pos += size) {
+            ++queuedRequests;
+        }
 
+        // Split headers and request xml
+        lock.relock();
+        splitHeadersAndData(request.left(requestSize), m_receivedHeaders, m_receivedData);
         m_headers = parseHeaders(m_receivedHeaders);
-
-        if (m_headers.value("Content-Length").toInt() > m_receivedData.size()) {
-            // if (doDebug)
-            //    qDebug() << "Storing partial request" << request;
-            m_partialRequest = request;
-            continue;
+        if (m_headers.value("Transfer-Encoding") == "chunked") {
+            QByteArray decoded;
+            decodeChunkedData(m_receivedData, decoded);
+            m_receivedData = decoded;
         }
-
-        m_partialRequest.clear();
+        m_maxQueuedRequests = qMax(m_maxQueuedRequests, queuedRequests);
 
         if (m_headers.value("_path").endsWith("terminateThread")) { // we're asked to exit
             break; // normal exit
         }
+        ++m_requestCount;
 
         lock.unlock();
 
@@ -242,6 +366,18 @@ void HttpServerThread::run()
         clientSocket->write(response);
 
         clientSocket->flush();
+
+        if ((m_features & BreakPipelining) && queuedRequests > 1) {
+            // drop the requests behind this one, like a server that can't pipeline
+            clientSocket->waitForBytesWritten(2000);
+            delete clientSocket;
+            m_partialRequest.clear();
+            clientSocket = m_server->waitForNextConnectionSocket();
+            Q_ASSERT(clientSocket);
+            lock.relock();
+            ++m_connectionCount;
+            lock.unlock();
+        }
     }
     // all done...
     delete clientSocket;
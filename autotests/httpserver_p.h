@@ -28,7 +28,14 @@ public:
         Ssl = 1, // HTTPS
         BasicAuth = 2, // Requires authentication
         Error404 = 4, // Return "404 not found"
-                      // bitfield, next item is 8
+        Ranges = 8, // Answer range requests, keep the connection alive
+        KeepAlive = 16, // Keep the connection alive
+        Pipelining = 32, // Wait a little for pipelined requests before answering one
+        BreakPipelining = 64, // Close the connection after answering a request that others were pipelined behind
+        Http10 = 128, // Answer with HTTP/1.0
+        EchoPath = 256, // Answer with the path of the request
+        Error503 = 512, // Return "503 Service Unavailable"
+                        // bitfield, next item is 1024
     };
     Q_DECLARE_FLAGS(Features, Feature)
 
@@ -57,6 +64,13 @@ public:
         m_dataToSend = data;
     }
 
+    // added to every response, each line ending with "\r\n"
+    void setResponseHeaders(const QByteArray &headers)
+    {
+        QMutexLocker lock(&m_mutex);
+        m_responseHeaders = headers;
+    }
+
     void setFeatures(Features features)
     {
         QMutexLocker lock(&m_mutex);
@@ -99,6 +113,25 @@ public:
         return m_headers.value(value);
     }
 
+    int requestCount() const
+    {
+        QMutexLocker lock(&m_mutex);
+        return m_requestCount;
+    }
+
+    int connectionCount() const
+    {
+        QMutexLocker lock(&m_mutex);
+        return m_connectionCount;
+    }
+
+    // the most requests that were waiting for an answer at once, more than 1 with pipelining
+    int maxQueuedRequests() const
+    {
+        QMutexLocker lock(&m_mutex);
+        return m_maxQueuedRequests;
+    }
+
 protected:
     /* \reimp */ void run() override;
 
@@ -110,12 +143,16 @@ private:
     QSemaphore m_ready;
     QByteArray m_dataToSend;
     QByteArray m_contentType;
+    QByteArray m_responseHeaders;
 
-    mutable QMutex m_mutex; // protects the 4 vars below
+    mutable QMutex m_mutex; // protects the 7 vars below
     QByteArray m_receivedData;
     QByteArray m_receivedHeaders;
     QMap<QByteArray, QByteArray> m_headers;
     int m_port;
+    int m_requestCount = 0;
+    int m_connectionCount = 0;
+    int m_maxQueuedRequests = 0;
 
     Features m_features;
     BlockingHttpServer *m_server;
@@ -137,9 +174,9 @@ public:
     {
     }
 
-    QTcpSocket *waitForNextConnectionSocket()
+    QTcpSocket *waitForNextConnectionSocket(int msecs = 20000) // 2000 would be enough, except in valgrind
     {
-        if (!waitForNewConnection(20000)) { // 2000 would be enough, except in valgrind
+        if (!waitForNewConnection(msecs)) {
             return nullptr;
         }
         if (doSsl) {
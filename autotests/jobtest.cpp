@@ -9,7 +9,9 @@
 #include "mockcoredelegateextensions.h"
 
 #include "kio/job.h"
+#include "job_p.h" // SimpleJobPrivate::m_slave
 #include "kiotesthelper.h" // createTestFile etc.
+#include <kio/checksumjob.h>
 #include <kio/chmodjob.h>
 #include <kio/copyjob.h>
 #include <kio/deletejob.h>
@@ -31,6 +33,7 @@
 #include <QHash>
 #include <QPointer>
 #include <QProcess>
+#include <QSet>
 #include <QSignalSpy>
 #include <QTemporaryFile>
 #include <QTest>
@@ -38,6 +41,9 @@
 #include <QVariant>
 
 #ifndef Q_OS_WIN
+#include <fcntl.h> // for utimensat
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h> // for readlink
 #endif
 
@@ -175,6 +181,81 @@ void JobTest::storedGet()
     QVERIFY(!spyPercent.isEmpty());
 }
 
+void JobTest::storedGetDeadlineExpired()
+{
+    const QString filePath = homeTmpDir() + "fileFromHome";
+    createTestFile(filePath);
+
+    KIO::StoredTransferJob *job = KIO::storedGet(QUrl::fromLocalFile(filePath), KIO::NoReload, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    // A deadline in the past makes the worker abort before sending any data
+    job->addMetaData(QStringLiteral("deadline"), QString::number(QDateTime::currentMSecsSinceEpoch() - 1000));
+    QVERIFY(!job->exec());
+    QCOMPARE(job->error(), KIO::ERR_SERVER_TIMEOUT);
+    QVERIFY(job->data().isEmpty());
+
+    // The worker is still usable for the next job
+    KIO::StoredTransferJob *job2 = KIO::storedGet(QUrl::fromLocalFile(filePath), KIO::NoReload, KIO::HideProgressInfo);
+    job2->setUiDelegate(nullptr);
+    QVERIFY2(job2->exec(), qPrintable(job2->errorString()));
+    QCOMPARE(job2->data(), QByteArray("Hello\0world", 11));
+}
+
+void JobTest::killedGetReusesWorker()
+{
+    // Much more than fits in the socket to the worker
+    const QString filePath = homeTmpDir() + "bigFileToCancel";
+    createTestFile(filePath, false, QByteArray(16 * 1024 * 1024, 'x'));
+
+    KIO::TransferJob *job = KIO::get(QUrl::fromLocalFile(filePath), KIO::NoReload, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    QPointer<KIO::Slave> slave;
+    connect(job, &KIO::TransferJob::data, this, [&slave](KIO::Job *job) {
+        if (!slave) {
+            slave = KIO::SimpleJobPrivate::get(static_cast<KIO::SimpleJob *>(job))->m_slave;
+            // the worker blocks on sending once the socket is full
+            job->suspend();
+        }
+    });
+    QTRY_VERIFY(slave);
+    QTest::qWait(200);
+
+    QSignalSpy spyWorkerError(slave.data(), &KIO::SlaveInterface::error);
+    QSignalSpy spyWorkerFinished(slave.data(), &KIO::SlaveInterface::finished);
+    QElapsedTimer timer;
+    timer.start();
+    job->kill();
+    // CMD_CANCEL was sent, rather than killing the worker
+    QVERIFY(slave);
+    QVERIFY(slave->isAlive());
+    QVERIFY(slave->isCancelling());
+
+    // the worker aborts the get, well before the scheduler would give up on it
+    QTRY_COMPARE_WITH_TIMEOUT(spyWorkerError.count(), 1, 4000);
+    QVERIFY(timer.elapsed() < 5000);
+    QCOMPARE(spyWorkerError.at(0).at(0).toInt(), int(KIO::ERR_USER_CANCELED));
+    QCOMPARE(spyWorkerFinished.count(), 0);
+    QVERIFY(slave);
+    QVERIFY(slave->isAlive());
+    QVERIFY(!slave->isCancelling());
+
+    // and is back in the idle pool, for the next job
+    const QString smallFilePath = homeTmpDir() + "fileFromHome";
+    createTestFile(smallFilePath);
+    KIO::StoredTransferJob *job2 = KIO::storedGet(QUrl::fromLocalFile(smallFilePath), KIO::NoReload, KIO::HideProgressInfo);
+    job2->setUiDelegate(nullptr);
+    QPointer<KIO::Slave> slave2;
+    connect(job2, &KIO::TransferJob::data, this, [&slave2](KIO::Job *job) {
+        slave2 = KIO::SimpleJobPrivate::get(static_cast<KIO::SimpleJob *>(job))->m_slave;
+    });
+    QVERIFY2(job2->exec(), qPrintable(job2->errorString()));
+    QCOMPARE(job2->data(), QByteArray("Hello\0world", 11));
+    QVERIFY(slave2);
+    QCOMPARE(slave2.data(), slave.data());
+
+    QFile::remove(filePath);
+}
+
 void JobTest::slotGetResult(KJob *job)
 {
     m_result = job->error();
@@ -894,6 +975,54 @@ void JobTest::testCopyFilePermissionsToSamePartition()
 #endif
 }
 
+void JobTest::copySparseFile()
+{
+#if defined(Q_OS_UNIX)
+    const QString src = homeTmpDir() + "sparseFile";
+    const QString dest = otherTmpDir() + "sparseFile_copied";
+    const qint64 size = 32 * 1024 * 1024;
+    {
+        // data at the start and in the middle, holes in between and at the end
+        QFile file(src);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write("start"), 5);
+        QVERIFY(file.seek(size / 2));
+        QCOMPARE(file.write("middle"), 6);
+        QVERIFY(file.resize(size));
+    }
+    QT_STATBUF buff;
+    QCOMPARE(QT_STAT(QFile::encodeName(src).constData(), &buff), 0);
+    if (buff.st_blocks * 512 >= buff.st_size) {
+        QFile::remove(src);
+        QSKIP("The filesystem of the home directory doesn't support sparse files");
+    }
+
+    KIO::FileCopyJob *job = KIO::file_copy(QUrl::fromLocalFile(src), QUrl::fromLocalFile(dest), -1, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    // the holes count as copied
+    QCOMPARE(job->processedAmount(KJob::Bytes), qulonglong(size));
+
+    QFile copy(dest);
+    QVERIFY(copy.open(QIODevice::ReadOnly));
+    QCOMPARE(copy.size(), size);
+    QCOMPARE(copy.read(5), QByteArray("start"));
+    QCOMPARE(copy.read(10), QByteArray(10, '\0'));
+    QVERIFY(copy.seek(size / 2));
+    QCOMPARE(copy.read(6), QByteArray("middle"));
+    QVERIFY(copy.seek(size - 10));
+    QCOMPARE(copy.read(10), QByteArray(10, '\0'));
+    copy.close();
+
+    // the holes weren't filled with zeros
+    QCOMPARE(QT_STAT(QFile::encodeName(dest).constData(), &buff), 0);
+    QVERIFY2(buff.st_blocks * 512 < size / 4, qPrintable(QString::number(buff.st_blocks)));
+
+    QVERIFY(QFile::remove(dest));
+    QVERIFY(QFile::remove(src));
+#endif
+}
+
 void JobTest::copyDirectoryToOtherPartition()
 {
     // qDebug();
@@ -903,6 +1032,165 @@ void JobTest::copyDirectoryToOtherPartition()
     copyLocalDirectory(src, dest);
 }
 
+void JobTest::copyDirectoryInParallel()
+{
+    const QString src = homeTmpDir() + "dirWithManyFiles";
+    const QString dest = otherTmpDir() + "dirWithManyFiles_copied";
+    QVERIFY(QDir().mkpath(src + "/subdir"));
+    const int fileCount = 50;
+    QStringList fileNames;
+    for (int i = 0; i < fileCount; ++i) {
+        const QString fileName = QStringLiteral("file%1").arg(i);
+        createTestFile(src + '/' + fileName, false, QByteArray(1024 * i, 'a' + i % 26));
+        fileNames << fileName;
+        createTestFile(src + "/subdir/" + fileName);
+    }
+    // one conflict, which the parallel copy leaves to the sequential one
+    QVERIFY(QDir().mkpath(dest));
+    createTestFile(dest + "/file7", false, QByteArray("already there"));
+
+    KIO::CopyJob *job = KIO::copyAs(QUrl::fromLocalFile(src), QUrl::fromLocalFile(dest), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setUiDelegateExtension(nullptr);
+    job->setMaximumParallelCopies(4);
+    job->setWriteIntoExistingDirectories(true);
+    job->setAutoRename(true);
+    QSignalSpy spyCopyingDone(job, &KIO::CopyJob::copyingDone);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+
+    // all the files once, including the renamed one
+    QSet<QUrl> copiedFiles;
+    for (const QList<QVariant> &args : std::as_const(spyCopyingDone)) {
+        if (!args.at(4).toBool()) { // not a directory
+            QVERIFY(!copiedFiles.contains(args.at(1).toUrl()));
+            copiedFiles.insert(args.at(1).toUrl());
+        }
+    }
+    QCOMPARE(copiedFiles.size(), 2 * fileCount);
+    for (const QString &fileName : std::as_const(fileNames)) {
+        if (fileName != QLatin1String("file7")) {
+            QCOMPARE(QFileInfo(dest + '/' + fileName).size(), QFileInfo(src + '/' + fileName).size());
+        }
+        QVERIFY(QFile::exists(dest + "/subdir/" + fileName));
+    }
+    QCOMPARE(QFileInfo(dest + "/file7").size(), 13);
+    QCOMPARE(QFileInfo(dest + "/file7 (1)").size(), QFileInfo(src + "/file7").size());
+    QCOMPARE(job->processedAmount(KJob::Files), job->totalAmount(KJob::Files));
+
+    QDir(src).removeRecursively();
+    QDir(dest).removeRecursively();
+}
+
+void JobTest::copyDirectoryInWorker()
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD)
+    const QString src = homeTmpDir() + "dirCopiedInWorker";
+    const QString dest = homeTmpDir() + "dirCopiedInWorker_copied";
+    createTestDirectory(src);
+    createTestDirectory(src + "/subdir");
+    createTestFile(src + "/subdir/bigfile", false, QByteArray(3 * 1024 * 1024, 'x'));
+    setTimeStamp(src + "/subdir", s_referenceTimeStamp);
+
+    KIO::CopyJob *job = KIO::copyAs(QUrl::fromLocalFile(src), QUrl::fromLocalFile(dest), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setUiDelegateExtension(nullptr);
+    job->setCopyDirectoriesInWorker(true);
+    QSignalSpy spyCopyingDone(job, &KIO::CopyJob::copyingDone);
+    QSignalSpy spyCopyingLinkDone(job, &KIO::CopyJob::copyingLinkDone);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+
+    // dest, subdir, testfile in both, bigfile; and the two symlinks
+    QCOMPARE(spyCopyingDone.count(), 5);
+    QCOMPARE(spyCopyingLinkDone.count(), 2);
+    QCOMPARE(spyCopyingDone.at(0).at(2).toUrl(), QUrl::fromLocalFile(dest));
+    QCOMPARE(job->processedAmount(KJob::Bytes), job->totalAmount(KJob::Bytes));
+    QCOMPARE(job->totalAmount(KJob::Files), 5);
+
+    QVERIFY(QFileInfo(dest + "/testfile").isFile());
+    QVERIFY(QFileInfo(dest + "/testlink").isSymLink());
+    QCOMPARE(QFileInfo(dest + "/subdir/bigfile").size(), 3 * 1024 * 1024);
+    QVERIFY(QFileInfo(dest + "/subdir/testlink").isSymLink());
+    QCOMPARE(QFileInfo(dest).lastModified(), QFileInfo(src).lastModified());
+    QCOMPARE(QFileInfo(dest + "/subdir").lastModified(), QFileInfo(src + "/subdir").lastModified());
+    QCOMPARE(QFileInfo(dest + "/testfile").lastModified(), QFileInfo(src + "/testfile").lastModified());
+
+    // The destination exists now, so the tree is copied the usual way, into it
+    job = KIO::copy(QUrl::fromLocalFile(src), QUrl::fromLocalFile(dest), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setUiDelegateExtension(nullptr);
+    job->setCopyDirectoriesInWorker(true);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QCOMPARE(QFileInfo(dest + "/dirCopiedInWorker/subdir/bigfile").size(), 3 * 1024 * 1024);
+
+    // With default permissions the files get what the umask leaves, not the source's ones
+    QVERIFY(QDir(dest).removeRecursively());
+    QCOMPARE(::chmod(QFile::encodeName(src + "/testfile").constData(), S_IRUSR | S_IWUSR), 0);
+    job = KIO::copyAs(QUrl::fromLocalFile(src), QUrl::fromLocalFile(dest), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setUiDelegateExtension(nullptr);
+    job->setDefaultPermissions(true);
+    job->setCopyDirectoriesInWorker(true);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    const mode_t mask = ::umask(0);
+    ::umask(mask);
+    QT_STATBUF destBuff;
+    QCOMPARE(QT_LSTAT(QFile::encodeName(dest + "/testfile").constData(), &destBuff), 0);
+    QCOMPARE(destBuff.st_mode & 07777, 0666 & ~mask);
+
+    QDir(src).removeRecursively();
+    QDir(dest).removeRecursively();
+#else
+    QSKIP("Only copied in the worker on Linux and FreeBSD");
+#endif
+}
+
+void JobTest::copyFileVerified()
+{
+    // Verified by kio_file while copying
+    const QString src = homeTmpDir() + "fileToVerify";
+    const QString dest = otherTmpDir() + "fileToVerify_copied";
+    createTestFile(src, false, QByteArray(3 * 1024 * 1024 + 5, 'v'));
+    KIO::FileCopyJob *job = KIO::file_copy(QUrl::fromLocalFile(src), QUrl::fromLocalFile(dest), -1, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setVerifyCopy(true);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QCOMPARE(QFileInfo(dest).size(), QFileInfo(src).size());
+    QVERIFY(QFile::remove(dest));
+
+    // Through the data pump, hashed on the way, and the destination hashed afterwards
+    job = KIO::file_copy(QUrl(QStringLiteral("data:,Hello%20world")), QUrl::fromLocalFile(dest), -1, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setVerifyCopy(true);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QFile destFile(dest);
+    QVERIFY(destFile.open(QIODevice::ReadOnly));
+    QCOMPARE(destFile.readAll(), QByteArray("Hello world"));
+    destFile.close();
+
+    QVERIFY(QFile::remove(dest));
+    QVERIFY(QFile::remove(src));
+}
+
+void JobTest::moveDirectoryVerified()
+{
+    const QString src = homeTmpDir() + "dirToVerify";
+    const QString dest = otherTmpDir() + "dirToVerify_moved";
+    createTestDirectory(src);
+    createTestFile(src + "/bigfile", false, QByteArray(2 * 1024 * 1024, 'x'));
+
+    KIO::CopyJob *job = KIO::moveAs(QUrl::fromLocalFile(src), QUrl::fromLocalFile(dest), KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setUiDelegateExtension(nullptr);
+    job->setVerifyCopies(true);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+
+    QVERIFY(!QFile::exists(src));
+    QVERIFY(QFileInfo(dest + "/testfile").isFile());
+    QCOMPARE(QFileInfo(dest + "/bigfile").size(), 2 * 1024 * 1024);
+
+    QDir(dest).removeRecursively();
+}
+
 void JobTest::copyRelativeSymlinkToSamePartition() // #352927
 {
 #ifdef Q_OS_WIN
@@ -1484,6 +1772,147 @@ void JobTest::directorySizeError()
     qApp->sendPostedEvents(nullptr, QEvent::DeferredDelete);
 }
 
+void JobTest::directorySizeOfTree()
+{
+#ifdef Q_OS_UNIX
+    const QString dir = homeTmpDir() + "dirSized";
+    QVERIFY(QDir().mkpath(dir + "/subdir/subsubdir"));
+    createTestFile(dir + "/file", false, QByteArray(100, 'a'));
+    QVERIFY(::link(QFile::encodeName(dir + "/file").constData(), QFile::encodeName(dir + "/hardlink").constData()) == 0);
+    createTestFile(dir + "/subdir/file", false, QByteArray(20, 'b'));
+    createTestFile(dir + "/subdir/subsubdir/.hidden", false, QByteArray(3, 'c'));
+    createTestSymlink(dir + "/broken_symlink");
+    QVERIFY(symlink("subdir", QFile::encodeName(dir + "/symlink_to_dir").constData()) == 0);
+    createTestFile(homeTmpDir() + "fileSized", false, QByteArray(7, 'd'));
+
+    // the hard link counted once, the symlinks by what they point to
+    KIO::DirectorySizeJob *job = KIO::directorySize(QUrl::fromLocalFile(dir));
+    job->setUiDelegate(nullptr);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QCOMPARE(job->totalFiles(), 4ULL);
+    QCOMPARE(job->totalSubdirs(), 3ULL);
+    QVERIFY(job->totalSize() >= 123);
+    QCOMPARE(job->processedAmount(KJob::Bytes), job->totalSize());
+    QCOMPARE(job->processedAmount(KJob::Files), job->totalFiles());
+    QCOMPARE(job->processedAmount(KJob::Directories), job->totalSubdirs());
+    const KIO::filesize_t dirSize = job->totalSize();
+
+    const KFileItemList items{KFileItem(QUrl::fromLocalFile(dir)), KFileItem(QUrl::fromLocalFile(homeTmpDir() + "fileSized"))};
+    job = KIO::directorySize(items);
+    job->setUiDelegate(nullptr);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QCOMPARE(job->totalFiles(), 5ULL);
+    QCOMPARE(job->totalSubdirs(), 3ULL);
+    QCOMPARE(job->totalSize(), dirSize + 7);
+
+    QDir(dir).removeRecursively();
+    QFile::remove(homeTmpDir() + "fileSized");
+    qApp->sendPostedEvents(nullptr, QEvent::DeferredDelete);
+#else
+    QSKIP("Symlinks and hard links are only created on Unix");
+#endif
+}
+
+void JobTest::directorySizeCached()
+{
+#ifdef Q_OS_UNIX
+    // only the trash is cached
+    const QString trashFiles = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/Trash/files/";
+    const QString dir = trashFiles + "dirSizeCached";
+    const QString movedDir = trashFiles + "dirSizeCachedMoved";
+    QVERIFY(QDir().mkpath(dir + "/subdir/subsubdir"));
+    createTestFile(dir + "/file", false, QByteArray(100, 'a'));
+    createTestFile(dir + "/subdir/file", false, QByteArray(20, 'b'));
+    createTestFile(dir + "/subdir/subsubdir/file", false, QByteArray(3, 'c'));
+    // directories modified just now aren't cached
+    const struct timespec anHourAgo[2] = {{time(nullptr) - 3600, 0}, {time(nullptr) - 3600, 0}};
+    for (const QString &path : {dir, dir + "/subdir", dir + "/subdir/subsubdir"}) {
+        QCOMPARE(::utimensat(AT_FDCWD, QFile::encodeName(path).constData(), anHourAgo, 0), 0);
+    }
+
+    auto sizeOf = [](const QString &path) {
+        KIO::DirectorySizeJob *job = KIO::directorySize(QUrl::fromLocalFile(path));
+        job->setUiDelegate(nullptr);
+        job->exec();
+        return job;
+    };
+
+    KIO::DirectorySizeJob *job = sizeOf(dir);
+    QCOMPARE(job->error(), 0);
+    QCOMPARE(job->totalFiles(), 3ULL);
+    QCOMPARE(job->totalSubdirs(), 2ULL);
+    const KIO::filesize_t size = job->totalSize();
+    QVERIFY(QFile::exists(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/kio/directorysizes"));
+
+    // from the cache this time: a file added while the time of its directory is put
+    // back isn't seen
+    createTestFile(dir + "/unseen", false, QByteArray(1000, 'e'));
+    QCOMPARE(::utimensat(AT_FDCWD, QFile::encodeName(dir).constData(), anHourAgo, 0), 0);
+    job = sizeOf(dir);
+    QCOMPARE(job->totalFiles(), 3ULL);
+    QCOMPARE(job->totalSubdirs(), 2ULL);
+    QCOMPARE(job->totalSize(), size);
+    QVERIFY(QFile::remove(dir + "/unseen"));
+    QCOMPARE(::utimensat(AT_FDCWD, QFile::encodeName(dir).constData(), anHourAgo, 0), 0);
+
+    // the directory of a new file changes, not its parents
+    createTestFile(dir + "/subdir/subsubdir/newfile", false, QByteArray(7, 'd'));
+    job = sizeOf(dir);
+    QCOMPARE(job->totalFiles(), 4ULL);
+    QCOMPARE(job->totalSubdirs(), 2ULL);
+    QVERIFY(job->totalSize() >= size + 7);
+    const KIO::filesize_t newSize = job->totalSize();
+
+    // found by inode once moved
+    QVERIFY(QFile::rename(dir, movedDir));
+    job = sizeOf(movedDir);
+    QCOMPARE(job->totalFiles(), 4ULL);
+    QCOMPARE(job->totalSubdirs(), 2ULL);
+    QCOMPARE(job->totalSize(), newSize);
+
+    QDir(movedDir).removeRecursively();
+    qApp->sendPostedEvents(nullptr, QEvent::DeferredDelete);
+#else
+    QSKIP("Directory sizes are only cached on Unix");
+#endif
+}
+
+void JobTest::directorySizeChangedInPlace()
+{
+#ifdef Q_OS_UNIX
+    // outside of the trash, files are edited
+    const QString dir = homeTmpDir() + "dirSizeChangedInPlace";
+    QVERIFY(QDir().mkpath(dir));
+    createTestFile(dir + "/file", false, QByteArray(100, 'a'));
+    const struct timespec anHourAgo[2] = {{time(nullptr) - 3600, 0}, {time(nullptr) - 3600, 0}};
+    QCOMPARE(::utimensat(AT_FDCWD, QFile::encodeName(dir).constData(), anHourAgo, 0), 0);
+
+    KIO::DirectorySizeJob *job = KIO::directorySize(QUrl::fromLocalFile(dir));
+    job->setUiDelegate(nullptr);
+    QVERIFY(job->exec());
+    QCOMPARE(job->totalFiles(), 1ULL);
+    const KIO::filesize_t size = job->totalSize();
+
+    // the directory keeps its time
+    QFile file(dir + "/file");
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.seek(100));
+    QCOMPARE(file.write(QByteArray(900, 'b')), 900);
+    file.close();
+    QCOMPARE(QFileInfo(dir).lastModified().toSecsSinceEpoch(), qint64(anHourAgo[1].tv_sec));
+
+    job = KIO::directorySize(QUrl::fromLocalFile(dir));
+    job->setUiDelegate(nullptr);
+    QVERIFY(job->exec());
+    QCOMPARE(job->totalFiles(), 1ULL);
+    QCOMPARE(job->totalSize(), size + 900);
+
+    QDir(dir).removeRecursively();
+#else
+    QSKIP("Directory sizes are only cached on Unix");
+#endif
+}
+
 void JobTest::slotEntries(KIO::Job *, const KIO::UDSEntryList &lst)
 {
     for (KIO::UDSEntryList::ConstIterator it = lst.begin(); it != lst.end(); ++it) {
@@ -1518,6 +1947,45 @@ void JobTest::getInvalidUrl()
     QVERIFY(!job->exec()); // it should fail :)
 }
 
+void JobTest::checksums()
+{
+    // Computed by kio_file
+    const QString filePath = homeTmpDir() + "fileFromHome";
+    createTestFile(filePath);
+    QFile file(filePath);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray content = file.readAll();
+
+    const QList<QCryptographicHash::Algorithm> algorithms{QCryptographicHash::Md5, QCryptographicHash::Sha1, QCryptographicHash::Sha256, QCryptographicHash::Sha512};
+    KIO::ChecksumJob *job = KIO::checksums(QUrl::fromLocalFile(filePath), algorithms, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    for (QCryptographicHash::Algorithm algorithm : algorithms) {
+        QCOMPARE(job->checksum(algorithm), QString::fromLatin1(QCryptographicHash::hash(content, algorithm).toHex()));
+    }
+    QVERIFY(job->checksum(QCryptographicHash::Sha384).isEmpty());
+    QCOMPARE(job->totalAmount(KJob::Bytes), qulonglong(content.size()));
+
+    // Errors from the worker are reported
+    job = KIO::checksums(QUrl::fromLocalFile(homeTmpDir() + "doesNotExist"), algorithms, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    QVERIFY(!job->exec());
+    QCOMPARE(job->error(), (int)KIO::ERR_DOES_NOT_EXIST);
+    QVERIFY(job->checksum(QCryptographicHash::Md5).isEmpty());
+}
+
+void JobTest::checksumsWithoutWorkerSupport()
+{
+    // The data worker has no checksum command, the job downloads the data and hashes it
+    const QList<QCryptographicHash::Algorithm> algorithms{QCryptographicHash::Md5, QCryptographicHash::Sha256};
+    KIO::ChecksumJob *job = KIO::checksums(QUrl(QStringLiteral("data:,Hello%20world")), algorithms, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    for (QCryptographicHash::Algorithm algorithm : algorithms) {
+        QCOMPARE(job->checksum(algorithm), QString::fromLatin1(QCryptographicHash::hash("Hello world", algorithm).toHex()));
+    }
+}
+
 void JobTest::slotMimetype(KIO::Job *job, const QString &type)
 {
     QVERIFY(job != nullptr);
@@ -1560,6 +2028,47 @@ void JobTest::deleteDirectory()
     QVERIFY(!QFile::exists(dest));
 }
 
+void JobTest::deleteDirectoryInBulk()
+{
+#ifdef Q_OS_UNIX
+    const QString dest = homeTmpDir() + "dirDeletedInBulk";
+    const QString other = homeTmpDir() + "dirNotDeletedInBulk";
+    createTestDirectory(other);
+    QVERIFY(QDir().mkpath(dest + "/empty"));
+    const int dirCount = 20;
+    for (int i = 0; i < dirCount; ++i) {
+        const QString subdir = dest + QStringLiteral("/subdir%1/subsubdir").arg(i);
+        QVERIFY(QDir().mkpath(subdir));
+        for (int j = 0; j < 10; ++j) {
+            createTestFile(subdir + QStringLiteral("/file%1").arg(j));
+        }
+    }
+    createTestFile(dest + "/.hidden");
+    createTestSymlink(dest + "/broken_symlink");
+    // not followed
+    QVERIFY(symlink(QFile::encodeName(other).constData(), QFile::encodeName(dest + "/symlink_to_dir").constData()) == 0);
+
+    createTestFile(homeTmpDir() + "fileDeletedInBulk");
+
+    const QList<QUrl> urls{QUrl::fromLocalFile(dest), QUrl::fromLocalFile(homeTmpDir() + "fileDeletedInBulk")};
+    KIO::DeleteJob *job = KIO::del(urls, KIO::HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->setBulkDelete(true);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+
+    QVERIFY(!QFileInfo::exists(dest));
+    QVERIFY(!QFileInfo::exists(homeTmpDir() + "fileDeletedInBulk"));
+    QVERIFY(QFileInfo::exists(other + "/testfile"));
+    // the files of the tree, its two symlinks and the single file
+    QCOMPARE(job->processedAmount(KJob::Files), qulonglong(dirCount * 10 + 4));
+    QCOMPARE(job->processedAmount(KJob::Directories), qulonglong(2 * dirCount + 2));
+
+    QDir(other).removeRecursively();
+#else
+    QSKIP("Bulk deletion is only supported on Unix");
+#endif
+}
+
 void JobTest::deleteSymlink(bool using_fast_path)
 {
     extern KIOCORE_EXPORT bool kio_resolve_local_urls;
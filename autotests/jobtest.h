@@ -36,6 +36,8 @@ private Q_SLOTS:
 
     // Local tests (kio_file only)
     void storedGet();
+    void storedGetDeadlineExpired();
+    void killedGetReusesWorker();
     void put();
     void storedPut();
     void storedPutIODevice();
@@ -51,7 +53,12 @@ private Q_SLOTS:
     void copyDirectoryToExistingDirectory();
     void copyDirectoryToExistingSymlinkedDirectory();
     void copyFileToOtherPartition();
+    void copySparseFile();
     void copyDirectoryToOtherPartition();
+    void copyDirectoryInParallel();
+    void copyDirectoryInWorker();
+    void copyFileVerified();
+    void moveDirectoryVerified();
     void copyRelativeSymlinkToSamePartition();
     void copyAbsoluteSymlinkToOtherPartition();
     void copyFolderWithUnaccessibleSubfolder();
@@ -66,6 +73,9 @@ private Q_SLOTS:
     void deleteJobBeforeStart();
     void directorySize();
     void directorySizeError();
+    void directorySizeOfTree();
+    void directorySizeCached();
+    void directorySizeChangedInPlace();
     void moveFileToSamePartition();
     void moveDirectoryToSamePartition();
     void moveDirectoryIntoItself();
@@ -78,6 +88,7 @@ private Q_SLOTS:
     void moveDirectoryToReadonlyFilesystem();
     void deleteFile();
     void deleteDirectory();
+    void deleteDirectoryInBulk();
     void deleteSymlink();
     void deleteManyDirs();
     void deleteManyFilesIndependently();
@@ -133,6 +144,8 @@ private Q_SLOTS:
     // void copyFileToSystem();
 
     void getInvalidUrl();
+    void checksums();
+    void checksumsWithoutWorkerSupport();
 #if KIOCORE_BUILD_DEPRECATED_SINCE(5, 84)
     void multiGet();
 #endif
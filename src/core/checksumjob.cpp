@@ -0,0 +1,209 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "checksumjob.h"
+#include "job_p.h"
+#include "transferjob.h"
+#include <kio/jobuidelegatefactory.h>
+
+#include <KLocalizedString>
+
+#include <QHash>
+#include <QTimer>
+
+#include <memory>
+#include <vector>
+
+using namespace KIO;
+
+// The names used in the "checksums" metadata and for the results, see docs/metadata.txt
+static QString algorithmName(QCryptographicHash::Algorithm algorithm)
+{
+    switch (algorithm) {
+    case QCryptographicHash::Md5:
+        return QStringLiteral("md5");
+    case QCryptographicHash::Sha1:
+        return QStringLiteral("sha1");
+    case QCryptographicHash::Sha224:
+        return QStringLiteral("sha224");
+    case QCryptographicHash::Sha256:
+        return QStringLiteral("sha256");
+    case QCryptographicHash::Sha384:
+        return QStringLiteral("sha384");
+    case QCryptographicHash::Sha512:
+        return QStringLiteral("sha512");
+    default:
+        return QString();
+    }
+}
+
+/** @internal */
+class KIO::ChecksumJobPrivate : public KIO::JobPrivate
+{
+public:
+    ChecksumJobPrivate(const QUrl &url, const QList<QCryptographicHash::Algorithm> &algorithms)
+        : m_url(url)
+        , m_algorithms(algorithms)
+    {
+    }
+
+    QUrl m_url;
+    QList<QCryptographicHash::Algorithm> m_algorithms;
+    QHash<QCryptographicHash::Algorithm, QString> m_checksums;
+    SimpleJob *m_checksumJob = nullptr;
+    TransferJob *m_getJob = nullptr;
+    // One per algorithm, fed with the data of m_getJob
+    std::vector<std::unique_ptr<QCryptographicHash>> m_hashes;
+
+    void slotStart();
+    void startGetJob();
+    void connectSubjob(SimpleJob *job);
+
+    Q_DECLARE_PUBLIC(ChecksumJob)
+
+    static inline ChecksumJob *newJob(const QUrl &url, const QList<QCryptographicHash::Algorithm> &algorithms, JobFlags flags)
+    {
+        ChecksumJob *job = new ChecksumJob(*new ChecksumJobPrivate(url, algorithms));
+        job->setUiDelegate(KIO::createDefaultJobUiDelegate());
+        if (!(flags & HideProgressInfo)) {
+            KIO::getJobTracker()->registerJob(job);
+        }
+        return job;
+    }
+};
+
+ChecksumJob::ChecksumJob(ChecksumJobPrivate &dd)
+    : Job(dd)
+{
+    Q_D(ChecksumJob);
+    QTimer::singleShot(0, this, [d]() {
+        d->slotStart();
+    });
+}
+
+ChecksumJob::~ChecksumJob()
+{
+}
+
+QUrl ChecksumJob::url() const
+{
+    return d_func()->m_url;
+}
+
+QString ChecksumJob::checksum(QCryptographicHash::Algorithm algorithm) const
+{
+    return d_func()->m_checksums.value(algorithm);
+}
+
+void ChecksumJobPrivate::slotStart()
+{
+    Q_Q(ChecksumJob);
+    QStringList names;
+    for (QCryptographicHash::Algorithm algorithm : std::as_const(m_algorithms)) {
+        const QString name = algorithmName(algorithm);
+        if (name.isEmpty()) {
+            q->setError(ERR_UNSUPPORTED_ACTION);
+            q->setErrorText(i18n("This kind of checksum is not supported."));
+            q->emitResult();
+            return;
+        }
+        names.append(name);
+    }
+
+    // Ask the worker first, it reads the file without sending it over
+    KIO_ARGS << m_url;
+    m_checksumJob = SimpleJobPrivate::newJobNoUi(m_url, CMD_CHECKSUM, packedArgs);
+    m_checksumJob->addMetaData(QStringLiteral("checksums"), names.join(QLatin1Char(',')));
+    connectSubjob(m_checksumJob);
+    q->addSubjob(m_checksumJob);
+}
+
+void ChecksumJobPrivate::startGetJob()
+{
+    Q_Q(ChecksumJob);
+    m_hashes.clear();
+    for (QCryptographicHash::Algorithm algorithm : std::as_const(m_algorithms)) {
+        m_hashes.push_back(std::make_unique<QCryptographicHash>(algorithm));
+    }
+
+    m_getJob = KIO::get(m_url, NoReload, HideProgressInfo);
+    q->connect(m_getJob, &TransferJob::data, q, [this](KIO::Job *, const QByteArray &data) {
+        for (const auto &hash : m_hashes) {
+            hash->addData(data);
+        }
+    });
+    connectSubjob(m_getJob);
+    q->addSubjob(m_getJob);
+}
+
+void ChecksumJobPrivate::connectSubjob(SimpleJob *job)
+{
+    Q_Q(ChecksumJob);
+    q->connect(job, &KJob::totalSize, q, [q](KJob *, qulonglong totalSize) {
+        if (totalSize != q->totalAmount(KJob::Bytes)) {
+            q->setTotalAmount(KJob::Bytes, totalSize);
+        }
+    });
+
+    q->connect(job, &KJob::processedSize, q, [q](KJob *, qulonglong processedSize) {
+        q->setProcessedAmount(KJob::Bytes, processedSize);
+        q->emitPercent(processedSize, q->totalAmount(KJob::Bytes));
+    });
+
+    if (q->isSuspended()) {
+        job->suspend();
+    }
+}
+
+void ChecksumJob::slotResult(KJob *job)
+{
+    Q_D(ChecksumJob);
+    if (job == d->m_checksumJob) {
+        SimpleJob *checksumJob = d->m_checksumJob;
+        d->m_checksumJob = nullptr;
+        bool complete = !job->error();
+        if (complete) {
+            for (QCryptographicHash::Algorithm algorithm : std::as_const(d->m_algorithms)) {
+                const QString checksum = checksumJob->queryMetaData(QLatin1String("checksum-") + algorithmName(algorithm));
+                if (checksum.isEmpty()) {
+                    complete = false; // an algorithm the worker doesn't know
+                    break;
+                }
+                d->m_checksums.insert(algorithm, checksum);
+            }
+        }
+
+        if (!complete && (!job->error() || job->error() == ERR_UNSUPPORTED_ACTION)) {
+            // Hash the data as it comes in here
+            removeSubjob(job);
+            d->m_checksums.clear();
+            d->startGetJob();
+            return;
+        }
+    } else if (job == d->m_getJob) {
+        d->m_getJob = nullptr;
+        if (!job->error()) {
+            for (int i = 0; i < d->m_algorithms.size(); ++i) {
+                d->m_checksums.insert(d->m_algorithms.at(i), QString::fromLatin1(d->m_hashes.at(i)->result().toHex()));
+            }
+        }
+        d->m_hashes.clear();
+    }
+
+    if (job->error()) {
+        Job::slotResult(job); // will set the error and emit result(this)
+        return;
+    }
+    removeSubjob(job);
+    emitResult();
+}
+
+ChecksumJob *KIO::checksums(const QUrl &url, const QList<QCryptographicHash::Algorithm> &algorithms, JobFlags flags)
+{
+    return ChecksumJobPrivate::newJob(url, algorithms, flags);
+}
+
+#include "moc_checksumjob.cpp"
@@ -0,0 +1,72 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef CHECKSUMJOB_H
+#define CHECKSUMJOB_H
+
+#include "job_base.h"
+#include "kiocore_export.h"
+
+#include <QCryptographicHash>
+
+namespace KIO
+{
+class ChecksumJobPrivate;
+/**
+ * @class KIO::ChecksumJob checksumjob.h <KIO/ChecksumJob>
+ *
+ * A KIO job that computes checksums of a file, e.g. to verify a download.
+ *
+ * All the checksums are computed while reading the file once. Workers that support it,
+ * like the one for local files, compute them on their side; from the other ones the file
+ * is downloaded and hashed on the fly.
+ *
+ * @see KIO::checksums()
+ * @since 5.98
+ */
+class KIOCORE_EXPORT ChecksumJob : public Job
+{
+    Q_OBJECT
+
+public:
+    ~ChecksumJob() override;
+
+    /**
+     * @return the URL of the file
+     */
+    QUrl url() const;
+
+    /**
+     * The checksum of the file for @p algorithm, in lower case hexadecimal digits.
+     * Empty until the job has finished successfully, and for algorithms that weren't asked for.
+     */
+    QString checksum(QCryptographicHash::Algorithm algorithm) const;
+
+protected Q_SLOTS:
+    void slotResult(KJob *job) override;
+
+protected:
+    ChecksumJob(ChecksumJobPrivate &dd);
+
+private:
+    Q_DECLARE_PRIVATE(ChecksumJob)
+};
+
+/**
+ * Computes checksums of a file with several algorithms in one go.
+ * MD5, SHA-1 and the SHA-2 algorithms are supported.
+ *
+ * @param url the file
+ * @param algorithms the checksums to compute
+ * @param flags can be HideProgressInfo here
+ * @return the job handling the operation
+ * @since 5.98
+ */
+KIOCORE_EXPORT ChecksumJob *checksums(const QUrl &url, const QList<QCryptographicHash::Algorithm> &algorithms, JobFlags flags = DefaultFlags);
+
+}
+
+#endif
@@ -55,6 +55,8 @@ enum Command {
     CMD_HOST_INFO = 94,
     CMD_FILESYSTEMFREESPACE = 95,
     CMD_TRUNCATE = 96,
+    CMD_CANCEL = 97, // Abort the running command, the job was killed
+    CMD_CHECKSUM = 98,
     // Add new ones here once a release is done, to avoid breaking binary compatibility.
     // Note that protocol-specific commands shouldn't be added here, but should use special.
 };
@@ -12,6 +12,7 @@
 #include "kiocoredebug.h"
 #include <QDebug>
 
+#include <algorithm>
 #include <cerrno>
 
 using namespace KIO;
@@ -219,6 +220,18 @@ int Connection::read(int *_cmd, QByteArray &data)
     return data.size();
 }
 
+bool Connection::takeIncomingTask(int cmd)
+{
+    auto it = std::find_if(d->incomingTasks.begin(), d->incomingTasks.end(), [cmd](const Task &task) {
+        return task.cmd == cmd;
+    });
+    if (it == d->incomingTasks.end()) {
+        return false;
+    }
+    d->incomingTasks.erase(it);
+    return true;
+}
+
 void Connection::setReadMode(ReadMode readMode)
 {
     d->readMode = readMode;
@@ -107,6 +107,13 @@ public:
      */
     int read(int *_cmd, QByteArray &data);
 
+    /**
+     * Removes the first queued incoming command @p cmd, leaving all other
+     * queued commands in place. Does not wait for data.
+     * @return true if such a command was queued
+     */
+    bool takeIncomingTask(int cmd);
+
     /**
      * Don't handle incoming data until resumed.
      */
@@ -12,6 +12,7 @@
 #include "../pathhelpers_p.h"
 #include "deletejob.h"
 #include "filecopyjob.h"
+#include "filecopyjob_p.h"
 #include "global.h"
 #include "job.h" // buildErrorString
 #include "kcoredirlister.h"
@@ -30,6 +31,7 @@
 #include "kprotocolmanager.h"
 #include "scheduler.h"
 #include "slave.h"
+#include "specialjob.h"
 #include <KDirWatch>
 
 #include "askuseractioninterface.h"
@@ -44,6 +46,7 @@
 
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QPointer>
 #include <QTemporaryFile>
 #include <QTimer>
@@ -56,6 +59,7 @@
 #include <KIO/FileSystemFreeSpaceJob>
 
 #include <list>
+#include <optional>
 #include <set>
 
 #include <QLoggingCategory>
@@ -66,6 +70,8 @@ using namespace KIO;
 
 // this will update the report dialog with 5 Hz, I think this is fast enough, aleXXX
 static constexpr int s_reportTimeout = 200;
+// How far down the list of files to look for files that can be copied in parallel
+static constexpr int s_parallelCopyLookAhead = 64;
 
 #if !defined(NAME_MAX)
 #if defined(_MAX_FNAME)
@@ -91,6 +97,7 @@ enum DestinationState {
  *         (on already exists, and user chooses rename, TODO: go to STATE_RENAMING again)
  *      STATE_STATING
  *         and then, if dir -> STATE_LISTING (filling 'd->dirs' and 'd->files')
+ *         or STATE_COPYING_TREE if the worker copies the whole dir (see setCopyDirectoriesInWorker)
  *     STATE_CREATING_DIRS (createNextDir, iterating over 'd->dirs')
  *          if conflict: STATE_CONFLICT_CREATING_DIRS
  *     STATE_COPYING_FILES (copyNextFile, iterating over 'd->files')
@@ -104,6 +111,7 @@ enum CopyJobState {
     STATE_STATING,
     STATE_RENAMING,
     STATE_LISTING,
+    STATE_COPYING_TREE,
     STATE_CREATING_DIRS,
     STATE_CONFLICT_CREATING_DIRS,
     STATE_COPYING_FILES,
@@ -311,6 +319,36 @@ public:
 
     std::set<QString> m_parentDirs;
 
+    // See setMaximumParallelCopies()
+    struct ParallelCopy {
+        CopyInfo info;
+        KIO::filesize_t processedSize;
+    };
+    int m_maxParallelCopies = 1;
+    // The job copying files.first(), other files are only copied in parallel while it runs
+    KJob *m_currentCopyJob = nullptr;
+    QHash<KJob *, ParallelCopy> m_parallelCopies;
+    // Copied again one by one, to ask the user about conflicts and errors
+    QList<CopyInfo> m_failedParallelCopies;
+    // Failed after writing the destination, so they can't be copied again, only reported
+    struct ParallelCopyError {
+        CopyInfo info;
+        int error;
+        QString errorText;
+    };
+    QList<ParallelCopyError> m_parallelCopyErrors;
+    bool m_waitingForParallelCopies = false;
+    std::optional<bool> m_destAllowsParallelCopies;
+
+    // See setCopyDirectoriesInWorker()
+    bool m_copyDirectoriesInWorker = false;
+    KIO::filesize_t m_treeTotalSize = 0;
+    int m_treeEntriesCopied = 0;
+    int m_treeFilesCopied = 0;
+
+    // See setVerifyCopies()
+    bool m_verifyCopies = false;
+
     void statCurrentSrc();
     void statNextSrc();
 
@@ -334,6 +372,18 @@ public:
     bool handleMsdosFsQuirks(QList<CopyInfo>::Iterator it, KFileSystemType::Type fsType);
     void copyNextFile();
     void processCopyNextFile(const QList<CopyInfo>::Iterator &it, int result, SkipType skipType);
+    JobFlags fileCopyFlags(const CopyInfo &info) const;
+    int fileCopyPermissions(const CopyInfo &info) const;
+    KIO::FileCopyJob *newFileCopyJob(const CopyInfo &info);
+    bool canCopyInParallel(const CopyInfo &info, KIO::filesize_t reservedSpace) const;
+    void startParallelCopies();
+    void slotResultParallelCopy(KJob *job);
+    void reportParallelCopyError(const ParallelCopyError &copyError);
+    void killParallelCopies();
+    bool canCopyTreeInWorker(const QUrl &src) const;
+    void startCopyingTree(const QUrl &src);
+    void slotTreeEntriesCopied(const QUrl &src, const QUrl &dest, const QByteArray &data);
+    void slotResultCopyingTree(KJob *job);
 
     void slotResultDeletingDirs(KJob *job);
     void deleteNextDir();
@@ -682,7 +732,11 @@ void CopyJobPrivate::sourceStated(const UDSEntry &entry, const QUrl &sourceUrl)
             }
         }
 
-        startListing(srcurl);
+        if (canCopyTreeInWorker(srcurl)) {
+            startCopyingTree(srcurl);
+        } else {
+            startListing(srcurl);
+        }
     } else {
         qCDebug(KIO_COPYJOB_DEBUG) << "Source is a file (or a symlink), or we are linking -> no recursive listing";
 
@@ -740,9 +794,13 @@ void CopyJobPrivate::slotReport()
         q->emitPercent(m_filesHandledByDirectRename, q->totalAmount(KJob::Files));
         break;
 
-    case STATE_COPYING_FILES:
+    case STATE_COPYING_FILES: {
+        KIO::filesize_t parallelProcessedSize = 0;
+        for (const ParallelCopy &copy : std::as_const(m_parallelCopies)) {
+            parallelProcessedSize += copy.processedSize;
+        }
         q->setProcessedAmount(KJob::Files, m_processedFiles);
-        q->setProcessedAmount(KJob::Bytes, m_processedSize + m_fileProcessedSize);
+        q->setProcessedAmount(KJob::Bytes, m_processedSize + m_fileProcessedSize + parallelProcessedSize);
         if (m_bURLDirty) {
             // Only emit urls when they changed. This saves time, and fixes #66281
             m_bURLDirty = false;
@@ -758,6 +816,7 @@ void CopyJobPrivate::slotReport()
             }
         }
         break;
+    }
 
     case STATE_CREATING_DIRS:
         q->setProcessedAmount(KJob::Directories, m_processedDirs);
@@ -768,6 +827,10 @@ void CopyJobPrivate::slotReport()
         }
         break;
 
+    case STATE_COPYING_TREE:
+        q->setProcessedAmount(KJob::Files, m_processedFiles + m_treeFilesCopied);
+        q->setProcessedAmount(KJob::Bytes, m_processedSize + m_fileProcessedSize);
+        Q_FALLTHROUGH();
     case STATE_STATING:
     case STATE_LISTING:
         if (m_bURLDirty) {
@@ -780,7 +843,7 @@ void CopyJobPrivate::slotReport()
         }
         q->setProgressUnit(KJob::Bytes);
         q->setTotalAmount(KJob::Bytes, m_totalSize);
-        q->setTotalAmount(KJob::Files, files.count() + m_filesHandledByDirectRename);
+        q->setTotalAmount(KJob::Files, files.count() + m_filesHandledByDirectRename + m_treeFilesCopied);
         q->setTotalAmount(KJob::Directories, dirs.count());
         break;
 
@@ -1048,7 +1111,8 @@ void CopyJobPrivate::statCurrentSrc()
 
         qCDebug(KIO_COPYJOB_DEBUG) << "Stating finished. To copy:" << m_totalSize << ", available:" << m_freeSpace;
 
-        if (m_totalSize > m_freeSpace && m_freeSpace != static_cast<KIO::filesize_t>(-1)) {
+        // Directories copied by the worker are already processed, and left out of m_freeSpace
+        if (m_totalSize - m_processedSize > m_freeSpace && m_freeSpace != static_cast<KIO::filesize_t>(-1)) {
             q->setError(ERR_DISK_FULL);
             q->setErrorText(m_currentSrcURL.toDisplayString());
             q->emitResult();
@@ -1116,6 +1180,104 @@ void CopyJobPrivate::startRenameJob(const QUrl &slave_url)
     }
 }
 
+bool CopyJobPrivate::canCopyTreeInWorker(const QUrl &src) const
+{
+    // sourceStated() just added the directory to dirs
+    // kio_file doesn't verify what it copies in copyTree()
+    return m_copyDirectoriesInWorker && !m_verifyCopies && m_mode == CopyJob::Copy && src.isLocalFile() //
+        && !dirs.isEmpty() && dirs.last().uSource == src && dirs.last().uDest.isLocalFile();
+}
+
+void CopyJobPrivate::startCopyingTree(const QUrl &src)
+{
+    Q_Q(CopyJob);
+    state = STATE_COPYING_TREE;
+    const QUrl dest = dirs.last().uDest;
+    m_currentSrcURL = src;
+    m_currentDestURL = dest;
+    m_bURLDirty = true;
+    m_treeTotalSize = 0;
+    m_treeEntriesCopied = 0;
+    m_treeFilesCopied = 0;
+    qCDebug(KIO_COPYJOB_DEBUG) << "Copying the tree" << src << "to" << dest << "in the worker";
+
+    // See FileProtocol::copyTree
+    QByteArray packedArgs;
+    QDataStream stream(&packedArgs, QIODevice::WriteOnly);
+    stream << int(3) << src << dest << qint8(!m_defaultPermissions);
+    KIO::SpecialJob *newjob = new KIO::SpecialJob(src, packedArgs);
+    q->connect(newjob, &TransferJob::data, q, [this, src, dest](KIO::Job *, const QByteArray &data) {
+        slotTreeEntriesCopied(src, dest, data);
+    });
+    q->connect(newjob, &Job::totalSize, q, [this](KJob *, qulonglong totalSize) {
+        m_totalSize += totalSize - m_treeTotalSize;
+        m_treeTotalSize = totalSize;
+    });
+    q->connect(newjob, &Job::processedSize, q, [this](KJob *, qulonglong processedSize) {
+        m_fileProcessedSize = processedSize;
+    });
+    q->addSubjob(newjob);
+}
+
+void CopyJobPrivate::slotTreeEntriesCopied(const QUrl &src, const QUrl &dest, const QByteArray &data)
+{
+    Q_Q(CopyJob);
+    QDataStream stream(data);
+    while (!stream.atEnd()) {
+        qint8 type; // 0 for a directory, 1 for a file, 2 for a symlink
+        QString path;
+        qint64 mtime;
+        QString linkTarget;
+        stream >> type >> path >> mtime >> linkTarget;
+
+        const QUrl from = path.isEmpty() ? src : addPathToUrl(src, path);
+        const QUrl to = path.isEmpty() ? dest : addPathToUrl(dest, path);
+        // required for the undo feature
+        if (type == 2) {
+            Q_EMIT q->copyingLinkDone(q, from, linkTarget, to);
+        } else {
+            Q_EMIT q->copyingDone(q, from, to, QDateTime::fromSecsSinceEpoch(mtime, Qt::UTC), type == 0, false);
+        }
+        ++m_treeEntriesCopied;
+        if (type != 0) {
+            ++m_treeFilesCopied;
+        }
+    }
+}
+
+void CopyJobPrivate::slotResultCopyingTree(KJob *job)
+{
+    Q_Q(CopyJob);
+    if (job->error()) {
+        if (m_treeEntriesCopied > 0 || job->error() == ERR_USER_CANCELED) {
+            q->Job::slotResult(job); // will set the error and emit result(this)
+            return;
+        }
+        // Nothing was copied, the tree needs the usual way
+        qCDebug(KIO_COPYJOB_DEBUG) << "The worker didn't copy the tree:" << job->errorString();
+        q->removeSubjob(job);
+        Q_ASSERT(!q->hasSubjobs());
+        m_totalSize -= m_treeTotalSize;
+        m_treeTotalSize = 0;
+        m_fileProcessedSize = 0;
+        startListing(static_cast<SimpleJob *>(job)->url());
+        return;
+    }
+
+    q->removeSubjob(job);
+    Q_ASSERT(!q->hasSubjobs());
+    dirs.removeLast(); // created by the worker
+    m_processedSize += m_treeTotalSize;
+    if (m_freeSpace != KIO::invalidFilesize) {
+        m_freeSpace = m_freeSpace > m_treeTotalSize ? m_freeSpace - m_treeTotalSize : 0;
+    }
+    m_fileProcessedSize = 0;
+    m_processedFiles += m_treeFilesCopied;
+    m_filesHandledByDirectRename += m_treeFilesCopied;
+    m_treeFilesCopied = 0;
+    statNextSrc();
+}
+
 void CopyJobPrivate::startListing(const QUrl &src)
 {
     Q_Q(CopyJob);
@@ -1543,6 +1705,7 @@ void CopyJobPrivate::processCreateNextDir(const QList<CopyInfo>::Iterator &it, i
 void CopyJobPrivate::slotResultCopyingFiles(KJob *job)
 {
     Q_Q(CopyJob);
+    m_currentCopyJob = nullptr;
     // The file we were trying to copy:
     QList<CopyInfo>::Iterator it = files.begin();
     if (job->error()) {
@@ -1572,12 +1735,13 @@ void CopyJobPrivate::slotResultCopyingFiles(KJob *job)
 #endif
                 } else {
                     if (!KIO::delegateExtension<AskUserActionInterface *>(q)) {
+                        killParallelCopies();
                         q->Job::slotResult(job); // will set the error and emit result(this)
                         return;
                     }
 
                     q->removeSubjob(job);
-                    Q_ASSERT(!q->hasSubjobs());
+                    Q_ASSERT(q->subjobs().size() == m_parallelCopies.size());
                     // We need to stat the existing file, to get its last-modification time
                     QUrl existingFile((*it).uDest);
                     SimpleJob *newJob =
@@ -1596,6 +1760,7 @@ void CopyJobPrivate::slotResultCopyingFiles(KJob *job)
                     files.erase(it);
                 } else {
                     if (!KIO::delegateExtension<AskUserActionInterface *>(q)) {
+                        killParallelCopies();
                         q->Job::slotResult(job); // will set the error and emit result(this)
                         return;
                     }
@@ -1613,12 +1778,13 @@ void CopyJobPrivate::slotResultCopyingFiles(KJob *job)
             && !qobject_cast<KIO::DeleteJob *>(job) // Deleting source not already done
         ) {
             q->removeSubjob(job);
-            Q_ASSERT(!q->hasSubjobs());
+            Q_ASSERT(q->subjobs().size() == m_parallelCopies.size());
             // The only problem with this trick is that the error handling for this del operation
             // is not going to be right... see 'Very special case' above.
             KIO::Job *newjob = KIO::del((*it).uSource, HideProgressInfo);
             newjob->setParentJob(q);
             q->addSubjob(newjob);
+            m_currentCopyJob = newjob;
             return; // Don't move to next file yet !
         }
 
@@ -1657,7 +1823,7 @@ void CopyJobPrivate::slotResultCopyingFiles(KJob *job)
     Q_ASSERT(kiojob);
     m_incomingMetaData += kiojob->metaData();
     q->removeSubjob(job);
-    Q_ASSERT(!q->hasSubjobs()); // We should have only one job at a time ...
+    Q_ASSERT(q->subjobs().size() == m_parallelCopies.size()); // We should have only one job at a time, next to the parallel copies
     copyNextFile();
 }
 
@@ -1675,7 +1841,7 @@ void CopyJobPrivate::slotResultErrorCopyingFiles(KJob *job)
     }
 
     q->removeSubjob(job);
-    Q_ASSERT(!q->hasSubjobs());
+    Q_ASSERT(q->subjobs().size() == m_parallelCopies.size());
     auto *askUserActionInterface = KIO::delegateExtension<KIO::AskUserActionInterface *>(q);
 
     if (m_conflictError == ERR_FILE_ALREADY_EXIST //
@@ -1750,6 +1916,7 @@ void CopyJobPrivate::slotResultErrorCopyingFiles(KJob *job)
         if (job->error() == ERR_USER_CANCELED) {
             res = Result_Cancel;
         } else if (!askUserActionInterface) {
+            killParallelCopies();
             q->Job::slotResult(job); // will set the error and emit result(this)
             return;
         } else {
@@ -1981,6 +2148,15 @@ void CopyJobPrivate::copyNextFile()
 
     bool isDestLocal = m_globalDest.isLocalFile();
 
+    if (!m_parallelCopyErrors.isEmpty()) {
+        reportParallelCopyError(m_parallelCopyErrors.takeFirst());
+        return;
+    }
+    if (!m_failedParallelCopies.isEmpty()) {
+        files = m_failedParallelCopies + files;
+        m_failedParallelCopies.clear();
+    }
+
     // Take the first file in the list
     QList<CopyInfo>::Iterator it = files.begin();
     // Is this URL on the skip list ?
@@ -2013,6 +2189,9 @@ void CopyJobPrivate::copyNextFile()
         }
 
         processCopyNextFile(it, -1, NoSkipType);
+    } else if (!m_parallelCopies.isEmpty()) {
+        // some of them might still need to be copied again
+        m_waitingForParallelCopies = true;
     } else {
         // We're done
         qCDebug(KIO_COPYJOB_DEBUG) << "copyNextFile finished";
@@ -2071,24 +2250,8 @@ void CopyJobPrivate::processCopyNextFile(const QList<CopyInfo>::Iterator &it, in
 
     const QUrl &uSource = (*it).uSource;
     const QUrl &uDest = (*it).uDest;
-    // Do we set overwrite ?
-    bool bOverwrite;
-    const QString destFile = uDest.path();
-    qCDebug(KIO_COPYJOB_DEBUG) << "copying" << destFile;
-    if (uDest == uSource) {
-        bOverwrite = false;
-    } else {
-        bOverwrite = shouldOverwriteFile(destFile);
-    }
-
-    // If source isn't local and target is local, we ignore the original permissions
-    // Otherwise, files downloaded from HTTP end up with -r--r--r--
-    const bool remoteSource = !KProtocolManager::supportsListing(uSource) || uSource.scheme() == QLatin1String("trash");
-    int permissions = (*it).permissions;
-    if (m_defaultPermissions || (remoteSource && uDest.isLocalFile())) {
-        permissions = -1;
-    }
-    const JobFlags flags = bOverwrite ? Overwrite : DefaultFlags;
+    qCDebug(KIO_COPYJOB_DEBUG) << "copying" << uDest.path();
+    const JobFlags flags = fileCopyFlags(*it);
 
     m_bCurrentOperationIsLink = false;
     KIO::Job *newjob = nullptr;
@@ -2112,28 +2275,13 @@ void CopyJobPrivate::processCopyNextFile(const QList<CopyInfo>::Iterator &it, in
         // Observer::self()->slotCopying( this, m_currentSrcURL, uDest ); // should be slotLinking perhaps
         m_bCurrentOperationIsLink = true;
         // NOTE: if we are moving stuff, the deletion of the source will be done in slotResultCopyingFiles
-    } else if (m_mode == CopyJob::Move) { // Moving a file
-        KIO::FileCopyJob *moveJob = KIO::file_move(uSource, uDest, permissions, flags | HideProgressInfo /*no GUI*/);
-        moveJob->setParentJob(q);
-        moveJob->setSourceSize((*it).size);
-        moveJob->setModificationTime((*it).mtime); // #55804
-        newjob = moveJob;
-        qCDebug(KIO_COPYJOB_DEBUG) << "Moving" << uSource << "to" << uDest;
+    } else { // Moving or copying a file
+        newjob = newFileCopyJob(*it);
         // emit moving( this, uSource, uDest );
         m_currentSrcURL = uSource;
         m_currentDestURL = uDest;
         m_bURLDirty = true;
         // Observer::self()->slotMoving( this, uSource, uDest );
-    } else { // Copying a file
-        KIO::FileCopyJob *copyJob = KIO::file_copy(uSource, uDest, permissions, flags | HideProgressInfo /*no GUI*/);
-        copyJob->setParentJob(q); // in case of rename dialog
-        copyJob->setSourceSize((*it).size);
-        copyJob->setModificationTime((*it).mtime);
-        newjob = copyJob;
-        qCDebug(KIO_COPYJOB_DEBUG) << "Copying" << uSource << "to" << uDest;
-        m_currentSrcURL = uSource;
-        m_currentDestURL = uDest;
-        m_bURLDirty = true;
     }
     q->addSubjob(newjob);
     q->connect(newjob, &Job::processedSize, q, [this](KJob *job, qulonglong processedSize) {
@@ -2142,6 +2290,195 @@ void CopyJobPrivate::processCopyNextFile(const QList<CopyInfo>::Iterator &it, in
     q->connect(newjob, &Job::totalSize, q, [this](KJob *job, qulonglong totalSize) {
         slotTotalSize(job, totalSize);
     });
+    m_currentCopyJob = newjob;
+    startParallelCopies();
+}
+
+JobFlags CopyJobPrivate::fileCopyFlags(const CopyInfo &info) const
+{
+    // Do we set overwrite ?
+    const bool bOverwrite = info.uDest != info.uSource && shouldOverwriteFile(info.uDest.path());
+    return bOverwrite ? Overwrite : DefaultFlags;
+}
+
+int CopyJobPrivate::fileCopyPermissions(const CopyInfo &info) const
+{
+    // If source isn't local and target is local, we ignore the original permissions
+    // Otherwise, files downloaded from HTTP end up with -r--r--r--
+    const bool remoteSource = !KProtocolManager::supportsListing(info.uSource) || info.uSource.scheme() == QLatin1String("trash");
+    if (m_defaultPermissions || (remoteSource && info.uDest.isLocalFile())) {
+        return -1;
+    }
+    return info.permissions;
+}
+
+KIO::FileCopyJob *CopyJobPrivate::newFileCopyJob(const CopyInfo &info)
+{
+    Q_Q(CopyJob);
+    const int permissions = fileCopyPermissions(info);
+    const JobFlags flags = fileCopyFlags(info) | HideProgressInfo /*no GUI*/;
+    KIO::FileCopyJob *job;
+    if (m_mode == CopyJob::Move) {
+        qCDebug(KIO_COPYJOB_DEBUG) << "Moving" << info.uSource << "to" << info.uDest;
+        job = KIO::file_move(info.uSource, info.uDest, permissions, flags);
+    } else {
+        qCDebug(KIO_COPYJOB_DEBUG) << "Copying" << info.uSource << "to" << info.uDest;
+        job = KIO::file_copy(info.uSource, info.uDest, permissions, flags);
+    }
+    job->setParentJob(q); // in case of rename dialog
+    job->setSourceSize(info.size);
+    job->setModificationTime(info.mtime); // #55804
+    job->setVerifyCopy(m_verifyCopies);
+    return job;
+}
+
+bool CopyJobPrivate::canCopyInParallel(const CopyInfo &info, KIO::filesize_t reservedSpace) const
+{
+    // symlinks need two jobs when moving, and skipped files are left to copyNextFile
+    if (!info.linkDest.isEmpty() || info.uSource == info.uDest || shouldSkip(info.uDest.path())) {
+        return false;
+    }
+    if (m_freeSpace != KIO::invalidFilesize && info.size != KIO::invalidFilesize && m_freeSpace < reservedSpace + info.size) {
+        return false;
+    }
+    return true;
+}
+
+void CopyJobPrivate::startParallelCopies()
+{
+    Q_Q(CopyJob);
+    if (m_maxParallelCopies <= 1 || m_mode == CopyJob::Link || !m_currentCopyJob || files.size() < 2 || q->isSuspended()) {
+        return;
+    }
+    if (!m_destAllowsParallelCopies.has_value()) {
+        // copyNextFile() asks about invalid names and symlinks there, one file at a time
+        m_destAllowsParallelCopies = !m_globalDest.isLocalFile() || !isFatOrNtfs(KFileSystemType::fileSystemType(m_globalDest.toLocalFile()));
+    }
+    if (!*m_destAllowsParallelCopies) {
+        return;
+    }
+
+    // The space the running copies will take
+    KIO::filesize_t reservedSpace = files.first().size != KIO::invalidFilesize ? files.first().size : 0;
+    for (const ParallelCopy &copy : std::as_const(m_parallelCopies)) {
+        if (copy.info.size != KIO::invalidFilesize) {
+            reservedSpace += copy.info.size;
+        }
+    }
+
+    // files.first() is the one m_currentCopyJob copies
+    int i = 1;
+    for (int looked = 0; looked < s_parallelCopyLookAhead && i < files.size() && m_parallelCopies.size() < m_maxParallelCopies - 1; ++looked) {
+        const CopyInfo info = files.at(i);
+        if (!canCopyInParallel(info, reservedSpace)) {
+            ++i;
+            continue;
+        }
+        files.removeAt(i);
+        if (info.size != KIO::invalidFilesize) {
+            reservedSpace += info.size;
+        }
+
+        KIO::FileCopyJob *job = newFileCopyJob(info);
+        m_parallelCopies.insert(job, ParallelCopy{info, 0});
+        q->addSubjob(job);
+        q->connect(job, &Job::processedSize, q, [this](KJob *job, qulonglong processedSize) {
+            auto it = m_parallelCopies.find(job);
+            if (it != m_parallelCopies.end()) {
+                it->processedSize = processedSize;
+            }
+        });
+    }
+}
+
+void CopyJobPrivate::slotResultParallelCopy(KJob *job)
+{
+    Q_Q(CopyJob);
+    const ParallelCopy copy = m_parallelCopies.take(job);
+    const CopyInfo &info = copy.info;
+    if (job->error() && FileCopyJobPrivate::destinationWritten(static_cast<FileCopyJob *>(job))) {
+        // e.g. deleting the source of a move failed, copying again would conflict with our own copy
+        qCDebug(KIO_COPYJOB_DEBUG) << "Copying" << info.uSource << "in parallel failed after writing" << info.uDest << ":" << job->errorString();
+        m_parallelCopyErrors.append(ParallelCopyError{info, job->error(), job->errorText()});
+    } else if (job->error()) {
+        // conflicts and errors are handled by copyNextFile() when it gets to the file again
+        qCDebug(KIO_COPYJOB_DEBUG) << "Copying" << info.uSource << "in parallel failed, retrying it later:" << job->errorString();
+        m_failedParallelCopies.append(info);
+    } else {
+        const QUrl finalUrl = finalDestUrl(info.uSource, info.uDest);
+        // required for the undo feature
+        Q_EMIT q->copyingDone(q, info.uSource, finalUrl, info.mtime, false, false);
+        if (m_mode == CopyJob::Move) {
+#ifndef KIO_ANDROID_STUB
+            org::kde::KDirNotify::emitFileMoved(info.uSource, finalUrl);
+#endif
+        }
+        m_successSrcList.append(info.uSource);
+        if (m_freeSpace != KIO::invalidFilesize && info.size != KIO::invalidFilesize) {
+            m_freeSpace -= info.size;
+        }
+        m_processedSize += info.size != KIO::invalidFilesize ? info.size : copy.processedSize;
+        ++m_processedFiles;
+        m_incomingMetaData += static_cast<KIO::Job *>(job)->metaData();
+    }
+    q->removeSubjob(job);
+
+    if (m_currentCopyJob) {
+        startParallelCopies();
+    } else if (m_waitingForParallelCopies && (m_parallelCopies.isEmpty() || !m_failedParallelCopies.isEmpty() || !m_parallelCopyErrors.isEmpty())) {
+        m_waitingForParallelCopies = false;
+        copyNextFile();
+    }
+}
+
+void CopyJobPrivate::reportParallelCopyError(const ParallelCopyError &copyError)
+{
+    Q_Q(CopyJob);
+    // Handled like the errors of slotResultCopyingFiles(), but with nothing to retry
+    files.prepend(copyError.info);
+    QList<CopyInfo>::Iterator it = files.begin();
+    if (m_bAutoSkipFiles) {
+        processFileRenameDialogResult(it, Result_Skip, QUrl{}, QDateTime{});
+        return;
+    }
+
+    auto *askUserActionInterface = KIO::delegateExtension<KIO::AskUserActionInterface *>(q);
+    if (!askUserActionInterface) {
+        killParallelCopies();
+        q->setError(copyError.error);
+        q->setErrorText(copyError.errorText);
+        q->emitResult();
+        return;
+    }
+
+    if (m_reportTimer) {
+        m_reportTimer->stop();
+    }
+
+    SkipDialog_Options options;
+    if (files.count() > 1) {
+        options |= SkipDialog_MultipleItems;
+    }
+
+    auto skipSignal = &KIO::AskUserActionInterface::askUserSkipResult;
+    QObject::connect(askUserActionInterface, skipSignal, q, [=](SkipDialog_Result result, KJob *parentJob) {
+        Q_ASSERT(parentJob == q);
+        // Only receive askUserSkipResult once per skip dialog
+        QObject::disconnect(askUserActionInterface, skipSignal, q, nullptr);
+        processFileRenameDialogResult(it, result, QUrl() /* no new url in skip */, QDateTime{});
+    });
+
+    askUserActionInterface->askUserSkip(q, options, KIO::buildErrorString(copyError.error, copyError.errorText));
+}
+
+void CopyJobPrivate::killParallelCopies()
+{
+    Q_Q(CopyJob);
+    for (auto it = m_parallelCopies.cbegin(); it != m_parallelCopies.cend(); ++it) {
+        q->removeSubjob(it.key());
+        it.key()->kill(KJob::Quietly);
+    }
+    m_parallelCopies.clear();
 }
 
 void CopyJobPrivate::deleteNextDir()
@@ -2190,6 +2527,7 @@ void CopyJobPrivate::setNextDirAttribute()
 void CopyJob::emitResult()
 {
     Q_D(CopyJob);
+    d->killParallelCopies();
     // Before we go, tell the world about the changes that were made.
     // Even if some error made us abort midway, we might still have done
     // part of the job so we better update the views! (#118583)
@@ -2553,6 +2891,12 @@ void CopyJob::slotResult(KJob *job)
 {
     Q_D(CopyJob);
     qCDebug(KIO_COPYJOB_DEBUG) << "d->state=" << (int)d->state;
+    // They are independent of the state
+    if (d->m_parallelCopies.contains(job)) {
+        d->slotResultParallelCopy(job);
+        return;
+    }
+
     // In each case, what we have to do is :
     // 1 - check for errors and treat them
     // 2 - removeSubjob(job);
@@ -2579,6 +2923,9 @@ void CopyJob::slotResult(KJob *job)
 
         d->statNextSrc();
         break;
+    case STATE_COPYING_TREE:
+        d->slotResultCopyingTree(job);
+        break;
     case STATE_CREATING_DIRS:
         d->slotResultCreatingDirs(job);
         break;
@@ -2624,6 +2971,21 @@ void KIO::CopyJob::setAutoRename(bool autoRename)
     d_func()->m_bAutoRenameDirs = autoRename;
 }
 
+void KIO::CopyJob::setCopyDirectoriesInWorker(bool copyInWorker)
+{
+    d_func()->m_copyDirectoriesInWorker = copyInWorker;
+}
+
+void KIO::CopyJob::setMaximumParallelCopies(int count)
+{
+    d_func()->m_maxParallelCopies = qMax(1, count);
+}
+
+void KIO::CopyJob::setVerifyCopies(bool verify)
+{
+    d_func()->m_verifyCopies = verify;
+}
+
 void KIO::CopyJob::setWriteIntoExistingDirectories(bool overwriteAll) // #65926
 {
     d_func()->m_bOverwriteAllDirs = overwriteAll;
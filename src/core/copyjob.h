@@ -115,6 +115,40 @@ public:
      */
     void setWriteIntoExistingDirectories(bool overwriteAllDirs);
 
+    /**
+     * Copy directories on the local filesystem in one go inside the worker, instead of
+     * listing them here and copying each entry with a job of its own. This only applies
+     * to copies within one filesystem to a destination that doesn't exist yet; anything
+     * else, e.g. something that can't be read, is copied entry by entry as usual.
+     *
+     * The default is false. Call this before the job starts.
+     * \since 5.98
+     */
+    void setCopyDirectoriesInWorker(bool copyInWorker);
+
+    /**
+     * Copy (or move) up to @p count independent files at the same time, instead of
+     * one after the other. This helps with many small files, and with destinations
+     * where each file takes a round trip, like network shares. Conflicts and errors
+     * are still handled one file at a time, and symlinks and files to FAT and NTFS
+     * filesystems are always copied sequentially.
+     *
+     * The default is 1. Call this before the job starts.
+     * \since 5.98
+     */
+    void setMaximumParallelCopies(int count);
+
+    /**
+     * Check each copied file against its source, see FileCopyJob::setVerifyCopy().
+     * A file whose copy differs is reported with KIO::ERR_COPY_VERIFICATION_FAILED,
+     * and isn't deleted when moving. Directories aren't copied in the worker then,
+     * see setCopyDirectoriesInWorker().
+     *
+     * The default is false. Call this before the job starts.
+     * \since 5.98
+     */
+    void setVerifyCopies(bool verify);
+
     /**
      * Reimplemented for internal reasons
      */
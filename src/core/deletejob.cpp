@@ -16,6 +16,7 @@
 #include "listjob.h"
 #include "scheduler.h"
 #include "statjob.h"
+#include "threadedworkqueue_p.h"
 #include <KDirWatch>
 #include <kdirnotify.h>
 
@@ -26,9 +27,21 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QMetaObject>
+#include <QMutex>
 #include <QPointer>
 #include <QThread>
 #include <QTimer>
+#include <qplatformdefs.h>
+
+#include <atomic>
+#include <deque>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "job_p.h"
 
@@ -43,6 +56,7 @@ namespace KIO
 {
 enum DeleteJobState {
     DELETEJOB_STATE_STATING,
+    DELETEJOB_STATE_DELETING_TREES,
     DELETEJOB_STATE_DELETING_FILES,
     DELETEJOB_STATE_DELETING_DIRS,
 };
@@ -76,6 +90,154 @@ public Q_SLOTS:
     }
 };
 
+#ifdef Q_OS_UNIX
+/**
+ * Deletes local directory trees with a few threads, see DeleteJob::setBulkDelete().
+ * There is a task per directory, run by ThreadedWorkQueue.
+ * Each directory is opened relative to its parent, without following symlinks, and
+ * its entries are unlinked relative to it, so replacing a directory of the tree by
+ * a symlink can't lead outside of the tree. A directory is removed once its entries
+ * and subdirectories are gone.
+ *
+ * Nothing is reported per entry, the job reads the counts when it reports progress.
+ * What can't be deleted is left alone, the job goes through it entry by entry then.
+ */
+class DeleteJobBulkDeleter : public QObject
+{
+    Q_OBJECT
+
+public:
+    DeleteJobBulkDeleter(const QList<QUrl> &dirs, QObject *parent)
+        : QObject(parent)
+    {
+        connect(&m_workQueue, &ThreadedWorkQueue::finished, this, &DeleteJobBulkDeleter::finished);
+        for (const QUrl &url : dirs) {
+            // the roots are opened by path, relative to nothing
+            addDir(QFile::encodeName(url.adjusted(QUrl::StripTrailingSlash).toLocalFile()), nullptr);
+        }
+        m_workQueue.start();
+    }
+
+    ~DeleteJobBulkDeleter() override
+    {
+        m_workQueue.stop();
+        // left open when stopping half way
+        for (const Dir &dir : m_dirs) {
+            if (dir.fd != -1) {
+                ::close(dir.fd);
+            }
+        }
+    }
+
+    quint64 deletedFiles() const
+    {
+        return m_deletedFiles;
+    }
+
+    quint64 deletedDirs() const
+    {
+        return m_deletedDirs;
+    }
+
+Q_SIGNALS:
+    void finished();
+
+private:
+    struct Dir {
+        Dir(const QByteArray &name, Dir *parent)
+            : name(name)
+            , parent(parent)
+        {
+        }
+        const QByteArray name; // the path for a root
+        Dir *const parent;
+        // open while its subdirectories need it, set before they are queued
+        int fd = -1;
+        // its own listing, and each subdirectory not removed yet
+        std::atomic<int> pending{1};
+    };
+
+    void addDir(const QByteArray &name, Dir *parent)
+    {
+        Dir *dir;
+        {
+            QMutexLocker locker(&m_dirsMutex);
+            m_dirs.emplace_back(name, parent);
+            dir = &m_dirs.back();
+        }
+        m_workQueue.add([this, dir]() {
+            deleteEntries(dir);
+        });
+    }
+
+    void deleteEntries(Dir *dir)
+    {
+        const int parentFd = dir->parent ? dir->parent->fd : AT_FDCWD;
+        dir->fd = ::openat(parentFd, dir->name.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        // closedir() closes the descriptor it reads from, the subdirectories need another one
+        const int listFd = dir->fd == -1 ? -1 : ::fcntl(dir->fd, F_DUPFD_CLOEXEC, 0);
+        DIR *dirp = listFd == -1 ? nullptr : ::fdopendir(listFd);
+        if (!dirp) {
+            if (listFd != -1) {
+                ::close(listFd);
+            }
+            release(dir);
+            return;
+        }
+        const int fd = dir->fd;
+
+        while (!m_workQueue.isStopping()) {
+            const struct dirent *ent = ::readdir(dirp);
+            if (!ent) {
+                break;
+            }
+            if (qstrcmp(ent->d_name, ".") == 0 || qstrcmp(ent->d_name, "..") == 0) {
+                continue;
+            }
+
+            bool isDir = ent->d_type == DT_DIR;
+            if (ent->d_type == DT_UNKNOWN) {
+                struct stat buff;
+                isDir = ::fstatat(fd, ent->d_name, &buff, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(buff.st_mode);
+            }
+
+            if (isDir) {
+                ++dir->pending;
+                addDir(QByteArray(ent->d_name), dir);
+            } else if (::unlinkat(fd, ent->d_name, 0) == 0) {
+                ++m_deletedFiles;
+            }
+        }
+
+        ::closedir(dirp);
+        release(dir);
+    }
+
+    // Removes the directories that are done, going up as long as the parents are done too
+    void release(Dir *dir)
+    {
+        while (dir && --dir->pending == 0) {
+            if (dir->fd != -1) {
+                ::close(dir->fd);
+                dir->fd = -1;
+            }
+            // the parent is still open, it waits for this one
+            const int result = dir->parent ? ::unlinkat(dir->parent->fd, dir->name.constData(), AT_REMOVEDIR) : ::rmdir(dir->name.constData());
+            if (result == 0) {
+                ++m_deletedDirs;
+            }
+            dir = dir->parent;
+        }
+    }
+
+    QMutex m_dirsMutex;
+    std::deque<Dir> m_dirs; // all of them, the tasks point into this
+    std::atomic<quint64> m_deletedFiles{0};
+    std::atomic<quint64> m_deletedDirs{0};
+    ThreadedWorkQueue m_workQueue;
+};
+#endif
+
 class DeleteJobPrivate : public KIO::JobPrivate
 {
 public:
@@ -104,10 +266,19 @@ public:
     DeleteJobIOWorker *m_ioworker = nullptr;
     QThread *m_thread = nullptr;
 
+    // See setBulkDelete()
+    bool m_bulkDelete = false;
+    QList<QUrl> m_bulkDirs;
+#ifdef Q_OS_UNIX
+    DeleteJobBulkDeleter *m_bulkDeleter = nullptr;
+#endif
+
     void statNextSrc();
     DeleteJobIOWorker *worker();
     void currentSourceStated(bool isDir, bool isLink);
     void finishedStatPhase();
+    void startBulkDelete();
+    void bulkDeleteFinished();
     void deleteNextFile();
     void deleteNextDir();
     void restoreDirWatch() const;
@@ -176,6 +347,11 @@ QList<QUrl> DeleteJob::urls() const
     return d_func()->m_srcList;
 }
 
+void DeleteJob::setBulkDelete(bool bulk)
+{
+    d_func()->m_bulkDelete = bulk;
+}
+
 void DeleteJobPrivate::slotStart()
 {
     statNextSrc();
@@ -213,8 +389,17 @@ void DeleteJobPrivate::slotReport()
 
     switch (state) {
     case DELETEJOB_STATE_STATING:
-        q->setTotalAmount(KJob::Files, files.count());
-        q->setTotalAmount(KJob::Directories, dirs.count());
+        q->setTotalAmount(KJob::Files, files.count() + m_processedFiles);
+        q->setTotalAmount(KJob::Directories, dirs.count() + m_processedDirs);
+        break;
+    case DELETEJOB_STATE_DELETING_TREES:
+#ifdef Q_OS_UNIX
+        // the size of the trees is only known once they are gone
+        q->setTotalAmount(KJob::Files, files.count() + m_bulkDeleter->deletedFiles());
+        q->setTotalAmount(KJob::Directories, dirs.count() + m_bulkDeleter->deletedDirs());
+        q->setProcessedAmount(KJob::Files, m_bulkDeleter->deletedFiles());
+        q->setProcessedAmount(KJob::Directories, m_bulkDeleter->deletedDirs());
+#endif
         break;
     case DELETEJOB_STATE_DELETING_DIRS:
         q->setProcessedAmount(KJob::Directories, m_processedDirs);
@@ -318,7 +503,13 @@ void DeleteJobPrivate::statNextSrc()
 
 void DeleteJobPrivate::finishedStatPhase()
 {
-    m_totalFilesDirs = files.count() + symlinks.count() + dirs.count();
+    if (!m_bulkDirs.isEmpty()) {
+        startBulkDelete();
+        return;
+    }
+
+    // m_processed* are what the bulk deletion did already
+    m_totalFilesDirs = files.count() + symlinks.count() + dirs.count() + m_processedFiles + m_processedDirs;
     slotReport();
     // Now we know which dirs hold the files we're going to delete.
     // To speed things up and prevent double-notification, we disable KDirWatch
@@ -331,6 +522,41 @@ void DeleteJobPrivate::finishedStatPhase()
     deleteNextFile();
 }
 
+void DeleteJobPrivate::startBulkDelete()
+{
+#ifdef Q_OS_UNIX
+    Q_Q(DeleteJob);
+    state = DELETEJOB_STATE_DELETING_TREES;
+    m_currentURL = m_bulkDirs.first();
+    m_bulkDeleter = new DeleteJobBulkDeleter(m_bulkDirs, q);
+    QObject::connect(m_bulkDeleter, &DeleteJobBulkDeleter::finished, q, [this]() {
+        bulkDeleteFinished();
+    });
+#endif
+}
+
+void DeleteJobPrivate::bulkDeleteFinished()
+{
+#ifdef Q_OS_UNIX
+    m_processedFiles += m_bulkDeleter->deletedFiles();
+    m_processedDirs += m_bulkDeleter->deletedDirs();
+    m_bulkDeleter->deleteLater();
+    m_bulkDeleter = nullptr;
+#endif
+
+    // What's left, e.g. for lack of permissions, is deleted the usual way
+    const QList<QUrl> bulkDirs = m_bulkDirs;
+    m_bulkDirs.clear();
+    for (const QUrl &url : bulkDirs) {
+        QT_STATBUF buff;
+        if (QT_LSTAT(QFile::encodeName(url.toLocalFile()).constData(), &buff) == 0) {
+            dirs.append(url);
+        }
+    }
+    state = DELETEJOB_STATE_STATING;
+    finishedStatPhase();
+}
+
 void DeleteJobPrivate::rmFileResult(bool result, bool isLink)
 {
     if (result) {
@@ -480,14 +706,23 @@ void DeleteJobPrivate::currentSourceStated(bool isDir, bool isLink)
     const QUrl url = (*m_currentStat);
     if (isDir && !isLink) {
         // Add toplevel dir in list of dirs
-        dirs.append(url);
+#ifdef Q_OS_UNIX
+        const bool bulk = m_bulkDelete && url.isLocalFile();
+#else
+        const bool bulk = false;
+#endif
+        if (bulk) {
+            m_bulkDirs.append(url);
+        } else {
+            dirs.append(url);
+        }
         if (url.isLocalFile()) {
             // We are about to delete this dir, no need to watch it
             // Maybe we should ask kdirwatch to remove all watches recursively?
             // But then there would be no feedback (things disappearing progressively) during huge deletions
             KDirWatch::self()->stopDirScan(url.adjusted(QUrl::StripTrailingSlash).toLocalFile());
         }
-        if (!KProtocolManager::canDeleteRecursive(url)) {
+        if (!bulk && !KProtocolManager::canDeleteRecursive(url)) {
             // qDebug() << url << "is a directory, let's list it";
             ListJob *newjob = KIO::listRecursive(url, KIO::HideProgressInfo);
 #if KIOCORE_BUILD_DEPRECATED_SINCE(5, 69)
@@ -43,6 +43,20 @@ public:
      */
     QList<QUrl> urls() const;
 
+    /**
+     * Delete local directories with a few threads working on the tree directly,
+     * instead of removing it entry by entry in one worker. Meant for big trees when
+     * nobody needs to follow each entry: deleting() only names the directories given
+     * to the job, and the number of files and directories grows as they are deleted.
+     *
+     * Anything that can't be deleted that way is deleted as usual afterwards, with the
+     * usual error handling. Only supported on Unix systems.
+     *
+     * The default is false. Call this before the job starts.
+     * @since 5.98
+     */
+    void setBulkDelete(bool bulk);
+
 Q_SIGNALS:
 
     /**
@@ -0,0 +1,320 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "directorysizecache_p.h"
+
+#include <kdirnotify.h>
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QGlobalStatic>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QUrl>
+#include <qplatformdefs.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+using namespace KIO;
+
+static const quint32 s_magic = 0x4b445343; // "KDSC"
+static const qint32 s_version = 1;
+// In case a file changed in place while nobody was listening
+static const qint64 s_maxAge = 24 * 60 * 60;
+// About 30 bytes on disk per unit, a few megabytes in total
+static const qint64 s_maxWeight = 100000;
+// A larger file wasn't written by us
+static const qint64 s_maxFileSize = 8 * 1024 * 1024;
+
+// What an entry costs, its names take most of the room
+static qint64 weight(const DirectorySizeCache::Entry &entry)
+{
+    return 1 + entry.subdirs.size() + entry.hardLinks.size();
+}
+
+Q_GLOBAL_STATIC(DirectorySizeCache, s_directorySizeCache)
+
+static void shutdownOnExit()
+{
+    if (s_directorySizeCache.exists()) {
+        s_directorySizeCache()->shutdown();
+    }
+}
+
+DirectorySizeCache *DirectorySizeCache::self()
+{
+    return s_directorySizeCache();
+}
+
+DirectorySizeCache::DirectorySizeCache()
+    : m_cachePath(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/kio/directorysizes"))
+    , m_saveTimer(new QTimer(this))
+{
+    // post routine since the timer and the D-Bus interface can't outlive QCoreApplication
+    qAddPostRoutine(shutdownOnExit);
+
+    // writes once after a burst of changes
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(2000);
+    connect(m_saveTimer, &QTimer::timeout, this, &DirectorySizeCache::save);
+
+#ifndef KIO_ANDROID_STUB
+    auto *kdirnotify = new org::kde::KDirNotify(QString(), QString(), QDBusConnection::sessionBus(), this);
+    connect(kdirnotify, &org::kde::KDirNotify::FileRenamedWithLocalPath, this, [this](const QString &src, const QString &dst) {
+        invalidateUrls({src, dst});
+    });
+    connect(kdirnotify, &org::kde::KDirNotify::FilesAdded, this, [this](const QString &dir) {
+        invalidateUrls({dir});
+    });
+    connect(kdirnotify, &org::kde::KDirNotify::FilesChanged, this, &DirectorySizeCache::invalidateUrls);
+    connect(kdirnotify, &org::kde::KDirNotify::FilesRemoved, this, &DirectorySizeCache::invalidateUrls);
+#endif
+}
+
+DirectorySizeCache::~DirectorySizeCache() = default;
+
+void DirectorySizeCache::shutdown()
+{
+    save();
+    QMutexLocker locker(&m_mutex);
+    // the timer is one of the children, which include the KDirNotify interface
+    m_saveTimer = nullptr;
+    qDeleteAll(children());
+}
+
+bool DirectorySizeCache::isCached(const QByteArray &path)
+{
+    auto isIn = [&path](const QByteArray &dir) {
+        return path == dir || path.startsWith(dir + '/');
+    };
+
+    // The trashes as TrashImpl finds them: the one in the home and those at the
+    // top of other partitions
+    if (isIn(QFile::encodeName(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)) + "/Trash/files")) {
+        return true;
+    }
+#ifdef Q_OS_UNIX
+    const QByteArray uid = QByteArray::number(::getuid());
+    for (const QByteArray &topDirTrash : {QByteArray("/.Trash-" + uid + "/files"), QByteArray("/.Trash/" + uid + "/files")}) {
+        for (int pos = path.indexOf(topDirTrash); pos != -1; pos = path.indexOf(topDirTrash, pos + 1)) {
+            const int end = pos + topDirTrash.size();
+            if (end == path.size() || path.at(end) == '/') {
+                return true;
+            }
+        }
+    }
+#endif
+    return false;
+}
+
+bool DirectorySizeCache::find(quint64 device, quint64 inode, qint64 mtime, Entry *entry)
+{
+    QMutexLocker locker(&m_mutex);
+    load();
+    auto it = m_entries.find(qMakePair(device, inode));
+    if (it == m_entries.end()) {
+        return false;
+    }
+    if (it->mtime != mtime || it->created < QDateTime::currentSecsSinceEpoch() - s_maxAge) {
+        eraseEntry(it);
+        m_changed = true;
+        return false;
+    }
+    *entry = *it;
+    return true;
+}
+
+void DirectorySizeCache::insert(quint64 device, quint64 inode, const Entry &entry)
+{
+    if (weight(entry) > s_maxWeight / 16) {
+        return; // would push out too many others
+    }
+
+    QMutexLocker locker(&m_mutex);
+    load();
+    Entry newEntry = entry;
+    newEntry.created = QDateTime::currentSecsSinceEpoch();
+    insertEntry(qMakePair(device, inode), newEntry);
+    prune();
+    m_changed = true;
+}
+
+void DirectorySizeCache::insertEntry(const QPair<quint64, quint64> &key, const Entry &entry)
+{
+    Q_ASSERT(!m_mutex.tryLock());
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        eraseEntry(it);
+    }
+    m_entries.insert(key, entry);
+    m_weight += weight(entry);
+}
+
+void DirectorySizeCache::eraseEntry(QHash<QPair<quint64, quint64>, Entry>::iterator it)
+{
+    Q_ASSERT(!m_mutex.tryLock());
+    m_weight -= weight(*it);
+    m_entries.erase(it);
+}
+
+void DirectorySizeCache::prune()
+{
+    Q_ASSERT(!m_mutex.tryLock());
+    if (m_weight <= s_maxWeight) {
+        return;
+    }
+
+    // the oldest go first, down to some room for new ones
+    std::vector<std::pair<qint64, QPair<quint64, quint64>>> byAge;
+    byAge.reserve(m_entries.size());
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        byAge.emplace_back(it->created, it.key());
+    }
+    std::sort(byAge.begin(), byAge.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+    for (const auto &oldest : byAge) {
+        if (m_weight <= s_maxWeight * 3 / 4) {
+            break;
+        }
+        eraseEntry(m_entries.find(oldest.second));
+    }
+}
+
+void DirectorySizeCache::invalidate(const QString &path)
+{
+    QByteArray encodedPath = QFile::encodeName(path);
+    while (encodedPath.size() > 1 && encodedPath.endsWith('/')) {
+        encodedPath.chop(1);
+    }
+    if (!isCached(encodedPath)) {
+        return;
+    }
+    const int slash = encodedPath.lastIndexOf('/');
+    const QByteArray parentPath = slash > 0 ? encodedPath.left(slash) : QByteArray("/");
+
+    QMutexLocker locker(&m_mutex);
+    load();
+    // a file changed in the parent, or the entries of the directory itself
+    const bool removed = remove(encodedPath) | remove(parentPath);
+    if (removed) {
+        m_changed = true;
+        if (m_saveTimer) {
+            QMetaObject::invokeMethod(m_saveTimer, qOverload<>(&QTimer::start));
+        }
+    }
+}
+
+void DirectorySizeCache::invalidateUrls(const QStringList &urls)
+{
+    for (const QString &url : urls) {
+        const QUrl u(url);
+        if (u.isLocalFile()) {
+            invalidate(u.toLocalFile());
+        }
+    }
+}
+
+bool DirectorySizeCache::remove(const QByteArray &path)
+{
+    Q_ASSERT(!m_mutex.tryLock());
+    QT_STATBUF buff;
+    if (path.isEmpty() || QT_LSTAT(path.constData(), &buff) == -1 || (buff.st_mode & QT_STAT_MASK) != QT_STAT_DIR) {
+        return false;
+    }
+    auto it = m_entries.find(qMakePair(quint64(buff.st_dev), quint64(buff.st_ino)));
+    if (it == m_entries.end()) {
+        return false;
+    }
+    eraseEntry(it);
+    return true;
+}
+
+void DirectorySizeCache::load()
+{
+    Q_ASSERT(!m_mutex.tryLock());
+    if (m_loaded) {
+        return;
+    }
+    m_loaded = true;
+
+    QFile file(m_cachePath);
+    if (file.size() > s_maxFileSize || !file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    quint32 magic;
+    qint32 version;
+    qint32 count;
+    stream >> magic >> version >> count;
+    if (magic != s_magic || version != s_version || count < 0) {
+        return;
+    }
+
+    const qint64 oldest = QDateTime::currentSecsSinceEpoch() - s_maxAge;
+    m_entries.reserve(qMin(count, 16384));
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok && m_weight <= s_maxWeight; ++i) {
+        quint64 device;
+        quint64 inode;
+        Entry entry;
+        qint32 hardLinkCount;
+        stream >> device >> inode >> entry.mtime >> entry.created >> entry.size >> entry.files >> entry.linkedSubdirs >> entry.subdirs >> hardLinkCount;
+        for (int j = 0; j < hardLinkCount && stream.status() == QDataStream::Ok; ++j) {
+            HardLink hardLink;
+            stream >> hardLink.device >> hardLink.inode >> hardLink.size;
+            entry.hardLinks.append(hardLink);
+        }
+        if (stream.status() == QDataStream::Ok && entry.created >= oldest) {
+            insertEntry(qMakePair(device, inode), entry);
+        }
+    }
+    if (stream.status() != QDataStream::Ok) {
+        // truncated or corrupt, start over
+        m_entries.clear();
+        m_weight = 0;
+    }
+}
+
+void DirectorySizeCache::save()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_changed) {
+        return;
+    }
+    m_changed = false;
+
+    QDir().mkpath(QFileInfo(m_cachePath).absolutePath());
+    QSaveFile file(m_cachePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << s_magic << s_version << qint32(m_entries.size());
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        const Entry &entry = it.value();
+        stream << it.key().first << it.key().second << entry.mtime << entry.created << entry.size << entry.files << entry.linkedSubdirs << entry.subdirs
+               << qint32(entry.hardLinks.size());
+        for (const HardLink &hardLink : entry.hardLinks) {
+            stream << hardLink.device << hardLink.inode << hardLink.size;
+        }
+    }
+    file.commit();
+}
@@ -0,0 +1,117 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KIO_DIRECTORYSIZECACHE_P_H
+#define KIO_DIRECTORYSIZECACHE_P_H
+
+#include "global.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QStringList>
+
+class QTimer;
+
+namespace KIO
+{
+/**
+ * @internal
+ * Singleton remembering what the local directories in the trash contain, shared by
+ * all the DirectorySizeJobs of a process and kept on disk between processes.
+ *
+ * There is an entry per directory, with the sizes of its files and the names of its
+ * subdirectories, so sizing a tree again only stats its directories. Entries are found
+ * by device and inode, so they survive renames within the trash, and are used as long
+ * as the modification time of the directory didn't change.
+ *
+ * Changing a file in place leaves the time of its directory alone, which is why only
+ * the trash is cached: nobody edits the files there. An entry is also dropped when
+ * KDirNotify tells about a change, and entries are recomputed after a day anyway.
+ * There are at most a few megabytes of entries, the oldest ones go first.
+ *
+ * All methods are thread-safe, the first call to self() has to be in the main thread.
+ */
+class DirectorySizeCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct HardLink {
+        quint64 device;
+        quint64 inode;
+        KIO::filesize_t size;
+    };
+
+    struct Entry {
+        qint64 mtime = 0; // of the directory, in nanoseconds
+        qint64 created = 0; // in seconds since the epoch
+        KIO::filesize_t size = 0; // of the files, not counting symlinks and hard links
+        KIO::filesize_t files = 0; // files and symlinks to anything but directories
+        KIO::filesize_t linkedSubdirs = 0; // symlinks to directories
+        QList<QByteArray> subdirs;
+        QList<HardLink> hardLinks; // files with more than one link, counted once per tree
+    };
+
+    // for Q_GLOBAL_STATIC, use self()
+    DirectorySizeCache();
+    ~DirectorySizeCache() override;
+
+    static DirectorySizeCache *self();
+
+    /**
+     * Whether the entries of the local directory @p path and of its subdirectories
+     * are cached, i.e. whether it is in a trash.
+     */
+    static bool isCached(const QByteArray &path);
+
+    /**
+     * Looks up the directory @p device and @p inode, modified at @p mtime.
+     * @return false if there is no entry, or an outdated one
+     */
+    bool find(quint64 device, quint64 inode, qint64 mtime, Entry *entry);
+
+    void insert(quint64 device, quint64 inode, const Entry &entry);
+
+    /**
+     * Drops the entries of the local @p path and of its parent directory.
+     */
+    void invalidate(const QString &path);
+
+    /**
+     * Writes the entries to disk, if they changed.
+     */
+    void save();
+
+    /**
+     * Saves the entries and deletes the timer and the D-Bus interface, which can't
+     * outlive QCoreApplication. Called when the application goes away.
+     */
+    void shutdown();
+
+private:
+    void load();
+    void insertEntry(const QPair<quint64, quint64> &key, const Entry &entry);
+    void eraseEntry(QHash<QPair<quint64, quint64>, Entry>::iterator it);
+    bool remove(const QByteArray &path);
+    void prune();
+    void invalidateUrls(const QStringList &urls);
+
+    const QString m_cachePath;
+    QMutex m_mutex; // protects all the member variables below
+    QHash<QPair<quint64, quint64>, Entry> m_entries; // device, inode -> entry
+    qint64 m_weight = 0; // of all the entries, see weight() in the .cpp
+    bool m_loaded = false;
+    bool m_changed = false;
+    QTimer *m_saveTimer;
+};
+
+}
+
+#endif
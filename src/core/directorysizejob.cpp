@@ -6,18 +6,260 @@
 */
 
 #include "directorysizejob.h"
+
+#include "../pathhelpers_p.h"
+#include "directorysizecache_p.h"
 #include "global.h"
+#include "kprotocolinfo.h"
 #include "listjob.h"
+#include "threadedworkqueue_p.h"
 #include <QDebug>
+#include <QFile>
+#include <QMutex>
+#include <QSet>
 #include <QTimer>
 #include <kio/jobuidelegatefactory.h>
 
 #include "job_p.h"
 
+#include <atomic>
 #include <set>
+#include <utility>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
 
 namespace KIO
 {
+#ifdef Q_OS_UNIX
+/**
+ * Sizes local directory trees with a few threads, instead of listing them through kio_file.
+ * There is a task per directory, run by ThreadedWorkQueue, which stats the entries
+ * relative to their directory. Directories in the trash that didn't change since
+ * DirectorySizeCache got their entries aren't read again.
+ *
+ * The sums are the ones a recursive listing gives: the size of each directory and
+ * of each entry that isn't a symlink, hard links and directories counted once.
+ * Only the directories it starts with report errors, like a recursive listing.
+ */
+class DirectorySizeJobLocalSizer : public QObject
+{
+    Q_OBJECT
+
+public:
+    DirectorySizeJobLocalSizer(const QList<QUrl> &dirs, QObject *parent)
+        : QObject(parent)
+        , m_cache(DirectorySizeCache::self())
+    {
+        connect(&m_workQueue, &ThreadedWorkQueue::finished, this, &DirectorySizeJobLocalSizer::finished);
+        for (const QUrl &url : dirs) {
+            const QByteArray path = QFile::encodeName(url.adjusted(QUrl::StripTrailingSlash).toLocalFile());
+            addDir({path, true, DirectorySizeCache::isCached(path)});
+        }
+        m_workQueue.start([this]() {
+            m_cache->save();
+        });
+    }
+
+    ~DirectorySizeJobLocalSizer() override
+    {
+        m_workQueue.stop();
+    }
+
+    KIO::filesize_t totalSize() const
+    {
+        return m_totalSize;
+    }
+
+    KIO::filesize_t totalFiles() const
+    {
+        return m_totalFiles;
+    }
+
+    KIO::filesize_t totalSubdirs() const
+    {
+        return m_totalSubdirs;
+    }
+
+    // The first error, once finished
+    int error() const
+    {
+        return m_error;
+    }
+
+    QString errorText() const
+    {
+        return m_errorText;
+    }
+
+Q_SIGNALS:
+    void finished();
+
+private:
+    struct Dir {
+        QByteArray path;
+        bool isRoot;
+        bool isCached; // see DirectorySizeCache::isCached()
+    };
+
+    void addDir(Dir &&dir)
+    {
+        m_workQueue.add([this, dir = std::move(dir)]() {
+            sizeEntries(dir);
+        });
+    }
+
+    void sizeEntries(const Dir &dir)
+    {
+        // its own size, what the "." entry of a listing gives
+        struct stat buff;
+        if ((dir.isRoot ? ::stat(dir.path.constData(), &buff) : ::lstat(dir.path.constData(), &buff)) == -1) {
+            if (dir.isRoot) {
+                setError(errno == ENOENT ? KIO::ERR_DOES_NOT_EXIST : KIO::ERR_CANNOT_ENTER_DIRECTORY, dir.path);
+            }
+            return;
+        }
+        if (!S_ISDIR(buff.st_mode)) {
+            if (dir.isRoot) {
+                setError(KIO::ERR_IS_FILE, dir.path);
+            }
+            return;
+        }
+        if (!visit(buff.st_dev, buff.st_ino)) {
+            return;
+        }
+        m_totalSize += buff.st_size;
+        if (!dir.isRoot) {
+            ++m_totalSubdirs;
+        }
+
+        DirectorySizeCache::Entry entry;
+        const qint64 mtime = modificationTime(buff);
+        if (dir.isCached && m_cache->find(buff.st_dev, buff.st_ino, mtime, &entry)) {
+            addEntry(dir, entry);
+            return;
+        }
+        entry.mtime = mtime;
+
+        const int fd = ::open(dir.path.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | (dir.isRoot ? 0 : O_NOFOLLOW));
+        DIR *dirp = fd == -1 ? nullptr : ::fdopendir(fd);
+        if (!dirp) {
+            const int err = errno;
+            if (fd != -1) {
+                ::close(fd);
+            }
+            if (dir.isRoot) {
+                setError(err == ENOENT ? KIO::ERR_DOES_NOT_EXIST : KIO::ERR_CANNOT_ENTER_DIRECTORY, dir.path);
+            }
+            return;
+        }
+
+        bool complete = true;
+        while (true) {
+            if (m_workQueue.isStopping()) {
+                complete = false;
+                break;
+            }
+            const struct dirent *ent = ::readdir(dirp);
+            if (!ent) {
+                break;
+            }
+            if (qstrcmp(ent->d_name, ".") == 0 || qstrcmp(ent->d_name, "..") == 0) {
+                continue;
+            }
+
+            struct stat entBuff;
+            if (::fstatat(fd, ent->d_name, &entBuff, AT_SYMLINK_NOFOLLOW) == -1) {
+                continue;
+            }
+            if (S_ISLNK(entBuff.st_mode)) {
+                // not followed, counted as what it points to
+                struct stat target;
+                if (::fstatat(fd, ent->d_name, &target, 0) == 0 && S_ISDIR(target.st_mode)) {
+                    ++entry.linkedSubdirs;
+                } else {
+                    ++entry.files;
+                }
+            } else if (S_ISDIR(entBuff.st_mode)) {
+                entry.subdirs.append(QByteArray(ent->d_name));
+            } else if (entBuff.st_nlink > 1) {
+                entry.hardLinks.append({quint64(entBuff.st_dev), quint64(entBuff.st_ino), KIO::filesize_t(entBuff.st_size)});
+            } else {
+                entry.size += entBuff.st_size;
+                ++entry.files;
+            }
+        }
+        ::closedir(dirp);
+
+        addEntry(dir, entry);
+        // a change within the same tick of the clock wouldn't show in the time
+        if (dir.isCached && complete && mtime / 1000000000 < qint64(::time(nullptr)) - 1) {
+            m_cache->insert(buff.st_dev, buff.st_ino, entry);
+        }
+    }
+
+    void addEntry(const Dir &dir, const DirectorySizeCache::Entry &entry)
+    {
+        m_totalSize += entry.size;
+        m_totalFiles += entry.files;
+        m_totalSubdirs += entry.linkedSubdirs;
+        for (const DirectorySizeCache::HardLink &hardLink : entry.hardLinks) {
+            // Hard-link detection (#67939)
+            if (visit(hardLink.device, hardLink.inode)) {
+                m_totalSize += hardLink.size;
+                ++m_totalFiles;
+            }
+        }
+
+        for (const QByteArray &name : entry.subdirs) {
+            addDir({dir.path + '/' + name, false, dir.isCached});
+        }
+    }
+
+    static qint64 modificationTime(const struct stat &buff)
+    {
+#if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD)
+        return qint64(buff.st_mtim.tv_sec) * 1000000000 + buff.st_mtim.tv_nsec;
+#else
+        return qint64(buff.st_mtime) * 1000000000;
+#endif
+    }
+
+    // Returns false if the file was seen already
+    bool visit(quint64 device, quint64 inode)
+    {
+        QMutexLocker locker(&m_visitedMutex);
+        return m_visitedInodes.insert({device, inode}).second;
+    }
+
+    void setError(int error, const QByteArray &path)
+    {
+        QMutexLocker locker(&m_errorMutex);
+        if (m_error == 0) {
+            m_error = error;
+            m_errorText = QFile::decodeName(path);
+        }
+    }
+
+    DirectorySizeCache *const m_cache;
+    std::atomic<KIO::filesize_t> m_totalSize{0};
+    std::atomic<KIO::filesize_t> m_totalFiles{0};
+    std::atomic<KIO::filesize_t> m_totalSubdirs{0};
+    QMutex m_errorMutex; // protects the 2 vars below
+    int m_error = 0;
+    QString m_errorText;
+    QMutex m_visitedMutex;
+    std::set<std::pair<quint64, quint64>> m_visitedInodes;
+    ThreadedWorkQueue m_workQueue;
+};
+#endif
+
 class DirectorySizeJobPrivate : public KIO::JobPrivate
 {
 public:
@@ -41,11 +283,32 @@ public:
     KIO::filesize_t m_totalSubdirs;
     KFileItemList m_lstItems;
     int m_currentItem;
+    QList<QUrl> m_dirs; // to size, besides the directories among m_lstItems
     QHash<long, std::set<long>> m_visitedInodes; // device -> set of inodes
 
-    void startNextJob(const QUrl &url);
+    // Directories are listed one level deep, their subdirectories recursively and
+    // concurrently, the listings of the subdirectories don't count their "."
+    QList<QPair<QUrl, bool>> m_pendingListings; // url, whether it's a subdirectory
+    QSet<KJob *> m_subdirListings;
+    int m_runningListings = 0;
+    int m_error = 0;
+    QString m_errorText;
+    QTimer *m_reportTimer = nullptr;
+#ifdef Q_OS_UNIX
+    DirectorySizeJobLocalSizer *m_localSizer = nullptr;
+#endif
+
+    KIO::filesize_t totalSize() const;
+    KIO::filesize_t totalFiles() const;
+    KIO::filesize_t totalSubdirs() const;
+    void startListings();
+    void startListing(const QUrl &url, bool isSubdir);
     void slotEntries(KIO::Job *, const KIO::UDSEntryList &);
     void processNextItem();
+    void localSizerFinished();
+    void setError(int error, const QString &errorText);
+    void slotReport();
+    void finishIfDone();
 
     Q_DECLARE_PUBLIC(DirectorySizeJob)
 
@@ -54,7 +317,8 @@ public:
         DirectorySizeJobPrivate *d = new DirectorySizeJobPrivate;
         DirectorySizeJob *job = new DirectorySizeJob(*d);
         job->setUiDelegate(KIO::createDefaultJobUiDelegate());
-        d->startNextJob(directory);
+        d->m_dirs.append(directory);
+        QTimer::singleShot(0, job, SLOT(processNextItem()));
         return job;
     }
 
@@ -83,17 +347,47 @@ DirectorySizeJob::~DirectorySizeJob()
 
 KIO::filesize_t DirectorySizeJob::totalSize() const
 {
-    return d_func()->m_totalSize;
+    return d_func()->totalSize();
 }
 
 KIO::filesize_t DirectorySizeJob::totalFiles() const
 {
-    return d_func()->m_totalFiles;
+    return d_func()->totalFiles();
 }
 
 KIO::filesize_t DirectorySizeJob::totalSubdirs() const
 {
-    return d_func()->m_totalSubdirs;
+    return d_func()->totalSubdirs();
+}
+
+KIO::filesize_t DirectorySizeJobPrivate::totalSize() const
+{
+#ifdef Q_OS_UNIX
+    if (m_localSizer) {
+        return m_totalSize + m_localSizer->totalSize();
+    }
+#endif
+    return m_totalSize;
+}
+
+KIO::filesize_t DirectorySizeJobPrivate::totalFiles() const
+{
+#ifdef Q_OS_UNIX
+    if (m_localSizer) {
+        return m_totalFiles + m_localSizer->totalFiles();
+    }
+#endif
+    return m_totalFiles;
+}
+
+KIO::filesize_t DirectorySizeJobPrivate::totalSubdirs() const
+{
+#ifdef Q_OS_UNIX
+    if (m_localSizer) {
+        return m_totalSubdirs + m_localSizer->totalSubdirs();
+    }
+#endif
+    return m_totalSubdirs;
 }
 
 void DirectorySizeJobPrivate::processNextItem()
@@ -104,9 +398,7 @@ void DirectorySizeJobPrivate::processNextItem()
         // qDebug() << item;
         if (!item.isLink()) {
             if (item.isDir()) {
-                // qDebug() << "dir -> listing";
-                startNextJob(item.targetUrl());
-                return; // we'll come back later, when this one's finished
+                m_dirs.append(item.targetUrl());
             } else {
                 m_totalSize += item.size();
                 m_totalFiles++;
@@ -116,15 +408,61 @@ void DirectorySizeJobPrivate::processNextItem()
             m_totalFiles++;
         }
     }
-    // qDebug() << "finished";
-    q->emitResult();
+
+    QList<QUrl> localDirs;
+    for (const QUrl &url : std::as_const(m_dirs)) {
+#ifdef Q_OS_UNIX
+        if (url.isLocalFile()) {
+            localDirs.append(url);
+            continue;
+        }
+#endif
+        m_pendingListings.append(qMakePair(url, false));
+    }
+    m_dirs.clear();
+
+#ifdef Q_OS_UNIX
+    if (!localDirs.isEmpty()) {
+        m_localSizer = new DirectorySizeJobLocalSizer(localDirs, q);
+        QObject::connect(m_localSizer, &DirectorySizeJobLocalSizer::finished, q, [this]() {
+            localSizerFinished();
+        });
+    }
+#endif
+    startListings();
+
+    m_reportTimer = new QTimer(q);
+    QObject::connect(m_reportTimer, &QTimer::timeout, q, [this]() {
+        slotReport();
+    });
+    m_reportTimer->start(200);
+
+    finishIfDone();
 }
 
-void DirectorySizeJobPrivate::startNextJob(const QUrl &url)
+// Up to as many listings as the protocol allows workers per host, the others would just wait for a worker
+static int maxListings(const QUrl &url)
+{
+    int max = KProtocolInfo::maxSlavesPerHost(url.scheme());
+    if (max <= 0) {
+        max = KProtocolInfo::maxSlaves(url.scheme());
+    }
+    return qMax(1, max);
+}
+
+void DirectorySizeJobPrivate::startListings()
+{
+    while (!m_pendingListings.isEmpty() && m_runningListings < maxListings(m_pendingListings.first().first)) {
+        const auto listing = m_pendingListings.takeFirst();
+        startListing(listing.first, listing.second);
+    }
+}
+
+void DirectorySizeJobPrivate::startListing(const QUrl &url, bool isSubdir)
 {
     Q_Q(DirectorySizeJob);
     // qDebug() << url;
-    KIO::ListJob *listJob = KIO::listRecursive(url, KIO::HideProgressInfo);
+    KIO::ListJob *listJob = isSubdir ? KIO::listRecursive(url, KIO::HideProgressInfo) : KIO::listDir(url, KIO::HideProgressInfo);
 #if KIOCORE_BUILD_DEPRECATED_SINCE(5, 69)
     // TODO KF6: remove legacy details code path
     listJob->addMetaData(QStringLiteral("details"), QStringLiteral("3"));
@@ -133,16 +471,28 @@ void DirectorySizeJobPrivate::startNextJob(const QUrl &url)
     q->connect(listJob, &KIO::ListJob::entries, q, [this](KIO::Job *job, const KIO::UDSEntryList &list) {
         slotEntries(job, list);
     });
+    if (isSubdir) {
+        m_subdirListings.insert(listJob);
+    }
+    ++m_runningListings;
     q->addSubjob(listJob);
 }
 
-void DirectorySizeJobPrivate::slotEntries(KIO::Job *, const KIO::UDSEntryList &list)
+void DirectorySizeJobPrivate::slotEntries(KIO::Job *job, const KIO::UDSEntryList &list)
 {
+    // the parent's listing counted it already
+    const bool isSubdirListing = m_subdirListings.contains(job);
+
     KIO::UDSEntryList::ConstIterator it = list.begin();
     const KIO::UDSEntryList::ConstIterator end = list.end();
     for (; it != end; ++it) {
         const KIO::UDSEntry &entry = *it;
 
+        const QString name = entry.stringValue(KIO::UDSEntry::UDS_NAME);
+        if (name == QLatin1String("..") || (isSubdirListing && name == QLatin1Char('.'))) {
+            continue;
+        }
+
         const long device = entry.numberValue(KIO::UDSEntry::UDS_DEVICE_ID, 0);
         if (device && !entry.isLink()) {
             // Hard-link detection (#67939)
@@ -154,11 +504,10 @@ void DirectorySizeJobPrivate::slotEntries(KIO::Job *, const KIO::UDSEntryList &l
             }
         }
         const KIO::filesize_t size = entry.numberValue(KIO::UDSEntry::UDS_SIZE, 0);
-        const QString name = entry.stringValue(KIO::UDSEntry::UDS_NAME);
         if (name == QLatin1Char('.')) {
             m_totalSize += size;
             // qDebug() << "'.': added" << size << "->" << m_totalSize;
-        } else if (name != QLatin1String("..")) {
+        } else {
             if (!entry.isLink()) {
                 m_totalSize += size;
             }
@@ -166,10 +515,74 @@ void DirectorySizeJobPrivate::slotEntries(KIO::Job *, const KIO::UDSEntryList &l
                 m_totalFiles++;
             } else {
                 m_totalSubdirs++;
+                if (!isSubdirListing && !entry.isLink()) {
+                    const QString udsUrl = entry.stringValue(KIO::UDSEntry::UDS_URL);
+                    QUrl url;
+                    if (!udsUrl.isEmpty()) {
+                        url = QUrl(udsUrl);
+                    } else {
+                        url = static_cast<KIO::SimpleJob *>(job)->url();
+                        url.setPath(concatPaths(url.path(), name));
+                    }
+                    m_pendingListings.append(qMakePair(url, true));
+                }
             }
             // qDebug() << name << ":" << size << "->" << m_totalSize;
         }
     }
+    startListings();
+}
+
+void DirectorySizeJobPrivate::localSizerFinished()
+{
+#ifdef Q_OS_UNIX
+    m_totalSize += m_localSizer->totalSize();
+    m_totalFiles += m_localSizer->totalFiles();
+    m_totalSubdirs += m_localSizer->totalSubdirs();
+    if (m_localSizer->error()) {
+        setError(m_localSizer->error(), m_localSizer->errorText());
+    }
+    m_localSizer->deleteLater();
+    m_localSizer = nullptr;
+#endif
+    finishIfDone();
+}
+
+void DirectorySizeJobPrivate::setError(int error, const QString &errorText)
+{
+    if (m_error == 0) {
+        m_error = error;
+        m_errorText = errorText;
+    }
+}
+
+void DirectorySizeJobPrivate::slotReport()
+{
+    Q_Q(DirectorySizeJob);
+    q->setProcessedAmount(KJob::Bytes, totalSize());
+    q->setProcessedAmount(KJob::Files, totalFiles());
+    q->setProcessedAmount(KJob::Directories, totalSubdirs());
+}
+
+void DirectorySizeJobPrivate::finishIfDone()
+{
+    Q_Q(DirectorySizeJob);
+#ifdef Q_OS_UNIX
+    if (m_localSizer) {
+        return;
+    }
+#endif
+    if (m_runningListings > 0 || !m_pendingListings.isEmpty() || q->isFinished()) {
+        return;
+    }
+    m_reportTimer->stop();
+    // display final numbers
+    slotReport();
+    if (m_error) {
+        q->setError(m_error);
+        q->setErrorText(m_errorText);
+    }
+    q->emitResult();
 }
 
 void DirectorySizeJob::slotResult(KJob *job)
@@ -177,15 +590,13 @@ void DirectorySizeJob::slotResult(KJob *job)
     Q_D(DirectorySizeJob);
     // qDebug() << d->m_totalSize;
     removeSubjob(job);
-    if (d->m_currentItem < d->m_lstItems.count()) {
-        d->processNextItem();
-    } else {
-        if (job->error()) {
-            setError(job->error());
-            setErrorText(job->errorText());
-        }
-        emitResult();
+    --d->m_runningListings;
+    // like a recursive listing, ignores the subdirectories it can't list
+    if (!d->m_subdirListings.remove(job) && job->error()) {
+        d->setError(job->error(), job->errorText());
     }
+    d->startListings();
+    d->finishIfDone();
 }
 
 // static
@@ -200,4 +611,5 @@ DirectorySizeJob *KIO::directorySize(const KFileItemList &lstItems)
     return DirectorySizeJobPrivate::newJob(lstItems);
 }
 
+#include "directorysizejob.moc"
 #include "moc_directorysizejob.cpp"
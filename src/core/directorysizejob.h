@@ -21,6 +21,13 @@ class DirectorySizeJobPrivate;
  * Computes a directory size (similar to "du", but doesn't give the same results
  * since we simply sum up the dir and file sizes, whereas du speaks disk blocks)
  *
+ * Local directories are walked by a few threads, other directories are listed
+ * with concurrent jobs, as many as the protocol allows per host. What the local
+ * directories in the trash contain is cached on disk, the ones that didn't change
+ * since they were last sized aren't read again.
+ * The totals found so far are reported every now and then with processedAmount()
+ * for KJob::Bytes, KJob::Files and KJob::Directories.
+ *
  * Usage: see KIO::directorySize.
  */
 class KIOCORE_EXPORT DirectorySizeJob : public KIO::Job
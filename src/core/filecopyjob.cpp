@@ -8,7 +8,8 @@
 
 #include "filecopyjob.h"
 #include "askuseractioninterface.h"
-#include "job_p.h"
+#include "checksumjob.h"
+#include "filecopyjob_p.h"
 #include "kprotocolmanager.h"
 #include "scheduler.h"
 #include "slave.h"
@@ -16,94 +17,22 @@
 
 #include <KLocalizedString>
 
+#include <QCryptographicHash>
 #include <QFile>
 #include <QTimer>
 
+#include <memory>
+
 using namespace KIO;
 
+// To check copies the worker couldn't verify itself, see FileCopyJob::setVerifyCopy
+static constexpr QCryptographicHash::Algorithm s_verifyAlgorithm = QCryptographicHash::Md5;
+
 static inline Slave *jobSlave(SimpleJob *job)
 {
     return SimpleJobPrivate::get(job)->m_slave;
 }
 
-/** @internal */
-class KIO::FileCopyJobPrivate : public KIO::JobPrivate
-{
-public:
-    FileCopyJobPrivate(const QUrl &src, const QUrl &dest, int permissions, bool move, JobFlags flags)
-        : m_sourceSize(filesize_t(-1))
-        , m_src(src)
-        , m_dest(dest)
-        , m_moveJob(nullptr)
-        , m_copyJob(nullptr)
-        , m_delJob(nullptr)
-        , m_chmodJob(nullptr)
-        , m_getJob(nullptr)
-        , m_putJob(nullptr)
-        , m_permissions(permissions)
-        , m_move(move)
-        , m_mustChmod(0)
-        , m_bFileCopyInProgress(false)
-        , m_flags(flags)
-    {
-    }
-    KIO::filesize_t m_sourceSize;
-    QDateTime m_modificationTime;
-    QUrl m_src;
-    QUrl m_dest;
-    QByteArray m_buffer;
-    SimpleJob *m_moveJob;
-    SimpleJob *m_copyJob;
-    SimpleJob *m_delJob;
-    SimpleJob *m_chmodJob;
-    TransferJob *m_getJob;
-    TransferJob *m_putJob;
-    int m_permissions;
-    bool m_move : 1;
-    bool m_canResume : 1;
-    bool m_resumeAnswerSent : 1;
-    bool m_mustChmod : 1;
-    bool m_bFileCopyInProgress : 1;
-    JobFlags m_flags;
-
-    void startBestCopyMethod();
-    void startCopyJob();
-    void startCopyJob(const QUrl &slave_url);
-    void startRenameJob(const QUrl &slave_url);
-    void startDataPump();
-    void connectSubjob(SimpleJob *job);
-
-    void slotStart();
-    void slotData(KIO::Job *, const QByteArray &data);
-    void slotDataReq(KIO::Job *, QByteArray &data);
-    void slotMimetype(KIO::Job *, const QString &type);
-    /**
-     * Forward signal from subjob
-     * @param job the job that emitted this signal
-     * @param offset the offset to resume from
-     */
-    void slotCanResume(KIO::Job *job, KIO::filesize_t offset);
-    void processCanResumeResult(KIO::Job *job, RenameDialog_Result result, KIO::filesize_t offset);
-
-    Q_DECLARE_PUBLIC(FileCopyJob)
-
-    static inline FileCopyJob *newJob(const QUrl &src, const QUrl &dest, int permissions, bool move, JobFlags flags)
-    {
-        // qDebug() << src << "->" << dest;
-        FileCopyJob *job = new FileCopyJob(*new FileCopyJobPrivate(src, dest, permissions, move, flags));
-        job->setProperty("destUrl", dest.toString());
-        job->setUiDelegate(KIO::createDefaultJobUiDelegate());
-        if (!(flags & HideProgressInfo)) {
-            KIO::getJobTracker()->registerJob(job);
-        }
-        if (!(flags & NoPrivilegeExecution)) {
-            job->d_func()->m_privilegeExecutionEnabled = true;
-            job->d_func()->m_operationType = move ? Move : Copy;
-        }
-        return job;
-    }
-};
-
 static bool isSrcDestSameSlaveProcess(const QUrl &src, const QUrl &dest)
 {
     /* clang-format off */
@@ -189,6 +118,12 @@ void FileCopyJob::setModificationTime(const QDateTime &mtime)
     d->m_modificationTime = mtime;
 }
 
+void FileCopyJob::setVerifyCopy(bool verify)
+{
+    Q_D(FileCopyJob);
+    d->m_verify = verify;
+}
+
 QUrl FileCopyJob::srcUrl() const
 {
     return d_func()->m_src;
@@ -215,6 +150,10 @@ void FileCopyJobPrivate::startCopyJob(const QUrl &slave_url)
     if (m_modificationTime.isValid()) {
         m_copyJob->addMetaData(QStringLiteral("modified"), m_modificationTime.toString(Qt::ISODate)); // #55804
     }
+    if (m_verify) {
+        // the worker answers with "verified" if it could
+        m_copyJob->addMetaData(QStringLiteral("verify"), QStringLiteral("true"));
+    }
     q->addSubjob(m_copyJob);
     connectSubjob(m_copyJob);
     q->connect(job, &DirectCopyJob::canResume, q, [this](KIO::Job *job, KIO::filesize_t offset) {
@@ -324,6 +263,10 @@ void FileCopyJobPrivate::startDataPump()
     if (m_modificationTime.isValid()) {
         m_putJob->setModificationTime(m_modificationTime);
     }
+    // Lets the worker reserve the space for the file up front
+    if (m_sourceSize != (KIO::filesize_t)-1) {
+        m_putJob->addMetaData(QStringLiteral("size"), KIO::number(m_sourceSize));
+    }
 
     // The first thing the put job will tell us is whether we can
     // resume or not (this is always emitted)
@@ -426,6 +369,11 @@ void FileCopyJobPrivate::processCanResumeResult(KIO::Job *job, RenameDialog_Resu
             m_getJob->setTotalAmount(KJob::Bytes, m_sourceSize);
         }
 
+        // Only a copy from the start goes through here entirely
+        if (m_verify && !offset) {
+            m_pumpHash = std::make_unique<QCryptographicHash>(s_verifyAlgorithm);
+        }
+
         if (offset) {
             // qDebug() << "Setting metadata for resume to" << (unsigned long) offset;
             m_getJob->addMetaData(QStringLiteral("range-start"), KIO::number(offset));
@@ -461,6 +409,9 @@ void FileCopyJobPrivate::slotData(KIO::Job *, const QByteArray &data)
     m_getJob->d_func()->internalSuspend();
     m_putJob->d_func()->internalResume(); // Drink the beer
     m_buffer += data;
+    if (m_pumpHash) {
+        m_pumpHash->addData(data);
+    }
 
     // On the first set of data incoming, we tell the "put" slave about our
     // decision about resuming
@@ -502,6 +453,30 @@ void FileCopyJobPrivate::slotMimetype(KIO::Job *, const QString &type)
     Q_EMIT q->mimeTypeFound(q, type);
 }
 
+void FileCopyJobPrivate::startVerification()
+{
+    Q_Q(FileCopyJob);
+    const QList<QCryptographicHash::Algorithm> algorithms{s_verifyAlgorithm};
+    if (m_pumpHash) {
+        m_srcChecksum = QString::fromLatin1(m_pumpHash->result().toHex());
+        m_pumpHash.reset();
+    } else {
+        m_srcChecksumJob = KIO::checksums(m_src, algorithms, HideProgressInfo);
+        q->addSubjob(m_srcChecksumJob);
+    }
+    m_destChecksumJob = KIO::checksums(m_dest, algorithms, HideProgressInfo);
+    q->addSubjob(m_destChecksumJob);
+}
+
+void FileCopyJobPrivate::copyDone()
+{
+    Q_Q(FileCopyJob);
+    if (m_move) {
+        m_delJob = file_delete(m_src, HideProgressInfo /*no GUI*/); // Delete source
+        q->addSubjob(m_delJob);
+    }
+}
+
 void FileCopyJob::slotResult(KJob *job)
 {
     Q_D(FileCopyJob);
@@ -547,6 +522,14 @@ void FileCopyJob::slotResult(KJob *job)
                 d->m_chmodJob->kill(Quietly);
                 removeSubjob(d->m_chmodJob);
             }
+        } else if (job == d->m_srcChecksumJob || job == d->m_destChecksumJob) {
+            ChecksumJob *otherJob = job == d->m_srcChecksumJob ? d->m_destChecksumJob : d->m_srcChecksumJob;
+            d->m_srcChecksumJob = nullptr;
+            d->m_destChecksumJob = nullptr;
+            if (otherJob) {
+                otherJob->kill(Quietly);
+                removeSubjob(otherJob);
+            }
         }
         setError(job->error());
         setErrorText(job->errorText());
@@ -563,15 +546,21 @@ void FileCopyJob::slotResult(KJob *job)
         d->m_mustChmod = false;
     }
 
+    if (job == d->m_moveJob || job == d->m_copyJob || job == d->m_putJob) {
+        // Whatever fails from now on, the data is at the destination, see CopyJob
+        d->m_destinationWritten = true;
+    }
+
     if (job == d->m_moveJob) {
         d->m_moveJob = nullptr; // Finished
     }
 
     if (job == d->m_copyJob) {
         d->m_copyJob = nullptr;
-        if (d->m_move) {
-            d->m_delJob = file_delete(d->m_src, HideProgressInfo /*no GUI*/); // Delete source
-            addSubjob(d->m_delJob);
+        if (d->m_verify && static_cast<SimpleJob *>(job)->queryMetaData(QStringLiteral("verified")) != QLatin1String("true")) {
+            d->startVerification();
+        } else {
+            d->copyDone();
         }
     }
 
@@ -591,10 +580,35 @@ void FileCopyJob::slotResult(KJob *job)
             // and before we receive its finished().
             d->m_getJob->d_func()->internalResume();
         }
-        if (d->m_move) {
-            d->m_delJob = file_delete(d->m_src, HideProgressInfo /*no GUI*/); // Delete source
-            addSubjob(d->m_delJob);
+        if (d->m_verify) {
+            d->startVerification();
+        } else {
+            d->copyDone();
+        }
+    }
+
+    if (job == d->m_srcChecksumJob) {
+        d->m_srcChecksum = d->m_srcChecksumJob->checksum(s_verifyAlgorithm);
+        d->m_srcChecksumJob = nullptr;
+    }
+
+    if (job == d->m_destChecksumJob) {
+        d->m_destChecksum = d->m_destChecksumJob->checksum(s_verifyAlgorithm);
+        d->m_destChecksumJob = nullptr;
+    }
+
+    // Compared once both are known
+    if (!d->m_destChecksum.isEmpty() && !d->m_srcChecksumJob && !d->m_destChecksumJob) {
+        const bool same = d->m_srcChecksum == d->m_destChecksum;
+        d->m_srcChecksum.clear();
+        d->m_destChecksum.clear();
+        if (!same) {
+            setError(ERR_COPY_VERIFICATION_FAILED);
+            setErrorText(d->m_dest.toDisplayString(QUrl::PreferLocalFile));
+            emitResult();
+            return;
         }
+        d->copyDone();
     }
 
     if (job == d->m_delJob) {
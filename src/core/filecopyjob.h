@@ -44,6 +44,21 @@ public:
      */
     void setModificationTime(const QDateTime &mtime);
 
+    /**
+     * Makes the job check that the destination holds the same data as the source once it's
+     * written, and fail with KIO::ERR_COPY_VERIFICATION_FAILED otherwise. The source of
+     * a move is only deleted after the check succeeded.
+     *
+     * The source is hashed while it's read for the copy; the worker copying locally reads
+     * the destination back from the disk. In the other cases the destination is hashed by
+     * its worker if it can, else downloaded again.
+     *
+     * Must be called before the job starts. Renames within a filesystem aren't verified,
+     * they don't copy any data. Off by default.
+     * @since 5.98
+     */
+    void setVerifyCopy(bool verify);
+
     /**
      * Returns the source URL.
      * @return the source URL
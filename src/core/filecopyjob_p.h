@@ -0,0 +1,126 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2000 Stephan Kulow <coolo@kde.org>
+    SPDX-FileCopyrightText: 2000-2009 David Faure <faure@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KIO_FILECOPYJOB_P_H
+#define KIO_FILECOPYJOB_P_H
+
+#include "filecopyjob.h"
+#include "job_p.h"
+#include <kio/jobuidelegateextension.h>
+#include <kio/jobuidelegatefactory.h>
+
+#include <QCryptographicHash>
+
+#include <memory>
+
+namespace KIO
+{
+class ChecksumJob;
+
+/** @internal */
+class FileCopyJobPrivate : public KIO::JobPrivate
+{
+public:
+    FileCopyJobPrivate(const QUrl &src, const QUrl &dest, int permissions, bool move, JobFlags flags)
+        : m_sourceSize(filesize_t(-1))
+        , m_src(src)
+        , m_dest(dest)
+        , m_moveJob(nullptr)
+        , m_copyJob(nullptr)
+        , m_delJob(nullptr)
+        , m_chmodJob(nullptr)
+        , m_getJob(nullptr)
+        , m_putJob(nullptr)
+        , m_permissions(permissions)
+        , m_move(move)
+        , m_mustChmod(0)
+        , m_bFileCopyInProgress(false)
+        , m_verify(false)
+        , m_flags(flags)
+    {
+    }
+    KIO::filesize_t m_sourceSize;
+    QDateTime m_modificationTime;
+    QUrl m_src;
+    QUrl m_dest;
+    QByteArray m_buffer;
+    SimpleJob *m_moveJob;
+    SimpleJob *m_copyJob;
+    SimpleJob *m_delJob;
+    SimpleJob *m_chmodJob;
+    TransferJob *m_getJob;
+    TransferJob *m_putJob;
+    int m_permissions;
+    bool m_move : 1;
+    bool m_canResume : 1;
+    bool m_resumeAnswerSent : 1;
+    bool m_mustChmod : 1;
+    bool m_bFileCopyInProgress : 1;
+    bool m_verify : 1;
+    bool m_destinationWritten = false;
+    JobFlags m_flags;
+
+    // Verifying the copy
+    std::unique_ptr<QCryptographicHash> m_pumpHash; // of the data going through the data pump
+    QString m_srcChecksum;
+    QString m_destChecksum;
+    ChecksumJob *m_srcChecksumJob = nullptr;
+    ChecksumJob *m_destChecksumJob = nullptr;
+
+    void startBestCopyMethod();
+    void startCopyJob();
+    void startCopyJob(const QUrl &slave_url);
+    void startRenameJob(const QUrl &slave_url);
+    void startDataPump();
+    void connectSubjob(SimpleJob *job);
+    void startVerification();
+    void copyDone();
+
+    void slotStart();
+    void slotData(KIO::Job *, const QByteArray &data);
+    void slotDataReq(KIO::Job *, QByteArray &data);
+    void slotMimetype(KIO::Job *, const QString &type);
+    /**
+     * Forward signal from subjob
+     * @param job the job that emitted this signal
+     * @param offset the offset to resume from
+     */
+    void slotCanResume(KIO::Job *job, KIO::filesize_t offset);
+    void processCanResumeResult(KIO::Job *job, RenameDialog_Result result, KIO::filesize_t offset);
+
+    Q_DECLARE_PUBLIC(FileCopyJob)
+
+    /**
+     * Whether @p job got the data to the destination before it failed, e.g. deleting
+     * the source of a move failed; copying again would conflict with that copy.
+     */
+    static bool destinationWritten(const FileCopyJob *job)
+    {
+        return job->d_func()->m_destinationWritten;
+    }
+
+    static inline FileCopyJob *newJob(const QUrl &src, const QUrl &dest, int permissions, bool move, JobFlags flags)
+    {
+        // qDebug() << src << "->" << dest;
+        FileCopyJob *job = new FileCopyJob(*new FileCopyJobPrivate(src, dest, permissions, move, flags));
+        job->setProperty("destUrl", dest.toString());
+        job->setUiDelegate(KIO::createDefaultJobUiDelegate());
+        if (!(flags & HideProgressInfo)) {
+            KIO::getJobTracker()->registerJob(job);
+        }
+        if (!(flags & NoPrivilegeExecution)) {
+            job->d_func()->m_privilegeExecutionEnabled = true;
+            job->d_func()->m_operationType = move ? Move : Copy;
+        }
+        return job;
+    }
+};
+
+} // namespace KIO
+
+#endif
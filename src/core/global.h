@@ -323,7 +323,13 @@ enum Error {
      * not supporting them. Used by e.g. CopyJob.
      * @since 5.88
      */
-    ERR_SYMLINKS_NOT_SUPPORTED = KJob::UserDefinedError + 78
+    ERR_SYMLINKS_NOT_SUPPORTED = KJob::UserDefinedError + 78,
+    /**
+     * Reading a copy back showed that it differs from its source.
+     * Used by FileCopyJob and CopyJob when asked to verify copies.
+     * @since 5.98
+     */
+    ERR_COPY_VERIFICATION_FAILED = KJob::UserDefinedError + 79,
 };
 
 /**
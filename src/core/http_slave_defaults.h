@@ -12,12 +12,18 @@
 
 // CONNECTION
 static constexpr int DEFAULT_KEEP_ALIVE_TIMEOUT = 60; // 60 seconds
+static constexpr int DEFAULT_PIPELINE_DEPTH = 4; // requests in flight in multiGet, 1 disables pipelining
 
 // CACHE SETTINGS
 static constexpr int DEFAULT_MAX_CACHE_SIZE = 50 * 1024; // 50 MB
 static constexpr int DEFAULT_MAX_CACHE_AGE = 60 * 60 * 24 * 14; // 14 DAYS
 static constexpr int DEFAULT_CACHE_EXPIRE = 3 * 60; // 3 MINS
 static constexpr auto DEFAULT_CACHE_CONTROL = KIO::CC_Refresh; // Verify with remote
+static constexpr int DEFAULT_MEMORY_CACHE_SIZE = 4 * 1024; // 4 MB, shared by all http workers
+static constexpr int DEFAULT_MEMORY_CACHE_MAX_ENTRY_SIZE = 64; // 64 KB
+static constexpr int DEFAULT_STALE_WHILE_REVALIDATE = -1; // RFC 5861 windows, -1: as sent by the server
+static constexpr int DEFAULT_STALE_IF_ERROR = -1;
+static constexpr int DEFAULT_RANGE_CACHE_SIZE = 256 * 1024; // 256 MB
 
 // DEFAULT USER AGENT KEY - ENABLES OS NAME
 static const char DEFAULT_USER_AGENT_KEYS[] = "om"; // Show OS, Machine
@@ -249,6 +249,9 @@ KIOCORE_EXPORT QString KIO::buildErrorString(int errorCode, const QString &error
                         "Cannot transfer <filename>%1</filename> because it is too large. The destination filesystem only supports files up to 4GiB",
                         errorText);
         break;
+    case KIO::ERR_COPY_VERIFICATION_FAILED:
+        result = i18n("The copy %1 differs from the original file.\nThe data may have been damaged while copying.", errorText);
+        break;
     case KIO::ERR_PRIVILEGE_NOT_REQUIRED:
         result =
             i18n("Privilege escalation is not necessary because \n'%1' is owned by the current user.\nPlease retry after changing permissions.", errorText);
@@ -1264,6 +1267,13 @@ KIOCORE_EXPORT QByteArray KIO::rawErrorDetail(int errorCode, const QString &erro
         solutions << i18n("Reformat the destination drive to use a filesystem that supports files that large.");
         break;
 
+    case KIO::ERR_COPY_VERIFICATION_FAILED:
+        errorName = i18n("Copy Verification Failed");
+        description = i18n("Reading the copy <strong>%1</strong> back showed that it differs from the original file.", errorText);
+        causes << i18n("The destination drive or the network connection may be faulty.") << i18n("The original file may have been changed while it was copied.");
+        solutions << i18n("Try copying the file again.") << i18n("Check the destination drive for errors.");
+        break;
+
     default:
         // fall back to the plain error...
         errorName = i18n("Undocumented Error");
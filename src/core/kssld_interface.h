@@ -70,6 +70,30 @@ public Q_SLOTS: // METHODS
         argumentList << QVariant::fromValue(cert) << QVariant::fromValue(hostName);
         return callWithArgumentList(QDBus::Block, QStringLiteral("rule"), argumentList);
     }
+
+    Q_NOREPLY void setTlsSession(const QString &hostName,
+                                 int port,
+                                 const QByteArray &context,
+                                 const QByteArray &ticket,
+                                 const QList<QSslCertificate> &peerChain,
+                                 int lifetimeHint)
+    {
+        QList<QVariant> argumentList;
+        argumentList << QVariant::fromValue(hostName) << QVariant::fromValue(port) << QVariant::fromValue(context) << QVariant::fromValue(ticket)
+                     << QVariant::fromValue(peerChain) << QVariant::fromValue(lifetimeHint);
+        callWithArgumentList(QDBus::NoBlock, QStringLiteral("setTlsSession"), argumentList);
+    }
+
+    QDBusReply<QByteArray> tlsSession(const QString &hostName, int port, const QByteArray &context, QList<QSslCertificate> &peerChain)
+    {
+        QList<QVariant> argumentList;
+        argumentList << QVariant::fromValue(hostName) << QVariant::fromValue(port) << QVariant::fromValue(context);
+        const QDBusMessage reply = callWithArgumentList(QDBus::Block, QStringLiteral("tlsSession"), argumentList);
+        if (reply.type() == QDBusMessage::ReplyMessage && reply.arguments().count() == 2) {
+            peerChain = qdbus_cast<QList<QSslCertificate>>(reply.arguments().at(1));
+        }
+        return reply;
+    }
 };
 
 namespace org
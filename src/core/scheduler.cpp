@@ -24,11 +24,14 @@
 #include <QDBusMessage>
 #endif
 #include <QHash>
+#include <QPointer>
 #include <QThread>
 #include <QThreadStorage>
 
 // Slaves may be idle for a certain time (3 minutes) before they are killed.
 static const int s_idleSlaveLifetime = 3 * 60;
+// Slaves of killed jobs get this long (5 seconds) to abort their command before they are killed.
+static const int s_cancelTimeout = 5;
 
 using namespace KIO;
 
@@ -174,10 +177,32 @@ Slave *SlaveKeeper::takeSlaveForJob(SimpleJob *job)
     }
 
     QUrl url = SimpleJobPrivate::get(job)->m_url;
-    // TODO take port, username and password into account
-    QMultiHash<QString, Slave *>::Iterator it = m_idleSlaves.find(url.host());
-    if (it == m_idleSlaves.end()) {
-        it = m_idleSlaves.begin();
+    // Prefer, in this order: a slave that still holds an open (keep-alive) connection to
+    // the host for the same port and user, any slave that was last used for the host, a
+    // slave without an open connection, and only then one connected to another host.
+    // This spares a burst of jobs to one host from opening new TCP and TLS connections.
+    QMultiHash<QString, Slave *>::Iterator it = m_idleSlaves.end();
+    int bestScore = -1;
+    for (auto candidate = m_idleSlaves.begin(); candidate != m_idleSlaves.end(); ++candidate) {
+        Slave *s = candidate.value();
+        const QString keepAliveHost = s->keepAliveHost();
+        int score = 0;
+        if (candidate.key() == url.host()) {
+            score = 2;
+            // the port of a slave is 0 for the default one, like in setupSlave()
+            if (keepAliveHost == url.host() && s->port() == url.port(0) && s->user() == url.userName()) {
+                score = 3;
+            }
+        } else if (keepAliveHost.isEmpty()) {
+            score = 1;
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            it = candidate;
+            if (score == 3) {
+                break;
+            }
+        }
     }
     if (it == m_idleSlaves.end()) {
         return nullptr;
@@ -633,12 +658,54 @@ bool ProtoQueue::removeSlave(KIO::Slave *slave)
     const bool removedConnected = m_connectedSlaveQueue.removeSlave(slave);
     const bool removedUnconnected = m_slaveKeeper.removeSlave(slave);
     Q_ASSERT(!(removedConnected && removedUnconnected));
+    if (m_cancellingSlaves.remove(slave)) {
+        slave->disconnect(this);
+        return true;
+    }
     return removedConnected || removedUnconnected;
 }
 
+void ProtoQueue::cancelSlave(KIO::Slave *slave)
+{
+    Q_ASSERT(!m_cancellingSlaves.contains(slave));
+    m_cancellingSlaves.insert(slave);
+
+    // the worker answers the command it was running with either of these
+    connect(slave, &Slave::finished, this, [this, slave]() {
+        slaveCancelled(slave);
+    });
+    connect(slave, &Slave::error, this, [this, slave]() {
+        slaveCancelled(slave);
+    });
+    slave->cancel();
+
+    QPointer<Slave> guard(slave);
+    QTimer::singleShot(s_cancelTimeout * 1000, this, [this, guard]() {
+        if (guard && m_cancellingSlaves.remove(guard)) {
+            guard->disconnect(this);
+            guard->kill();
+        }
+    });
+}
+
+void ProtoQueue::slaveCancelled(KIO::Slave *slave)
+{
+    if (!m_cancellingSlaves.remove(slave)) {
+        return;
+    }
+    slave->disconnect(this);
+    slave->setCancelled();
+    if (slave->isAlive()) {
+        m_slaveKeeper.returnSlave(slave);
+        // a queued job may be waiting for a slave
+        m_startJobTimer.start();
+    }
+}
+
 QList<Slave *> ProtoQueue::allSlaves() const
 {
     QList<Slave *> ret(m_slaveKeeper.allSlaves());
+    ret.append(m_cancellingSlaves.values());
     auto it = m_queuesByHostname.cbegin();
     for (; it != m_queuesByHostname.cend(); ++it) {
         ret.append(it.value().allSlaves());
@@ -954,11 +1021,21 @@ void SchedulerPrivate::cancelJob(SimpleJob *job)
     }
     Slave *slave = jobSlave(job);
     // qDebug() << job << slave;
+    // Rather than killing the worker, ask it to abort the command so it can be reused.
+    // FileJob keeps its worker in the open loop, and the data "worker" lives in-process.
+    const bool canCancel =
+        slave && slave->isAlive() && jobPriv->m_command != CMD_OPEN && slave->slaveProtocol() != QLatin1String("data");
     jobFinished(job, slave);
     if (slave) {
         ProtoQueue *pq = m_protocols.value(jobPriv->m_protocol);
         if (pq) {
             pq->removeSlave(slave);
+            // removeSlave() already killed it if it was a connected slave, otherwise
+            // it may abort the command and be reused
+            if (canCancel && slave->isAlive()) {
+                pq->cancelSlave(slave);
+                return;
+            }
         }
         slave->kill(); // don't use slave after this!
     }
@@ -159,6 +159,9 @@ public:
     void removeJob(KIO::SimpleJob *job);
     KIO::Slave *createSlave(const QString &protocol, KIO::SimpleJob *job, const QUrl &url);
     bool removeSlave(KIO::Slave *slave);
+    // ask the slave of a killed job to abort its command; it goes back to the
+    // idle slaves once it's done, or gets killed if it takes too long
+    void cancelSlave(KIO::Slave *slave);
     QList<KIO::Slave *> allSlaves() const;
     ConnectedSlaveQueue m_connectedSlaveQueue; // KF6 TODO: remove
 
@@ -167,11 +170,14 @@ private Q_SLOTS:
     void startAJob();
 
 private:
+    void slaveCancelled(KIO::Slave *slave);
+
     SerialPicker m_serialPicker;
     QTimer m_startJobTimer;
     QMap<int, HostQueue *> m_queuesBySerial;
     QHash<QString, HostQueue> m_queuesByHostname;
     SlaveKeeper m_slaveKeeper;
+    QSet<KIO::Slave *> m_cancellingSlaves;
     int m_maxConnectionsPerHost;
     int m_maxConnectionsTotal;
     int m_runningJobsCount;
@@ -70,6 +70,7 @@ public:
         , m_port(0)
         , contacted(false)
         , dead(false)
+        , cancelling(false)
         , m_refCount(1)
     {
         contact_started.start();
@@ -95,6 +96,8 @@ public:
     quint16 m_port;
     bool contacted;
     bool dead;
+    bool cancelling; // the job was killed, waiting for the worker to abort the command
+    QString m_keepAliveHost; // as reported by the worker with slaveStatus()
     QElapsedTimer contact_started;
     QElapsedTimer m_idleSince;
     int m_refCount;
@@ -156,6 +159,9 @@ Slave::Slave(const QString &protocol, QObject *parent)
     d->slaveconnserver->setParent(this);
     d->connection = new Connection(this);
     connect(d->slaveconnserver, &ConnectionServer::newConnection, this, &Slave::accept);
+    connect(this, &SlaveInterface::slaveStatus, this, [d](qint64, const QByteArray &, const QString &host, bool connected) {
+        d->m_keepAliveHost = connected ? host : QString();
+    });
 }
 
 Slave::~Slave()
@@ -295,6 +301,35 @@ bool Slave::isAlive()
     return !d->dead;
 }
 
+void Slave::cancel()
+{
+    Q_D(Slave);
+    d->cancelling = true;
+    // a suspended job would never let the worker get to the point of noticing
+    if (d->connection->suspended()) {
+        d->connection->resume();
+    }
+    d->connection->send(CMD_CANCEL);
+}
+
+bool Slave::isCancelling() const
+{
+    Q_D(const Slave);
+    return d->cancelling;
+}
+
+void Slave::setCancelled()
+{
+    Q_D(Slave);
+    d->cancelling = false;
+}
+
+QString Slave::keepAliveHost() const
+{
+    Q_D(const Slave);
+    return d->m_keepAliveHost;
+}
+
 // TODO KF6: remove, unused
 void Slave::hold(const QUrl &url)
 {
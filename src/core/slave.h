@@ -158,6 +158,28 @@ private:
      */
     void kill();
 
+    /**
+     * Asks the slave to abort the command it is running, without killing it.
+     * It emits finished() or error() once it's done and can be reused then.
+     */
+    void cancel();
+
+    /**
+     * @return true between cancel() and setCancelled()
+     */
+    bool isCancelling() const;
+
+    /**
+     * The slave acknowledged the cancel() request.
+     */
+    void setCancelled();
+
+    /**
+     * @return the host the worker reported to hold an open (keep-alive)
+     * connection to, or an empty string if it has none.
+     */
+    QString keepAliveHost() const;
+
     /**
      * @return true if the slave survived the last mission.
      */
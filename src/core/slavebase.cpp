@@ -82,6 +82,8 @@ typedef QMap<QString, QByteArray> AuthKeysMap;
 
 static constexpr int KIO_MAX_ENTRIES_PER_BATCH = 200;
 static constexpr int KIO_MAX_SEND_BATCH_TIME = 300;
+// How often wasCancelled() looks at the application connection, in ms
+static constexpr int KIO_CANCEL_POLL_INTERVAL = 100;
 
 namespace KIO
 {
@@ -115,6 +117,7 @@ public:
     bool onHold : 1;
     bool inOpenLoop : 1;
     std::atomic<bool> wasKilled = false;
+    std::atomic<bool> wasCancelled = false;
     std::atomic<bool> exit_loop = false;
     std::atomic<bool> runInThread = false;
     MetaData configData;
@@ -126,6 +129,8 @@ public:
     QElapsedTimer lastTimeout;
     QElapsedTimer nextTimeout;
     qint64 nextTimeoutMsecs;
+    QElapsedTimer lastCancelPoll;
+    qint64 deadline = 0; // msecs since epoch, from the "deadline" metadata; 0 means none
     KIO::filesize_t totalSize;
     KRemoteEncoding *remotefile = nullptr;
     enum { Idle, InsideMethod, FinishedCalled, ErrorCalled } m_state;
@@ -163,6 +168,33 @@ public:
         return !m_tempAuths.isEmpty();
     }
 
+    bool deadlineExpired() const
+    {
+        return deadline > 0 && QDateTime::currentMSecsSinceEpoch() >= deadline;
+    }
+
+    // Picks up a CMD_CANCEL sent while the current command is running,
+    // without consuming any other queued command
+    void pollForCancel()
+    {
+        if (!appConnection.isConnected()) {
+            return;
+        }
+        // A zero timeout only parses what is already in the socket
+        appConnection.waitForIncomingTask(0);
+        if (appConnection.takeIncomingTask(CMD_CANCEL)) {
+            wasCancelled = true;
+        }
+    }
+
+    // Called once a command is over, a late CMD_CANCEL must not affect the next one
+    void resetCancellation()
+    {
+        wasCancelled = false;
+        deadline = 0;
+        lastCancelPoll.invalidate();
+    }
+
     // Reconstructs configGroup from configData and mIncomingMetaData
     void rebuildConfig()
     {
@@ -527,6 +559,7 @@ void SlaveBase::error(int _errid, const QString &_text)
 
     send(MSG_ERROR, data);
     // reset
+    d->resetCancellation();
     d->totalSize = 0;
     d->inOpenLoop = false;
     d->m_confirmationAsked = false;
@@ -582,6 +615,7 @@ void SlaveBase::finished()
     send(MSG_FINISHED);
 
     // reset
+    d->resetCancellation();
     d->totalSize = 0;
     d->inOpenLoop = false;
     d->m_rootEntryListed = false;
@@ -720,6 +754,12 @@ void SlaveBase::mimeType(const QString &_type)
             if (cmd == CMD_HOST) { // Ignore.
                 continue;
             }
+            if (cmd == CMD_CANCEL) {
+                // The job was killed, don't wait for the MIME type to be acknowledged
+                d->wasCancelled = true;
+                cmd = CMD_NONE;
+                break;
+            }
             if (!isSubCommand(cmd)) {
                 break;
             }
@@ -896,6 +936,8 @@ KIOCORE_EXPORT QString KIO::unsupportedActionErrorString(const QString &protocol
         return i18n("Multiple get is not supported with protocol %1.", protocol);
     case CMD_OPEN:
         return i18n("Opening files is not supported with protocol %1.", protocol);
+    case CMD_CHECKSUM:
+        return i18n("Computing checksums is not supported with protocol %1.", protocol);
     default:
         return i18n("Protocol %1 does not support action %2.", protocol, cmd);
     } /*end switch*/
@@ -1113,6 +1155,12 @@ int SlaveBase::waitForAnswer(int expected1, int expected2, QByteArray &data, int
             }
             return result;
         }
+        if (cmd == CMD_CANCEL) {
+            // The job was killed, e.g. while we were waiting for data in put(),
+            // so the answer will never come
+            d->wasCancelled = true;
+            return -1;
+        }
         if (isSubCommand(cmd)) {
             dispatch(cmd, data);
         } else {
@@ -1382,6 +1430,7 @@ void SlaveBase::dispatch(int command, const QByteArray &data)
     case CMD_META_DATA: {
         // qDebug() << "(" << getpid() << ") Incoming meta-data...";
         stream >> mIncomingMetaData;
+        d->deadline = mIncomingMetaData.value(QStringLiteral("deadline")).toLongLong();
         d->rebuildConfig();
         break;
     }
@@ -1397,6 +1446,10 @@ void SlaveBase::dispatch(int command, const QByteArray &data)
         qCWarning(KIO_CORE) << "Got unexpected CMD_NONE!";
         break;
     }
+    case CMD_CANCEL: {
+        // The command it was meant for has already completed, nothing to abort
+        break;
+    }
     case CMD_MULTI_GET: {
         d->m_state = d->InsideMethod;
         multiGet(data);
@@ -1415,6 +1468,17 @@ void SlaveBase::dispatch(int command, const QByteArray &data)
         d->m_state = d->Idle;
         break;
     }
+    case CMD_CHECKSUM: {
+        stream >> url;
+
+        void *data = static_cast<void *>(&url);
+
+        d->m_state = d->InsideMethod;
+        virtual_hook(GetChecksums, data);
+        d->verifyState("checksums()");
+        d->m_state = d->Idle;
+        break;
+    }
     default: {
         // Some command we don't understand.
         // Just ignore it, it may come from some future version of KIO.
@@ -1536,6 +1600,27 @@ void SlaveBase::setKillFlag()
     d->wasKilled = true;
 }
 
+bool SlaveBase::wasCancelled() const
+{
+    if (d->wasKilled || d->wasCancelled || d->deadlineExpired()) {
+        return true;
+    }
+    // Looking at the connection costs a syscall, don't do it for every block
+    if (!d->lastCancelPoll.isValid() || d->lastCancelPoll.hasExpired(KIO_CANCEL_POLL_INTERVAL)) {
+        d->lastCancelPoll.start();
+        d->pollForCancel();
+    }
+    return d->wasCancelled;
+}
+
+int SlaveBase::cancellationError() const
+{
+    if (d->wasKilled || d->wasCancelled) {
+        return ERR_USER_CANCELED;
+    }
+    return d->deadlineExpired() ? ERR_SERVER_TIMEOUT : ERR_USER_CANCELED;
+}
+
 void SlaveBase::send(int cmd, const QByteArray &arr)
 {
     if (d->runInThread) {
@@ -1568,6 +1653,10 @@ void SlaveBase::virtual_hook(int id, void *data)
         error(ERR_UNSUPPORTED_ACTION, unsupportedActionErrorString(protocolName(), CMD_TRUNCATE));
         break;
     }
+    case GetChecksums: {
+        error(ERR_UNSUPPORTED_ACTION, unsupportedActionErrorString(protocolName(), CMD_CHECKSUM));
+        break;
+    }
     }
 }
 
@@ -997,6 +997,31 @@ public:
      */
     void setKillFlag();
 
+    /**
+     * Returns @c true if the current command should be aborted: either the
+     * application killed the job, the "deadline" metadata of the job has
+     * passed, or the slave was killed (see wasKilled()).
+     *
+     * Check it regularly in read/write loops (e.g. once per block in get(),
+     * put() and copy()) and, if it returns true, clean up and call
+     * error(cancellationError(), ...). Unlike a kill, a cancelled slave is
+     * put back in the pool once it has called error() or finished(), so it
+     * must return from the command promptly but must not exit.
+     *
+     * Checking for a cancel request is cheap, the connection to the
+     * application is only looked at every 100 ms.
+     * @since 5.98
+     */
+    bool wasCancelled() const;
+
+    /**
+     * Returns the error code to report when wasCancelled() returned @c true:
+     * KIO::ERR_SERVER_TIMEOUT if the job deadline passed,
+     * KIO::ERR_USER_CANCELED otherwise.
+     * @since 5.98
+     */
+    int cancellationError() const;
+
     /** Internally used
      * @internal
      */
@@ -1045,6 +1070,7 @@ protected:
         AppConnectionMade = 0,
         GetFileSystemFreeSpace = 1, // KF6 TODO: Turn into a virtual method
         Truncate = 2, // KF6 TODO: Turn into a virtual method
+        GetChecksums = 3, // KF6 TODO: Turn into a virtual method
     };
     virtual void virtual_hook(int id, void *data);
 
@@ -145,6 +145,7 @@ StoredTransferJob *KIO::storedPut(const QByteArray &arr, const QUrl &url, int pe
     KIO_ARGS << url << qint8((flags & Overwrite) ? 1 : 0) << qint8((flags & Resume) ? 1 : 0) << permissions;
     StoredTransferJob *job = StoredTransferJobPrivate::newJob(url, CMD_PUT, packedArgs, QByteArray(), flags);
     job->setData(arr);
+    job->addMetaData(QStringLiteral("size"), KIO::number(arr.size()));
     return job;
 }
 
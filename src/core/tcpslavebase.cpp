@@ -12,17 +12,23 @@
 
 #include "tcpslavebase.h"
 #include "kiocoredebug.h"
+#include "kssld_interface.h"
 
 #include <KConfigGroup>
 #include <KLocalizedString>
 #include <ksslcertificatemanager.h>
 #include <ksslsettings.h>
 
+#include <QCryptographicHash>
+#include <QElapsedTimer>
 #include <QSslCipher>
+#include <QSslConfiguration>
 #include <QSslSocket>
 
 #include <QDBusConnection>
 
+#include <memory>
+
 using namespace KIO;
 // using namespace KNetwork;
 
@@ -34,8 +40,8 @@ Q_DECLARE_OPERATORS_FOR_FLAGS(TCPSlaveBase::SslResult)
 // TODO Proxy support whichever way works; KPAC reportedly does *not* work.
 // NOTE kded_proxyscout may or may not be interesting
 
-// TODO resurrect SSL session recycling; this means save the session on disconnect and look
-// for a reusable session on connect. Consider how HTTP persistent connections interact with that.
+// TLS sessions are shared between workers through kssld, see startTLSInternal().
+// With "ShareTlsSessions=false" in kioslaverc every connection does a full handshake.
 
 // TODO in case we support SSL-lessness we need static KTcpSocket::sslAvailable() and check it
 // in most places we ATM check for d->isSSL.
@@ -80,8 +86,10 @@ public:
         sslMetaData.insert(QStringLiteral("ssl_cipher_used_bits"), QString::number(cipher.usedBits()));
         sslMetaData.insert(QStringLiteral("ssl_cipher_bits"), QString::number(cipher.supportedBits()));
         sslMetaData.insert(QStringLiteral("ssl_peer_ip"), ip);
+        sslMetaData.insert(QStringLiteral("ssl_session_resumed"), sessionResumed ? QStringLiteral("TRUE") : QStringLiteral("FALSE"));
+        sslMetaData.insert(QStringLiteral("ssl_handshake_time"), QString::number(handshakeTime));
 
-        const QList<QSslCertificate> peerCertificateChain = socket.peerCertificateChain();
+        const QList<QSslCertificate> peerCertificateChain = peerChain;
         // try to fill in the blanks, i.e. missing certificates, and just assume that
         // those belong to the peer (==website or similar) certificate.
         for (int i = 0; i < sslErrors.count(); i++) {
@@ -132,6 +140,80 @@ public:
 
     SslResult startTLSInternal(QSsl::SslProtocol sslVersion, int waitForEncryptedTimeout = -1);
 
+    OrgKdeKSSLDInterface *tlsSessionCache()
+    {
+        if (!kssld) {
+            kssld.reset(new OrgKdeKSSLDInterface(QStringLiteral("org.kde.kssld5"), QStringLiteral("/modules/kssld"), QDBusConnection::sessionBus()));
+            // a full handshake is better than waiting for a stuck kiod
+            kssld->setTimeout(1000);
+        }
+        return kssld->connection().isConnected() ? kssld.get() : nullptr;
+    }
+
+    // The settings that the peer chain of a session is validated with; a session is only
+    // shared between workers that validate the same way
+    static QByteArray tlsSessionContext(const QSslConfiguration &config)
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(QByteArray::number(int(config.protocol())));
+        hash.addData(QByteArray::number(int(config.peerVerifyMode())));
+        const QList<QSslCertificate> caCertificates = config.caCertificates();
+        for (const QSslCertificate &caCertificate : caCertificates) {
+            hash.addData(caCertificate.digest(QCryptographicHash::Sha1));
+        }
+        return hash.result().toHex();
+    }
+
+    // Offers the session that another worker negotiated with the same server, if any
+    void offerTlsSession(QSslConfiguration *config)
+    {
+        offeredTicket.clear();
+        offeredPeerChain.clear();
+        storedTicket.clear();
+        sessionContext = tlsSessionContext(*config);
+        if (shareTlsSessions) {
+            if (OrgKdeKSSLDInterface *cache = tlsSessionCache()) {
+                const QDBusReply<QByteArray> reply = cache->tlsSession(host, sessionPort, sessionContext, offeredPeerChain);
+                if (reply.isValid()) {
+                    offeredTicket = reply.value();
+                }
+            }
+        }
+        // also replaces the session of the previous connection, which may have been to another host
+        config->setSessionTicket(offeredTicket);
+        // QSslSocket only hands out the negotiated session with this option off
+        config->setSslOption(QSsl::SslOptionDisableSessionPersistence, !shareTlsSessions);
+    }
+
+    // Shares the negotiated session with other workers. TLS 1.3 servers send their
+    // session tickets after the handshake, so this is done again before disconnecting.
+    void storeTlsSession()
+    {
+        // a session that needed the user to accept errors must not be resumed silently
+        if (!shareTlsSessions || !usingSSL || !sslErrors.isEmpty() || peerChain.isEmpty()) {
+            return;
+        }
+        const QSslConfiguration config = socket.sslConfiguration();
+        const QByteArray ticket = config.sessionTicket();
+        if (ticket.isEmpty() || ticket == storedTicket || ticket == offeredTicket) {
+            return;
+        }
+        storedTicket = ticket;
+        // sessions without a ticket (TLS 1.2 session IDs) have no lifetime hint, servers
+        // usually keep them for five minutes
+        const int lifetimeHint = config.sessionTicketLifeTimeHint() > 0 ? config.sessionTicketLifeTimeHint() : 300;
+        if (OrgKdeKSSLDInterface *cache = tlsSessionCache()) {
+            cache->setTlsSession(host, sessionPort, sessionContext, ticket, peerChain, lifetimeHint);
+        }
+    }
+
+    void forgetTlsSession()
+    {
+        if (OrgKdeKSSLDInterface *cache = tlsSessionCache()) {
+            cache->setTlsSession(host, sessionPort, sessionContext, QByteArray(), QList<QSslCertificate>(), 0);
+        }
+    }
+
     TCPSlaveBase *const q;
 
     bool isBlocking;
@@ -143,6 +225,18 @@ public:
     quint16 port;
     QByteArray serviceName;
 
+    // TLS session sharing and statistics
+    std::unique_ptr<OrgKdeKSSLDInterface> kssld;
+    bool shareTlsSessions;
+    quint16 sessionPort; // as given to connectToHost(), port may be a proxy's
+    QByteArray sessionContext; // see tlsSessionContext()
+    QByteArray offeredTicket;
+    QList<QSslCertificate> offeredPeerChain;
+    QByteArray storedTicket;
+    QList<QSslCertificate> peerChain;
+    bool sessionResumed;
+    qint64 handshakeTime; // in milliseconds
+
     KSSLSettings sslSettings;
     bool usingSSL;
     bool autoSSL;
@@ -175,6 +269,10 @@ TCPSlaveBase::TCPSlaveBase(const QByteArray &protocol, const QByteArray &poolSoc
     d->usingSSL = false;
     d->autoSSL = autoSSL;
     d->sslNoUi = false;
+    d->shareTlsSessions = true;
+    d->sessionPort = 0;
+    d->sessionResumed = false;
+    d->handshakeTime = 0;
     // Limit the read buffer size to 14 MB (14*1024*1024) (based on the upload limit
     // in TransferJob::slotDataReq). See the docs for QAbstractSocket::setReadBufferSize
     // and the BR# 187876 to understand why setting this limit is necessary.
@@ -306,6 +404,7 @@ int TCPSlaveBase::connectToHost(const QString &host, quint16 port, QString *erro
 
     disconnectFromHost(); // Reset some state, even if we are already disconnected
     d->host = host;
+    d->sessionPort = port;
 
     d->socket.connectToHost(host, port);
     /*const bool connectOk = */ d->socket.waitForConnected(timeout > -1 ? timeout : -1);
@@ -353,6 +452,7 @@ int TCPSlaveBase::connectToHost(const QString &host, quint16 port, QString *erro
 void TCPSlaveBase::disconnectFromHost()
 {
     // qDebug();
+    d->storeTlsSession();
     d->host.clear();
     d->ip.clear();
     d->usingSSL = false;
@@ -364,9 +464,6 @@ void TCPSlaveBase::disconnectFromHost()
         return;
     }
 
-    //### maybe save a session for reuse on SSL shutdown if and when QSslSocket
-    //    does that. QCA::TLS can do it apparently but that is not enough if
-    //    we want to present that as KDE API. Not a big loss in any case.
     d->socket.disconnectFromHost();
     if (d->socket.state() != QAbstractSocket::UnconnectedState) {
         d->socket.waitForDisconnected(-1); // wait for unsent data to be sent
@@ -404,32 +501,50 @@ bool TCPSlaveBase::startSsl()
 
 TCPSlaveBase::SslResult TCPSlaveBase::TcpSlaveBasePrivate::startTLSInternal(QSsl::SslProtocol sslVersion, int waitForEncryptedTimeout)
 {
-    // setMetaData("ssl_session_id", d->kssl->session()->toString());
-    //### we don't support session reuse for now...
     usingSSL = true;
+    shareTlsSessions = q->configValue(QStringLiteral("ShareTlsSessions"), true);
 
-    // Set the SSL protocol version to use...
-    socket.setProtocol(sslVersion);
+    // Set the SSL protocol version to use, and try to resume a session
+    QSslConfiguration config = socket.sslConfiguration();
+    config.setProtocol(sslVersion);
+    offerTlsSession(&config);
+    socket.setSslConfiguration(config);
 
     /* Usually ignoreSslErrors() would be called in the slot invoked by the sslErrors()
        signal but that would mess up the flow of control. We will check for errors
        anyway to decide if we want to continue connecting. Otherwise ignoreSslErrors()
        before connecting would be very insecure. */
     socket.ignoreSslErrors();
+    QElapsedTimer handshakeTimer;
+    handshakeTimer.start();
     socket.startClientEncryption();
     const bool encryptionStarted = socket.waitForEncrypted(waitForEncryptedTimeout);
+    handshakeTime = handshakeTimer.elapsed();
+
+    // A resumed session only contains the peer certificate, not the chain. QSslSocket
+    // doesn't tell whether the session was resumed, but the chain missing does.
+    peerChain = socket.peerCertificateChain();
+    sessionResumed = false;
+    if (peerChain.isEmpty() && !offeredPeerChain.isEmpty() && socket.peerCertificate() == offeredPeerChain.first()) {
+        peerChain = offeredPeerChain;
+        sessionResumed = true;
+    }
+    qCDebug(KIO_CORE) << "TLS handshake with" << host << "took" << handshakeTime << "ms" << (sessionResumed ? "resuming a session" : "");
 
     // Set metadata, among other things for the "SSL Details" dialog
     QSslCipher cipher = socket.sessionCipher();
 
-    if (!encryptionStarted || socket.mode() != QSslSocket::SslClientMode || cipher.isNull() || cipher.usedBits() == 0
-        || socket.peerCertificateChain().isEmpty()) {
+    if (!encryptionStarted || socket.mode() != QSslSocket::SslClientMode || cipher.isNull() || cipher.usedBits() == 0 || peerChain.isEmpty()) {
+        if (!offeredTicket.isEmpty()) {
+            // don't let the next connection fail the same way
+            forgetTlsSession();
+        }
         usingSSL = false;
         clearSslMetaData();
         /*qDebug() << "Initial SSL handshake failed. encryptionStarted is"
           << encryptionStarted << ", cipher.isNull() is" << cipher.isNull()
           << ", cipher.usedBits() is" << cipher.usedBits()
-          << ", length of certificate chain is" << socket.peerCertificateChain().count()
+          << ", length of certificate chain is" << peerChain.count()
           << ", the socket says:" << socket.errorString()
           << "and the list of SSL errors contains"
           << socket.sslErrors().count() << "items.";*/
@@ -450,6 +565,11 @@ TCPSlaveBase::SslResult TCPSlaveBase::TcpSlaveBasePrivate::startTLSInternal(QSsl
       << " usedBits:" << cipher.usedBits();*/
 
     sslErrors = socket.sslHandshakeErrors();
+    if (sessionResumed) {
+        // the abbreviated handshake verified no certificates, check the chain of the
+        // original handshake against this host again
+        sslErrors = QSslCertificate::verify(peerChain, host);
+    }
 
     // TODO: review / rewrite / remove the comment
     // The app side needs the metadata now for the SSL error dialog (if any) but
@@ -464,6 +584,9 @@ TCPSlaveBase::SslResult TCPSlaveBase::TcpSlaveBasePrivate::startTLSInternal(QSsl
     q->sendAndKeepMetaData();
 
     SslResult rc = q->verifyServerCertificate();
+    if (rc == ResultOk) {
+        storeTlsSession();
+    }
     if (rc & ResultFailed) {
         usingSSL = false;
         clearSslMetaData();
@@ -510,7 +633,7 @@ TCPSlaveBase::SslResult TCPSlaveBase::verifyServerCertificate()
         // TODO message "sorry, fatal error, you can't override it"
         return ResultFailed;
     }
-    QList<QSslCertificate> peerCertificationChain = d->socket.peerCertificateChain();
+    QList<QSslCertificate> peerCertificationChain = d->peerChain;
     KSslCertificateManager *const cm = KSslCertificateManager::self();
     KSslCertificateRule rule = cm->rule(peerCertificationChain.first(), d->host);
 
@@ -0,0 +1,97 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "threadedworkqueue_p.h"
+
+#include <QMetaObject>
+#include <QThread>
+
+using namespace KIO;
+
+ThreadedWorkQueue::ThreadedWorkQueue(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ThreadedWorkQueue::~ThreadedWorkQueue()
+{
+    stop();
+}
+
+void ThreadedWorkQueue::add(Task &&task)
+{
+    QMutexLocker locker(&m_mutex);
+    m_tasks.push_back(std::move(task));
+    m_changed.wakeOne();
+}
+
+void ThreadedWorkQueue::start(Task &&finalTask)
+{
+    Q_ASSERT(m_threads.empty());
+    m_finalTask = std::move(finalTask);
+
+    const int threadCount = qBound(2, QThread::idealThreadCount(), 8);
+    m_running = threadCount;
+    for (int i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back(QThread::create([this]() {
+            run();
+        }));
+        m_threads.back()->start();
+    }
+}
+
+void ThreadedWorkQueue::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_tasks.clear();
+        m_changed.wakeAll();
+    }
+    for (const auto &thread : m_threads) {
+        thread->wait();
+    }
+}
+
+void ThreadedWorkQueue::run()
+{
+    QMutexLocker locker(&m_mutex);
+    while (true) {
+        while (m_tasks.empty() && m_busy > 0 && !m_stopping) {
+            m_changed.wait(&m_mutex);
+        }
+        if (m_tasks.empty() || m_stopping) {
+            break;
+        }
+        const Task task = std::move(m_tasks.back());
+        m_tasks.pop_back();
+        ++m_busy;
+
+        locker.unlock();
+        task();
+        locker.relock();
+
+        --m_busy;
+        m_changed.wakeAll();
+    }
+
+    if (--m_running == 0) {
+        const bool stopped = m_stopping;
+        locker.unlock();
+        if (m_finalTask) {
+            m_finalTask();
+        }
+        if (stopped) {
+            return;
+        }
+        QMetaObject::invokeMethod(
+            this,
+            [this]() {
+                Q_EMIT finished();
+            },
+            Qt::QueuedConnection);
+    }
+}
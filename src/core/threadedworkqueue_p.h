@@ -0,0 +1,86 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KIO_THREADEDWORKQUEUE_P_H
+#define KIO_THREADEDWORKQUEUE_P_H
+
+#include <QMutex>
+#include <QObject>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QThread;
+
+namespace KIO
+{
+/**
+ * @internal
+ * Runs tasks with a few threads of its own, for the jobs going through local
+ * directory trees (DeleteJob::setBulkDelete(), DirectorySizeJob). The threads take
+ * the tasks from a common queue, and a task usually adds more, one per subdirectory
+ * it found, so the threads spread over the subtrees.
+ *
+ * The task added last runs first: going deep before going wide keeps the queue short.
+ * The queue is done once it's empty and no task runs anymore.
+ */
+class ThreadedWorkQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadedWorkQueue(QObject *parent = nullptr);
+    ~ThreadedWorkQueue() override;
+
+    /**
+     * Queues @p task, from any thread.
+     */
+    void add(Task &&task);
+
+    /**
+     * Starts the threads, @p finalTask runs in the last one once the queue is done
+     * or stopped.
+     */
+    void start(Task &&finalTask = Task());
+
+    /**
+     * Drops the tasks that didn't start and waits for the running ones. Long tasks
+     * should check isStopping() to give up early.
+     */
+    void stop();
+
+    bool isStopping() const
+    {
+        return m_stopping;
+    }
+
+Q_SIGNALS:
+    /**
+     * Emitted in the thread of this object once the queue is done, not after stop().
+     */
+    void finished();
+
+private:
+    void run();
+
+    QMutex m_mutex; // protects the tasks and the counts
+    QWaitCondition m_changed;
+    std::vector<Task> m_tasks;
+    int m_busy = 0;
+    int m_running = 0;
+    std::atomic<bool> m_stopping{false};
+    Task m_finalTask;
+    std::vector<std::unique_ptr<QThread>> m_threads;
+};
+
+}
+
+#endif
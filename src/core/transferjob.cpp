@@ -35,6 +35,18 @@ TransferJob::~TransferJob()
 {
 }
 
+// The worker served a stale cache entry (RFC 5861 stale-while-revalidate) and can't
+// revalidate it after it has answered, so a job of its own does that, with nobody waiting for it
+static void revalidateInBackground(const QUrl &url, const MetaData &requestMetaData)
+{
+    TransferJob *job = KIO::get(url, NoReload, HideProgressInfo);
+    job->setUiDelegate(nullptr);
+    job->addMetaData(requestMetaData);
+    // force a conditional request, and make sure that it doesn't end up serving stale again
+    job->addMetaData(QStringLiteral("cache"), QStringLiteral("refresh"));
+    job->addMetaData(QStringLiteral("cache-revalidation"), QStringLiteral("true"));
+}
+
 // Slave sends data
 void TransferJob::slotData(const QByteArray &_data)
 {
@@ -155,6 +167,10 @@ void TransferJob::slotFinished()
         }
     }
 
+    if (d->m_command == CMD_GET && !error() && queryMetaData(QStringLiteral("cache-revalidate")) == QLatin1String("true")) {
+        revalidateInBackground(d->m_url, d->m_outgoingMetaData);
+    }
+
     SimpleJob::slotFinished();
 }
 
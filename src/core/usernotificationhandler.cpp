@@ -60,7 +60,9 @@ void UserNotificationHandler::processRequest()
     int result = -1;
     Request *r = m_pendingRequests.first();
 
-    if (r->slave) {
+    if (r->slave && r->slave->isCancelling()) {
+        // The job is gone, don't bother the user: any answer lets the worker abort
+    } else if (r->slave) {
         const QString key = r->key();
 
         if (m_cachedResults.contains(key)) {
@@ -194,6 +194,9 @@ protected:
         case SlaveBase::Truncate:
             maybeError(base->truncate(*static_cast<KIO::filesize_t *>(data)));
             return;
+        case SlaveBase::GetChecksums:
+            finalize(base->checksums(*static_cast<QUrl *>(data)));
+            return;
         }
 
         maybeError(WorkerResult::fail(ERR_UNSUPPORTED_ACTION, unsupportedActionErrorString(protocolName(), id)));
@@ -526,6 +529,11 @@ WorkerResult WorkerBase::fileSystemFreeSpace(const QUrl &)
     return WorkerResult::fail(ERR_UNSUPPORTED_ACTION, unsupportedActionErrorString(d->protocolName(), CMD_FILESYSTEMFREESPACE));
 }
 
+WorkerResult WorkerBase::checksums(const QUrl &)
+{
+    return WorkerResult::fail(ERR_UNSUPPORTED_ACTION, unsupportedActionErrorString(d->protocolName(), CMD_CHECKSUM));
+}
+
 void WorkerBase::worker_status()
 {
     workerStatus(QString(), false);
@@ -611,6 +619,16 @@ bool WorkerBase::wasKilled() const
     return d->bridge.wasKilled();
 }
 
+bool WorkerBase::wasCancelled() const
+{
+    return d->bridge.wasCancelled();
+}
+
+int WorkerBase::cancellationError() const
+{
+    return d->bridge.cancellationError();
+}
+
 void WorkerBase::lookupHost(const QString &host)
 {
     return d->bridge.lookupHost(host);
@@ -644,6 +644,19 @@ public:
      */
     virtual void reparseConfiguration();
 
+    /**
+     * Computes checksums of the file at @p url, for KIO::ChecksumJob.
+     *
+     * The algorithms to compute are listed in the "checksums" metadata, comma separated
+     * ("md5", "sha1", "sha256", ...). Set the result of each one as "checksum-<name>"
+     * metadata, hex encoded; algorithms the worker doesn't know are skipped and computed
+     * by the job from the file data.
+     *
+     * @param url the file to hash
+     * @since 5.98
+     */
+    Q_REQUIRED_RESULT virtual WorkerResult checksums(const QUrl &url);
+
     /**
      * @return timeout value for connecting to remote host.
      */
@@ -850,6 +863,26 @@ public:
      */
     bool wasKilled() const;
 
+    /**
+     * Returns @c true if the current command should be aborted: either the
+     * application killed the job, the "deadline" metadata of the job has
+     * passed, or the worker was killed (see wasKilled()).
+     *
+     * Check it regularly in read/write loops and, if it returns true, clean up
+     * and return WorkerResult::fail(cancellationError(), ...). A cancelled
+     * worker is reused once it has returned, so it must not exit.
+     * @since 5.98
+     */
+    bool wasCancelled() const;
+
+    /**
+     * Returns the error code to report when wasCancelled() returned @c true:
+     * KIO::ERR_SERVER_TIMEOUT if the job deadline passed,
+     * KIO::ERR_USER_CANCELED otherwise.
+     * @since 5.98
+     */
+    int cancellationError() const;
+
     /** Internally used
      * @internal
      */
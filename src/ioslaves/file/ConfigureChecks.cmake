@@ -14,6 +14,12 @@ check_include_files(sys/xattr.h   HAVE_SYS_XATTR_H)
 check_include_files("sys/types.h;sys/extattr.h" HAVE_SYS_EXTATTR_H)
 
 check_function_exists(copy_file_range HAVE_COPY_FILE_RANGE)
+check_function_exists(fallocate HAVE_FALLOCATE)
+
+# glibc only defines SEEK_DATA/SEEK_HOLE with _GNU_SOURCE, which C++ compilers define anyway
+set(CMAKE_REQUIRED_DEFINITIONS -D_GNU_SOURCE)
+check_symbol_exists(SEEK_HOLE "unistd.h" HAVE_SEEK_HOLE)
+unset(CMAKE_REQUIRED_DEFINITIONS)
 
 check_function_exists(posix_fadvise    HAVE_FADVISE)                  # kioslave
 
@@ -24,5 +24,11 @@
 /* Defined if system has the copy_file_range function. */
 #cmakedefine01 HAVE_COPY_FILE_RANGE
 
+/* Defined if system has the (Linux) fallocate function. */
+#cmakedefine01 HAVE_FALLOCATE
+
+/* Defined if lseek() can find data and holes in sparse files. */
+#cmakedefine01 HAVE_SEEK_HOLE
+
 /* Defined if system has the statx function, meaning glibc >= 2.28 */
 #cmakedefine01 HAVE_STATX
@@ -9,6 +9,7 @@
 */
 
 #include "file.h"
+#include "filepipeline_p.h"
 
 #include <QDirIterator>
 
@@ -22,6 +23,8 @@
 
 #include <assert.h>
 #include <cerrno>
+#include <memory>
+#include <vector>
 #ifdef Q_OS_WIN
 #include <qt_windows.h>
 #include <sys/utime.h>
@@ -31,6 +34,7 @@
 #endif
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDate>
 #include <QTemporaryFile>
 #include <QVarLengthArray>
@@ -343,31 +347,33 @@ void FileProtocol::get(const QUrl &url)
         }
     }
 
-    char buffer[s_maxIPCSize];
-    QByteArray array;
+    {
+        // the next blocks are read while this one is sent
+        FileReadAhead reader(&f, buff.st_size - processed_size, s_maxIPCSize, pipelineDepth());
+        QByteArray array;
 
-    while (1) {
-        int n = f.read(buffer, s_maxIPCSize);
-        if (n == -1) {
-            if (errno == EINTR) {
-                continue;
+        while (1) {
+            if (wasCancelled()) {
+                error(cancellationError(), path);
+                return;
+            }
+
+            if (!reader.next(&array)) {
+                error(KIO::ERR_CANNOT_READ, path);
+                return;
+            }
+            if (array.isEmpty()) {
+                break; // Finished
             }
-            error(KIO::ERR_CANNOT_READ, path);
-            f.close();
-            return;
-        }
-        if (n == 0) {
-            break; // Finished
-        }
 
-        array = QByteArray::fromRawData(buffer, n);
-        data(array);
-        array.clear();
+            data(array);
 
-        processed_size += n;
-        processedSize(processed_size);
+            processed_size += array.size();
+            processedSize(processed_size);
+            reader.recycle(std::move(array));
 
-        // qDebug() << "Processed: " << KIO::number (processed_size);
+            // qDebug() << "Processed: " << KIO::number (processed_size);
+        }
     }
 
     data(QByteArray());
@@ -378,6 +384,105 @@ void FileProtocol::get(const QUrl &url)
     finished();
 }
 
+void FileProtocol::checksums(const QUrl &url)
+{
+    static const struct {
+        const char *name;
+        QCryptographicHash::Algorithm algorithm;
+    } s_algorithms[] = {
+        {"md5", QCryptographicHash::Md5},
+        {"sha1", QCryptographicHash::Sha1},
+        {"sha224", QCryptographicHash::Sha224},
+        {"sha256", QCryptographicHash::Sha256},
+        {"sha384", QCryptographicHash::Sha384},
+        {"sha512", QCryptographicHash::Sha512},
+    };
+
+    // Unknown names are skipped, the job computes those itself
+    std::vector<std::pair<QString, std::unique_ptr<QCryptographicHash>>> hashes;
+    const QStringList names = metaData(QStringLiteral("checksums")).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const QString &name : names) {
+        for (const auto &known : s_algorithms) {
+            if (name == QLatin1String(known.name)) {
+                hashes.emplace_back(name, std::make_unique<QCryptographicHash>(known.algorithm));
+                break;
+            }
+        }
+    }
+
+    const QString path(url.toLocalFile());
+    QT_STATBUF buff;
+    if (QT_STAT(QFile::encodeName(path).constData(), &buff) == -1) {
+        if (errno == EACCES) {
+            error(KIO::ERR_ACCESS_DENIED, path);
+        } else {
+            error(KIO::ERR_DOES_NOT_EXIST, path);
+        }
+        return;
+    }
+    if ((buff.st_mode & QT_STAT_MASK) == QT_STAT_DIR) {
+        error(KIO::ERR_IS_DIRECTORY, path);
+        return;
+    }
+    if ((buff.st_mode & QT_STAT_MASK) != QT_STAT_REG) {
+        error(KIO::ERR_CANNOT_OPEN_FOR_READING, path);
+        return;
+    }
+
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        error(KIO::ERR_CANNOT_OPEN_FOR_READING, path);
+        return;
+    }
+
+#if HAVE_FADVISE
+    posix_fadvise(f.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    totalSize(buff.st_size);
+
+    {
+        // Nothing goes over the socket, so read in bigger blocks than get()
+        FileReadAhead reader(&f, buff.st_size, 1024 * 1024, pipelineDepth());
+        QByteArray array;
+        KIO::filesize_t processed_size = 0;
+
+        while (true) {
+            if (wasCancelled()) {
+                error(cancellationError(), path);
+                return;
+            }
+
+            if (!reader.next(&array)) {
+                error(KIO::ERR_CANNOT_READ, path);
+                return;
+            }
+            if (array.isEmpty()) {
+                break;
+            }
+
+            for (const auto &hash : hashes) {
+                hash.second->addData(array);
+            }
+
+            processed_size += array.size();
+            processedSize(processed_size);
+            reader.recycle(std::move(array));
+        }
+    }
+
+    for (const auto &hash : hashes) {
+        setMetaData(QLatin1String("checksum-") + hash.first, QString::fromLatin1(hash.second->result().toHex()));
+    }
+    finished();
+}
+
+int FileProtocol::pipelineDepth()
+{
+    // 0 reads and writes synchronously
+    return qBound(0, configValue(QStringLiteral("IOQueueDepth"), 4), 64);
+}
+
 void FileProtocol::open(const QUrl &url, QIODevice::OpenMode mode)
 {
     // qDebug() << url;
@@ -556,6 +661,8 @@ void FileProtocol::put(const QUrl &url, int _mode, KIO::JobFlags _flags)
     int result;
     QString dest;
     QFile f;
+    // receives the next data while the current data is written
+    std::unique_ptr<FileWriteBehind> writer;
 
     // Loop until we got 0 (end of data)
     do {
@@ -630,10 +737,24 @@ void FileProtocol::put(const QUrl &url, int _mode, KIO::JobFlags _flags)
 #endif
                     }
                 }
+
+#ifndef Q_OS_WIN
+                // set by file_copy when it knows the size of the source
+                const qint64 expectedSize = metaData(QStringLiteral("size")).toLongLong();
+                const qint64 existingSize = f.size();
+                if (expectedSize > existingSize) {
+                    preallocate(f.handle(), existingSize, expectedSize - existingSize);
+                }
+#endif
+                writer.reset(new FileWriteBehind(&f, pipelineDepth()));
             }
 
-            if (f.write(buffer) == -1) {
-                if (f.error() == QFile::ResourceError) { // disk full
+            bool written = writer->write(buffer);
+            if (written && result == 0) {
+                written = writer->finish(); // that was all
+            }
+            if (!written) {
+                if (writer->error() == QFile::ResourceError) { // disk full
                     error(KIO::ERR_DISK_FULL, dest_orig);
                     result = -2; // means: remove dest file
                 } else {
@@ -641,7 +762,13 @@ void FileProtocol::put(const QUrl &url, int _mode, KIO::JobFlags _flags)
                     error(KIO::ERR_CANNOT_WRITE, dest_orig);
                     result = -1;
                 }
+            } else if (result > 0 && wasCancelled()) {
+                error(cancellationError(), dest_orig);
+                result = -1;
             }
+        } else if (wasCancelled()) {
+            // the job was killed while we were waiting for data
+            error(cancellationError(), dest_orig);
         } else {
             qCWarning(KIO_FILE) << "readData() returned" << result;
             error(KIO::ERR_CANNOT_WRITE, dest_orig);
@@ -652,6 +779,7 @@ void FileProtocol::put(const QUrl &url, int _mode, KIO::JobFlags _flags)
     if (result < 0) {
         // qDebug() << "Error during 'put'. Aborting.";
 
+        writer.reset();
         if (f.isOpen()) {
             f.close();
 
@@ -671,6 +799,7 @@ void FileProtocol::put(const QUrl &url, int _mode, KIO::JobFlags _flags)
         return;
     }
 
+    writer.reset();
     f.close();
 
     if (f.error() != QFile::NoError) {
@@ -773,6 +902,14 @@ void FileProtocol::special(const QByteArray &data)
         unmount(point);
         break;
     }
+    case 3: {
+        QUrl src;
+        QUrl dest;
+        qint8 iKeepPermissions;
+        stream >> src >> dest >> iKeepPermissions;
+        copyTree(src, dest, iKeepPermissions != 0);
+        break;
+    }
     default:
         break;
     }
@@ -1007,6 +1144,11 @@ void FileProtocol::virtual_hook(int id, void *data)
         truncate(*length);
         break;
     }
+    case SlaveBase::GetChecksums: {
+        QUrl *url = static_cast<QUrl *>(data);
+        checksums(*url);
+        break;
+    }
     default: {
         SlaveBase::virtual_hook(id, data);
         break;
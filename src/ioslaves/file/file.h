@@ -64,11 +64,22 @@ public:
      * Special commands supported by this slave:
      * 1 - mount
      * 2 - unmount
+     * 3 - copy a directory tree, see copyTree()
      */
     void special(const QByteArray &data) override;
     void unmount(const QString &point);
     void mount(bool _ro, const char *_fstype, const QString &dev, const QString &point);
 
+    /**
+     * Copies the directory @p src with everything in it to @p dest, in one go for CopyJob.
+     * @p dest must not exist and must be on the same filesystem as @p src. What has been
+     * created is sent with data() on the way.
+     *
+     * Fails with ERR_UNSUPPORTED_ACTION before copying anything when CopyJob has to copy
+     * the tree one entry at a time, e.g. because something can't be read.
+     */
+    void copyTree(const QUrl &src, const QUrl &dest, bool keepPermissions);
+
 #if HAVE_POSIX_ACL
     static bool isExtendedACL(acl_t acl);
 #endif
@@ -83,11 +94,22 @@ private:
     bool deleteRecursive(const QString &path);
 
     void fileSystemFreeSpace(const QUrl &url); // KF6 TODO: Turn into virtual method in SlaveBase
+    // Hashes the file with the algorithms in the "checksums" metadata, reading it once
+    void checksums(const QUrl &url); // KF6 TODO: Turn into virtual method in SlaveBase
 
     bool privilegeOperationUnitTestMode();
     PrivilegeOperationReturnValue execWithElevatedPrivilege(ActionType action, const QVariantList &args, int errcode);
     PrivilegeOperationReturnValue tryOpen(QFile &f, const QByteArray &path, int flags, int mode, int errcode);
 
+    // How many blocks get, put and copy read ahead or write behind in a thread
+    int pipelineDepth();
+
+    // Reserves disk space for the length bytes at offset that are about to be written
+    static void preallocate(int fd, qint64 offset, qint64 length);
+
+    // Copies the content of a file for copyTree(), returns false and sets errno on failure
+    bool copyTreeFileData(int srcFd, int destFd, qint64 size, bool sparse, KIO::filesize_t *processed, QByteArray *buffer);
+
     // We want to execute chmod/chown/utime with elevated privileges (in copy & put)
     // only during the brief period privileges are elevated. If it's not the case show
     // a warning and continue.
@@ -17,7 +17,9 @@
 #include <../../aclhelpers_p.h>
 #endif
 
+#include <QCryptographicHash>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QMimeDatabase>
 #include <QStandardPaths>
@@ -30,22 +32,27 @@
 #include <QDebug>
 #include <kmountpoint.h>
 
-#include <array>
 #include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <memory>
 #include <stdint.h>
 #include <utime.h>
+#include <vector>
 
 #include <KAuth/Action>
 #include <KAuth/ExecuteJob>
 #include <KRandom>
 
 #include "fdreceiver.h"
+#include "filepipeline_p.h"
 #include "statjob.h"
 
 #ifdef Q_OS_LINUX
 
 #include <linux/fs.h>
 #include <sys/ioctl.h>
+#include <sys/sysmacros.h> // for major() and minor()
 #include <unistd.h>
 
 #endif // Q_OS_LINUX
@@ -62,6 +69,15 @@
 #include <unistd.h>
 #endif
 
+#if HAVE_SEEK_HOLE
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#if HAVE_FALLOCATE
+#include <fcntl.h>
+#endif
+
 #if HAVE_SYS_XATTR_H
 #include <sys/xattr.h>
 // BSD uses a different include
@@ -76,6 +92,168 @@ using namespace KIO;
 /* 512 kB */
 static constexpr int s_maxIPCSize = 1024 * 512;
 
+// Smaller files aren't worth preallocating or looking at the device for
+static constexpr qint64 s_minPreallocateSize = 1024 * 1024;
+
+// How much copyTree() copies at a time, and after how many entries it tells CopyJob about them
+static constexpr qint64 s_treeCopyChunkSize = 8 * 1024 * 1024;
+static constexpr int s_treeCopyReportCount = 64;
+
+// Verified copies compare the hashes of what was read and of what ended up on the disk.
+// They are meant to catch corruption, not tampering, so the fast MD5 is enough.
+static constexpr QCryptographicHash::Algorithm s_verifyAlgorithm = QCryptographicHash::Md5;
+static constexpr size_t s_verifyBlockSize = 1024 * 1024;
+
+#ifdef Q_OS_LINUX
+// Whether the block device with the given number is a spinning disk
+static bool isRotational(dev_t dev)
+{
+    // partitions don't have a queue of their own, their disk has
+    const QString base = QStringLiteral("/sys/dev/block/%1:%2/").arg(major(dev)).arg(minor(dev));
+    for (const QString &path : {base + QLatin1String("queue/rotational"), base + QLatin1String("../queue/rotational")}) {
+        QFile file(path);
+        if (file.open(QIODevice::ReadOnly)) {
+            return file.read(1) == "1";
+        }
+    }
+    return false;
+}
+#endif
+
+/**
+ * How much copy() reads and writes at once. Large chunks get local disks to their full
+ * bandwidth, but progress reports and cancellation wait for the current chunk. The size
+ * starts from what suits the device and then doubles or halves to keep a chunk at about
+ * s_targetTime.
+ */
+class CopyChunkSize
+{
+public:
+    CopyChunkSize(const QString &dest, const QT_STATBUF &src, const QT_STATBUF &destStat, qint64 fileSize, bool adaptive)
+        : m_size(s_maxIPCSize)
+        , m_maxSize(s_maxIPCSize)
+    {
+        if (!adaptive || fileSize < s_minPreallocateSize) {
+            return;
+        }
+        const KMountPoint::Ptr mp = KMountPoint::currentMountPoints().findByPath(dest);
+        if (mp && mp->probablySlow()) {
+            // network filesystems, don't hold up cancelling for long
+            m_maxSize = 2 * 1024 * 1024;
+            return;
+        }
+        m_maxSize = 16 * 1024 * 1024;
+#ifdef Q_OS_LINUX
+        if (isRotational(src.st_dev) || isRotational(destStat.st_dev)) {
+            // hard disks seek between reading and writing, the longer the runs the better
+            m_size = 2 * 1024 * 1024;
+            m_maxSize = 32 * 1024 * 1024;
+        }
+#else
+        Q_UNUSED(src);
+        Q_UNUSED(destStat);
+#endif
+        m_timer.start();
+    }
+
+    int size() const
+    {
+        return m_size;
+    }
+
+    // Call after each chunk, with the number of bytes it copied
+    void update(qint64 bytes)
+    {
+        if (!m_timer.isValid()) {
+            return;
+        }
+        const qint64 elapsed = m_timer.nsecsElapsed() / 1000000;
+        m_timer.start();
+        if (bytes < m_size) {
+            return; // the end of the file, or an interrupted call
+        }
+        if (elapsed < s_targetTime / 2 && m_size < m_maxSize) {
+            m_size *= 2;
+        } else if (elapsed > s_targetTime * 2 && m_size > s_minSize) {
+            m_size /= 2;
+        }
+    }
+
+private:
+    static constexpr qint64 s_targetTime = 100; // ms
+    static constexpr int s_minSize = 64 * 1024;
+
+    int m_size;
+    int m_maxSize;
+    QElapsedTimer m_timer;
+};
+
+void FileProtocol::preallocate(int fd, qint64 offset, qint64 length)
+{
+#if HAVE_FALLOCATE
+    if (length < s_minPreallocateSize) {
+        return;
+    }
+    // Reserving the space in one go lets the filesystem keep large files in few extents,
+    // and fails early on a full disk. Not posix_fallocate(), which writes zeros where
+    // fallocate() isn't supported (NFS, ...). The size only grows with the data written,
+    // a partly copied file keeps its real size.
+    if (::fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, length) == -1 && errno != EOPNOTSUPP && errno != ENOSYS) {
+        qCDebug(KIO_FILE) << "Couldn't preallocate" << length << "bytes:" << strerror(errno);
+    }
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(offset);
+    Q_UNUSED(length);
+#endif
+}
+
+#if HAVE_SEEK_HOLE
+// Whether fewer blocks are allocated than the size needs, because of holes (or compression)
+static bool isSparseFile(const QT_STATBUF &buff)
+{
+    // st_blocks is in units of 512 bytes, whatever the block size of the filesystem
+    return S_ISREG(buff.st_mode) && buff.st_blocks * 512 < buff.st_size;
+}
+#endif
+
+// Copies up to length bytes at offset in srcFd to the same offset in destFd, without
+// touching the file positions. Returns the number of bytes copied, or -1 and sets errno.
+static ssize_t copyFileRange(int srcFd, int destFd, off_t offset, size_t length, bool *useCopyFileRange, QByteArray *buffer)
+{
+#if HAVE_COPY_FILE_RANGE
+    if (*useCopyFileRange) {
+        off_t srcOffset = offset;
+        off_t destOffset = offset;
+        const ssize_t copiedBytes = ::copy_file_range(srcFd, &srcOffset, destFd, &destOffset, length, 0);
+        if (copiedBytes != -1 || (errno != EINVAL && errno != EXDEV && errno != ENOSYS)) {
+            return copiedBytes;
+        }
+        *useCopyFileRange = false; // e.g. across filesystems with older kernels
+    }
+#endif
+
+    if (buffer->size() < int(length)) {
+        buffer->resize(length);
+    }
+    const ssize_t readBytes = ::pread(srcFd, buffer->data(), length, offset);
+    if (readBytes <= 0) {
+        return readBytes;
+    }
+    ssize_t writtenBytes = 0;
+    while (writtenBytes < readBytes) {
+        const ssize_t n = ::pwrite(destFd, buffer->constData() + writtenBytes, readBytes - writtenBytes, offset + writtenBytes);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        writtenBytes += n;
+    }
+    return readBytes;
+}
+
 static bool same_inode(const QT_STATBUF &src, const QT_STATBUF &dest)
 {
     if (src.st_ino == dest.st_ino && src.st_dev == dest.st_dev) {
@@ -671,6 +849,62 @@ bool FileProtocol::copyXattrs(const int src_fd, const int dest_fd)
 }
 #endif // HAVE_SYS_XATTR_H || HAVE_SYS_EXTATTR_H
 
+// Hashes the file as it was stored rather than what the page cache still holds of it, reading
+// with O_DIRECT where the filesystem allows it. The file must have been synced.
+static bool hashFromDisk(const QByteArray &path, QCryptographicHash *hash)
+{
+    int fd = -1;
+#ifdef O_DIRECT
+    fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+#endif
+    if (fd == -1) {
+        fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return false;
+        }
+#if HAVE_FADVISE
+        // only drops clean pages, hence the sync
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    }
+
+    // O_DIRECT needs a buffer aligned to the block size of the device
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, 4096, s_verifyBlockSize) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    bool ok = true;
+    while (true) {
+        const ssize_t n = ::read(fd, buffer, s_verifyBlockSize);
+        if (n == -1) {
+            const int readErrno = errno;
+#ifdef O_DIRECT
+            const int flags = ::fcntl(fd, F_GETFL);
+            if (readErrno == EINVAL && flags != -1 && (flags & O_DIRECT)) {
+                // stricter alignment than we thought, go on through the page cache
+                ::fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+                continue;
+            }
+#endif
+            if (readErrno == EINTR) {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        hash->addData(static_cast<const char *>(buffer), n);
+    }
+
+    ::free(buffer);
+    ::close(fd);
+    return ok;
+}
+
 void FileProtocol::copy(const QUrl &srcUrl, const QUrl &destUrl, int _mode, JobFlags _flags)
 {
     if (privilegeOperationUnitTestMode()) {
@@ -792,31 +1026,123 @@ void FileProtocol::copy(const QUrl &srcUrl, const QUrl &destUrl, int _mode, JobF
     posix_fadvise(destFile.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
 #endif
 
-    totalSize(buffSrc.st_size);
+    // the size from the start, srcFile must not be used while the read-ahead thread reads it
+    const off_t fileSize = buffSrc.st_size;
+    totalSize(fileSize);
+
+    // A verified copy goes through the read/write loop below, which hashes the data on the way
+    std::unique_ptr<QCryptographicHash> sourceHash;
+    if (metaData(QStringLiteral("verify")) == QLatin1String("true")) {
+        sourceHash = std::make_unique<QCryptographicHash>(s_verifyAlgorithm);
+    }
 
     off_t sizeProcessed = 0;
 
 #ifdef FICLONE
     // Share data blocks ("reflink") on supporting filesystems, like brfs and XFS
-    int ret = ::ioctl(destFile.handle(), FICLONE, srcFile.handle());
+    int ret = sourceHash ? -1 : ::ioctl(destFile.handle(), FICLONE, srcFile.handle());
     if (ret != -1) {
-        sizeProcessed = srcFile.size();
-        processedSize(srcFile.size());
+        sizeProcessed = fileSize;
+        processedSize(fileSize);
     }
     // if fs does not support reflinking, files are on different devices...
 #endif
 
     bool existingDestDeleteAttempted = false;
+    const bool slowTestCopy = testMode && destFile.fileName().contains(QLatin1String("slow"));
 
     processedSize(sizeProcessed);
 
+#if HAVE_SEEK_HOLE
+    // Copy only the data of sparse files like VM images, so that the holes stay holes instead
+    // of filling the destination with zeros. The destination has been truncated, anything
+    // not written to it is a hole. The progress counts the holes as copied.
+    if (!sourceHash && sizeProcessed < fileSize && isSparseFile(buffSrc)) {
+        QByteArray buffer;
+        bool useCopyFileRange = true;
+        off_t dataEnd = sizeProcessed; // end of the data extent being copied
+        while (!wasCancelled() && sizeProcessed < fileSize) {
+            if (sizeProcessed == dataEnd) {
+                off_t dataStart = ::lseek(srcFile.handle(), sizeProcessed, SEEK_DATA);
+                if (dataStart == -1 && errno == ENXIO) {
+                    dataStart = fileSize; // only a hole is left
+                }
+                dataEnd = dataStart < fileSize ? ::lseek(srcFile.handle(), dataStart, SEEK_HOLE) : fileSize;
+                if (dataStart == -1 || dataEnd == -1) {
+                    break; // not supported by the filesystem after all, copy the rest below
+                }
+                sizeProcessed = dataStart;
+                processedSize(sizeProcessed);
+                continue;
+            }
+
+            if (slowTestCopy) {
+                QThread::msleep(50);
+            }
+
+            const size_t length = qMin<off_t>(dataEnd - sizeProcessed, s_maxIPCSize);
+            const ssize_t copiedBytes = copyFileRange(srcFile.handle(), destFile.handle(), sizeProcessed, length, &useCopyFileRange, &buffer);
+            if (copiedBytes == 0) {
+                break; // the file shrank, let the loops below sort it out
+            }
+            if (copiedBytes == -1) {
+                if (errno == EINTR) { // Interrupted
+                    continue;
+                }
+
+                if (errno == ENOSPC) { // disk full
+                    // attempt to free disk space occupied by file being overwritten
+                    if (!_destBackup.isEmpty() && !existingDestDeleteAttempted) {
+                        ::unlink(_destBackup.constData());
+                        existingDestDeleteAttempted = true;
+                        continue;
+                    }
+                    error(KIO::ERR_DISK_FULL, dest);
+                } else {
+                    error(KIO::ERR_WORKER_DEFINED, i18n("Cannot copy file from %1 to %2. (Errno: %3)", src, dest, errno));
+                }
+
+                if (!QFile::remove(dest)) { // don't keep partly copied file
+                    execWithElevatedPrivilege(DEL, {_dest}, errno);
+                }
+                return;
+            }
+
+            sizeProcessed += copiedBytes;
+            processedSize(sizeProcessed);
+        }
+
+        // a hole at the end is not written either, it only needs the right size
+        if (sizeProcessed == fileSize && ::ftruncate(destFile.handle(), fileSize) == -1) {
+            error(KIO::ERR_CANNOT_WRITE, dest);
+            if (!QFile::remove(dest)) { // don't keep partly copied file
+                execWithElevatedPrivilege(DEL, {_dest}, errno);
+            }
+            return;
+        }
+        // the ways of copying below go on from the file positions
+        ::lseek(srcFile.handle(), sizeProcessed, SEEK_SET);
+        ::lseek(destFile.handle(), sizeProcessed, SEEK_SET);
+    }
+#endif
+
+    if (sizeProcessed < fileSize) {
+        preallocate(destFile.handle(), sizeProcessed, fileSize - sizeProcessed);
+    }
+    QT_STATBUF buffDestFile;
+    if (QT_FSTAT(destFile.handle(), &buffDestFile) == -1) {
+        buffDestFile = buffSrc;
+    }
+    // the tests want many small chunks for the slow copies
+    CopyChunkSize chunkSize(dest, buffSrc, buffDestFile, fileSize - sizeProcessed, !slowTestCopy);
+
 #if HAVE_COPY_FILE_RANGE
-    while (!wasKilled() && sizeProcessed < srcFile.size()) {
-        if (testMode && destFile.fileName().contains(QLatin1String("slow"))) {
+    while (!sourceHash && !wasCancelled() && sizeProcessed < fileSize) {
+        if (slowTestCopy) {
             QThread::msleep(50);
         }
 
-        const ssize_t copiedBytes = ::copy_file_range(srcFile.handle(), nullptr, destFile.handle(), nullptr, s_maxIPCSize, 0);
+        const ssize_t copiedBytes = ::copy_file_range(srcFile.handle(), nullptr, destFile.handle(), nullptr, chunkSize.size(), 0);
 
         if (copiedBytes == -1) {
             if (errno == EINVAL || errno == EXDEV) {
@@ -847,43 +1173,43 @@ void FileProtocol::copy(const QUrl &srcUrl, const QUrl &destUrl, int _mode, JobF
 
         sizeProcessed += copiedBytes;
         processedSize(sizeProcessed);
+        chunkSize.update(copiedBytes);
     }
 #endif
 
     /* standard read/write fallback */
-    if (sizeProcessed < srcFile.size()) {
-        std::array<char, s_maxIPCSize> buffer;
-        while (!wasKilled() && sizeProcessed < srcFile.size()) {
-            if (testMode && destFile.fileName().contains(QLatin1String("slow"))) {
+    if (sizeProcessed < fileSize) {
+        // the next chunks are read while this one is written
+        FileReadAhead reader(&srcFile, fileSize - sizeProcessed, chunkSize.size(), pipelineDepth());
+        QByteArray buffer;
+        while (!wasCancelled() && sizeProcessed < fileSize) {
+            if (slowTestCopy) {
                 QThread::msleep(50);
             }
 
-            const ssize_t readBytes = ::read(srcFile.handle(), &buffer, s_maxIPCSize);
-
-            if (readBytes == -1) {
-                if (errno == EINTR) { // Interrupted
-                    continue;
-                } else {
-                    qCWarning(KIO_FILE) << "Couldn't read[2]. Error:" << srcFile.errorString();
-                    error(KIO::ERR_CANNOT_READ, src);
-                }
+            reader.setBlockSize(chunkSize.size());
+            if (!reader.next(&buffer)) {
+                qCWarning(KIO_FILE) << "Couldn't read[2]. Error:" << srcFile.errorString();
+                error(KIO::ERR_CANNOT_READ, src);
 
                 if (!QFile::remove(dest)) { // don't keep partly copied file
                     execWithElevatedPrivilege(DEL, {_dest}, errno);
                 }
                 return;
             }
+            if (buffer.isEmpty()) {
+                break; // the file shrank
+            }
 
-            if (destFile.write(buffer.data(), readBytes) != readBytes) {
+            bool written = destFile.write(buffer) == buffer.size();
+            if (!written && destFile.error() == QFileDevice::ResourceError && !_destBackup.isEmpty() && !existingDestDeleteAttempted) {
+                // attempt to free disk space occupied by file being overwritten
+                ::unlink(_destBackup.constData());
+                existingDestDeleteAttempted = true;
+                written = destFile.write(buffer) == buffer.size(); // retry
+            }
+            if (!written) {
                 if (destFile.error() == QFileDevice::ResourceError) { // disk full
-                    // attempt to free disk space occupied by file being overwritten
-                    if (!_destBackup.isEmpty() && !existingDestDeleteAttempted) {
-                        ::unlink(_destBackup.constData());
-                        existingDestDeleteAttempted = true;
-                        if (destFile.write(buffer.data(), readBytes) == readBytes) { // retry
-                            continue;
-                        }
-                    }
                     error(KIO::ERR_DISK_FULL, dest);
                 } else {
                     qCWarning(KIO_FILE) << "Couldn't write[2]. Error:" << destFile.errorString();
@@ -895,8 +1221,13 @@ void FileProtocol::copy(const QUrl &srcUrl, const QUrl &destUrl, int _mode, JobF
                 }
                 return;
             }
-            sizeProcessed += readBytes;
+            if (sourceHash) {
+                sourceHash->addData(buffer);
+            }
+            sizeProcessed += buffer.size();
             processedSize(sizeProcessed);
+            chunkSize.update(buffer.size());
+            reader.recycle(std::move(buffer));
         }
     }
 
@@ -912,7 +1243,7 @@ void FileProtocol::copy(const QUrl &srcUrl, const QUrl &destUrl, int _mode, JobF
     destFile.flush(); // so the write() happens before futimes()
 
     // copy access and modification time
-    if (!wasKilled()) {
+    if (!wasCancelled()) {
 #if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD)
         // with nano secs precision
         struct timespec ut[2];
@@ -934,14 +1265,18 @@ void FileProtocol::copy(const QUrl &srcUrl, const QUrl &destUrl, int _mode, JobF
         }
     }
 
+    if (sourceHash && !wasCancelled()) {
+        ::fsync(destFile.handle()); // for hashFromDisk()
+    }
+
     destFile.close();
 
-    if (wasKilled()) {
-        qCDebug(KIO_FILE) << "Clean dest file after ioslave was killed:" << dest;
+    if (wasCancelled()) {
+        qCDebug(KIO_FILE) << "Clean dest file after copy was cancelled:" << dest;
         if (!QFile::remove(dest)) { // don't keep partly copied file
             execWithElevatedPrivilege(DEL, {_dest}, errno);
         }
-        error(KIO::ERR_USER_CANCELED, dest);
+        error(cancellationError(), dest);
         return;
     }
 
@@ -955,6 +1290,25 @@ void FileProtocol::copy(const QUrl &srcUrl, const QUrl &destUrl, int _mode, JobF
         return;
     }
 
+    if (sourceHash) {
+        QCryptographicHash destHash(s_verifyAlgorithm);
+        const bool read = hashFromDisk(_dest, &destHash);
+        if (!read || destHash.result() != sourceHash->result()) {
+            if (read) {
+                qCWarning(KIO_FILE) << "The copy of" << src << "differs from it:" << dest;
+                error(KIO::ERR_COPY_VERIFICATION_FAILED, destUrl.toLocalFile());
+            } else {
+                error(KIO::ERR_CANNOT_READ, dest);
+            }
+
+            if (!QFile::remove(dest)) { // don't keep a bad copy
+                execWithElevatedPrivilege(DEL, {_dest}, errno);
+            }
+            return;
+        }
+        setMetaData(QStringLiteral("verified"), QStringLiteral("true"));
+    }
+
 #if HAVE_POSIX_ACL
     // If no special mode is given, preserve the ACL attributes from the source file
     if (_mode == -1) {
@@ -992,6 +1346,355 @@ void FileProtocol::copy(const QUrl &srcUrl, const QUrl &destUrl, int _mode, JobF
     finished();
 }
 
+#if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD)
+namespace
+{
+// An entry below the top directory given to copyTree()
+struct TreeEntry {
+    QByteArray path; // relative to the top directory
+    struct stat buff;
+};
+}
+
+// Lists what's in the directory dirFd, which this takes over, and below it in entries, parents
+// before their children. Returns false when something has to be left to CopyJob, because it
+// can't be read or isn't a file, a directory or a symlink.
+static bool collectTree(int dirFd, const QByteArray &dirPath, std::vector<TreeEntry> &entries)
+{
+    DIR *dir = ::fdopendir(dirFd);
+    if (!dir) {
+        ::close(dirFd);
+        return false;
+    }
+
+    bool ok = true;
+    errno = 0;
+    while (const struct dirent *ent = ::readdir(dir)) {
+        if (qstrcmp(ent->d_name, ".") == 0 || qstrcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+        TreeEntry entry;
+        entry.path = dirPath.isEmpty() ? QByteArray(ent->d_name) : dirPath + '/' + ent->d_name;
+        if (::fstatat(::dirfd(dir), ent->d_name, &entry.buff, AT_SYMLINK_NOFOLLOW) == -1) {
+            ok = false;
+            break;
+        }
+        const mode_t mode = entry.buff.st_mode;
+        if (!S_ISREG(mode) && !S_ISDIR(mode) && !S_ISLNK(mode)) {
+            ok = false;
+            break;
+        }
+        if (!S_ISLNK(mode) && ::faccessat(::dirfd(dir), ent->d_name, S_ISDIR(mode) ? R_OK | X_OK : R_OK, 0) == -1) {
+            ok = false;
+            break;
+        }
+        entries.push_back(entry);
+
+        if (S_ISDIR(mode)) {
+            const int subDirFd = ::openat(::dirfd(dir), ent->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (subDirFd == -1 || !collectTree(subDirFd, entry.path, entries)) {
+                ok = false;
+                break;
+            }
+        }
+        errno = 0;
+    }
+    if (ok && errno != 0) {
+        ok = false; // readdir failed
+    }
+
+    ::closedir(dir);
+    return ok;
+}
+
+bool FileProtocol::copyTreeFileData(int srcFd, int destFd, qint64 size, bool sparse, KIO::filesize_t *processed, QByteArray *buffer)
+{
+#ifdef FICLONE
+    if (::ioctl(destFd, FICLONE, srcFd) != -1) {
+        *processed += size;
+        processedSize(*processed);
+        return true;
+    }
+#endif
+
+    if (!sparse) {
+        preallocate(destFd, 0, size);
+    }
+
+    bool useCopyFileRange = true;
+    off_t offset = 0;
+    off_t dataEnd = sparse ? 0 : size; // end of the data extent being copied
+    while (offset < size) {
+        if (wasCancelled()) {
+            return false;
+        }
+#if HAVE_SEEK_HOLE
+        // like copy(), only the data of sparse files is copied, the holes stay holes
+        if (offset == dataEnd) {
+            off_t dataStart = ::lseek(srcFd, offset, SEEK_DATA);
+            if (dataStart == -1 && errno == ENXIO) {
+                dataStart = size; // only a hole is left
+            }
+            dataEnd = dataStart < size ? ::lseek(srcFd, dataStart, SEEK_HOLE) : size;
+            if (dataStart == -1 || dataEnd == -1) {
+                dataStart = offset; // not supported by the filesystem after all
+                dataEnd = size;
+            }
+            *processed += dataStart - offset;
+            offset = dataStart;
+            continue;
+        }
+#else
+        dataEnd = size;
+#endif
+
+        const size_t length = qMin<off_t>(dataEnd - offset, s_treeCopyChunkSize);
+        const ssize_t copiedBytes = copyFileRange(srcFd, destFd, offset, length, &useCopyFileRange, buffer);
+        if (copiedBytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (copiedBytes == 0) {
+            break; // the file shrank
+        }
+        offset += copiedBytes;
+        *processed += copiedBytes;
+        processedSize(*processed);
+    }
+
+    // nothing is written for a hole at the end, it only needs the right size
+    return !sparse || ::ftruncate(destFd, offset) == 0;
+}
+
+void FileProtocol::copyTree(const QUrl &srcUrl, const QUrl &destUrl, bool keepPermissions)
+{
+    const QString src = srcUrl.toLocalFile();
+    const QString dest = destUrl.adjusted(QUrl::StripTrailingSlash).toLocalFile();
+    const QByteArray _src(QFile::encodeName(src));
+    const QByteArray _dest(QFile::encodeName(dest));
+    const QByteArray _destParent(QFile::encodeName(destUrl.adjusted(QUrl::StripTrailingSlash | QUrl::RemoveFilename).toLocalFile()));
+    qCDebug(KIO_FILE) << "copyTree()" << src << "to" << dest << "keepPermissions=" << keepPermissions;
+
+    // Anything that might need a question to the user or more than one try is left to CopyJob,
+    // it copies the tree one entry at a time when this fails before copying anything.
+    const int srcRootFd = ::open(_src.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    QT_STATBUF buffSrc;
+    QT_STATBUF buffDest;
+    QT_STATBUF buffDestParent;
+    if (srcRootFd == -1 //
+        || QT_FSTAT(srcRootFd, &buffSrc) == -1 //
+        || QT_STAT(_destParent.constData(), &buffDestParent) == -1 //
+        || buffSrc.st_dev != buffDestParent.st_dev // the data is shared or copied in the kernel within a filesystem
+        || QT_LSTAT(_dest.constData(), &buffDest) != -1 // nothing to ask about below a new directory
+        || (dest + QLatin1Char('/')).startsWith(src + QLatin1Char('/'))) {
+        if (srcRootFd != -1) {
+            ::close(srcRootFd);
+        }
+        error(KIO::ERR_UNSUPPORTED_ACTION, src);
+        return;
+    }
+
+    std::vector<TreeEntry> entries;
+    if (!collectTree(::openat(srcRootFd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC), QByteArray(), entries)) {
+        ::close(srcRootFd);
+        error(KIO::ERR_UNSUPPORTED_ACTION, src);
+        return;
+    }
+
+    KIO::filesize_t total = 0;
+    for (const TreeEntry &entry : entries) {
+        if (S_ISREG(entry.buff.st_mode)) {
+            total += entry.buff.st_size;
+        }
+    }
+    totalSize(total);
+
+    // Like CopyJob, directories get the default permissions and keep their modification time
+    if (::mkdir(_dest.constData(), 0777) == -1) {
+        ::close(srcRootFd);
+        error(KIO::ERR_UNSUPPORTED_ACTION, src);
+        return;
+    }
+    const int destRootFd = ::open(_dest.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (destRootFd == -1) {
+        ::rmdir(_dest.constData());
+        ::close(srcRootFd);
+        error(KIO::ERR_UNSUPPORTED_ACTION, src);
+        return;
+    }
+
+    // What has been created, for CopyJob to tell about it: the type (0 for a directory,
+    // 1 for a file, 2 for a symlink), the path relative to dest, the modification time
+    // and the target of symlinks
+    QByteArray copied;
+    QDataStream copiedStream(&copied, QIODevice::WriteOnly);
+    int copiedCount = 0;
+    auto addCopied = [&](qint8 type, const QByteArray &path, qint64 mtime, const QByteArray &linkTarget) {
+        copiedStream << type << QFile::decodeName(path) << mtime << QFile::decodeName(linkTarget);
+        if (++copiedCount % s_treeCopyReportCount == 0) {
+            data(copied);
+            copied.clear();
+            copiedStream.device()->seek(0);
+        }
+    };
+    auto sendCopied = [&]() {
+        if (!copied.isEmpty()) {
+            data(copied);
+            copied.clear();
+            copiedStream.device()->seek(0);
+        }
+    };
+    auto fail = [&](int errorCode, const QByteArray &path) {
+        const int savedErrno = errno;
+        sendCopied();
+        ::close(srcRootFd);
+        ::close(destRootFd);
+        const QString failedPath = dest + QLatin1Char('/') + QFile::decodeName(path);
+        if (errorCode == KIO::ERR_WORKER_DEFINED) {
+            error(errorCode, i18n("Cannot copy file from %1 to %2. (Errno: %3)", src + QLatin1Char('/') + QFile::decodeName(path), failedPath, savedErrno));
+        } else {
+            error(errorCode, failedPath);
+        }
+    };
+
+    addCopied(0, QByteArray(), buffSrc.st_mtime, QByteArray());
+
+    KIO::filesize_t processed = 0;
+    QByteArray buffer;
+    for (const TreeEntry &entry : entries) {
+        const char *path = entry.path.constData();
+        const struct stat &buff = entry.buff;
+        if (wasCancelled()) {
+            sendCopied();
+            ::close(srcRootFd);
+            ::close(destRootFd);
+            error(cancellationError(), dest);
+            return;
+        }
+
+        if (S_ISDIR(buff.st_mode)) {
+            if (::mkdirat(destRootFd, path, 0777) == -1) {
+                fail(errno == ENOSPC ? KIO::ERR_DISK_FULL : KIO::ERR_CANNOT_MKDIR, entry.path);
+                return;
+            }
+            addCopied(0, entry.path, buff.st_mtime, QByteArray());
+            continue;
+        }
+
+        if (S_ISLNK(buff.st_mode)) {
+            char target[PATH_MAX];
+            const ssize_t targetLength = ::readlinkat(srcRootFd, path, target, sizeof(target));
+            if (targetLength <= 0 || targetLength == ssize_t(sizeof(target))) {
+                fail(KIO::ERR_CANNOT_READ, entry.path);
+                return;
+            }
+            const QByteArray linkTarget(target, targetLength);
+            if (::symlinkat(linkTarget.constData(), destRootFd, path) == -1) {
+                fail(errno == ENOSPC ? KIO::ERR_DISK_FULL : KIO::ERR_CANNOT_SYMLINK, entry.path);
+                return;
+            }
+            addCopied(2, entry.path, buff.st_mtime, linkTarget);
+            continue;
+        }
+
+        const int srcFd = ::openat(srcRootFd, path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+        if (srcFd == -1) {
+            fail(KIO::ERR_CANNOT_OPEN_FOR_READING, entry.path);
+            return;
+        }
+        // the umask applies unless the permissions are copied below, don't expose the data until then
+        const mode_t createMode = keepPermissions ? S_IRUSR | S_IWUSR : 0666;
+        const int destFd = ::openat(destRootFd, path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, createMode);
+        if (destFd == -1) {
+            ::close(srcFd);
+            fail(errno == ENOSPC ? KIO::ERR_DISK_FULL : KIO::ERR_CANNOT_OPEN_FOR_WRITING, entry.path);
+            return;
+        }
+#if HAVE_FADVISE
+        posix_fadvise(srcFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+        const bool sparse = buff.st_blocks * 512 < buff.st_size;
+        bool written = copyTreeFileData(srcFd, destFd, buff.st_size, sparse, &processed, &buffer);
+        const int copyErrno = errno;
+
+        if (written) {
+#if HAVE_SYS_XATTR_H || HAVE_SYS_EXTATTR_H
+            if (!copyXattrs(srcFd, destFd)) {
+                qCDebug(KIO_FILE) << "can't copy Extended attributes";
+            }
+#endif
+            // the same attributes as copy() with the permissions CopyJob would give it
+            if (keepPermissions) {
+                if (::fchmod(destFd, buff.st_mode & 07777) == -1) {
+                    qCWarning(KIO_FILE) << "Could not change permissions for" << dest << path;
+                }
+                if (::fchown(destFd, -1 /*keep user*/, buff.st_gid) == 0) {
+                    (void)::fchown(destFd, buff.st_uid, -1 /*keep group*/);
+                }
+            } else {
+#if HAVE_POSIX_ACL
+                acl_t acl = acl_get_fd(srcFd);
+                if (acl) {
+                    if (acl_set_fd(destFd, acl) != 0) {
+                        qCWarning(KIO_FILE) << "Could not set ACL permissions for" << dest << path;
+                    }
+                    acl_free(acl);
+                }
+#endif
+            }
+            const struct timespec times[2] = {buff.st_atim, buff.st_mtim};
+            if (::futimens(destFd, times) != 0) {
+                qCWarning(KIO_FILE) << "Couldn't preserve access and modification time for" << dest << path;
+            }
+        }
+        ::close(srcFd);
+        if (::close(destFd) == -1 && written) {
+            written = false;
+        }
+
+        if (!written) {
+            ::unlinkat(destRootFd, path, 0); // don't keep partly copied file
+            if (wasCancelled()) {
+                sendCopied();
+                ::close(srcRootFd);
+                ::close(destRootFd);
+                error(cancellationError(), dest);
+                return;
+            }
+            errno = copyErrno;
+            fail(copyErrno == ENOSPC ? KIO::ERR_DISK_FULL : KIO::ERR_WORKER_DEFINED, entry.path);
+            return;
+        }
+        addCopied(1, entry.path, buff.st_mtime, QByteArray());
+    }
+
+    // The directories were modified by what was created in them
+    for (auto it = entries.crbegin(); it != entries.crend(); ++it) {
+        if (S_ISDIR(it->buff.st_mode)) {
+            const struct timespec times[2] = {{0, UTIME_OMIT}, it->buff.st_mtim};
+            ::utimensat(destRootFd, it->path.constData(), times, 0);
+        }
+    }
+    const struct timespec times[2] = {{0, UTIME_OMIT}, buffSrc.st_mtim};
+    ::futimens(destRootFd, times);
+
+    ::close(srcRootFd);
+    ::close(destRootFd);
+    sendCopied();
+    processedSize(total);
+    finished();
+}
+#else
+void FileProtocol::copyTree(const QUrl &srcUrl, const QUrl &, bool)
+{
+    // CopyJob copies the tree one entry at a time
+    error(KIO::ERR_UNSUPPORTED_ACTION, srcUrl.toLocalFile());
+}
+#endif
+
 static bool isLocalFileSameHost(const QUrl &url)
 {
     if (!url.isLocalFile()) {
@@ -310,6 +310,12 @@ void FileProtocol::del(const QUrl &url, bool isfile)
     finished();
 }
 
+void FileProtocol::copyTree(const QUrl &src, const QUrl &, bool)
+{
+    // CopyJob copies the tree one entry at a time
+    error(KIO::ERR_UNSUPPORTED_ACTION, src.toLocalFile());
+}
+
 void FileProtocol::chown(const QUrl &url, const QString &, const QString &)
 {
     error(KIO::ERR_CANNOT_CHOWN, url.toLocalFile());
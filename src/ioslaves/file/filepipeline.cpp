@@ -0,0 +1,214 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "filepipeline_p.h"
+
+#include <QMutexLocker>
+#include <QThread>
+
+FileReadAhead::FileReadAhead(QFileDevice *file, qint64 size, int blockSize, int depth)
+    : m_file(file)
+    , m_depth(qMax(0, depth))
+    , m_blockSize(blockSize)
+{
+    // not worth a thread when the rest of the file is read in one go
+    if (m_depth > 0 && size > blockSize) {
+        m_thread.reset(QThread::create([this]() {
+            run();
+        }));
+        m_thread->start();
+    }
+}
+
+FileReadAhead::~FileReadAhead()
+{
+    if (m_thread) {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_stopping = true;
+            m_changed.wakeAll();
+        }
+        // at most the read of one block to wait for
+        m_thread->wait();
+    }
+}
+
+void FileReadAhead::setBlockSize(int blockSize)
+{
+    QMutexLocker locker(&m_mutex);
+    m_blockSize = blockSize;
+}
+
+bool FileReadAhead::next(QByteArray *block)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_thread) {
+        if (!m_freeBlocks.isEmpty()) {
+            *block = m_freeBlocks.takeLast();
+        }
+        const qint64 n = readBlock(block, m_blockSize);
+        if (n == 0) {
+            block->clear();
+        }
+        return n != -1;
+    }
+
+    while (m_blocks.isEmpty() && !m_atEnd && !m_failed) {
+        m_changed.wait(&m_mutex);
+    }
+    if (!m_blocks.isEmpty()) {
+        *block = m_blocks.takeFirst();
+        m_changed.wakeAll(); // room for another block
+        return true;
+    }
+    block->clear();
+    return !m_failed;
+}
+
+void FileReadAhead::recycle(QByteArray &&block)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_freeBlocks.size() <= m_depth) {
+        m_freeBlocks.append(std::move(block));
+    }
+}
+
+void FileReadAhead::run()
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_stopping && !m_atEnd && !m_failed) {
+        if (m_blocks.size() >= m_depth) {
+            m_changed.wait(&m_mutex);
+            continue;
+        }
+        QByteArray block = m_freeBlocks.isEmpty() ? QByteArray() : m_freeBlocks.takeLast();
+        const int blockSize = m_blockSize;
+
+        locker.unlock();
+        const qint64 n = readBlock(&block, blockSize);
+        locker.relock();
+
+        if (n == -1) {
+            m_failed = true;
+        } else if (n == 0) {
+            m_atEnd = true;
+        } else {
+            m_blocks.append(std::move(block));
+        }
+        m_changed.wakeAll();
+    }
+}
+
+qint64 FileReadAhead::readBlock(QByteArray *block, int blockSize)
+{
+    // doesn't give memory back when shrinking, a recycled block is usually big enough
+    block->resize(blockSize);
+    const qint64 n = m_file->read(block->data(), blockSize);
+    if (n > 0) {
+        block->resize(n);
+    }
+    return n;
+}
+
+FileWriteBehind::FileWriteBehind(QFileDevice *file, int depth)
+    : m_file(file)
+    , m_depth(qMax(0, depth))
+{
+}
+
+FileWriteBehind::~FileWriteBehind()
+{
+    if (m_thread) {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_stopping = true;
+            m_blocks.clear();
+            m_changed.wakeAll();
+        }
+        m_thread->wait();
+    }
+}
+
+bool FileWriteBehind::write(const QByteArray &block)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_failed) {
+        return false;
+    }
+    if (block.isEmpty()) {
+        return true;
+    }
+    // Data that comes in one block is written without a thread, it's only
+    // started once there is more
+    if (!m_thread && (m_depth == 0 || !m_wroteBlock)) {
+        m_wroteBlock = true;
+        if (m_file->write(block) != block.size()) {
+            m_failed = true;
+            m_error = m_file->error();
+        }
+        return !m_failed;
+    }
+    if (!m_thread) {
+        m_thread.reset(QThread::create([this]() {
+            run();
+        }));
+        m_thread->start();
+    }
+
+    while (m_blocks.size() >= m_depth && !m_failed) {
+        m_changed.wait(&m_mutex);
+    }
+    if (m_failed) {
+        return false;
+    }
+    m_blocks.append(block);
+    m_changed.wakeAll();
+    return true;
+}
+
+bool FileWriteBehind::finish()
+{
+    QMutexLocker locker(&m_mutex);
+    while ((!m_blocks.isEmpty() || m_writing) && !m_failed) {
+        m_changed.wait(&m_mutex);
+    }
+    // the thread is idle now
+    if (!m_failed && !m_file->flush()) {
+        m_failed = true;
+        m_error = m_file->error();
+    }
+    return !m_failed;
+}
+
+QFileDevice::FileError FileWriteBehind::error() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_error;
+}
+
+void FileWriteBehind::run()
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_stopping && !m_failed) {
+        if (m_blocks.isEmpty()) {
+            m_changed.wait(&m_mutex);
+            continue;
+        }
+        const QByteArray block = m_blocks.takeFirst();
+        m_writing = true;
+
+        locker.unlock();
+        const bool written = m_file->write(block) == block.size();
+        locker.relock();
+
+        m_writing = false;
+        if (!written) {
+            m_failed = true;
+            m_error = m_file->error();
+        }
+        m_changed.wakeAll();
+    }
+}
@@ -0,0 +1,118 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef FILEPIPELINE_P_H
+#define FILEPIPELINE_P_H
+
+#include <QByteArray>
+#include <QFileDevice>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <memory>
+
+class QThread;
+
+/**
+ * Reads a file in a thread of its own, up to @p depth blocks ahead of the caller,
+ * so that reading the next block overlaps with sending or writing the current one.
+ * With a depth of 0, or when the rest of the file fits into one block, next() reads
+ * synchronously. @p size is the number of bytes left to read from the current
+ * position of the file descriptor; the position of @p file may not know about reads
+ * and seeks done on the descriptor.
+ *
+ * The file must not be used by anybody else while this exists.
+ */
+class FileReadAhead
+{
+public:
+    FileReadAhead(QFileDevice *file, qint64 size, int blockSize, int depth);
+    ~FileReadAhead();
+
+    /**
+     * Sets the size of the blocks read from now on.
+     */
+    void setBlockSize(int blockSize);
+
+    /**
+     * Takes the next block of the file, which is empty at the end of the file.
+     * @return false if reading failed, see the error of the file
+     */
+    bool next(QByteArray *block);
+
+    /**
+     * Hands back a block from next() once it has been used, to read into it again
+     * instead of allocating another one.
+     */
+    void recycle(QByteArray &&block);
+
+private:
+    void run();
+    qint64 readBlock(QByteArray *block, int blockSize);
+
+    QFileDevice *const m_file;
+    const int m_depth;
+    int m_blockSize;
+
+    QMutex m_mutex;
+    QWaitCondition m_changed;
+    QList<QByteArray> m_blocks; // read, but not taken yet
+    QList<QByteArray> m_freeBlocks;
+    bool m_atEnd = false;
+    bool m_failed = false;
+    bool m_stopping = false;
+    std::unique_ptr<QThread> m_thread;
+};
+
+/**
+ * Writes to a file in a thread of its own, so that the caller can go on with the next
+ * block while up to @p depth blocks wait to be written. With a depth of 0, write()
+ * writes synchronously, as it does for the first block: the thread is only started
+ * for the second one.
+ *
+ * The first failing write stops the writing, write() and finish() return false from
+ * then on and error() tells why. The file must not be used by anybody else while
+ * this exists, unwritten blocks are dropped when it's deleted before finish().
+ */
+class FileWriteBehind
+{
+public:
+    FileWriteBehind(QFileDevice *file, int depth);
+    ~FileWriteBehind();
+
+    /**
+     * Queues a block to be written, waiting while @p depth blocks are queued.
+     * @return false if writing failed
+     */
+    bool write(const QByteArray &block);
+
+    /**
+     * Waits until all the blocks are written and flushed.
+     * @return false if writing failed
+     */
+    bool finish();
+
+    QFileDevice::FileError error() const;
+
+private:
+    void run();
+
+    QFileDevice *const m_file;
+    const int m_depth;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_changed;
+    QList<QByteArray> m_blocks; // not written yet
+    bool m_wroteBlock = false;
+    bool m_writing = false;
+    bool m_failed = false;
+    bool m_stopping = false;
+    QFileDevice::FileError m_error = QFileDevice::NoError;
+    std::unique_ptr<QThread> m_thread;
+};
+
+#endif
@@ -1903,6 +1903,11 @@ Result FtpInternal::ftpGet(int iCopyFile, const QString &sCopyFile, const QUrl &
     int iBufferCur = 0;
 
     while (m_size == UnknownSize || bytesLeft > 0) {
+        if (q->wasCancelled()) {
+            // ftpCloseCommand() in the caller drops the data connection
+            return Result::fail(q->cancellationError(), url.toString());
+        }
+
         // let the buffer size grow if the file is larger 64kByte ...
         if (processed_size - llOffset > 1024 * 64) {
             iBlockSize = maximumIpcSize;
@@ -2087,6 +2092,12 @@ Result FtpInternal::ftpPut(int iCopyFile, const QUrl &dest_url, int permissions,
             processed_size += result;
             q->processedSize(processed_size);
         }
+
+        // also covers readData() failing because the job was killed while waiting for data
+        if (result != 0 && q->wasCancelled()) {
+            writeError = q->cancellationError();
+            result = -1;
+        }
     } while (result > 0);
 
     if (result != 0) { // error
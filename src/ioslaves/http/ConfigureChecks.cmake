@@ -1,3 +1,6 @@
 include(CheckSymbolExists)
 
 check_symbol_exists(strtoll         "stdlib.h"                 HAVE_STRTOLL)
+check_symbol_exists(sendfile        "sys/sendfile.h"           HAVE_SENDFILE)
+
+set(HAVE_BROTLI ${LibBrotliDec_FOUND})
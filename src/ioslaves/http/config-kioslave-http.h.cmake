@@ -1,2 +1,4 @@
 #cmakedefine01 HAVE_STRTOLL
+#cmakedefine01 HAVE_SENDFILE
+#cmakedefine01 HAVE_BROTLI
 #define KDE_INSTALL_FULL_LIBEXECDIR_KF "${KDE_INSTALL_FULL_LIBEXECDIR_KF}"
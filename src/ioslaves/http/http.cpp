@@ -59,7 +59,16 @@
 
 #include <sys/stat.h>
 
+#if HAVE_SENDFILE
+#include <cerrno>
+#include <poll.h>
+#include <sys/sendfile.h>
+#endif
+
 #include "httpauthentication.h"
+#include "httpcachestore.h"
+#include "httpmemorycache.h"
+#include "httprangecache.h"
 #include "kioglobal_p.h"
 
 #include <QLoggingCategory>
@@ -88,6 +97,10 @@ static bool supportedProxyScheme(const QString &scheme)
 static const int s_hashedUrlBits = 160; // this number should always be divisible by eight
 static const int s_hashedUrlNibbles = s_hashedUrlBits / 4;
 static const int s_MaxInMemPostBufSize = 256 * 1024; // Write anything over 256 KB to file...
+static const qint64 s_fileBodyChunkSize = 1024 * 1024; // Send a file's content in 1 MB pieces
+
+static QByteArray cacheKeyFromUrl(const QUrl &url);
+static QUrl storableUrl(const QUrl &url);
 
 using namespace KIO;
 
@@ -176,6 +189,19 @@ static QString sanitizeCustomHTTPHeader(const QString &_header)
     return sanitizedHeaders;
 }
 
+// the content codings that our filters can decode
+static QString acceptEncodingHeaderValue()
+{
+    QString ret = QStringLiteral("gzip, deflate, x-gzip, x-deflate");
+#if HAVE_BROTLI
+    ret += QLatin1String(", br");
+#endif
+    if (HTTPFilterZstd::isSupported()) {
+        ret += QLatin1String(", zstd");
+    }
+    return ret;
+}
+
 static bool isPotentialSpoofingAttack(const HTTPProtocol::HTTPRequest &request, const KConfigGroup *config)
 {
     qCDebug(KIO_HTTP) << request.url << "response code: " << request.responseCode << "previous response code:" << request.prevResponseCode;
@@ -266,6 +292,7 @@ static QIODevice *createPostBufferDeviceFor(KIO::filesize_t size)
     }
 
     if (!device->open(QIODevice::ReadWrite)) {
+        delete device;
         return nullptr;
     }
 
@@ -345,6 +372,10 @@ static void changeProtocolToHttp(QUrl *url)
 
 #define NO_SIZE ((KIO::filesize_t)-1)
 
+// bounds of the adaptive read-ahead of open() / read()
+static const KIO::filesize_t s_fileJobMinBlockSize = 64 * 1024;
+static const KIO::filesize_t s_fileJobMaxBlockSize = 4 * 1024 * 1024;
+
 #if HAVE_STRTOLL
 #define STRTOLL strtoll
 #else
@@ -358,9 +389,14 @@ HTTPProtocol::HTTPProtocol(const QByteArray &protocol, const QByteArray &pool, c
     , m_iSize(NO_SIZE)
     , m_iPostDataSize(NO_SIZE)
     , m_isBusy(false)
+    , m_isPipelinedResponse(false)
     , m_POSTbuf(nullptr)
+    , m_POSTbufIncomplete(false)
     , m_maxCacheAge(DEFAULT_MAX_CACHE_AGE)
     , m_maxCacheSize(DEFAULT_MAX_CACHE_SIZE)
+    , m_cacheStore(nullptr)
+    , m_memoryCache(nullptr)
+    , m_rangeCache(nullptr)
     , m_protocol(protocol)
     , m_wwwAuth(nullptr)
     , m_triedWwwCredentials(NoCredentials)
@@ -380,6 +416,13 @@ HTTPProtocol::HTTPProtocol(const QByteArray &protocol, const QByteArray &pool, c
 HTTPProtocol::~HTTPProtocol()
 {
     httpClose(false);
+    delete m_cacheStore;
+    if (m_memoryCache) {
+        const HTTPMemoryCache::Statistics stats = m_memoryCache->statistics();
+        qCDebug(KIO_HTTP) << "Memory cache hits:" << stats.hits << "misses:" << stats.misses << "free:" << stats.freeSize << "of" << stats.totalSize;
+        delete m_memoryCache;
+    }
+    delete m_rangeCache;
 }
 
 void HTTPProtocol::reparseConfiguration()
@@ -440,6 +483,33 @@ void HTTPProtocol::resetSessionSettings()
     m_request.doNotWWWAuthenticate = configValue(QStringLiteral("no-www-auth"), noAuth);
     m_request.doNotProxyAuthenticate = configValue(QStringLiteral("no-proxy-auth"), noAuth);
     m_strCacheDir = config()->readPathEntry(QStringLiteral("CacheDir"), QString());
+    if (configValue(QStringLiteral("UseCacheStore"), false)) {
+        if (!m_cacheStore || m_cacheStore->cacheDir() != m_strCacheDir) {
+            delete m_cacheStore;
+            m_cacheStore = new HTTPCacheStore(m_strCacheDir);
+        }
+        // retried with every request if it fails, the cache directory may become writable
+        if (!m_cacheStore->open()) {
+            qCDebug(KIO_HTTP) << "Could not open the cache store in" << m_strCacheDir << ", not caching.";
+            m_request.cacheTag.useCache = false;
+        }
+    } else {
+        delete m_cacheStore;
+        m_cacheStore = nullptr;
+    }
+    if (configValue(QStringLiteral("UseMemoryCache"), false)) {
+        const uint maxEntrySize = configValue(QStringLiteral("MemoryCacheMaxEntrySize"), DEFAULT_MEMORY_CACHE_MAX_ENTRY_SIZE) * 1024;
+        if (!m_memoryCache || m_memoryCache->maxEntrySize() != maxEntrySize) {
+            delete m_memoryCache;
+            m_memoryCache = new HTTPMemoryCache(configValue(QStringLiteral("MemoryCacheSize"), DEFAULT_MEMORY_CACHE_SIZE) * 1024, maxEntrySize);
+        }
+    } else {
+        delete m_memoryCache;
+        m_memoryCache = nullptr;
+    }
+    // cheap to create, it only opens files for range requests
+    delete m_rangeCache;
+    m_rangeCache = configValue(QStringLiteral("UseRangeCache"), false) ? new HTTPRangeCache(m_strCacheDir) : nullptr;
     m_maxCacheAge = configValue(QStringLiteral("MaxCacheAge"), DEFAULT_MAX_CACHE_AGE);
     m_request.windowId = configValue(QStringLiteral("window-id"));
 
@@ -500,6 +570,10 @@ void HTTPProtocol::resetSessionSettings()
     } else {
         m_request.endoffset = 0;
     }
+    m_rangeRequest = RangeCacheRequest();
+    m_rangeRequest.offset = m_request.offset;
+    m_rangeRequest.endoffset = m_request.endoffset;
+    m_fileJob = FileJobState();
 
     m_request.disablePassDialog = configValue(QStringLiteral("DisablePassDlg"), false);
     m_request.allowTransferCompression = configValue(QStringLiteral("AllowCompressedPage"), true);
@@ -1266,9 +1340,171 @@ void HTTPProtocol::get(const QUrl &url)
         m_request.cacheTag.policy = DEFAULT_CACHE_CONTROL;
     }
 
+    if (satisfyRangeFromCache()) {
+        return;
+    }
     proceedUntilResponseContent();
 }
 
+void HTTPProtocol::open(const QUrl &url, QIODevice::OpenMode mode)
+{
+    qCDebug(KIO_HTTP) << url << mode;
+
+    if (mode & (QIODevice::WriteOnly | QIODevice::Append | QIODevice::Truncate)) {
+        error(ERR_CANNOT_OPEN_FOR_WRITING, url.toDisplayString());
+        return;
+    }
+    if (!maybeSetRequestUrl(url)) {
+        return;
+    }
+    resetSessionSettings();
+
+    // ranges are of the bytes as the server stores them, caches and error pages don't fit in
+    m_request.cacheTag.useCache = false;
+    m_request.allowTransferCompression = false;
+    m_request.preferErrorPage = false;
+
+    m_fileJob.isActive = true;
+    m_fileJob.blockSize = s_fileJobMinBlockSize;
+    if (!fileJobFetch(0, m_fileJob.blockSize)) {
+        return;
+    }
+    if (m_isRedirection) {
+        // the job was told where to open instead
+        m_fileJob = FileJobState();
+        httpClose(m_request.isKeepAlive);
+        finished();
+        return;
+    }
+    if (m_mimeType.isEmpty()) {
+        mimeType(QString::fromLatin1(DEFAULT_MIME_TYPE));
+    }
+
+    m_fileJob.isOpen = true;
+    if (m_fileJob.size != NO_SIZE) {
+        totalSize(m_fileJob.size);
+    }
+    position(0);
+    opened();
+}
+
+void HTTPProtocol::read(KIO::filesize_t bytes)
+{
+    Q_ASSERT(m_fileJob.isOpen);
+
+    KIO::filesize_t pos = m_fileJob.position;
+    if (m_fileJob.size != NO_SIZE) {
+        bytes = pos < m_fileJob.size ? qMin(bytes, m_fileJob.size - pos) : 0;
+    }
+
+    QByteArray ret;
+    while (KIO::filesize_t(ret.size()) < bytes) {
+        const KIO::filesize_t bufferEnd = m_fileJob.bufferStart + m_fileJob.buffer.size();
+        if (pos < m_fileJob.bufferStart || pos >= bufferEnd) {
+            // Reading on where the buffer ends is sequential access, read ahead more and more.
+            // Anything else looks like random access, where reading ahead is mostly wasted.
+            if (pos == bufferEnd) {
+                m_fileJob.blockSize = qMin(m_fileJob.blockSize * 2, s_fileJobMaxBlockSize);
+            } else {
+                m_fileJob.blockSize = s_fileJobMinBlockSize;
+            }
+            KIO::filesize_t length = qMax(bytes - ret.size(), m_fileJob.blockSize);
+            if (m_fileJob.size != NO_SIZE) {
+                length = qMin(length, m_fileJob.size - pos);
+            }
+            if (!fileJobFetch(pos, length)) {
+                return;
+            }
+            if (m_fileJob.buffer.isEmpty()) {
+                break;
+            }
+            if (KIO::filesize_t(m_fileJob.buffer.size()) < length && m_fileJob.size == NO_SIZE) {
+                // a short range is the end of a resource of unknown size
+                m_fileJob.size = pos + m_fileJob.buffer.size();
+            }
+            continue;
+        }
+        const int available = qMin(bufferEnd - pos, bytes - ret.size());
+        ret.append(m_fileJob.buffer.constData() + (pos - m_fileJob.bufferStart), available);
+        pos += available;
+    }
+
+    m_fileJob.position = pos;
+    data(ret);
+}
+
+void HTTPProtocol::seek(KIO::filesize_t offset)
+{
+    Q_ASSERT(m_fileJob.isOpen);
+
+    if (m_fileJob.size != NO_SIZE && offset > m_fileJob.size) {
+        error(ERR_CANNOT_SEEK, m_request.url.toDisplayString());
+        return;
+    }
+    // nothing to do before the next read, which may well be served from the buffer
+    m_fileJob.position = offset;
+    position(offset);
+}
+
+void HTTPProtocol::close()
+{
+    qCDebug(KIO_HTTP) << m_request.url;
+
+    m_fileJob = FileJobState();
+    httpClose(m_request.isKeepAlive);
+    finished();
+}
+
+bool HTTPProtocol::fileJobFetch(KIO::filesize_t offset, KIO::filesize_t length)
+{
+    qCDebug(KIO_HTTP) << "Requesting" << length << "bytes at" << offset << "of" << m_request.url;
+
+    m_request.method = HTTP_GET;
+    m_request.offset = offset;
+    m_request.endoffset = offset + length - 1;
+    m_iEOFRetryCount = 0;
+    if (!proceedUntilResponseHeader() || m_kioError) {
+        // errors are reported by now
+        return false;
+    }
+    if (m_isRedirection) {
+        if (m_fileJob.isOpen) {
+            m_request.isKeepAlive = false;
+            error(ERR_CANNOT_READ, m_request.url.toDisplayString());
+            return false;
+        }
+        return readBody(true);
+    }
+
+    // a server without range support may still send all of a small resource
+    const bool isComplete = m_request.responseCode == 200 && !m_fileJob.isOpen && m_iSize != NO_SIZE && m_iSize <= length;
+    const bool isRange = m_request.responseCode == 206 && m_fileJob.rangeFirst == qint64(offset);
+    if ((!isComplete && !isRange) || !m_contentEncodings.isEmpty()) {
+        // the body is useless, rather close the connection than read it
+        m_request.isKeepAlive = false;
+        if (!m_fileJob.isOpen) {
+            error(ERR_UNSUPPORTED_ACTION, i18n("The server does not support random access to %1.", m_request.url.toDisplayString()));
+        } else {
+            // most likely the resource changed since it was opened and If-Range got us all of it
+            error(ERR_CANNOT_READ, m_request.url.toDisplayString());
+        }
+        return false;
+    }
+
+    if (!readBody(true)) {
+        return false;
+    }
+    m_fileJob.bufferStart = offset;
+    m_fileJob.buffer.clear();
+    m_fileJob.buffer.swap(m_webDavDataBuf);
+    if (isComplete) {
+        m_fileJob.size = m_fileJob.buffer.size();
+    } else if (m_fileJob.rangeTotal >= 0) {
+        m_fileJob.size = m_fileJob.rangeTotal;
+    }
+    return true;
+}
+
 void HTTPProtocol::put(const QUrl &url, int, KIO::JobFlags flags)
 {
     qCDebug(KIO_HTTP) << url;
@@ -1974,34 +2210,80 @@ void HTTPProtocol::multiGet(const QByteArray &data)
     }
     if (!m_isBusy) {
         m_isBusy = true;
-        QMutableListIterator<HTTPRequest> it(m_requestQueue);
-        // send the requests
-        while (it.hasNext()) {
-            m_request = it.next();
-            sendQuery();
-            // save the request state so we can pick it up again in the collection phase
-            it.setValue(m_request);
-            qCDebug(KIO_HTTP) << "check one: isKeepAlive =" << m_request.isKeepAlive;
-            if (m_request.cacheTag.ioMode != ReadFromCache) {
-                m_server.initFrom(m_request);
+        const int pipelineDepth = qMax(1, configValue(QStringLiteral("PipelineDepth"), DEFAULT_PIPELINE_DEPTH));
+        const int count = m_requestQueue.count();
+        // Requests before sent have been written to the connection or were served from
+        // the cache, responses have been read for those before received. After the
+        // connection got lost, sent is rewound and the unanswered requests go out again.
+        int sent = 0;
+        int received = 0;
+        int highestSent = 0;
+        QVector<bool> pipelined(count, false);
+        while (received < count) {
+            // send the requests, as many ahead of the responses as the server takes
+            while (sent < count && (sent == received || (sent - received < pipelineDepth && canPipelineRequest(m_requestQueue.at(sent))))) {
+                if (sent < highestSent && m_requestQueue.at(sent).cacheTag.ioMode == ReadFromCache) {
+                    ++sent; // still good, it does not depend on the connection
+                    continue;
+                }
+                m_request = m_requestQueue.at(sent);
+                pipelined[sent] = false;
+                sendQuery();
+                if (!isConnected() && m_request.cacheTag.ioMode != ReadFromCache) {
+                    break; // the server closed the connection, the collection phase recovers
+                }
+                // save the request state so we can pick it up again in the collection phase
+                m_requestQueue[sent] = m_request;
+                qCDebug(KIO_HTTP) << "check one: isKeepAlive =" << m_request.isKeepAlive;
+                if (m_request.cacheTag.ioMode != ReadFromCache) {
+                    m_server.initFrom(m_request);
+                    pipelined[sent] = (sent != received);
+                }
+                ++sent;
+                highestSent = qMax(highestSent, sent);
             }
-        }
-        // collect the responses
-        //### for the moment we use a hack: instead of saving and restoring request-id
-        //    we just count up like ParallelGetJobs does.
-        int requestId = 0;
-        for (const HTTPRequest &r : std::as_const(m_requestQueue)) {
-            m_request = r;
+
+            // collect the responses
+            //### for the moment we use a hack: instead of saving and restoring request-id
+            //    we just count up like ParallelGetJobs does.
+            m_request = m_requestQueue.at(received);
             qCDebug(KIO_HTTP) << "check two: isKeepAlive =" << m_request.isKeepAlive;
-            setMetaData(QStringLiteral("request-id"), QString::number(requestId++));
+            setMetaData(QStringLiteral("request-id"), QString::number(received));
             sendAndKeepMetaData();
-            if (!(readResponseHeader() && readBody())) {
+            m_isPipelinedResponse = pipelined.at(received);
+            const bool haveHeader = readResponseHeader();
+            m_isPipelinedResponse = false;
+            if (!haveHeader) {
+                if (m_kioError) {
+                    return;
+                }
+                // The response got lost or the request needs another round, e.g. with credentials.
+                // Responses to later requests can't be told apart from that anymore, so start over
+                // on a new connection and do this request the way get() does it.
+                if (pipelined.at(received) && !isConnected()) {
+                    qCDebug(KIO_HTTP) << "Connection lost with pipelined requests in flight, not pipelining to" << m_request.url.host();
+                    m_pipeliningBrokenHosts.insert(m_request.url.host() + QLatin1Char(':') + QString::number(m_request.url.port(defaultPort())));
+                }
+                cacheFileClose();
+                httpCloseConnection();
+                m_request.isKeepAlive = true;
+                if (!proceedUntilResponseHeader()) {
+                    return;
+                }
+                sent = received + 1;
+            }
+            if (!readBody()) {
                 return;
             }
             // the "next job" signal for ParallelGetJob is data of size zero which
             // readBody() sends without our intervention.
             qCDebug(KIO_HTTP) << "check three: isKeepAlive =" << m_request.isKeepAlive;
             httpClose(m_request.isKeepAlive); // actually keep-alive is mandatory for pipelining
+            ++received;
+            if (!isConnected() && sent > received) {
+                // the server announced closing the connection, repeat what it didn't answer
+                sent = received;
+            }
         }
 
         finished();
@@ -2159,6 +2441,28 @@ bool HTTPProtocol::httpShouldCloseConnection()
     return !isCompatibleNextUrl(m_server.url, m_request.url);
 }
 
+bool HTTPProtocol::canPipelineRequest(const HTTPRequest &request) const
+{
+    // Only safe methods may be pipelined (RFC 7230, section 6.3.2), anything else
+    // waits for the previous response. The server must have answered on this
+    // connection with HTTP/1.1 already; proxies are left alone.
+    switch (request.method) {
+    case HTTP_GET:
+    case HTTP_HEAD:
+    case HTTP_OPTIONS:
+    case DAV_PROPFIND:
+    case DAV_REPORT:
+        break;
+    default:
+        return false;
+    }
+
+    if (!isConnected() || m_server.httpRev != HTTP_11 || !m_server.proxyUrl.isEmpty() || !isCompatibleNextUrl(m_server.url, request.url)) {
+        return false;
+    }
+    return !m_pipeliningBrokenHosts.contains(request.url.host() + QLatin1Char(':') + QString::number(request.url.port(defaultPort())));
+}
+
 bool HTTPProtocol::httpOpenConnection()
 {
     qCDebug(KIO_HTTP);
@@ -2253,7 +2557,9 @@ bool HTTPProtocol::httpOpenConnection()
     }
 
     if (connectError != 0) {
-        error(connectError, errorString);
+        if (!openStaleCacheEntry()) {
+            error(connectError, errorString);
+        }
         return false;
     }
 
@@ -2307,6 +2613,140 @@ bool HTTPProtocol::satisfyRequestFromCache(bool *cacheHasPage)
     return false;
 }
 
+bool HTTPProtocol::useStaleCacheEntry()
+{
+    CacheTag &cacheTag = m_request.cacheTag;
+    if (cacheTag.ioMode != ReadFromCache || !cacheTag.file || !cacheTag.isWithinStaleWindow(m_maxCacheAge, cacheTag.staleIfError)) {
+        return false;
+    }
+    qCDebug(KIO_HTTP) << "Validation failed, using the stale cache entry of" << m_request.url;
+    cacheTag.useStale = true;
+    return true;
+}
+
+bool HTTPProtocol::openStaleCacheEntry()
+{
+    CacheTag &cacheTag = m_request.cacheTag;
+    if (cacheTag.file) {
+        // already open for validation
+        return useStaleCacheEntry();
+    }
+    if (m_request.method != HTTP_GET || !cacheTag.useCache || cacheTag.policy == KIO::CC_Reload) {
+        return false;
+    }
+    // sendQuery() connects before it looks into the cache, forget the previous request's entry
+    cacheTag.servedDate = QDateTime();
+    cacheTag.lastModifiedDate = QDateTime();
+    cacheTag.expireDate = QDateTime();
+    cacheTag.staleWhileRevalidate = 0;
+    cacheTag.staleIfError = 0;
+    if (!cacheFileOpenRead()) {
+        return false;
+    }
+    cacheTag.ioMode = ReadFromCache;
+    if (!useStaleCacheEntry()) {
+        cacheFileClose();
+        cacheTag.ioMode = NoCache;
+        return false;
+    }
+    return true;
+}
+
+bool HTTPProtocol::satisfyRangeFromCache()
+{
+    if (!m_rangeCache || !m_request.cacheTag.useCache || (!m_request.offset && !m_request.endoffset)) {
+        return false;
+    }
+    // fails if another worker is using the entry, then this request does without it
+    if (!m_rangeCache->open(cacheKeyFromUrl(m_request.url), true)) {
+        return false;
+    }
+    m_rangeRequest.active = true;
+    if (m_request.cacheTag.policy == KIO::CC_Reload || !m_rangeCache->validator().isValid()) {
+        return false; // only store the response
+    }
+
+    const qint64 start = m_request.offset;
+    const qint64 resourceSize = m_rangeCache->totalSize();
+    qint64 end = m_request.endoffset ? qint64(m_request.endoffset) + 1 : std::numeric_limits<qint64>::max();
+    if (resourceSize >= 0) {
+        end = qMin(end, resourceSize);
+    }
+    if (start >= end) {
+        rangeCacheClose();
+        return false;
+    }
+    m_rangeRequest.end = end;
+
+    // request all that is missing at once, even if some of it is cached
+    qint64 spanStart = -1;
+    qint64 spanEnd = -1;
+    const QList<HTTPRangeCache::Segment> segments = m_rangeCache->segments(start, end);
+    for (const HTTPRangeCache::Segment &segment : segments) {
+        if (!segment.cached) {
+            if (spanStart < 0) {
+                spanStart = segment.start;
+            }
+            spanEnd = segment.end;
+        }
+    }
+    if (spanStart == start && spanEnd == end) {
+        return false; // nothing to use
+    }
+
+    const KIO::CacheControl policy = m_request.cacheTag.policy;
+    if (spanStart < 0) {
+        const bool isFresh = policy == KIO::CC_Cache || policy == KIO::CC_CacheOnly
+            || (policy == KIO::CC_Verify && QDateTime::currentSecsSinceEpoch() < m_rangeCache->expireDate());
+        if (isFresh) {
+            qCDebug(KIO_HTTP) << "Serving bytes" << start << "to" << end << "of" << m_request.url << "from the range cache";
+            if (start > 0) {
+                canResume();
+            }
+            m_mimeType = m_rangeCache->mimeType();
+            if (m_mimeType.isEmpty()) {
+                m_mimeType = QString::fromLatin1(DEFAULT_MIME_TYPE);
+            }
+            mimeType(m_mimeType);
+            totalSize(end);
+            KIO::filesize_t processed = start;
+            if (!rangeCacheSendData(start, end, &processed)) {
+                return true;
+            }
+            data(QByteArray());
+            rangeCacheClose();
+            httpClose(m_request.isKeepAlive);
+            finished();
+            return true;
+        }
+        // have the server confirm the cached bytes by sending the last one of them
+        spanStart = end - 1;
+        spanEnd = end;
+    } else if (policy == KIO::CC_CacheOnly) {
+        return false;
+    }
+
+    qCDebug(KIO_HTTP) << "Requesting bytes" << spanStart << "to" << spanEnd << "of" << m_request.url << ", the rest of" << start << "to" << end
+                      << "is in the range cache";
+    m_rangeRequest.spanStart = spanStart;
+    m_rangeRequest.spanEnd = spanEnd;
+    return false;
+}
+
+void HTTPProtocol::rangeCachePrepareRequest()
+{
+    if (m_request.cacheTag.ioMode == ReadFromCache) {
+        // the complete response is cached, ranges of it don't matter
+        rangeCacheClose();
+        return;
+    }
+    if (m_rangeRequest.spanStart < 0) {
+        return;
+    }
+    m_request.offset = m_rangeRequest.spanStart;
+    m_request.endoffset = m_rangeRequest.spanEnd == std::numeric_limits<qint64>::max() ? 0 : m_rangeRequest.spanEnd - 1;
+}
+
 QString HTTPProtocol::formatRequestUri() const
 {
     // Only specify protocol, host and port when they are not already clear, i.e. when
@@ -2374,10 +2814,12 @@ bool HTTPProtocol::sendQuery()
     // looking disconnected after receiving the initial 407 response.
     // I guess the Qt socket fails to hide the effect of  proxy-connection: close after receiving
     // the 407 header.
+    m_request.cacheTag.useStale = false;
     if ((!isConnected() && !m_socketProxyAuth)) {
         if (!httpOpenConnection()) {
             qCDebug(KIO_HTTP) << "Couldn't connect, oopsie!";
-            return false;
+            // the cache entry may stand in for the server (stale-if-error)
+            return m_request.cacheTag.useStale;
         }
     }
 
@@ -2385,6 +2827,8 @@ bool HTTPProtocol::sendQuery()
     m_request.cacheTag.servedDate = QDateTime();
     m_request.cacheTag.lastModifiedDate = QDateTime();
     m_request.cacheTag.expireDate = QDateTime();
+    m_request.cacheTag.staleWhileRevalidate = 0;
+    m_request.cacheTag.staleIfError = 0;
     QString header;
     bool hasBodyData = false;
     bool hasDavData = false;
@@ -2407,6 +2851,7 @@ bool HTTPProtocol::sendQuery()
                 // start a new cache file later if appropriate
                 m_request.cacheTag.ioMode = WriteToCache;
             }
+            rangeCachePrepareRequest();
             break;
         }
         case HTTP_HEAD:
@@ -2511,7 +2956,7 @@ bool HTTPProtocol::sendQuery()
             header += QLatin1String("Referer: ") + m_request.referrer + QLatin1String("\r\n");
         }
 
-        if (m_request.endoffset > m_request.offset) {
+        if (m_request.endoffset && m_request.endoffset >= m_request.offset) {
             header +=
                 QLatin1String("Range: bytes=") + KIO::number(m_request.offset) + QLatin1Char('-') + KIO::number(m_request.endoffset) + QLatin1String("\r\n");
             qCDebug(KIO_HTTP) << "kio_http : Range =" << KIO::number(m_request.offset) << "-" << KIO::number(m_request.endoffset);
@@ -2520,6 +2965,19 @@ bool HTTPProtocol::sendQuery()
             qCDebug(KIO_HTTP) << "kio_http: Range =" << KIO::number(m_request.offset);
         }
 
+        if (m_rangeRequest.spanStart >= 0) {
+            // the server only sends the range if the cached bytes around it are still valid
+            const HTTPRangeCache::Validator validator = m_rangeCache->validator();
+            if (!validator.etag.isEmpty()) {
+                header += QLatin1String("If-Range: ") + QString::fromLatin1(validator.etag) + QLatin1String("\r\n");
+            } else {
+                header += QLatin1String("If-Range: ") + formatHttpDate(QDateTime::fromSecsSinceEpoch(validator.lastModified, Qt::UTC)) + QLatin1String("\r\n");
+            }
+        } else if (m_fileJob.isOpen && !m_fileJob.ifRange.isEmpty()) {
+            // the resource must not change under a job that reads it piecewise
+            header += QLatin1String("If-Range: ") + m_fileJob.ifRange + QLatin1String("\r\n");
+        }
+
         if (!m_request.cacheTag.useCache || m_request.cacheTag.policy == CC_Reload) {
             /* No caching for reload */
             header += QLatin1String("Pragma: no-cache\r\n"); /* for HTTP/1.0 caches */
@@ -2548,7 +3006,7 @@ bool HTTPProtocol::sendQuery()
         header += QLatin1String("\r\n");
 
         if (m_request.allowTransferCompression) {
-            header += QLatin1String("Accept-Encoding: gzip, deflate, x-gzip, x-deflate\r\n");
+            header += QLatin1String("Accept-Encoding: ") + acceptEncodingHeaderValue() + QLatin1String("\r\n");
         }
 
         if (!m_request.charsets.isEmpty()) {
@@ -2864,6 +3322,11 @@ bool HTTPProtocol::readResponseHeader()
 {
     resetResponseParsing();
     if (m_request.cacheTag.ioMode == ReadFromCache && m_request.cacheTag.plan(m_maxCacheAge) == CacheTag::UseCached) {
+        if (!m_request.cacheTag.useStale && m_request.cacheTag.strictPlan(m_maxCacheAge) == CacheTag::ValidateCached) {
+            // served within stale-while-revalidate; we have to answer before we could
+            // revalidate, so TransferJob does that once we are done
+            setMetaData(QStringLiteral("cache-revalidate"), QStringLiteral("true"));
+        }
         // parseHeaderFromCache replaces this method in case of cached content
         return parseHeaderFromCache();
     }
@@ -2923,6 +3386,13 @@ try_again:
     qCDebug(KIO_HTTP) << "============ Received Status Response:";
     qCDebug(KIO_HTTP) << QByteArray(buffer, bufPos).trimmed();
 
+    if (m_isPipelinedResponse && !QByteArray::fromRawData(buffer, bufPos).startsWith("HTTP/1.1")) {
+        // The server got confused by pipelining, multiGet() starts over without it
+        qCDebug(KIO_HTTP) << "Invalid response to a pipelined request.";
+        httpCloseConnection();
+        return false;
+    }
+
     HTTP_REV httpRev = HTTP_None;
     int idx = 0;
 
@@ -3006,6 +3476,13 @@ try_again:
         setMetaData(QStringLiteral("{internal~currenthost}LastSpoofedUserName"), m_request.url.userName());
     }
 
+    if (m_request.responseCode >= 500 && m_request.responseCode <= 599 && m_request.method == HTTP_GET && useStaleCacheEntry()) {
+        // the server is in trouble, serve the cached page without its error page (stale-if-error)
+        httpCloseConnection();
+        m_request.responseCode = 200;
+        return parseHeaderFromCache();
+    }
+
     if (m_request.responseCode != 200 && m_request.responseCode != 304) {
         m_request.cacheTag.ioMode = NoCache;
 
@@ -3021,6 +3498,19 @@ try_again:
             }
         } else if (m_request.responseCode == 416) {
             // Range not supported
+            // the error page is not read, so the connection can't be reused
+            m_request.isKeepAlive = false;
+            if (m_rangeRequest.spanStart >= 0) {
+                // the resource changed since the cached ranges were stored, try what was asked for
+                m_request.offset = m_rangeRequest.offset;
+                m_request.endoffset = m_rangeRequest.endoffset;
+                rangeCacheClose(true);
+                return false;
+            }
+            if (m_request.offset == 0) {
+                // not even the first bytes, e.g. of an empty resource. Asking again won't help.
+                m_request.endoffset = 0;
+            }
             m_request.offset = 0;
             return false; // Try again.
         } else if (m_request.responseCode == 426) {
@@ -3096,6 +3586,7 @@ try_again:
     } // (m_request.responseCode != 200 && m_request.responseCode != 304)
 
 endParsing:
+    m_server.httpRev = httpRev;
     bool authRequiresAnotherRoundtrip = false;
 
     // Skip the whole header parsing if we got no HTTP headers at all
@@ -3471,11 +3962,19 @@ endParsing:
             setCacheabilityMetadata(false);
         }
 
+        if (!rangeCacheParseResponseHeader(tokenizer)) {
+            return false;
+        }
+        fileJobParseResponseHeader(tokenizer);
+
         // Inform the job that we can indeed resume...
         if (bCanResume && m_request.offset) {
             // TODO turn off caching???
-            canResume();
-        } else {
+            // when assembling from the range cache, the response may start after the requested offset
+            if (!m_rangeRequest.assemble || m_rangeRequest.offset) {
+                canResume();
+            }
+        } else if (!m_rangeRequest.assemble) {
             m_request.offset = 0;
         }
 
@@ -3526,8 +4025,9 @@ endParsing:
 
     // Let the app know about the MIME type iff this is not a redirection and
     // the mime-type string is not empty.
+    // (an opened resource has got its MIME type when it was opened)
     if (!m_isRedirection && m_request.responseCode != 204 && (!m_mimeType.isEmpty() || m_request.method == HTTP_HEAD) && !m_kioError
-        && (m_isLoadingErrorPage || !authRequiresAnotherRoundtrip)) {
+        && (m_isLoadingErrorPage || !authRequiresAnotherRoundtrip) && !m_fileJob.isOpen) {
         qCDebug(KIO_HTTP) << "Emitting mimetype " << m_mimeType;
         mimeType(m_mimeType);
     }
@@ -3575,6 +4075,10 @@ void HTTPProtocol::addEncoding(const QString &_encoding, QStringList &encs)
         encs.append(QStringLiteral("bzip2")); // Not yet supported!
     } else if ((encoding == QLatin1String("x-deflate")) || (encoding == QLatin1String("deflate"))) {
         encs.append(QStringLiteral("deflate"));
+    } else if (encoding == QLatin1String("br")) {
+        encs.append(QStringLiteral("br"));
+    } else if (encoding == QLatin1String("zstd")) {
+        encs.append(QStringLiteral("zstd"));
     } else {
         qCDebug(KIO_HTTP) << "Unknown encoding encountered.  "
                           << "Please write code. Encoding =" << encoding;
@@ -3768,6 +4272,188 @@ void HTTPProtocol::cacheParseResponseHeader(const HeaderTokenizer &tokenizer)
     setCacheabilityMetadata(mayCache);
 }
 
+bool HTTPProtocol::rangeCacheParseResponseHeader(const HeaderTokenizer &tokenizer)
+{
+    m_rangeRequest.assemble = false;
+    m_rangeRequest.writePos = -1;
+    if (!m_rangeRequest.active || m_request.method != HTTP_GET) {
+        return true;
+    }
+
+    if (m_request.responseCode == 200 && m_rangeRequest.spanStart >= 0) {
+        qCDebug(KIO_HTTP) << "If-Range failed, the cached ranges of" << m_request.url << "are outdated";
+        rangeCacheClose(true);
+        return true;
+    }
+    if (m_request.responseCode != 206) {
+        return true;
+    }
+
+    qint64 first = 0;
+    qint64 last = 0;
+    qint64 total = 0;
+    TokenIterator tIt = tokenizer.iterator("content-range");
+    // no Content-Range means multipart/byteranges, which we never ask for
+    const bool haveRange = tIt.hasNext() && HTTPRangeCache::parseContentRange(tIt.next(), &first, &last, &total);
+
+    HTTPRangeCache::Validator validator;
+    tIt = tokenizer.iterator("etag");
+    if (tIt.hasNext()) {
+        const QByteArray etag = tIt.next().trimmed();
+        // weak entity tags don't promise byte-for-byte equality
+        if (!etag.startsWith("W/")) {
+            validator.etag = etag;
+        }
+    }
+    tIt = tokenizer.iterator("last-modified");
+    if (tIt.hasNext()) {
+        const QDateTime lastModified = QDateTime::fromString(toQString(tIt.next()), Qt::RFC2822Date);
+        if (lastModified.isValid()) {
+            validator.lastModified = lastModified.toSecsSinceEpoch();
+        }
+    }
+
+    if (m_rangeRequest.spanStart >= 0) {
+        const bool matches = haveRange && first == m_rangeRequest.spanStart
+            && (m_rangeRequest.spanEnd == std::numeric_limits<qint64>::max() || last + 1 == m_rangeRequest.spanEnd) && m_contentEncodings.isEmpty()
+            && (!validator.isValid() || validator == m_rangeCache->validator());
+        if (!matches) {
+            qCDebug(KIO_HTTP) << "The response does not fit the cached ranges of" << m_request.url << ", requesting without them";
+            // the body of this response is still unread
+            m_request.isKeepAlive = false;
+            m_request.offset = m_rangeRequest.offset;
+            m_request.endoffset = m_rangeRequest.endoffset;
+            rangeCacheClose(true);
+            return false;
+        }
+        m_rangeRequest.assemble = true;
+        if (m_mimeType.isEmpty()) {
+            m_mimeType = m_rangeCache->mimeType();
+        }
+        if (m_mimeType.isEmpty()) {
+            m_mimeType = QString::fromLatin1(DEFAULT_MIME_TYPE);
+        }
+    }
+
+    if (!haveRange || !validator.isValid() || !m_contentEncodings.isEmpty()) {
+        return true;
+    }
+
+    bool noStore = false;
+    qint64 maxAge = -1;
+    tIt = tokenizer.iterator("cache-control");
+    while (tIt.hasNext()) {
+        const QByteArray cacheStr = tIt.next().toLower().trimmed();
+        if (cacheStr.startsWith("no-store")) { // krazy:exclude=strings
+            noStore = true;
+        } else if (cacheStr.startsWith("max-age=")) { // krazy:exclude=strings
+            bool ok = false;
+            const qint64 value = cacheStr.mid(qstrlen("max-age=")).trimmed().toLongLong(&ok);
+            if (ok) {
+                maxAge = value;
+            }
+        }
+    }
+    if (noStore) {
+        return true;
+    }
+
+    qint64 expireDate = 0;
+    if (maxAge >= 0) {
+        expireDate = QDateTime::currentSecsSinceEpoch() + maxAge;
+    } else {
+        tIt = tokenizer.iterator("expires");
+        if (tIt.hasNext()) {
+            const QDateTime expires = QDateTime::fromString(toQString(tIt.next()), Qt::RFC2822Date);
+            if (expires.isValid()) {
+                expireDate = expires.toSecsSinceEpoch();
+            }
+        }
+    }
+
+    qCDebug(KIO_HTTP) << "Range cache, adding bytes" << first << "to" << last << "of" << m_request.url;
+    m_rangeCache->setValidator(validator);
+    if (total >= 0) {
+        m_rangeCache->setTotalSize(total);
+    }
+    if (!m_mimeType.isEmpty()) {
+        m_rangeCache->setMimeType(m_mimeType);
+    }
+    m_rangeCache->setExpireDate(expireDate);
+    m_rangeRequest.writePos = first;
+    return true;
+}
+
+bool HTTPProtocol::rangeCacheSendData(qint64 start, qint64 end, KIO::filesize_t *processed)
+{
+    for (qint64 pos = start; pos < end;) {
+        if (wasCancelled()) {
+            m_request.isKeepAlive = false;
+            error(cancellationError(), m_request.url.host());
+            return false;
+        }
+        const QByteArray d = m_rangeCache->read(pos, qMin<qint64>(end - pos, MAX_IPC_SIZE));
+        if (d.isEmpty()) {
+            qCWarning(KIO_HTTP) << "The range cache entry of" << m_request.url << "is damaged, deleting it";
+            rangeCacheClose(true);
+            m_request.isKeepAlive = false;
+            error(ERR_CANNOT_READ, m_request.url.toDisplayString());
+            return false;
+        }
+        data(d);
+        pos += d.size();
+        *processed += d.size();
+        processedSize(*processed);
+    }
+    return true;
+}
+
+void HTTPProtocol::rangeCacheClose(bool discard)
+{
+    if (m_rangeRequest.active) {
+        if (discard) {
+            m_rangeCache->remove();
+        } else {
+            m_rangeCache->close();
+        }
+    }
+    m_rangeRequest.active = false;
+    m_rangeRequest.spanStart = -1;
+    m_rangeRequest.spanEnd = -1;
+    m_rangeRequest.assemble = false;
+    m_rangeRequest.writePos = -1;
+}
+
+void HTTPProtocol::fileJobParseResponseHeader(const HeaderTokenizer &tokenizer)
+{
+    if (!m_fileJob.isActive) {
+        return;
+    }
+
+    qint64 last = 0;
+    TokenIterator tIt = tokenizer.iterator("content-range");
+    if (!tIt.hasNext() || !HTTPRangeCache::parseContentRange(tIt.next(), &m_fileJob.rangeFirst, &last, &m_fileJob.rangeTotal)) {
+        m_fileJob.rangeFirst = -1;
+        m_fileJob.rangeTotal = -1;
+    }
+
+    if (m_fileJob.isOpen) {
+        return;
+    }
+    tIt = tokenizer.iterator("etag");
+    if (tIt.hasNext()) {
+        const QByteArray etag = tIt.next().trimmed();
+        // If-Range only works with strong entity tags
+        if (!etag.startsWith("W/")) {
+            m_fileJob.ifRange = toQString(etag);
+        }
+    }
+    tIt = tokenizer.iterator("last-modified");
+    if (m_fileJob.ifRange.isEmpty() && tIt.hasNext()) {
+        m_fileJob.ifRange = toQString(tIt.next().trimmed());
+    }
+}
+
 void HTTPProtocol::setCacheabilityMetadata(bool cachingAllowed)
 {
     if (!cachingAllowed) {
@@ -3802,13 +4488,35 @@ bool HTTPProtocol::sendCachedBody()
     }
 
     totalSize(size);
+
+#if HAVE_SENDFILE
+    // Data in a file (e.g. from copyPut()) is handed to the kernel when there is no TLS to
+    // apply, the headers written above have already been flushed out of the socket buffer.
+    QFile *file = qobject_cast<QFile *>(m_POSTbuf);
+    if (file && file->handle() != -1 && !isUsingSsl() && tcpSocket()->bytesToWrite() == 0) {
+        const int sendResult = sendFileBody(file->handle(), size);
+        if (sendResult >= 0) {
+            return sendResult == 1;
+        }
+        // sendfile() can't be used on these descriptors, copy the data ourselves
+    }
+#endif
+
     // Make sure the read head is at the beginning...
     m_POSTbuf->reset();
     KIO::filesize_t totalBytesSent = 0;
+    // No need to keep a file's content in small pieces, it isn't held in memory anyway
+    const qint64 chunkSize = qobject_cast<QFile *>(m_POSTbuf) ? s_fileBodyChunkSize : 65536;
 
     // Send the data...
     while (!m_POSTbuf->atEnd()) {
-        const QByteArray buffer = m_POSTbuf->read(65536);
+        if (wasCancelled()) {
+            // the request is incomplete, the connection can't be reused
+            m_request.isKeepAlive = false;
+            error(cancellationError(), m_request.url.host());
+            return false;
+        }
+        const QByteArray buffer = m_POSTbuf->read(chunkSize);
         const ssize_t bytesSent = write(buffer.data(), buffer.size());
         if (bytesSent != static_cast<ssize_t>(buffer.size())) {
             qCDebug(KIO_HTTP) << "Connection broken when sending message body: (" << m_request.url.host() << ")";
@@ -3823,6 +4531,48 @@ bool HTTPProtocol::sendCachedBody()
     return true;
 }
 
+#if HAVE_SENDFILE
+int HTTPProtocol::sendFileBody(int fd, qint64 size)
+{
+    const int socketFd = static_cast<int>(tcpSocket()->socketDescriptor());
+    off_t offset = 0;
+    while (offset < size) {
+        if (wasCancelled()) {
+            // the request is incomplete, the connection can't be reused
+            m_request.isKeepAlive = false;
+            error(cancellationError(), m_request.url.host());
+            return 0;
+        }
+
+        const ssize_t sent = ::sendfile(socketFd, fd, &offset, qMin<qint64>(size - offset, s_fileBodyChunkSize));
+        if (sent > 0) {
+            processedSize(offset);
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EINTR)) {
+            // the socket is non-blocking, wait until it takes more data
+            pollfd pfd = {socketFd, POLLOUT, 0};
+            ::poll(&pfd, 1, 1000);
+            continue;
+        }
+        if (sent < 0 && offset == 0 && (errno == EINVAL || errno == ENOSYS)) {
+            return -1;
+        }
+
+        if (sent == 0) {
+            qCDebug(KIO_HTTP) << "File shrank while sending it to" << m_request.url.host();
+            error(ERR_CANNOT_READ, m_request.url.toDisplayString());
+        } else {
+            qCDebug(KIO_HTTP) << "Connection broken when sending message body: (" << m_request.url.host() << ")";
+            error(ERR_CONNECTION_BROKEN, m_request.url.host());
+        }
+        return 0;
+    }
+
+    return 1;
+}
+#endif
+
 bool HTTPProtocol::sendBody()
 {
     // If we have cached data, the it is either a repost or a DAV request so send
@@ -3831,7 +4581,15 @@ bool HTTPProtocol::sendBody()
         return sendCachedBody();
     }
 
-    if (m_iPostDataSize == NO_SIZE) {
+    if (m_POSTbufIncomplete) {
+        // The job has handed out the data already and it could not be kept.
+        error(ERR_SLAVE_DEFINED, i18n("The data for %1 is too large to send it again.", m_request.url.host()));
+        return false;
+    }
+
+    // Data of unknown size is sent as it comes, in chunks, to servers known to take them
+    const bool isChunked = (m_iPostDataSize == NO_SIZE);
+    if (isChunked && m_server.httpRev != HTTP_11) {
         // Try the old approach of retrieving content data from the job
         // before giving up.
         if (retrieveAllData()) {
@@ -3846,7 +4604,8 @@ bool HTTPProtocol::sendBody()
 
     infoMessage(i18n("Sending data to %1", m_request.url.host()));
 
-    const QByteArray cLength = "Content-Length: " + QByteArray::number(m_iPostDataSize) + "\r\n\r\n";
+    const QByteArray cLength = isChunked ? QByteArray("Transfer-Encoding: chunked\r\n\r\n") //
+                                         : "Content-Length: " + QByteArray::number(m_iPostDataSize) + "\r\n\r\n";
 
     qCDebug(KIO_HTTP) << cLength.trimmed();
 
@@ -3865,12 +4624,14 @@ bool HTTPProtocol::sendBody()
         return false;
     }
 
-    // Send the amount
-    totalSize(m_iPostDataSize);
+    if (!isChunked) {
+        // Send the amount
+        totalSize(m_iPostDataSize);
 
-    // If content-length is 0, then do nothing but simply return true.
-    if (m_iPostDataSize == 0) {
-        return true;
+        // If content-length is 0, then do nothing but simply return true.
+        if (m_iPostDataSize == 0) {
+            return true;
+        }
     }
 
     sendOk = true;
@@ -3884,27 +4645,57 @@ bool HTTPProtocol::sendBody()
 
         // On done...
         if (bytesRead == 0) {
-            sendOk = (bytesSent == m_iPostDataSize);
+            if (!sendOk) {
+                break;
+            }
+            if (!isChunked) {
+                sendOk = (bytesSent == m_iPostDataSize);
+                break;
+            }
+            // the last chunk
+            static const char lastChunk[] = "0\r\n\r\n";
+            if (write(lastChunk, sizeof(lastChunk) - 1) == static_cast<ssize_t>(sizeof(lastChunk) - 1)) {
+                break;
+            }
+            qCDebug(KIO_HTTP) << "Connection broken while sending POST content to" << m_request.url.host();
+            error(ERR_CONNECTION_BROKEN, m_request.url.host());
+            sendOk = false;
             break;
         }
 
         // On error return false...
         if (bytesRead < 0) {
-            error(ERR_ABORTED, m_request.url.host());
+            m_request.isKeepAlive = false;
+            error(wasCancelled() ? cancellationError() : int(ERR_ABORTED), m_request.url.host());
             sendOk = false;
             break;
         }
 
-        // Cache the POST data in case of a repost request.
-        cachePostData(buffer);
+        // Keep the POST data in case of a repost request.
+        keepPostDataForRetry(buffer);
 
-        // This will only happen if transmitting the data fails, so we will simply
-        // cache the content locally for the potential re-transmit...
+        // This will only happen if transmitting the data fails; the rest of the
+        // data still has to be taken from the job.
         if (!sendOk) {
             continue;
         }
 
-        if (write(buffer.data(), bytesRead) == static_cast<ssize_t>(bytesRead)) {
+        if (wasCancelled()) {
+            m_request.isKeepAlive = false;
+            error(cancellationError(), m_request.url.host());
+            sendOk = false;
+            break;
+        }
+
+        bool written;
+        if (isChunked) {
+            const QByteArray chunkSize = QByteArray::number(bytesRead, 16) + "\r\n";
+            written = write(chunkSize.data(), chunkSize.size()) == static_cast<ssize_t>(chunkSize.size())
+                && write(buffer.data(), bytesRead) == static_cast<ssize_t>(bytesRead) && write("\r\n", 2) == 2;
+        } else {
+            written = write(buffer.data(), bytesRead) == static_cast<ssize_t>(bytesRead);
+        }
+        if (written) {
             bytesSent += bytesRead;
             processedSize(bytesSent); // Send update status...
             continue;
@@ -3941,10 +4732,13 @@ void HTTPProtocol::httpClose(bool keepAlive)
         stream << int(99); // special: Close connection
         setTimeoutSpecialCommand(m_request.keepAliveTimeout, data);
 
+        // Let the scheduler prefer this worker for the next job to the same host
+        slaveStatus(m_server.url.host(), isConnected());
         return;
     }
 
     httpCloseConnection();
+    slaveStatus(QString(), false);
 }
 
 void HTTPProtocol::closeConnection()
@@ -4014,12 +4808,19 @@ void HTTPProtocol::special(const QByteArray &data)
         bool no_cache;
         qint64 expireDate;
         stream >> url >> no_cache >> expireDate;
+        if (m_memoryCache) {
+            // it is read from disk again next time
+            m_memoryCache->remove(storableUrl(url).toEncoded());
+        }
         if (no_cache) {
-            QString filename = cacheFilePathFromUrl(url);
             // there is a tiny risk of deleting the wrong file due to hash collisions here.
             // this is an unimportant performance issue.
-            // FIXME on Windows we may be unable to delete the file if open
-            QFile::remove(filename);
+            if (m_cacheStore) {
+                m_cacheStore->remove(cacheKeyFromUrl(url));
+            } else {
+                // FIXME on Windows we may be unable to delete the file if open
+                QFile::remove(cacheFilePathFromUrl(url));
+            }
             finished();
             break;
         }
@@ -4061,6 +4862,7 @@ void HTTPProtocol::special(const QByteArray &data)
     }
     case 99: { // Close Connection
         httpCloseConnection();
+        slaveStatus(QString(), false);
         break;
     }
     default:
@@ -4245,6 +5047,9 @@ void HTTPProtocol::slotData(const QByteArray &_d)
         if (m_request.cacheTag.ioMode == WriteToCache) {
             cacheFileWritePayload(d);
         }
+        if (m_rangeRequest.writePos >= 0) {
+            m_rangeRequest.writePos = m_rangeCache->write(m_rangeRequest.writePos, d) ? m_rangeRequest.writePos + d.size() : -1;
+        }
     } else {
         uint old_size = m_webDavDataBuf.size();
         m_webDavDataBuf.resize(old_size + d.size());
@@ -4297,7 +5102,8 @@ bool HTTPProtocol::readBody(bool dataInternal /* = false */)
         // until we uncompress to find out the actual data size
         if (!dataInternal) {
             if ((m_iSize > 0) && (m_iSize != NO_SIZE)) {
-                totalSize(m_iSize);
+                // the cached bytes after the received ones are sent as well
+                totalSize(m_rangeRequest.assemble ? m_iSize + (m_rangeRequest.end - m_rangeRequest.spanEnd) : m_iSize);
                 infoMessage(i18n("Retrieving %1 from %2...", KIO::convertSize(m_iSize), m_request.url.host()));
             } else {
                 totalSize(0);
@@ -4308,9 +5114,14 @@ bool HTTPProtocol::readBody(bool dataInternal /* = false */)
             qCDebug(KIO_HTTP) << "reading data from cache...";
 
             m_iContentLeft = NO_SIZE;
+            rangeCacheClose();
 
             QByteArray d;
             while (true) {
+                if (wasCancelled()) {
+                    error(cancellationError(), m_request.url.host());
+                    return false;
+                }
                 d = cacheFileReadPayload(MAX_IPC_SIZE);
                 if (d.isEmpty()) {
                     break;
@@ -4332,6 +5143,14 @@ bool HTTPProtocol::readBody(bool dataInternal /* = false */)
         }
     }
 
+    // the cached bytes before the ones to receive go first
+    if (m_rangeRequest.assemble) {
+        KIO::filesize_t processed = m_rangeRequest.offset;
+        if (!rangeCacheSendData(m_rangeRequest.offset, m_rangeRequest.spanStart, &processed)) {
+            return false;
+        }
+    }
+
     if (m_iSize != NO_SIZE) {
         m_iBytesLeft = m_iSize - sz;
     } else {
@@ -4365,6 +5184,12 @@ bool HTTPProtocol::readBody(bool dataInternal /* = false */)
             chain.addFilter(new HTTPFilterGZip);
         } else if (enc == QLatin1String("deflate")) {
             chain.addFilter(new HTTPFilterDeflate);
+        } else if (enc == QLatin1String("zstd")) {
+            chain.addFilter(new HTTPFilterZstd);
+#if HAVE_BROTLI
+        } else if (enc == QLatin1String("br")) {
+            chain.addFilter(new HTTPFilterBrotli);
+#endif
         }
     }
 
@@ -4394,6 +5219,12 @@ bool HTTPProtocol::readBody(bool dataInternal /* = false */)
             chain.addFilter(new HTTPFilterGZip);
         } else if (enc == QLatin1String("deflate")) {
             chain.addFilter(new HTTPFilterDeflate);
+        } else if (enc == QLatin1String("zstd")) {
+            chain.addFilter(new HTTPFilterZstd);
+#if HAVE_BROTLI
+        } else if (enc == QLatin1String("br")) {
+            chain.addFilter(new HTTPFilterBrotli);
+#endif
         }
     }
 
@@ -4444,6 +5275,13 @@ bool HTTPProtocol::readBody(bool dataInternal /* = false */)
         }
         m_receiveBuf.resize(0); // res
 
+        if (wasCancelled()) {
+            // the rest of the body is still on the wire, the connection can't be reused
+            m_request.isKeepAlive = false;
+            error(cancellationError(), m_request.url.host());
+            return false;
+        }
+
         if (m_iBytesLeft && m_isEOD && !m_isChunked) {
             // gzip'ed data sometimes reports a too long content-length.
             // (The length of the unzipped data)
@@ -4470,6 +5308,20 @@ bool HTTPProtocol::readBody(bool dataInternal /* = false */)
         cacheFileClose(); // no-op if not necessary
     }
 
+    if (m_rangeRequest.assemble) {
+        if (m_rangeRequest.spanEnd != std::numeric_limits<qint64>::max() && sz != KIO::filesize_t(m_rangeRequest.spanEnd)) {
+            qCDebug(KIO_HTTP) << "Received up to" << sz << "instead of" << m_rangeRequest.spanEnd << ", connection broken!";
+            error(ERR_CONNECTION_BROKEN, m_request.url.host());
+            return false;
+        }
+        if (!rangeCacheSendData(m_rangeRequest.spanEnd, m_rangeRequest.end, &sz)) {
+            return false;
+        }
+    }
+    if (!dataInternal) {
+        rangeCacheClose();
+    }
+
     if (!dataInternal && sz <= 1) {
         if (m_request.responseCode >= 500 && m_request.responseCode <= 599) {
             error(ERR_INTERNAL_SERVER, m_request.url.host());
@@ -4509,6 +5361,8 @@ void HTTPProtocol::error(int _err, const QString &_text)
 
     // It's over, we don't need it anymore
     clearPostDataBuffer();
+    rangeCacheClose();
+    m_fileJob = FileJobState();
 
     SlaveBase::error(_err, _text);
     m_kioError = _err;
@@ -4537,6 +5391,20 @@ QString HTTPProtocol::findCookies(const QString &url)
 /******************************* CACHING CODE ****************************/
 
 HTTPProtocol::CacheTag::CachePlan HTTPProtocol::CacheTag::plan(int maxCacheAge) const
+{
+    const CachePlan strict = strictPlan(maxCacheAge);
+    if (strict != ValidateCached) {
+        return strict;
+    }
+    // RFC 5861: validating the entry failed and it may be used instead of an error, or it is
+    // only a little stale and may be used while it is revalidated in the background
+    if (useStale || ((policy == KIO::CC_Verify || policy == KIO::CC_Refresh) && isWithinStaleWindow(maxCacheAge, staleWhileRevalidate))) {
+        return UseCached;
+    }
+    return ValidateCached;
+}
+
+HTTPProtocol::CacheTag::CachePlan HTTPProtocol::CacheTag::strictPlan(int maxCacheAge) const
 {
     // notable omission: we're not checking cache file presence or integrity
     switch (policy) {
@@ -4564,6 +5432,21 @@ HTTPProtocol::CacheTag::CachePlan HTTPProtocol::CacheTag::plan(int maxCacheAge)
     return UseCached;
 }
 
+bool HTTPProtocol::CacheTag::isWithinStaleWindow(int maxCacheAge, qint64 staleSeconds) const
+{
+    if (staleSeconds <= 0) {
+        return false;
+    }
+    QDateTime freshUntil;
+    if (servedDate.isValid()) {
+        freshUntil = servedDate.addSecs(maxCacheAge);
+    }
+    if (expireDate.isValid() && (!freshUntil.isValid() || expireDate < freshUntil)) {
+        freshUntil = expireDate;
+    }
+    return freshUntil.isValid() && QDateTime::currentDateTime() <= freshUntil.addSecs(staleSeconds);
+}
+
 // !START SYNC!
 // The following code should be kept in sync
 // with the code in http_cache_cleaner.cpp
@@ -4682,6 +5565,25 @@ static QUrl storableUrl(const QUrl &url)
     return ret;
 }
 
+// A cache entry from the memory cache, read like a cache file
+class MemoryCacheEntryDevice : public QBuffer
+{
+public:
+    explicit MemoryCacheEntryDevice(const QByteArray &entry)
+    {
+        setData(entry);
+        open(QIODevice::ReadOnly);
+    }
+
+    // as stored in the memory cache
+    QDateTime expireDate() const
+    {
+        HTTPProtocol::CacheTag cacheTag;
+        cacheTag.deserialize(data().left(BinaryCacheFileHeader::size));
+        return cacheTag.expireDate;
+    }
+};
+
 static void writeLine(QIODevice *dev, const QByteArray &line)
 {
     static const char linefeed = '\n';
@@ -4691,7 +5593,7 @@ static void writeLine(QIODevice *dev, const QByteArray &line)
 
 void HTTPProtocol::cacheFileWriteTextHeader()
 {
-    QFile *&file = m_request.cacheTag.file;
+    QIODevice *&file = m_request.cacheTag.file;
     Q_ASSERT(file);
     Q_ASSERT(file->openMode() & QIODevice::WriteOnly);
 
@@ -4719,7 +5621,7 @@ static bool readLineChecked(QIODevice *dev, QByteArray *line)
 
 bool HTTPProtocol::cacheFileReadTextHeader1(const QUrl &desiredUrl)
 {
-    QFile *&file = m_request.cacheTag.file;
+    QIODevice *&file = m_request.cacheTag.file;
     Q_ASSERT(file);
     Q_ASSERT(file->openMode() == QIODevice::ReadOnly);
 
@@ -4738,7 +5640,7 @@ bool HTTPProtocol::cacheFileReadTextHeader1(const QUrl &desiredUrl)
 
 bool HTTPProtocol::cacheFileReadTextHeader2()
 {
-    QFile *&file = m_request.cacheTag.file;
+    QIODevice *&file = m_request.cacheTag.file;
     Q_ASSERT(file);
     Q_ASSERT(file->openMode() == QIODevice::ReadOnly);
 
@@ -4768,11 +5670,59 @@ bool HTTPProtocol::cacheFileReadTextHeader2()
     return ok; // it may still be false ;)
 }
 
+// Applies the per-host configuration to a window of RFC 5861: a negative value means to
+// go with the server's choice, anything else overrides it.
+static qint64 staleWindow(int configured, qint64 fromServer)
+{
+    return configured < 0 ? fromServer : configured;
+}
+
+void HTTPProtocol::cacheFileReadStaleWindows()
+{
+    CacheTag &cacheTag = m_request.cacheTag;
+    if (metaData(QStringLiteral("cache-revalidation")) == QLatin1String("true")) {
+        // we are the background revalidation of a stale entry, it must not be served stale again
+        return;
+    }
+
+    // the stale-* directives are only needed after the entry expired, so they are not in the
+    // binary header; find them in the stored response header and come back
+    QIODevice *file = cacheTag.file;
+    const qint64 oldPos = file->pos();
+    qint64 whileRevalidate = 0;
+    qint64 ifError = 0;
+    QByteArray readBuf;
+    bool ok = readLineChecked(file, &readBuf); // MIME type
+    while (ok && readLineChecked(file, &readBuf) && !readBuf.isEmpty()) {
+        const QByteArray line = readBuf.toLower();
+        if (!line.startsWith("cache-control:")) {
+            continue;
+        }
+        const QList<QByteArray> directives = line.mid(14).split(',');
+        for (const QByteArray &directive : directives) {
+            const QByteArray trimmed = directive.trimmed();
+            if (trimmed.startsWith("stale-while-revalidate=")) {
+                whileRevalidate = trimmed.mid(23).toLongLong();
+            } else if (trimmed.startsWith("stale-if-error=")) {
+                ifError = trimmed.mid(15).toLongLong();
+            }
+        }
+    }
+    file->seek(oldPos);
+
+    cacheTag.staleWhileRevalidate = staleWindow(configValue(QStringLiteral("StaleWhileRevalidate"), DEFAULT_STALE_WHILE_REVALIDATE), whileRevalidate);
+    cacheTag.staleIfError = staleWindow(configValue(QStringLiteral("StaleIfError"), DEFAULT_STALE_IF_ERROR), ifError);
+    qCDebug(KIO_HTTP) << "stale-while-revalidate:" << cacheTag.staleWhileRevalidate << "stale-if-error:" << cacheTag.staleIfError;
+}
+
+static QByteArray cacheKeyFromUrl(const QUrl &url)
+{
+    return QCryptographicHash::hash(storableUrl(url).toEncoded(), QCryptographicHash::Sha1);
+}
+
 static QString filenameFromUrl(const QUrl &url)
 {
-    QCryptographicHash hash(QCryptographicHash::Sha1);
-    hash.addData(storableUrl(url).toEncoded());
-    return toQString(hash.result().toHex());
+    return toQString(cacheKeyFromUrl(url).toHex());
 }
 
 QString HTTPProtocol::cacheFilePathFromUrl(const QUrl &url) const
@@ -4790,19 +5740,39 @@ bool HTTPProtocol::cacheFileOpenRead()
     qCDebug(KIO_HTTP);
     QString filename = cacheFilePathFromUrl(m_request.url);
 
-    QFile *&file = m_request.cacheTag.file;
+    QIODevice *&file = m_request.cacheTag.file;
     if (file) {
-        qCDebug(KIO_HTTP) << "File unexpectedly open; old file is" << file->fileName() << "new name is" << filename;
-        Q_ASSERT(file->fileName() == filename);
+        qCDebug(KIO_HTTP) << "File unexpectedly open, new name is" << filename;
     }
     Q_ASSERT(!file);
-    file = new QFile(filename);
-    if (file->open(QIODevice::ReadOnly)) {
+    HTTPCacheStore::Entry storeEntry;
+    QByteArray memoryEntry;
+    const auto varyValues = [this](const QByteArray &vary, QByteArray *values) {
+        return varyRequestHeaderValues(vary, values);
+    };
+    if (m_memoryCache && m_memoryCache->find(storableUrl(m_request.url).toEncoded(), varyValues, &memoryEntry)) {
+        file = new MemoryCacheEntryDevice(memoryEntry);
+    } else if (m_cacheStore) {
+        if (m_cacheStore->find(cacheKeyFromUrl(m_request.url), &storeEntry)) {
+            file = m_cacheStore->openRecord(storeEntry);
+        }
+        if (!file) {
+            return false;
+        }
+    } else {
+        file = new QFile(filename);
+        file->open(QIODevice::ReadOnly);
+    }
+    if (file->isOpen()) {
         QByteArray header = file->read(BinaryCacheFileHeader::size);
         if (!m_request.cacheTag.deserialize(header)) {
             qCDebug(KIO_HTTP) << "Cache file header is invalid.";
 
             file->close();
+        } else if (m_cacheStore && memoryEntry.isEmpty()) {
+            // records are never modified, the index has the current values
+            m_request.cacheTag.fileUseCount = storeEntry.useCount;
+            m_request.cacheTag.expireDate.setSecsSinceEpoch(storeEntry.expireDate);
         }
     }
 
@@ -4814,6 +5784,9 @@ bool HTTPProtocol::cacheFileOpenRead()
         cacheFileClose();
         return false;
     }
+    if (m_request.cacheTag.strictPlan(m_maxCacheAge) == CacheTag::ValidateCached) {
+        cacheFileReadStaleWindows();
+    }
     return true;
 }
 
@@ -4824,14 +5797,20 @@ bool HTTPProtocol::cacheFileOpenWrite()
 
     // if we open a cache file for writing while we have a file open for reading we must have
     // found out that the old cached content is obsolete, so delete the file.
-    QFile *&file = m_request.cacheTag.file;
+    QIODevice *&file = m_request.cacheTag.file;
     if (file) {
         // ensure that the file is in a known state - either open for reading or null
         Q_ASSERT(!qobject_cast<QTemporaryFile *>(file));
         Q_ASSERT((file->openMode() & QIODevice::WriteOnly) == 0);
-        Q_ASSERT(file->fileName() == filename);
         qCDebug(KIO_HTTP) << "deleting expired cache entry and recreating.";
-        file->remove();
+        if (m_memoryCache) {
+            m_memoryCache->remove(storableUrl(m_request.url).toEncoded());
+        }
+        if (m_cacheStore) {
+            m_cacheStore->remove(cacheKeyFromUrl(m_request.url));
+        } else {
+            QFile::remove(filename);
+        }
         delete file;
         file = nullptr;
     }
@@ -4846,14 +5825,14 @@ bool HTTPProtocol::cacheFileOpenWrite()
 
     if ((file->openMode() & QIODevice::WriteOnly) == 0) {
         qCDebug(KIO_HTTP) << "Could not open file for writing: QTemporaryFile(" << filename << ")"
-                          << "due to error" << file->error();
+                          << "due to error" << file->errorString();
         cacheFileClose();
         return false;
     }
     return true;
 }
 
-static QByteArray makeCacheCleanerCommand(const HTTPProtocol::CacheTag &cacheTag, CacheCleanerCommandCode cmd)
+static QByteArray makeCacheCleanerCommand(const HTTPProtocol::CacheTag &cacheTag, CacheCleanerCommandCode cmd, const QUrl &url)
 {
     QByteArray ret = cacheTag.serialize();
     QDataStream stream(&ret, QIODevice::ReadWrite);
@@ -4863,9 +5842,7 @@ static QByteArray makeCacheCleanerCommand(const HTTPProtocol::CacheTag &cacheTag
     // append the command code
     stream << quint32(cmd);
     // append the filename
-    const QString fileName = cacheTag.file->fileName();
-    const int basenameStart = fileName.lastIndexOf(QLatin1Char('/')) + 1;
-    const QByteArray baseName = QStringView(fileName).mid(basenameStart, s_hashedUrlNibbles).toLatin1();
+    const QByteArray baseName = cacheKeyFromUrl(url).toHex();
     stream.writeRawData(baseName.constData(), baseName.size());
 
     Q_ASSERT(ret.size() == BinaryCacheFileHeader::size + sizeof(quint32) + s_hashedUrlNibbles);
@@ -4877,7 +5854,7 @@ void HTTPProtocol::cacheFileClose()
 {
     qCDebug(KIO_HTTP);
 
-    QFile *&file = m_request.cacheTag.file;
+    QIODevice *&file = m_request.cacheTag.file;
     if (!file) {
         return;
     }
@@ -4895,26 +5872,49 @@ void HTTPProtocol::cacheFileClose()
             tempFile->seek(0);
             tempFile->write(header);
 
-            ccCommand = makeCacheCleanerCommand(m_request.cacheTag, CreateFileNotificationCommand);
-
-            QString oldName = tempFile->fileName();
-            QString newName = oldName;
-            int basenameStart = newName.lastIndexOf(QLatin1Char('/')) + 1;
-            // remove the randomized name part added by QTemporaryFile
-            newName.chop(newName.length() - basenameStart - s_hashedUrlNibbles);
-            qCDebug(KIO_HTTP) << "Renaming temporary file" << oldName << "to" << newName;
-
-            // on windows open files can't be renamed
-            tempFile->setAutoRemove(false);
-            delete tempFile;
-            file = nullptr;
-
-            if (!QFile::rename(oldName, newName)) {
-                // ### currently this hides a minor bug when force-reloading a resource. We
-                //     should not even open a new file for writing in that case.
-                qCDebug(KIO_HTTP) << "Renaming temporary file failed, deleting it instead.";
-                QFile::remove(oldName);
-                ccCommand.clear(); // we have nothing of value to tell the cache cleaner
+            ccCommand = makeCacheCleanerCommand(m_request.cacheTag, CreateFileNotificationCommand, m_request.url);
+
+            QByteArray memoryEntry;
+            if (m_memoryCache && tempFile->size() <= m_memoryCache->maxEntrySize()) {
+                tempFile->flush();
+                QFile entryFile(tempFile->fileName());
+                if (entryFile.open(QIODevice::ReadOnly)) {
+                    memoryEntry = entryFile.readAll();
+                }
+            }
+
+            if (m_cacheStore) {
+                // the record is a copy of the temporary file, which removes itself when deleted below
+                tempFile->close();
+                if (!m_cacheStore->insert(cacheKeyFromUrl(m_request.url), tempFile->fileName(), m_request.cacheTag.expireDate.toSecsSinceEpoch())) {
+                    qCDebug(KIO_HTTP) << "Adding the entry to the cache store failed.";
+                    ccCommand.clear();
+                    memoryEntry.clear();
+                }
+            } else {
+                QString oldName = tempFile->fileName();
+                QString newName = oldName;
+                int basenameStart = newName.lastIndexOf(QLatin1Char('/')) + 1;
+                // remove the randomized name part added by QTemporaryFile
+                newName.chop(newName.length() - basenameStart - s_hashedUrlNibbles);
+                qCDebug(KIO_HTTP) << "Renaming temporary file" << oldName << "to" << newName;
+
+                // on windows open files can't be renamed
+                tempFile->setAutoRemove(false);
+                delete tempFile;
+                file = nullptr;
+
+                if (!QFile::rename(oldName, newName)) {
+                    // ### currently this hides a minor bug when force-reloading a resource. We
+                    //     should not even open a new file for writing in that case.
+                    qCDebug(KIO_HTTP) << "Renaming temporary file failed, deleting it instead.";
+                    QFile::remove(oldName);
+                    ccCommand.clear(); // we have nothing of value to tell the cache cleaner
+                    memoryEntry.clear();
+                }
+            }
+            if (!memoryEntry.isEmpty()) {
+                memoryCacheInsert(memoryEntry);
             }
         } else {
             // oh, we've never written payload data to the cache file.
@@ -4922,7 +5922,12 @@ void HTTPProtocol::cacheFileClose()
         }
     } else if (file->openMode() == QIODevice::ReadOnly) {
         Q_ASSERT(!tempFile);
-        ccCommand = makeCacheCleanerCommand(m_request.cacheTag, UpdateFileCommand);
+        if (m_cacheStore) {
+            // the store keeps use counts itself, the cleaner does not need to know
+            m_cacheStore->touch(cacheKeyFromUrl(m_request.url), m_request.cacheTag.expireDate.toSecsSinceEpoch());
+        } else {
+            ccCommand = makeCacheCleanerCommand(m_request.cacheTag, UpdateFileCommand, m_request.url);
+        }
     }
     delete file;
     file = nullptr;
@@ -4988,13 +5993,96 @@ QByteArray HTTPProtocol::cacheFileReadPayload(int maxLength)
     Q_ASSERT(m_request.cacheTag.file);
     Q_ASSERT(m_request.cacheTag.ioMode == ReadFromCache);
     Q_ASSERT(m_request.cacheTag.file->openMode() == QIODevice::ReadOnly);
-    QByteArray ret = m_request.cacheTag.file->read(maxLength);
+    QIODevice *file = m_request.cacheTag.file;
+    QByteArray ret = file->read(maxLength);
     if (ret.isEmpty()) {
+        // the entry was served completely, keep it in memory for the next request if small enough
+        if (m_memoryCache && file->size() <= m_memoryCache->maxEntrySize()) {
+            auto *memoryDevice = dynamic_cast<MemoryCacheEntryDevice *>(file);
+            QByteArray entry;
+            if (!memoryDevice) {
+                file->seek(0);
+                entry = file->readAll();
+            } else if (memoryDevice->expireDate() != m_request.cacheTag.expireDate) {
+                // a validation has updated the expire date
+                entry = memoryDevice->data();
+            }
+            if (entry.size() > BinaryCacheFileHeader::size) {
+                entry.replace(0, BinaryCacheFileHeader::size, m_request.cacheTag.serialize());
+                memoryCacheInsert(entry);
+            }
+        }
         cacheFileClose();
     }
     return ret;
 }
 
+bool HTTPProtocol::varyRequestHeaderValues(const QByteArray &vary, QByteArray *values) const
+{
+    values->clear();
+    if (vary.isEmpty()) {
+        return true;
+    }
+    const QString customHeaders = sanitizeCustomHTTPHeader(metaData(QStringLiteral("customHTTPHeader")));
+    const QByteArrayList names = vary.split(',');
+    for (const QByteArray &rawName : names) {
+        const QByteArray name = rawName.trimmed().toLower();
+        QString value;
+        if (name == "*" || name == "cookie" || name == "authorization" || name == "proxy-authorization") {
+            // anything, or values that we only know when sending the request
+            return false;
+        } else if (name == "accept") {
+            value = metaData(QStringLiteral("accept"));
+            if (value.isEmpty()) {
+                value = QLatin1String(DEFAULT_ACCEPT_HEADER);
+            }
+        } else if (name == "accept-encoding") {
+            if (m_request.allowTransferCompression) {
+                value = acceptEncodingHeaderValue();
+            }
+        } else if (name == "accept-charset") {
+            value = m_request.charsets;
+        } else if (name == "accept-language") {
+            value = m_request.languages;
+        } else if (name == "user-agent") {
+            value = m_request.userAgent;
+        } else if (name == "referer") {
+            value = m_request.referrer;
+        } else {
+            const QStringList lines = customHeaders.split(QLatin1String("\r\n"));
+            const QString prefix = QString::fromLatin1(name) + QLatin1Char(':');
+            for (const QString &line : lines) {
+                if (line.startsWith(prefix, Qt::CaseInsensitive)) {
+                    value = line.mid(prefix.length()).trimmed();
+                    break;
+                }
+            }
+        }
+        *values += name + ": " + value.toLatin1() + '\n';
+    }
+    return true;
+}
+
+void HTTPProtocol::memoryCacheInsert(const QByteArray &entry)
+{
+    Q_ASSERT(m_memoryCache);
+    QByteArray vary;
+    for (const QString &header : std::as_const(m_responseHeaders)) {
+        if (header.startsWith(QLatin1String("vary:"), Qt::CaseInsensitive)) {
+            if (!vary.isEmpty()) {
+                vary += ',';
+            }
+            vary += header.mid(5).toLatin1();
+        }
+    }
+    const auto varyValues = [this](const QByteArray &vary, QByteArray *values) {
+        return varyRequestHeaderValues(vary, values);
+    };
+    if (!m_memoryCache->insert(storableUrl(m_request.url).toEncoded(), vary, varyValues, entry)) {
+        qCDebug(KIO_HTTP) << "Not keeping" << m_request.url << "in the memory cache.";
+    }
+}
+
 void HTTPProtocol::cacheFileWritePayload(const QByteArray &d)
 {
     if (!m_request.cacheTag.file) {
@@ -5034,13 +6122,38 @@ void HTTPProtocol::cachePostData(const QByteArray &data)
         if (!m_POSTbuf) {
             return;
         }
+    } else if (qobject_cast<QBuffer *>(m_POSTbuf) && m_POSTbuf->size() + data.size() > s_MaxInMemPostBufSize) {
+        // a body of unknown size outgrew the memory buffer
+        QIODevice *file = createPostBufferDeviceFor(s_MaxInMemPostBufSize + 1);
+        if (!file) {
+            clearPostDataBuffer();
+            return;
+        }
+        file->write(static_cast<QBuffer *>(m_POSTbuf)->data());
+        delete m_POSTbuf;
+        m_POSTbuf = file;
     }
 
     m_POSTbuf->write(data.constData(), data.size());
 }
 
+void HTTPProtocol::keepPostDataForRetry(const QByteArray &data)
+{
+    if (m_POSTbufIncomplete) {
+        return;
+    }
+
+    // Any response may ask for authentication, and then the body has to be sent again
+    cachePostData(data);
+    if (!m_POSTbuf) {
+        m_POSTbufIncomplete = true;
+    }
+}
+
 void HTTPProtocol::clearPostDataBuffer()
 {
+    m_POSTbufIncomplete = false;
+
     if (!m_POSTbuf) {
         return;
     }
@@ -5509,7 +6622,8 @@ void HTTPProtocol::copyPut(const QUrl &src, const QUrl &dest, JobFlags flags)
 
     resetSessionSettings();
 
-    if (!(flags & KIO::Overwrite)) {
+    // Webdav hosts are capable of observing overwrite == false
+    if (m_protocol.startsWith("webdav") && !(flags & KIO::Overwrite)) { // krazy:exclude=strings
         // check to make sure this host supports WebDAV
         if (!davHostOk()) {
             return;
@@ -15,6 +15,7 @@
 #include <QDateTime>
 #include <QList>
 #include <QLocalSocket>
+#include <QSet>
 #include <QStringList>
 #include <QUrl>
 
@@ -34,6 +35,9 @@ class AuthInfo;
 }
 
 class HeaderTokenizer;
+class HTTPCacheStore;
+class HTTPMemoryCache;
+class HTTPRangeCache;
 class KAbstractHttpAuthentication;
 
 class HTTPProtocol : public QObject, public KIO::TCPSlaveBase
@@ -75,6 +79,9 @@ public:
             ioMode = NoCache;
             bytesCached = 0;
             file = nullptr;
+            staleWhileRevalidate = 0;
+            staleIfError = 0;
+            useStale = false;
         }
 
         enum CachePlan {
@@ -84,6 +91,10 @@ public:
         };
         // int maxCacheAge refers to seconds
         CachePlan plan(int maxCacheAge) const;
+        // the plan without the RFC 5861 extensions, i.e. whether the entry should be validated before use
+        CachePlan strictPlan(int maxCacheAge) const;
+        // whether the entry is no more than @p staleSeconds past its freshness lifetime
+        bool isWithinStaleWindow(int maxCacheAge, qint64 staleSeconds) const;
 
         QByteArray serialize() const;
         bool deserialize(const QByteArray &);
@@ -94,11 +105,14 @@ public:
         quint32 fileUseCount;
         quint32 bytesCached;
         QString etag; // entity tag header as described in the HTTP standard.
-        QFile *file; // file on disk - either a QTemporaryFile (write) or QFile (read)
+        QIODevice *file; // either a QTemporaryFile (write) or a QFile or cache store record (read)
         QDateTime servedDate; // Date when the resource was served by the origin server
         QDateTime lastModifiedDate; // Last modified.
         QDateTime expireDate; // Date when the cache entry will expire
         QString charset;
+        qint64 staleWhileRevalidate; // RFC 5861 windows in seconds, from the response or the configuration
+        qint64 staleIfError;
+        bool useStale; // validating the entry failed, use it anyway (stale-if-error)
     };
 
     /** The request for the current connection **/
@@ -161,12 +175,39 @@ public:
         CacheTag cacheTag;
     };
 
+    /** A range request as it involves the range cache **/
+    struct RangeCacheRequest {
+        bool active = false; // the cache entry of the URL is open
+        KIO::filesize_t offset = 0; // the range the job asked for
+        KIO::filesize_t endoffset = 0;
+        qint64 end = -1; // end of the requested range, exclusive
+        qint64 spanStart = -1; // range to request from the network, with the cached
+        qint64 spanEnd = -1; // ranges around it sent from the cache; end exclusive
+        bool assemble = false; // the server confirmed the span, send the cached ranges too
+        qint64 writePos = -1; // where the received data goes in the cache, -1 for nowhere
+    };
+
+    /** A resource opened for random access with open(), read with range requests **/
+    struct FileJobState {
+        bool isActive = false; // open() was called
+        bool isOpen = false; // open() succeeded
+        KIO::filesize_t size = KIO::filesize_t(-1); // of the resource, -1 if unknown
+        KIO::filesize_t position = 0;
+        KIO::filesize_t blockSize = 0; // minimum size of the next range request
+        KIO::filesize_t bufferStart = 0;
+        QByteArray buffer; // the bytes from bufferStart on, read ahead
+        QString ifRange; // strong entity tag or modification date of the opened version
+        qint64 rangeFirst = -1; // Content-Range of the last response
+        qint64 rangeTotal = -1;
+    };
+
     /** State of the current connection to the server **/
     struct HTTPServerState {
         HTTPServerState()
         {
             isKeepAlive = false;
             isPersistentProxyConnection = false;
+            httpRev = HTTP_None;
         }
 
         void initFrom(const HTTPRequest &request)
@@ -197,6 +238,7 @@ public:
             proxyUrl.clear();
             isKeepAlive = false;
             isPersistentProxyConnection = false;
+            httpRev = HTTP_None;
         }
 
         QUrl url;
@@ -204,6 +246,7 @@ public:
         QUrl proxyUrl;
         bool isKeepAlive;
         bool isPersistentProxyConnection;
+        HTTP_REV httpRev; // of the last response received on this connection
     };
 
     //---------------------- Re-implemented methods ----------------
@@ -214,6 +257,15 @@ public:
     void get(const QUrl &url) override;
     void put(const QUrl &url, int _mode, KIO::JobFlags flags) override;
 
+    /**
+     * Random access for KIO::open() with Range requests on a keep-alive connection. Only
+     * reading is supported, and the server must support byte ranges.
+     */
+    void open(const QUrl &url, QIODevice::OpenMode mode) override;
+    void read(KIO::filesize_t size) override;
+    void seek(KIO::filesize_t offset) override;
+    void close() override;
+
     //----------------- Re-implemented methods for WebDAV -----------
     void listDir(const QUrl &url) override;
     void mkdir(const QUrl &url, int _permissions) override;
@@ -316,6 +368,25 @@ protected:
      * @p cacheHasPage will be set to true if the page was found, false otherwise.
      */
     bool satisfyRequestFromCache(bool *cacheHasPage);
+    /**
+     * Use the cache entry opened for validation if validating it failed and the entry
+     * may be used instead of an error (RFC 5861 stale-if-error). Returns whether to do so.
+     */
+    bool useStaleCacheEntry();
+    /**
+     * Like useStaleCacheEntry(), but for a connection that failed before the cache was
+     * consulted; opens the cache entry of the request first.
+     */
+    bool openStaleCacheEntry();
+    /**
+     * Serve a range request completely from the range cache if possible, otherwise determine
+     * the span that must come from the network. Return true if the request is done.
+     */
+    bool satisfyRangeFromCache();
+    /**
+     * Make the request that is sent ask for the span determined by satisfyRangeFromCache().
+     */
+    void rangeCachePrepareRequest();
     QString formatRequestUri() const;
     /**
      * create HTTP authentications response(s), if any
@@ -323,6 +394,12 @@ protected:
     QString authenticationHeader();
     bool sendQuery();
 
+    /**
+     * Return true if @p request may be sent while responses to earlier
+     * requests on the current connection are still outstanding.
+     */
+    bool canPipelineRequest(const HTTPRequest &request) const;
+
     /**
      * Close transfer
      */
@@ -361,6 +438,12 @@ protected:
 
     bool sendBody();
     bool sendCachedBody();
+    /**
+     * Send @p size bytes from file descriptor @p fd with sendfile().
+     * Returns 1 on success, 0 after an error() and -1 if nothing was sent
+     * because sendfile() does not support the descriptors.
+     */
+    int sendFileBody(int fd, qint64 size);
 
     // where dataInternal == true, the content is to be made available
     // to an internal function.
@@ -401,6 +484,29 @@ protected:
     QString findCookies(const QString &url);
 
     void cacheParseResponseHeader(const HeaderTokenizer &tokenizer);
+    /**
+     * Check a response to a range request against the range cache and prepare storing its
+     * body there. Return false if the request has to be sent again.
+     */
+    bool rangeCacheParseResponseHeader(const HeaderTokenizer &tokenizer);
+    /**
+     * Remember the Content-Range of a response to a request of an opened resource, and the
+     * validator of the resource while opening it.
+     */
+    void fileJobParseResponseHeader(const HeaderTokenizer &tokenizer);
+    /**
+     * Read @p length bytes at @p offset of the opened resource into its buffer.
+     */
+    bool fileJobFetch(KIO::filesize_t offset, KIO::filesize_t length);
+    /**
+     * Send the cached bytes from @p start to @p end exclusive to the job, counting them
+     * in @p processed.
+     */
+    bool rangeCacheSendData(qint64 start, qint64 end, KIO::filesize_t *processed);
+    /**
+     * Close the range cache entry of the current request, deleting it if @p discard is set.
+     */
+    void rangeCacheClose(bool discard = false);
 
     QString cacheFilePathFromUrl(const QUrl &url) const;
     bool cacheFileOpenRead();
@@ -419,7 +525,21 @@ protected:
      * load the rest of the text fields
      */
     bool cacheFileReadTextHeader2();
+    /**
+     * Reads the RFC 5861 stale-while-revalidate and stale-if-error windows of the cache entry
+     * opened for reading into the cache tag, leaving the file position unchanged.
+     */
+    void cacheFileReadStaleWindows();
     void setCacheabilityMetadata(bool cachingAllowed);
+    /**
+     * The values of the request headers named in the Vary header @p vary, as sent with
+     * the current request. Returns false if they are only known when the request is sent.
+     */
+    bool varyRequestHeaderValues(const QByteArray &vary, QByteArray *values) const;
+    /**
+     * Put the cache entry @p entry for the current request and response into the memory cache
+     */
+    void memoryCacheInsert(const QByteArray &entry);
 
     /**
      * Do everything proceedUntilResponseHeader does, and also get the response body.
@@ -462,6 +582,12 @@ protected:
      */
     void cachePostData(const QByteArray &);
 
+    /**
+     * Caches streamed POST data for sending it again. If that fails,
+     * the body can't be sent twice.
+     */
+    void keepPostDataForRetry(const QByteArray &);
+
     /**
      * Clears the POST data buffer.
      *
@@ -517,6 +643,7 @@ protected:
     HTTPServerState m_server;
     HTTPRequest m_request;
     QList<HTTPRequest> m_requestQueue;
+    QSet<QString> m_pipeliningBrokenHosts; ///< host:port of servers that dropped pipelined requests
 
     // Processing related
     KIO::filesize_t m_iSize; ///< Expected size of message
@@ -528,6 +655,7 @@ protected:
     bool m_isChunked; ///< Chunked transfer encoding
 
     bool m_isBusy; ///< Busy handling request queue.
+    bool m_isPipelinedResponse; ///< Reading the response to a pipelined request
     bool m_isEOF;
     bool m_isEOD;
 
@@ -558,11 +686,19 @@ protected:
     // happened to get a 401/407 response when submitting
     // a form.
     QIODevice *m_POSTbuf;
+    // The POST data was sent, but it could not be kept in m_POSTbuf
+    bool m_POSTbufIncomplete;
 
     // Cache related
     int m_maxCacheAge; ///< Maximum age of a cache entry in seconds.
     long m_maxCacheSize; ///< Maximum cache size in Kb.
     QString m_strCacheDir; ///< Location of the cache.
+    HTTPCacheStore *m_cacheStore; ///< Cache storage backend, null for one file per URL
+    HTTPMemoryCache *m_memoryCache; ///< Shared cache of small entries in front of the disk cache, null if disabled
+    HTTPRangeCache *m_rangeCache; ///< Cache of byte ranges for range requests, null if disabled
+    RangeCacheRequest m_rangeRequest;
+
+    FileJobState m_fileJob;
     QLocalSocket m_cacheCleanerConnection; ///< Connection to the cache cleaner process
 
     // Operation mode
@@ -17,12 +17,22 @@
 #include <QElapsedTimer>
 #include <QLocalServer>
 #include <QLocalSocket>
+#include <QScopedPointer>
+#include <QSet>
 #include <QString>
 
+#include <KConfigGroup>
 #include <KLocalizedString>
+#include <KSharedConfig>
 #include <QDebug>
+#include <http_slave_defaults.h>
 #include <kprotocolmanager.h>
 
+#include "httpcacheevictionqueue.h"
+#include "httpcachestore.h"
+#include "httpmemorycache.h"
+#include "httprangecache.h"
+
 #include <QCommandLineOption>
 #include <QCommandLineParser>
 #include <QCryptographicHash>
@@ -37,6 +47,8 @@ qint64 g_maxCacheSize;
 
 static const char appFullName[] = "org.kio5.kio_http_cache_cleaner";
 static const char appName[] = "kio_http_cache_cleaner";
+static const int s_scoreboardWriteInterval = 5 * 60 * 1000; // ms
+static const int s_rangeCacheTrimInterval = 10 * 60 * 1000; // ms
 
 // !START OF SYNC!
 // Keep the following in sync with the cache code in http.cpp
@@ -73,8 +85,6 @@ struct MiniCacheFileInfo {
     // from filesystem
     QDateTime lastUsedDate;
     qint64 sizeOnDisk;
-    // we want to delete the least "useful" files and we'll have to sort a list for that...
-    bool operator<(const MiniCacheFileInfo &other) const;
     void debugPrint() const
     {
         // qDebug() << "useCount:" << useCount
@@ -117,22 +127,11 @@ struct CacheFileInfo : MiniCacheFileInfo {
     }
 };
 
-bool MiniCacheFileInfo::operator<(const MiniCacheFileInfo &other) const
-{
-    const int thisUseful = useCount / qMax(lastUsedDate.secsTo(g_currentDate), qint64(1));
-    const int otherUseful = other.useCount / qMax(other.lastUsedDate.secsTo(g_currentDate), qint64(1));
-    return thisUseful < otherUseful;
-}
-
-bool CacheFileInfoPtrLessThan(const CacheFileInfo *cf1, const CacheFileInfo *cf2)
-{
-    return *cf1 < *cf2;
-}
-
 enum OperationMode {
     CleanCache = 0,
     DeleteCache,
     FileInfo,
+    MemoryCacheStats,
 };
 
 static bool readBinaryHeader(const QByteArray &d, CacheFileInfo *fi)
@@ -201,14 +200,14 @@ static bool readLineChecked(QIODevice *dev, QByteArray *line)
     return true;
 }
 
-static bool readTextHeader(QFile *file, CacheFileInfo *fi, OperationMode mode)
+static bool readTextHeader(QIODevice *file, CacheFileInfo *fi, OperationMode mode)
 {
     bool ok = true;
     QByteArray readBuf;
 
     ok = ok && readLineChecked(file, &readBuf);
     fi->url = QString::fromLatin1(readBuf);
-    if (filenameFromUrl(readBuf) != QFileInfo(*file).baseName()) {
+    if (filenameFromUrl(readBuf) != fi->baseName) {
         // qDebug() << "You have witnessed a very improbable hash collision!";
         return false;
     }
@@ -265,88 +264,29 @@ static bool readCacheFile(const QString &baseName, CacheFileInfo *fi, OperationM
     return true;
 }
 
-class Scoreboard;
-
-class CacheIndex
+// the cache store counterpart of readCacheFile(), only used for --file-info
+static bool readStoreEntry(HTTPCacheStore *store, const QString &baseName, CacheFileInfo *fi, OperationMode mode)
 {
-public:
-    explicit CacheIndex(const QString &baseName)
-    {
-        QByteArray ba = baseName.toLatin1();
-        const int sz = ba.size();
-        const char *input = ba.constData();
-        Q_ASSERT(sz == s_hashedUrlNibbles);
-
-        int translated = 0;
-        for (int i = 0; i < sz; i++) {
-            int c = input[i];
-
-            if (c >= '0' && c <= '9') {
-                translated |= c - '0';
-            } else if (c >= 'a' && c <= 'f') {
-                translated |= c - 'a' + 10;
-            } else {
-                Q_ASSERT(false);
-            }
-
-            if (i & 1) {
-                // odd index
-                m_index[i >> 1] = translated;
-                translated = 0;
-            } else {
-                translated = translated << 4;
-            }
-        }
-
-        computeHash();
-    }
-
-    bool operator==(const CacheIndex &other) const
-    {
-        const bool isEqual = memcmp(m_index, other.m_index, s_hashedUrlBytes) == 0;
-        if (isEqual) {
-            Q_ASSERT(m_hash == other.m_hash);
-        }
-        return isEqual;
+    HTTPCacheStore::Entry entry;
+    if (!store->find(QByteArray::fromHex(baseName.toLatin1()), &entry)) {
+        return false;
     }
-
-private:
-    explicit CacheIndex(const QByteArray &index)
-    {
-        Q_ASSERT(index.length() >= s_hashedUrlBytes);
-        memcpy(m_index, index.constData(), s_hashedUrlBytes);
-        computeHash();
+    QScopedPointer<QIODevice> record(store->openRecord(entry));
+    if (!record) {
+        return false;
     }
+    fi->baseName = baseName;
 
-    void computeHash()
-    {
-        uint hash = 0;
-        const int ints = s_hashedUrlBytes / sizeof(uint);
-        for (int i = 0; i < ints; i++) {
-            hash ^= reinterpret_cast<uint *>(&m_index[0])[i];
-        }
-        if (const int bytesLeft = s_hashedUrlBytes % sizeof(uint)) {
-            // dead code until a new url hash algorithm or architecture with sizeof(uint) != 4 appears.
-            // we have the luxury of ignoring endianness because the hash is never written to disk.
-            // just merge the bits into the hash in some way.
-            const int offset = ints * sizeof(uint);
-            for (int i = 0; i < bytesLeft; i++) {
-                hash ^= static_cast<uint>(m_index[offset + i]) << (i * 8);
-            }
-        }
-        m_hash = hash;
+    QByteArray header = record->read(SerializedCacheFileInfo::size);
+    if (!readBinaryHeader(header, fi) || !readTextHeader(record.data(), fi, mode)) {
+        return false;
     }
-
-    friend uint qHash(const CacheIndex &);
-    friend class Scoreboard;
-
-    quint8 m_index[s_hashedUrlBytes]; // packed binary version of the hexadecimal name
-    uint m_hash;
-};
-
-uint qHash(const CacheIndex &ci)
-{
-    return ci.m_hash;
+    // the index is more current than the record
+    fi->useCount = entry.useCount;
+    fi->expireDate.setSecsSinceEpoch(entry.expireDate);
+    fi->lastUsedDate.setSecsSinceEpoch(entry.lastUsedDate);
+    fi->sizeOnDisk = entry.size;
+    return true;
 }
 
 static CacheCleanerCommand readCommand(const QByteArray &cmd, CacheFileInfo *fi)
@@ -378,14 +318,30 @@ struct ScoreboardEntry {
     qint64 lastUsedDate;
     qint32 sizeOnDisk;
     static const int size = 36;
-    // we want to delete the least "useful" files and we'll have to sort a list for that...
-    bool operator<(const MiniCacheFileInfo &other) const;
 };
 
+static QByteArray keyFromBaseName(const QString &baseName)
+{
+    Q_ASSERT(baseName.length() == s_hashedUrlNibbles);
+    return QByteArray::fromHex(baseName.toLatin1());
+}
+
+static HTTPCacheEvictionQueue::Info evictionInfo(const MiniCacheFileInfo &mcfi)
+{
+    HTTPCacheEvictionQueue::Info info;
+    info.useCount = mcfi.useCount;
+    info.lastUsedDate = mcfi.lastUsedDate.toSecsSinceEpoch();
+    info.size = mcfi.sizeOnDisk;
+    return info;
+}
+
+// What we know about the cache files, kept up to date by the commands of the kio_http workers
+// and saved in the scoreboard file between runs, so that we don't have to open every file.
 class Scoreboard
 {
 public:
     Scoreboard()
+        : m_isDirty(false)
     {
         // read in the scoreboard...
         QFile sboard(filePath(QStringLiteral("scoreboard")));
@@ -400,7 +356,7 @@ public:
                 const QString entryBasename = QString::fromLatin1(baIndex.toHex());
                 MiniCacheFileInfo mcfi;
                 if (readAndValidateMcfi(baRest, entryBasename, &mcfi)) {
-                    m_scoreboard.insert(CacheIndex(baIndex), mcfi);
+                    m_queue.insert(baIndex, evictionInfo(mcfi));
                 }
             }
         }
@@ -415,30 +371,29 @@ public:
         }
         QDataStream stream(&sboard);
 
-        QHash<CacheIndex, MiniCacheFileInfo>::ConstIterator it = m_scoreboard.constBegin();
-        for (; it != m_scoreboard.constEnd(); ++it) {
-            const char *indexData = reinterpret_cast<const char *>(it.key().m_index);
-            stream.writeRawData(indexData, s_hashedUrlBytes);
+        m_queue.forEach([&stream](const QByteArray &key, const HTTPCacheEvictionQueue::Info &info) {
+            stream.writeRawData(key.constData(), s_hashedUrlBytes);
 
-            stream << it.value().useCount;
-            stream << it.value().lastUsedDate.toSecsSinceEpoch();
-            stream << qint32(it.value().sizeOnDisk);
-        }
+            stream << info.useCount;
+            stream << info.lastUsedDate;
+            stream << qint32(info.size);
+        });
+        m_isDirty = false;
     }
 
-    bool fillInfo(const QString &baseName, MiniCacheFileInfo *mcfi)
+    bool isDirty() const
     {
-        QHash<CacheIndex, MiniCacheFileInfo>::ConstIterator it = m_scoreboard.constFind(CacheIndex(baseName));
-        if (it == m_scoreboard.constEnd()) {
-            return false;
-        }
-        *mcfi = it.value();
-        return true;
+        return m_isDirty;
     }
 
-    qint64 runCommand(const QByteArray &cmd)
+    bool contains(const QString &baseName) const
     {
-        // execute the command; return number of bytes if a new file was created, zero otherwise.
+        return m_queue.contains(keyFromBaseName(baseName));
+    }
+
+    void runCommand(const QByteArray &cmd)
+    {
+        // execute the command
         Q_ASSERT(cmd.size() == 80);
         CacheFileInfo fi;
         const CacheCleanerCommand ccc = readCommand(cmd, &fi);
@@ -448,7 +403,7 @@ public:
         case CreateFileNotificationCommand:
             // qDebug() << "CreateNotificationCommand for" << fi.baseName;
             if (!readBinaryHeader(cmd, &fi)) {
-                return 0;
+                return;
             }
             break;
 
@@ -460,7 +415,7 @@ public:
             CacheFileInfo fiFromDisk;
             QByteArray header = file.read(SerializedCacheFileInfo::size);
             if (!readBinaryHeader(header, &fiFromDisk) || fiFromDisk.bytesCached != fi.bytesCached) {
-                return 0;
+                return;
             }
 
             // adjust the use count, to make sure that we actually count up. (slaves read the file
@@ -478,56 +433,70 @@ public:
             file.close();
 
             if (!readBinaryHeader(newHeader, &fi)) {
-                return 0;
+                return;
             }
             break;
         }
 
         default:
             // qDebug() << "received invalid command";
-            return 0;
+            return;
         }
 
         QFileInfo fileInfo(fileName);
         fi.lastUsedDate = fileInfo.lastModified();
         fi.sizeOnDisk = fileInfo.size();
         fi.debugPrint();
-        // a CacheFileInfo is-a MiniCacheFileInfo which enables the following assignment...
+        // a CacheFileInfo is-a MiniCacheFileInfo which enables the following call...
         add(fi);
-        // finally, return cache dir growth (only relevant if a file was actually created!)
-        return ccc == CreateFileNotificationCommand ? fi.sizeOnDisk : 0;
     }
 
     void add(const CacheFileInfo &fi)
     {
-        m_scoreboard[CacheIndex(fi.baseName)] = fi;
+        m_queue.insert(keyFromBaseName(fi.baseName), evictionInfo(fi));
+        m_isDirty = true;
     }
 
-    void remove(const QString &basename)
+    qint64 totalSizeOnDisk() const
     {
-        m_scoreboard.remove(CacheIndex(basename));
+        return m_queue.totalSize();
     }
 
-    // keep memory usage reasonably low - otherwise entries of nonexistent files don't hurt.
-    void maybeRemoveStaleEntries(const QList<CacheFileInfo *> &fiList)
+    // Delete the least useful files until the cache is no larger than @p maxSize. Return true
+    // when done, false when the time for this slice is up.
+    bool evictSlice(qint64 maxSize)
     {
-        // don't bother when there are a few bogus entries
-        if (m_scoreboard.count() < fiList.count() + 100) {
-            return;
-        }
-        // qDebug() << "we have too many fake/stale entries, cleaning up...";
-        QSet<CacheIndex> realFiles;
-        for (CacheFileInfo *fi : fiList) {
-            realFiles.insert(CacheIndex(fi->baseName));
+        QElapsedTimer t;
+        t.start();
+        while (m_queue.totalSize() > maxSize) {
+            if (t.elapsed() >= 100) {
+                return false;
+            }
+            const QByteArray key = m_queue.takeLeastUseful();
+            if (key.isEmpty()) {
+                break;
+            }
+            // the file may be gone already, which is just as good
+            QFile::remove(filePath(QString::fromLatin1(key.toHex())));
+            m_isDirty = true;
         }
-        QHash<CacheIndex, MiniCacheFileInfo>::Iterator it = m_scoreboard.begin();
-        while (it != m_scoreboard.end()) {
-            if (realFiles.contains(it.key())) {
-                ++it;
-            } else {
-                it = m_scoreboard.erase(it);
+        // qDebug() << "total size of cache files after cleaning is" << m_queue.totalSize();
+        return true;
+    }
+
+    // forget about files that don't exist anymore
+    void removeStaleEntries(const QSet<QString> &existingFiles)
+    {
+        QList<QByteArray> staleKeys;
+        m_queue.forEach([&](const QByteArray &key, const HTTPCacheEvictionQueue::Info &) {
+            if (!existingFiles.contains(QString::fromLatin1(key.toHex()))) {
+                staleKeys.append(QByteArray(key.constData(), key.size()));
             }
+        });
+        for (const QByteArray &key : std::as_const(staleKeys)) {
+            m_queue.remove(key);
         }
+        m_isDirty = m_isDirty || !staleKeys.isEmpty();
     }
 
 private:
@@ -574,12 +543,35 @@ private:
         return ok;
     }
 
-    QHash<CacheIndex, MiniCacheFileInfo> m_scoreboard;
+    HTTPCacheEvictionQueue m_queue;
+    bool m_isDirty;
 };
 
 // Keep the above in sync with the cache code in http.cpp
 // !END OF SYNC!
 
+// check if the filename is of the $s_hashedUrlNibbles letters, 0...f type, possibly followed
+// by the random part of a temporary file name
+static bool isCacheEntryName(const QString &baseName)
+{
+    if (baseName.length() < s_hashedUrlNibbles) {
+        return false;
+    }
+    for (int i = 0; i < s_hashedUrlNibbles; i++) {
+        const QChar c = baseName[i];
+        if (!((c >= QLatin1Char('0') && c <= QLatin1Char('9')) || (c >= QLatin1Char('a') && c <= QLatin1Char('f')))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isStaleTemporaryFile(const QString &baseName)
+{
+    // it looks like a temporary file that hasn't been touched in > 15 minutes...
+    return baseName.length() > s_hashedUrlNibbles && QFileInfo(filePath(baseName)).lastModified().secsTo(g_currentDate) > 15 * 60;
+}
+
 // remove files and directories used by earlier versions of the HTTP cache.
 static void removeOldFiles()
 {
@@ -593,109 +585,127 @@ static void removeOldFiles()
     QFile::remove(cacheRootDir + QLatin1String("cleaned"));
 }
 
+// Goes once through all files in the cache directory. It tells the scoreboard about the files that
+// it does not know and makes it forget the files that are gone, or deletes all files if there is no
+// scoreboard.
 class CacheCleaner
 {
 public:
     CacheCleaner(const QDir &cacheDir)
-        : m_totalSizeOnDisk(0)
     {
         // qDebug();
         m_fileNameList = cacheDir.entryList(QDir::Files);
     }
 
-    // Delete some of the files that need to be deleted. Return true when done, false otherwise.
-    // This makes interleaved cleaning / serving ioslaves possible.
+    // Process some of the files. Return true when done, false otherwise.
+    // This makes interleaved scanning / serving ioslaves possible.
     bool processSlice(Scoreboard *scoreboard = nullptr)
     {
         QElapsedTimer t;
         t.start();
-        // phase one: gather information about cache files
-        if (!m_fileNameList.isEmpty()) {
-            while (t.elapsed() < 100 && !m_fileNameList.isEmpty()) {
-                QString baseName = m_fileNameList.takeFirst();
-                // check if the filename is of the $s_hashedUrlNibbles letters, 0...f type
-                if (baseName.length() < s_hashedUrlNibbles) {
-                    continue;
-                }
-                bool nameOk = true;
-                for (int i = 0; i < s_hashedUrlNibbles && nameOk; i++) {
-                    QChar c = baseName[i];
-                    nameOk = (c >= QLatin1Char('0') && c <= QLatin1Char('9')) || (c >= QLatin1Char('a') && c <= QLatin1Char('f'));
-                }
-                if (!nameOk) {
-                    continue;
-                }
-                if (baseName.length() > s_hashedUrlNibbles) {
-                    if (QFileInfo(filePath(baseName)).lastModified().secsTo(g_currentDate) > 15 * 60) {
-                        // it looks like a temporary file that hasn't been touched in > 15 minutes...
-                        QFile::remove(filePath(baseName));
-                    }
-                    // the temporary file might still be written to, leave it alone
-                    continue;
+        while (t.elapsed() < 100 && !m_fileNameList.isEmpty()) {
+            QString baseName = m_fileNameList.takeFirst();
+            if (!isCacheEntryName(baseName)) {
+                continue;
+            }
+            if (baseName.length() > s_hashedUrlNibbles) {
+                if (isStaleTemporaryFile(baseName)) {
+                    QFile::remove(filePath(baseName));
                 }
+                // the temporary file might still be written to, leave it alone
+                continue;
+            }
 
-                CacheFileInfo *fi = new CacheFileInfo();
-                fi->baseName = baseName;
-
-                bool gotInfo = false;
-                if (scoreboard) {
-                    gotInfo = scoreboard->fillInfo(baseName, fi);
-                }
-                if (!gotInfo) {
-                    gotInfo = readCacheFile(baseName, fi, CleanCache);
-                    if (gotInfo && scoreboard) {
-                        scoreboard->add(*fi);
-                    }
-                }
-                if (gotInfo) {
-                    m_fiList.append(fi);
-                    m_totalSizeOnDisk += fi->sizeOnDisk;
-                } else {
-                    delete fi;
+            if (!scoreboard) {
+                QFile::remove(filePath(baseName));
+                continue;
+            }
+            if (!scoreboard->contains(baseName)) {
+                CacheFileInfo fi;
+                if (!readCacheFile(baseName, &fi, CleanCache)) {
+                    continue;
                 }
+                scoreboard->add(fi);
             }
-            // qDebug() << "total size of cache files is" << m_totalSizeOnDisk;
+            m_existingFiles.insert(baseName);
+        }
 
-            if (m_fileNameList.isEmpty()) {
-                // final step of phase one
-                std::sort(m_fiList.begin(), m_fiList.end(), CacheFileInfoPtrLessThan);
-            }
+        if (!m_fileNameList.isEmpty()) {
             return false;
         }
+        if (scoreboard) {
+            scoreboard->removeStaleEntries(m_existingFiles);
+        }
+        return true;
+    }
 
-        // phase two: delete files until cache is under maximum allowed size
+private:
+    QStringList m_fileNameList;
+    QSet<QString> m_existingFiles;
+};
+
+// Cleans the cache store (see httpcachestore.h). Its index has all the information needed to
+// choose the entries to evict, so no entry has to be opened for that.
+class StoreCleaner
+{
+public:
+    explicit StoreCleaner(HTTPCacheStore *store)
+        : m_store(store)
+    {
+        const QList<HTTPCacheStore::Entry> entries = store->entries();
+        for (const HTTPCacheStore::Entry &entry : entries) {
+            HTTPCacheEvictionQueue::Info info;
+            info.useCount = entry.useCount;
+            info.lastUsedDate = entry.lastUsedDate;
+            info.size = entry.size;
+            m_queue.insert(entry.key, info);
+        }
+    }
 
-        // TODO: delete files larger than allowed for a single file
+    // Return true when done, false otherwise; see CacheCleaner::processSlice().
+    bool processSlice()
+    {
+        QElapsedTimer t;
+        t.start();
         while (t.elapsed() < 100) {
-            if (m_totalSizeOnDisk <= g_maxCacheSize || m_fiList.isEmpty()) {
-                // qDebug() << "total size of cache files after cleaning is" << m_totalSizeOnDisk;
-                if (scoreboard) {
-                    scoreboard->maybeRemoveStaleEntries(m_fiList);
-                    scoreboard->writeOut();
-                }
-                qDeleteAll(m_fiList);
-                m_fiList.clear();
-                return true;
+            // phase one: remove entries until the cache is under the maximum allowed size
+            if (m_queue.count() && m_store->liveBytes() > g_maxCacheSize) {
+                m_store->remove(m_queue.takeLeastUseful());
+                continue;
             }
-            CacheFileInfo *fi = m_fiList.takeFirst();
-            QString filename = filePath(fi->baseName);
-            if (QFile::remove(filename)) {
-                m_totalSizeOnDisk -= fi->sizeOnDisk;
-                if (scoreboard) {
-                    scoreboard->remove(fi->baseName);
-                }
+            // phase two: reclaim the space of removed and replaced entries
+            if (!m_store->compactSegment()) {
+                return true;
             }
-            delete fi;
         }
         return false;
     }
 
 private:
-    QStringList m_fileNameList;
-    QList<CacheFileInfo *> m_fiList;
-    qint64 m_totalSizeOnDisk;
+    HTTPCacheStore *const m_store;
+    HTTPCacheEvictionQueue m_queue;
 };
 
+// the cache store keeps its statistics itself, so the commands only tell how much the cache grew
+static qint64 newBytesFromCommand(const QByteArray &cmd)
+{
+    CacheFileInfo fi;
+    return readCommand(cmd, &fi) == CreateFileNotificationCommand ? fi.bytesCached : 0;
+}
+
+// with the cache store enabled, files of the one-file-per-URL layout are dead weight
+static void removeFileCacheEntries(const QDir &cacheDir)
+{
+    const QStringList fileNames = cacheDir.entryList(QDir::Files);
+    for (const QString &baseName : fileNames) {
+        // leave temporary files alone that may still be written to
+        if (isCacheEntryName(baseName) && (baseName.length() == s_hashedUrlNibbles || isStaleTemporaryFile(baseName))) {
+            QFile::remove(filePath(baseName));
+        }
+    }
+    QFile::remove(filePath(QStringLiteral("scoreboard")));
+}
+
 int main(int argc, char **argv)
 {
     QCoreApplication app(argc, argv);
@@ -711,6 +721,8 @@ int main(int argc, char **argv)
     parser.addOption(QCommandLineOption(QStringList{QStringLiteral("file-info")},
                                         QCoreApplication::translate("main", "Display information about cache file"),
                                         QStringLiteral("filename")));
+    parser.addOption(QCommandLineOption(QStringList{QStringLiteral("memory-cache-stats")},
+                                        QCoreApplication::translate("main", "Display statistics of the memory cache shared by the http workers")));
     parser.process(app);
 
     OperationMode mode = CleanCache;
@@ -718,12 +730,32 @@ int main(int argc, char **argv)
         mode = DeleteCache;
     } else if (parser.isSet(QStringLiteral("file-info"))) {
         mode = FileInfo;
+    } else if (parser.isSet(QStringLiteral("memory-cache-stats"))) {
+        mode = MemoryCacheStats;
+    }
+
+    const KConfigGroup config(KSharedConfig::openConfig(QStringLiteral("kio_httprc"), KConfig::NoGlobals), QString());
+    const bool useStore = config.readEntry("UseCacheStore", false);
+    HTTPCacheStore store(cacheDir());
+
+    if (mode == MemoryCacheStats) {
+        const HTTPMemoryCache memoryCache(config.readEntry("MemoryCacheSize", DEFAULT_MEMORY_CACHE_SIZE) * 1024,
+                                          config.readEntry("MemoryCacheMaxEntrySize", DEFAULT_MEMORY_CACHE_MAX_ENTRY_SIZE) * 1024);
+        const HTTPMemoryCache::Statistics stats = memoryCache.statistics();
+        QTextStream out(stdout, QIODevice::WriteOnly);
+        out << "Memory cache " << stats.totalSize - stats.freeSize << " of " << stats.totalSize << " bytes used";
+        out << "\n hits       " << stats.hits;
+        out << "\n misses     " << stats.misses;
+        out << "\n insertions " << stats.insertions;
+        out << "\n rejections " << stats.rejections << '\n';
+        return 0;
     }
 
     // file info mode: no scanning of directories, just output info and exit.
     if (mode == FileInfo) {
         CacheFileInfo fi;
-        if (!readCacheFile(parser.value(QStringLiteral("file-info")), &fi, mode)) {
+        const QString baseName = parser.value(QStringLiteral("file-info"));
+        if (useStore ? !(store.open() && readStoreEntry(&store, baseName, &fi, mode)) : !readCacheFile(baseName, &fi, mode)) {
             return 1;
         }
         fi.prettyPrint();
@@ -766,9 +798,21 @@ int main(int argc, char **argv)
         CacheCleaner cleaner(cacheDir);
         while (!cleaner.processSlice()) { }
         QFile::remove(filePath(QStringLiteral("scoreboard")));
+        // also when the store is disabled, it may have been in use before
+        store.clear();
+        HTTPMemoryCache::deleteCache();
+        HTTPRangeCache::clear(cacheDirName);
         return 0;
     }
 
+    if (useStore) {
+        if (!store.open()) {
+            fprintf(stderr, "%s: Could not open the cache store in '%s'.\n", appName, qPrintable(cacheDirName));
+            return 1;
+        }
+        removeFileCacheEntries(cacheDir);
+    }
+
     QLocalServer lServer;
     const QString socketFileName = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + QLatin1String("/kio_http_cache_cleaner");
     // we need to create the file by opening the socket, otherwise it won't work
@@ -777,10 +821,25 @@ int main(int argc, char **argv)
         qWarning() << "Error listening on" << socketFileName;
     }
     QList<QLocalSocket *> sockets;
-    qint64 newBytesCounter = LLONG_MAX; // force cleaner run on startup
+    qint64 newBytesCounter = LLONG_MAX; // force store cleaner run on startup
 
     Scoreboard scoreboard;
-    CacheCleaner *cleaner = nullptr;
+    // Scan the cache directory once to catch up with what happened while we were not running.
+    // From then on the scoreboard is kept up to date by the commands of the kio_http workers.
+    CacheCleaner *cleaner = useStore ? nullptr : new CacheCleaner(cacheDir);
+    StoreCleaner *storeCleaner = nullptr;
+    QElapsedTimer scoreboardWriteTimer;
+    scoreboardWriteTimer.start();
+    // the range cache is not reported to the cleaner, it is trimmed by looking at it now and then
+    const bool useRangeCache = config.readEntry("UseRangeCache", false);
+    const qint64 maxRangeCacheSize = config.readEntry("RangeCacheSize", DEFAULT_RANGE_CACHE_SIZE) * qint64(1024);
+    if (useRangeCache) {
+        HTTPRangeCache::trim(cacheDirName, maxRangeCacheSize);
+    } else {
+        HTTPRangeCache::clear(cacheDirName);
+    }
+    QElapsedTimer rangeCacheTrimTimer;
+    rangeCacheTrimTimer.start();
     while (QDBusConnection::sessionBus().isConnected()) {
         g_currentDate = QDateTime::currentDateTime();
 
@@ -812,7 +871,11 @@ int main(int argc, char **argv)
                     break;
                 }
                 Q_ASSERT(recv.size() == 80);
-                newBytesCounter += scoreboard.runCommand(recv);
+                if (useStore) {
+                    newBytesCounter += newBytesFromCommand(recv);
+                } else {
+                    scoreboard.runCommand(recv);
+                }
             }
         }
 
@@ -823,11 +886,31 @@ int main(int argc, char **argv)
                 delete cleaner;
                 cleaner = nullptr;
             }
+        } else if (!useStore) {
+            if (scoreboard.totalSizeOnDisk() > g_maxCacheSize) {
+                scoreboard.evictSlice(g_maxCacheSize);
+            }
+            if (scoreboard.isDirty() && scoreboardWriteTimer.elapsed() > s_scoreboardWriteInterval) {
+                scoreboard.writeOut();
+                scoreboardWriteTimer.restart();
+            }
+        } else if (storeCleaner) {
+            if (storeCleaner->processSlice()) {
+                delete storeCleaner;
+                storeCleaner = nullptr;
+            }
         } else if (newBytesCounter > (g_maxCacheSize / 8)) {
-            cacheDir.refresh();
-            cleaner = new CacheCleaner(cacheDir);
+            storeCleaner = new StoreCleaner(&store);
             newBytesCounter = 0;
         }
+
+        if (useRangeCache && rangeCacheTrimTimer.elapsed() > s_rangeCacheTrimInterval) {
+            HTTPRangeCache::trim(cacheDirName, maxRangeCacheSize);
+            rangeCacheTrimTimer.restart();
+        }
+    }
+    if (scoreboard.isDirty()) {
+        scoreboard.writeOut();
     }
     return 0;
 }
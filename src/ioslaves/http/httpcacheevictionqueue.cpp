@@ -0,0 +1,128 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "httpcacheevictionqueue.h"
+
+#include <algorithm>
+
+uint qHash(const HTTPCacheEvictionQueue::Key &key)
+{
+    // the key is a cryptographic hash already, any part of it makes a good hash code
+    uint hash;
+    memcpy(&hash, key.bytes, sizeof(hash));
+    return hash;
+}
+
+void HTTPCacheEvictionQueue::insert(const QByteArray &key, const Info &info)
+{
+    const Key k = toKey(key);
+    auto it = m_entries.find(k);
+    if (it != m_entries.end()) {
+        m_totalSize -= it->size;
+        *it = info;
+    } else {
+        m_entries.insert(k, info);
+    }
+    m_totalSize += info.size;
+    push(k, info);
+}
+
+bool HTTPCacheEvictionQueue::remove(const QByteArray &key)
+{
+    auto it = m_entries.find(toKey(key));
+    if (it == m_entries.end()) {
+        return false;
+    }
+    // the heap item is skipped when it comes up
+    m_totalSize -= it->size;
+    m_entries.erase(it);
+    return true;
+}
+
+bool HTTPCacheEvictionQueue::contains(const QByteArray &key) const
+{
+    return m_entries.contains(toKey(key));
+}
+
+bool HTTPCacheEvictionQueue::find(const QByteArray &key, Info *info) const
+{
+    auto it = m_entries.constFind(toKey(key));
+    if (it == m_entries.constEnd()) {
+        return false;
+    }
+    *info = it.value();
+    return true;
+}
+
+int HTTPCacheEvictionQueue::count() const
+{
+    return m_entries.count();
+}
+
+qint64 HTTPCacheEvictionQueue::totalSize() const
+{
+    return m_totalSize;
+}
+
+QByteArray HTTPCacheEvictionQueue::takeLeastUseful()
+{
+    while (!m_heap.empty()) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), isMoreUseful);
+        const HeapItem item = m_heap.back();
+        m_heap.pop_back();
+
+        auto it = m_entries.find(item.key);
+        // skip the items of removed entries and the outdated items of updated ones
+        if (it == m_entries.end() || it->lastUsedDate != item.lastUsedDate || it->useCount != item.useCount) {
+            continue;
+        }
+        m_totalSize -= it->size;
+        m_entries.erase(it);
+        return QByteArray(reinterpret_cast<const char *>(item.key.bytes), keySize);
+    }
+    return QByteArray();
+}
+
+void HTTPCacheEvictionQueue::clear()
+{
+    m_entries.clear();
+    m_heap.clear();
+    m_totalSize = 0;
+}
+
+HTTPCacheEvictionQueue::Key HTTPCacheEvictionQueue::toKey(const QByteArray &key)
+{
+    Q_ASSERT(key.size() == keySize);
+    Key ret;
+    memcpy(ret.bytes, key.constData(), keySize);
+    return ret;
+}
+
+bool HTTPCacheEvictionQueue::isMoreUseful(const HeapItem &item1, const HeapItem &item2)
+{
+    // the std heap functions keep the "largest" item in front, so this puts the least useful one there
+    if (item1.lastUsedDate != item2.lastUsedDate) {
+        return item1.lastUsedDate > item2.lastUsedDate;
+    }
+    return item1.useCount > item2.useCount;
+}
+
+void HTTPCacheEvictionQueue::push(const Key &key, const Info &info)
+{
+    // rebuild instead of growing without bounds when entries keep being updated or removed
+    if (m_heap.size() >= 2 * size_t(m_entries.size()) + 1024) {
+        m_heap.clear();
+        m_heap.reserve(m_entries.size());
+        for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+            m_heap.push_back({it->lastUsedDate, it->useCount, it.key()});
+        }
+        std::make_heap(m_heap.begin(), m_heap.end(), isMoreUseful);
+        // the rebuilt heap already contains the new item
+        return;
+    }
+    m_heap.push_back({info.lastUsedDate, info.useCount, key});
+    std::push_heap(m_heap.begin(), m_heap.end(), isMoreUseful);
+}
@@ -0,0 +1,83 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef HTTPCACHEEVICTIONQUEUE_H
+#define HTTPCACHEEVICTIONQUEUE_H
+
+#include <QByteArray>
+#include <QHash>
+
+#include <cstring>
+#include <vector>
+
+/**
+ * The entries of the HTTP cache in the order in which kio_http_cache_cleaner evicts them:
+ * least recently used first, and of entries last used at the same time, the one with the
+ * lower use count first.
+ *
+ * Besides the use statistics of each entry it keeps a binary min-heap of the entries, so
+ * adding or updating an entry and taking the next one to evict cost O(log n) no matter how
+ * big the cache is. Updating an entry pushes it again and leaves the outdated heap item to
+ * be skipped when it comes up; the heap is rebuilt when too many of those pile up.
+ */
+class HTTPCacheEvictionQueue
+{
+public:
+    static const int keySize = 20; // binary SHA1 of the URL
+
+    struct Info {
+        qint32 useCount = 0;
+        qint64 lastUsedDate = 0; // in seconds since the epoch
+        qint64 size = 0;
+    };
+
+    /// Adds the entry of @p key or replaces its statistics
+    void insert(const QByteArray &key, const Info &info);
+    bool remove(const QByteArray &key);
+    bool contains(const QByteArray &key) const;
+    bool find(const QByteArray &key, Info *info) const;
+    int count() const;
+    /// Sum of the sizes of all entries
+    qint64 totalSize() const;
+    /// Removes the entry that should be evicted next and returns its key, or an empty QByteArray
+    QByteArray takeLeastUseful();
+    void clear();
+
+    /// Calls @p function with the key and the Info of each entry, in no particular order
+    template<typename Function>
+    void forEach(Function function) const
+    {
+        for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+            function(QByteArray::fromRawData(reinterpret_cast<const char *>(it.key().bytes), keySize), it.value());
+        }
+    }
+
+private:
+    struct Key {
+        quint8 bytes[keySize];
+        bool operator==(const Key &other) const
+        {
+            return memcmp(bytes, other.bytes, keySize) == 0;
+        }
+    };
+    friend uint qHash(const Key &key);
+
+    struct HeapItem {
+        qint64 lastUsedDate;
+        qint32 useCount;
+        Key key;
+    };
+
+    static Key toKey(const QByteArray &key);
+    static bool isMoreUseful(const HeapItem &item1, const HeapItem &item2);
+    void push(const Key &key, const Info &info);
+
+    QHash<Key, Info> m_entries;
+    std::vector<HeapItem> m_heap;
+    qint64 m_totalSize = 0;
+};
+
+#endif // HTTPCACHEEVICTIONQUEUE_H
@@ -0,0 +1,599 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "httpcachestore.h"
+
+#include <QBuffer>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+
+#include <cstring>
+#include <limits>
+#include <memory>
+
+// The files of the store never leave the machine they were written on, so they use
+// native byte order and alignment.
+
+struct HTTPCacheStore::IndexHeader {
+    char magic[4];
+    quint32 version;
+    quint32 capacity; // number of slots, always a power of two
+    quint32 usedSlots;
+    quint32 removedSlots;
+    quint32 activeSegment; // the segment that new records are appended to
+    quint32 superseded; // set when the index file has been replaced by a new one
+    quint32 reserved;
+    qint64 liveBytes;
+    quint8 padding[24];
+};
+
+struct HTTPCacheStore::IndexSlot {
+    quint8 key[keySize];
+    quint32 state;
+    quint32 segment;
+    qint32 useCount;
+    qint64 offset;
+    qint64 size;
+    qint64 lastUsedDate;
+    qint64 expireDate;
+};
+
+namespace
+{
+enum SlotState {
+    EmptySlot = 0,
+    UsedSlot,
+    RemovedSlot, // a tombstone; lookups have to probe past it
+};
+
+// precedes the data of each record in a segment file
+struct RecordHeader {
+    char magic[4];
+    quint8 key[HTTPCacheStore::keySize];
+    qint64 size;
+};
+static_assert(sizeof(RecordHeader) == 32, "unexpected padding in the cache record header");
+
+const char s_indexMagic[4] = {'K', 'H', 'C', 'I'};
+const quint32 s_indexVersion = 1;
+const char s_recordMagic[4] = {'K', 'H', 'C', 'R'};
+const quint32 s_initialCapacity = 4096;
+const qint64 s_maxSegmentSize = 32 * 1024 * 1024;
+const qint64 s_copyChunkSize = 64 * 1024;
+const int s_lockTimeout = 1000; // ms; not getting the lock means not caching a response, which is fine
+
+class StoreLocker
+{
+public:
+    explicit StoreLocker(QLockFile *lock)
+        : m_lock(lock)
+        , m_locked(lock->tryLock(s_lockTimeout))
+    {
+    }
+
+    ~StoreLocker()
+    {
+        if (m_locked) {
+            m_lock->unlock();
+        }
+    }
+
+    bool isLocked() const
+    {
+        return m_locked;
+    }
+
+private:
+    QLockFile *const m_lock;
+    const bool m_locked;
+};
+
+// Maps the data of one record. Records are never modified and segment files are only ever
+// appended to or deleted, so the mapping stays valid for as long as we keep it.
+class RecordDevice : public QBuffer
+{
+public:
+    explicit RecordDevice(const QString &segmentPath)
+        : m_segment(segmentPath)
+        , m_mapped(nullptr)
+    {
+    }
+
+    ~RecordDevice() override
+    {
+        close();
+        if (m_mapped) {
+            m_segment.unmap(m_mapped);
+        }
+    }
+
+    bool mapRecord(const QByteArray &key, qint64 offset, qint64 size)
+    {
+        const qint64 start = offset - qint64(sizeof(RecordHeader));
+        if (start < 0 || size < 0 || size > std::numeric_limits<int>::max() || !m_segment.open(QIODevice::ReadOnly)
+            || offset + size > m_segment.size()) {
+            return false;
+        }
+        m_mapped = m_segment.map(start, sizeof(RecordHeader) + size);
+        if (!m_mapped) {
+            return false;
+        }
+        RecordHeader header;
+        memcpy(&header, m_mapped, sizeof(header));
+        if (memcmp(header.magic, s_recordMagic, sizeof(s_recordMagic)) != 0 || memcmp(header.key, key.constData(), HTTPCacheStore::keySize) != 0
+            || header.size != size) {
+            return false;
+        }
+        setData(QByteArray::fromRawData(reinterpret_cast<const char *>(m_mapped) + sizeof(RecordHeader), size));
+        return open(QIODevice::ReadOnly);
+    }
+
+private:
+    QFile m_segment;
+    uchar *m_mapped;
+};
+}
+
+HTTPCacheStore::HTTPCacheStore(const QString &cacheDir)
+    : m_cacheDir(cacheDir)
+    , m_dir(QDir(cacheDir).filePath(QStringLiteral("store")))
+    , m_index(nullptr)
+    , m_lock(m_dir + QLatin1String("/lock"))
+{
+}
+
+HTTPCacheStore::~HTTPCacheStore()
+{
+    unmapIndex();
+}
+
+bool HTTPCacheStore::open()
+{
+    if (isOpen()) {
+        return true;
+    }
+    if (!QDir().mkpath(m_dir)) {
+        return false;
+    }
+    if (mapIndex()) {
+        return true;
+    }
+    StoreLocker locker(&m_lock);
+    if (!locker.isLocked()) {
+        return false;
+    }
+    // another process may have created the index while we were waiting for the lock
+    return mapIndex() || resetFiles();
+}
+
+bool HTTPCacheStore::isOpen() const
+{
+    return m_index != nullptr;
+}
+
+QString HTTPCacheStore::cacheDir() const
+{
+    return m_cacheDir;
+}
+
+bool HTTPCacheStore::find(const QByteArray &key, Entry *entry)
+{
+    if (key.size() != keySize || !ensureCurrentIndex()) {
+        return false;
+    }
+    const IndexSlot *slot = probe(indexSlots(), header()->capacity, key, false);
+    if (!slot) {
+        return false;
+    }
+    // take a copy first, the slot may be modified by another process while we look at it
+    const IndexSlot copy = *slot;
+    if (copy.state != UsedSlot || memcmp(copy.key, key.constData(), keySize) != 0) {
+        return false;
+    }
+    *entry = toEntry(copy);
+    return true;
+}
+
+QIODevice *HTTPCacheStore::openRecord(const Entry &entry)
+{
+    if (entry.key.size() != keySize) {
+        return nullptr;
+    }
+    auto *device = new RecordDevice(segmentPath(entry.segment));
+    if (!device->mapRecord(entry.key, entry.offset, entry.size)) {
+        delete device;
+        return nullptr;
+    }
+    return device;
+}
+
+void HTTPCacheStore::touch(const QByteArray &key, qint64 expireDate)
+{
+    if (key.size() != keySize || !ensureCurrentIndex()) {
+        return;
+    }
+    IndexSlot *slot = probe(indexSlots(), header()->capacity, key, false);
+    if (!slot) {
+        return;
+    }
+    slot->useCount++;
+    slot->lastUsedDate = QDateTime::currentSecsSinceEpoch();
+
+    if (slot->expireDate != expireDate) {
+        StoreLocker locker(&m_lock);
+        // look the slot up again, the index may have been rebuilt in the meantime
+        if (locker.isLocked() && ensureCurrentIndex()) {
+            if (IndexSlot *current = probe(indexSlots(), header()->capacity, key, false)) {
+                current->expireDate = expireDate;
+            }
+        }
+    }
+}
+
+bool HTTPCacheStore::insert(const QByteArray &key, const QString &dataFileName, qint64 expireDate)
+{
+    QFile data(dataFileName);
+    if (key.size() != keySize || !data.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    StoreLocker locker(&m_lock);
+    if (!locker.isLocked() || !ensureCurrentIndex() || !reserveSlot()) {
+        return false;
+    }
+
+    quint32 segment;
+    qint64 offset;
+    if (!appendRecord(key, &data, &segment, &offset)) {
+        return false;
+    }
+
+    IndexHeader *h = header();
+    IndexSlot *slot = probe(indexSlots(), h->capacity, key, true);
+    Q_ASSERT(slot); // reserveSlot() made sure that there is room
+    if (slot->state == UsedSlot) {
+        h->liveBytes -= sizeof(RecordHeader) + slot->size;
+    } else {
+        if (slot->state == RemovedSlot) {
+            h->removedSlots--;
+        }
+        h->usedSlots++;
+        memcpy(slot->key, key.constData(), keySize);
+    }
+    slot->segment = segment;
+    slot->offset = offset;
+    slot->size = data.size();
+    slot->useCount = 0;
+    slot->lastUsedDate = QDateTime::currentSecsSinceEpoch();
+    slot->expireDate = expireDate;
+    // lookups ignore the slot until now
+    slot->state = UsedSlot;
+    h->liveBytes += sizeof(RecordHeader) + data.size();
+    return true;
+}
+
+bool HTTPCacheStore::remove(const QByteArray &key)
+{
+    if (key.size() != keySize) {
+        return false;
+    }
+    StoreLocker locker(&m_lock);
+    if (!locker.isLocked() || !ensureCurrentIndex()) {
+        return false;
+    }
+    IndexHeader *h = header();
+    IndexSlot *slot = probe(indexSlots(), h->capacity, key, false);
+    if (!slot) {
+        return false;
+    }
+    slot->state = RemovedSlot;
+    h->usedSlots--;
+    h->removedSlots++;
+    h->liveBytes -= sizeof(RecordHeader) + slot->size;
+    return true;
+}
+
+QList<HTTPCacheStore::Entry> HTTPCacheStore::entries()
+{
+    QList<Entry> ret;
+    if (!ensureCurrentIndex()) {
+        return ret;
+    }
+    const IndexSlot *table = indexSlots();
+    const quint32 capacity = header()->capacity;
+    ret.reserve(header()->usedSlots);
+    for (quint32 i = 0; i < capacity; ++i) {
+        const IndexSlot copy = table[i];
+        if (copy.state == UsedSlot) {
+            ret.append(toEntry(copy));
+        }
+    }
+    return ret;
+}
+
+qint64 HTTPCacheStore::liveBytes()
+{
+    return ensureCurrentIndex() ? header()->liveBytes : 0;
+}
+
+bool HTTPCacheStore::compactSegment()
+{
+    StoreLocker locker(&m_lock);
+    if (!locker.isLocked() || !ensureCurrentIndex()) {
+        return false;
+    }
+    IndexHeader *h = header();
+    IndexSlot *table = indexSlots();
+
+    QHash<quint32, qint64> liveBytesBySegment;
+    for (quint32 i = 0; i < h->capacity; ++i) {
+        if (table[i].state == UsedSlot) {
+            liveBytesBySegment[table[i].segment] += sizeof(RecordHeader) + table[i].size;
+        }
+    }
+
+    const QDir dir(m_dir);
+    const QString prefix = QStringLiteral("segment-");
+    quint32 victim = 0;
+    qint64 victimWaste = 0;
+    const QStringList segmentNames = dir.entryList({prefix + QLatin1Char('*')}, QDir::Files);
+    for (const QString &name : segmentNames) {
+        bool ok;
+        const quint32 segment = name.mid(prefix.size()).toUInt(&ok);
+        if (!ok || segment == h->activeSegment) {
+            continue;
+        }
+        const qint64 size = QFileInfo(dir.filePath(name)).size();
+        const qint64 waste = size - liveBytesBySegment.value(segment);
+        if (waste * 2 >= size && (!victim || waste > victimWaste)) {
+            victim = segment;
+            victimWaste = waste;
+        }
+    }
+    if (!victim) {
+        return false;
+    }
+
+    for (quint32 i = 0; i < h->capacity; ++i) {
+        IndexSlot *slot = &table[i];
+        if (slot->state != UsedSlot || slot->segment != victim) {
+            continue;
+        }
+        const Entry entry = toEntry(*slot);
+        const std::unique_ptr<QIODevice> record(openRecord(entry));
+        quint32 segment;
+        qint64 offset;
+        if (record && appendRecord(entry.key, record.get(), &segment, &offset)) {
+            slot->segment = segment;
+            slot->offset = offset;
+        } else {
+            // the record is damaged or could not be copied, so the entry goes away
+            slot->state = RemovedSlot;
+            h->usedSlots--;
+            h->removedSlots++;
+            h->liveBytes -= sizeof(RecordHeader) + slot->size;
+        }
+    }
+    // processes still reading from the segment keep their mapping
+    QFile::remove(segmentPath(victim));
+    return true;
+}
+
+void HTTPCacheStore::clear()
+{
+    if (!QDir().mkpath(m_dir)) {
+        return;
+    }
+    StoreLocker locker(&m_lock);
+    if (locker.isLocked()) {
+        resetFiles();
+    }
+}
+
+qint64 HTTPCacheStore::indexFileSize(quint32 capacity)
+{
+    static_assert(sizeof(IndexHeader) == 64, "unexpected padding in the cache index header");
+    static_assert(sizeof(IndexSlot) == 64, "unexpected padding in the cache index slots");
+    return sizeof(IndexHeader) + qint64(capacity) * sizeof(IndexSlot);
+}
+
+HTTPCacheStore::IndexSlot *HTTPCacheStore::probe(IndexSlot *table, quint32 capacity, const QByteArray &key, bool forInsert)
+{
+    // the key is a cryptographic hash already, any part of it makes a good hash code
+    quint32 hash;
+    memcpy(&hash, key.constData(), sizeof(hash));
+
+    IndexSlot *reusable = nullptr;
+    for (quint32 i = 0; i < capacity; ++i) {
+        IndexSlot *slot = &table[(hash + i) & (capacity - 1)];
+        if (slot->state == EmptySlot) {
+            if (forInsert) {
+                return reusable ? reusable : slot;
+            }
+            return nullptr;
+        }
+        if (slot->state == UsedSlot) {
+            if (memcmp(slot->key, key.constData(), keySize) == 0) {
+                return slot;
+            }
+        } else if (!reusable) {
+            reusable = slot;
+        }
+    }
+    return forInsert ? reusable : nullptr;
+}
+
+HTTPCacheStore::Entry HTTPCacheStore::toEntry(const IndexSlot &slot)
+{
+    Entry entry;
+    entry.key = QByteArray(reinterpret_cast<const char *>(slot.key), keySize);
+    entry.segment = slot.segment;
+    entry.offset = slot.offset;
+    entry.size = slot.size;
+    entry.useCount = slot.useCount;
+    entry.lastUsedDate = slot.lastUsedDate;
+    entry.expireDate = slot.expireDate;
+    return entry;
+}
+
+HTTPCacheStore::IndexHeader *HTTPCacheStore::header() const
+{
+    return reinterpret_cast<IndexHeader *>(m_index);
+}
+
+HTTPCacheStore::IndexSlot *HTTPCacheStore::indexSlots() const
+{
+    return reinterpret_cast<IndexSlot *>(m_index + sizeof(IndexHeader));
+}
+
+bool HTTPCacheStore::mapIndex()
+{
+    unmapIndex();
+    m_indexFile.setFileName(m_dir + QLatin1String("/index"));
+    if (!m_indexFile.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    const qint64 fileSize = m_indexFile.size();
+    if (fileSize < qint64(sizeof(IndexHeader))) {
+        m_indexFile.close();
+        return false;
+    }
+    m_index = m_indexFile.map(0, fileSize);
+    if (!m_index) {
+        m_indexFile.close();
+        return false;
+    }
+    const IndexHeader *h = header();
+    const bool isPowerOfTwo = h->capacity && !(h->capacity & (h->capacity - 1));
+    if (memcmp(h->magic, s_indexMagic, sizeof(s_indexMagic)) != 0 || h->version != s_indexVersion || !isPowerOfTwo
+        || fileSize != indexFileSize(h->capacity)) {
+        unmapIndex();
+        return false;
+    }
+    return true;
+}
+
+void HTTPCacheStore::unmapIndex()
+{
+    if (m_index) {
+        m_indexFile.unmap(m_index);
+        m_index = nullptr;
+    }
+    m_indexFile.close();
+}
+
+bool HTTPCacheStore::ensureCurrentIndex()
+{
+    if (!m_index) {
+        return false;
+    }
+    // follow a rebuild of the index by another process
+    return !header()->superseded || mapIndex();
+}
+
+bool HTTPCacheStore::resetFiles()
+{
+    QDir dir(m_dir);
+    const QStringList segmentNames = dir.entryList({QStringLiteral("segment-*")}, QDir::Files);
+    for (const QString &name : segmentNames) {
+        dir.remove(name);
+    }
+    return rebuildIndex(s_initialCapacity, false);
+}
+
+bool HTTPCacheStore::reserveSlot()
+{
+    const IndexHeader *h = header();
+    // keep the load factor, tombstones included, at 3/4 at most so that probe sequences stay short
+    if ((quint64(h->usedSlots) + h->removedSlots + 1) * 4 <= quint64(h->capacity) * 3) {
+        return true;
+    }
+    // grow if there are many entries, otherwise just get rid of the tombstones
+    const bool grow = (quint64(h->usedSlots) + 1) * 2 > h->capacity;
+    return rebuildIndex(grow ? h->capacity * 2 : h->capacity, true);
+}
+
+bool HTTPCacheStore::rebuildIndex(quint32 capacity, bool keepEntries)
+{
+    QByteArray data(indexFileSize(capacity), 0);
+    auto *newHeader = reinterpret_cast<IndexHeader *>(data.data());
+    auto *newTable = reinterpret_cast<IndexSlot *>(data.data() + sizeof(IndexHeader));
+    memcpy(newHeader->magic, s_indexMagic, sizeof(s_indexMagic));
+    newHeader->version = s_indexVersion;
+    newHeader->capacity = capacity;
+    newHeader->activeSegment = 1;
+
+    if (m_index && keepEntries) {
+        const IndexHeader *h = header();
+        const IndexSlot *table = indexSlots();
+        newHeader->activeSegment = h->activeSegment;
+        newHeader->liveBytes = h->liveBytes;
+        for (quint32 i = 0; i < h->capacity; ++i) {
+            if (table[i].state == UsedSlot) {
+                const QByteArray key = QByteArray::fromRawData(reinterpret_cast<const char *>(table[i].key), keySize);
+                *probe(newTable, capacity, key, true) = table[i];
+                newHeader->usedSlots++;
+            }
+        }
+    }
+
+    // replace the file instead of resizing it, other processes may be reading the old one
+    QSaveFile file(m_dir + QLatin1String("/index"));
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        return false;
+    }
+    if (m_index) {
+        header()->superseded = 1;
+    }
+    return mapIndex();
+}
+
+bool HTTPCacheStore::appendRecord(const QByteArray &key, QIODevice *data, quint32 *segment, qint64 *offset)
+{
+    IndexHeader *h = header();
+    QFile file(segmentPath(h->activeSegment));
+    if (!file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    const qint64 dataSize = data->size();
+    if (file.size() > 0 && file.size() + qint64(sizeof(RecordHeader)) + dataSize > s_maxSegmentSize) {
+        file.close();
+        h->activeSegment++;
+        file.setFileName(segmentPath(h->activeSegment));
+        if (!file.open(QIODevice::ReadWrite)) {
+            return false;
+        }
+    }
+
+    const qint64 start = file.size();
+    RecordHeader recordHeader;
+    memcpy(recordHeader.magic, s_recordMagic, sizeof(s_recordMagic));
+    memcpy(recordHeader.key, key.constData(), keySize);
+    recordHeader.size = dataSize;
+
+    bool ok = file.seek(start) && file.write(reinterpret_cast<const char *>(&recordHeader), sizeof(recordHeader)) == sizeof(recordHeader);
+    qint64 copied = 0;
+    while (ok && copied < dataSize) {
+        const QByteArray chunk = data->read(qMin(s_copyChunkSize, dataSize - copied));
+        ok = !chunk.isEmpty() && file.write(chunk) == chunk.size();
+        copied += chunk.size();
+    }
+    if (!ok) {
+        // nothing points at the partial record, but don't leave it around
+        file.resize(start);
+        return false;
+    }
+    *segment = h->activeSegment;
+    *offset = start + sizeof(RecordHeader);
+    return true;
+}
+
+QString HTTPCacheStore::segmentPath(quint32 segment) const
+{
+    return m_dir + QStringLiteral("/segment-%1").arg(segment, 8, 10, QLatin1Char('0'));
+}
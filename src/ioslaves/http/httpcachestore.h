@@ -0,0 +1,123 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef HTTPCACHESTORE_H
+#define HTTPCACHESTORE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QLockFile>
+#include <QString>
+
+class QIODevice;
+
+/**
+ * Optional storage backend of the HTTP cache, used instead of one file per URL
+ * when "UseCacheStore" is set in kio_httprc.
+ *
+ * All entries live in a few append-only segment files in the "store" subdirectory
+ * of the cache directory. The file "index" is a hash table with fixed-size slots,
+ * memory-mapped by every kio_http worker and by kio_http_cache_cleaner, which maps
+ * the SHA1 of a URL to the location of its record and to what the cleaner needs to
+ * know about it (use count, last use, expire date). A record holds exactly what a
+ * cache file of the one-file-per-URL layout holds, so the code parsing cache entries
+ * does not care where it reads from.
+ *
+ * Records are never modified. Replacing or removing an entry only updates the index,
+ * the cleaner reclaims the space of dead records with compactSegment(). Modifications
+ * are serialized between processes with a lock file; lookups don't lock and every
+ * record is checked against its key before it is handed out.
+ */
+class HTTPCacheStore
+{
+public:
+    static const int keySize = 20; // binary SHA1 of the URL
+
+    struct Entry {
+        QByteArray key;
+        quint32 segment = 0;
+        qint64 offset = 0; // of the record data in the segment file
+        qint64 size = 0; // of the record data
+        qint32 useCount = 0;
+        qint64 lastUsedDate = 0; // in seconds since the epoch, like the other dates
+        qint64 expireDate = 0;
+    };
+
+    explicit HTTPCacheStore(const QString &cacheDir);
+    ~HTTPCacheStore();
+
+    HTTPCacheStore(const HTTPCacheStore &) = delete;
+    HTTPCacheStore &operator=(const HTTPCacheStore &) = delete;
+
+    /**
+     * Maps the index, creating the store if it does not exist yet. An index that is
+     * unreadable or has an unknown format is discarded together with all records.
+     */
+    bool open();
+    bool isOpen() const;
+    QString cacheDir() const;
+
+    bool find(const QByteArray &key, Entry *entry);
+    /**
+     * Returns a read-only device over the record data of @p entry, or nullptr if the
+     * record is gone or does not belong to the entry's key. The caller owns the device.
+     */
+    QIODevice *openRecord(const Entry &entry);
+    /**
+     * Counts a use of the entry of @p key. The use count is updated without locking,
+     * so concurrent uses may be lost; it is only a hint for the cleaner anyway.
+     * Also stores @p expireDate if it differs from the one in the index.
+     */
+    void touch(const QByteArray &key, qint64 expireDate);
+    /**
+     * Appends the content of the file @p dataFileName as the new record of @p key,
+     * replacing the previous one if any.
+     */
+    bool insert(const QByteArray &key, const QString &dataFileName, qint64 expireDate);
+    bool remove(const QByteArray &key);
+
+    // Interface for the cache cleaner
+
+    QList<Entry> entries();
+    /// Size of all records that are reachable from the index, including record headers
+    qint64 liveBytes();
+    /**
+     * Moves the live records of the segment with the most wasted space to the active
+     * segment and deletes it. Segments that are less than half dead are left alone.
+     * Returns false if there was nothing to compact.
+     */
+    bool compactSegment();
+    /// Removes all entries
+    void clear();
+
+private:
+    struct IndexHeader;
+    struct IndexSlot;
+
+    static qint64 indexFileSize(quint32 capacity);
+    static IndexSlot *probe(IndexSlot *table, quint32 capacity, const QByteArray &key, bool forInsert);
+    static Entry toEntry(const IndexSlot &slot);
+
+    IndexHeader *header() const;
+    IndexSlot *indexSlots() const;
+    bool mapIndex();
+    void unmapIndex();
+    bool ensureCurrentIndex();
+    bool resetFiles();
+    bool reserveSlot();
+    bool rebuildIndex(quint32 capacity, bool keepEntries);
+    bool appendRecord(const QByteArray &key, QIODevice *data, quint32 *segment, qint64 *offset);
+    QString segmentPath(quint32 segment) const;
+
+    const QString m_cacheDir;
+    const QString m_dir;
+    QFile m_indexFile;
+    uchar *m_index;
+    QLockFile m_lock;
+};
+
+#endif // HTTPCACHESTORE_H
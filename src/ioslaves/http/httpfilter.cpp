@@ -12,6 +12,11 @@
 #include <KLocalizedString>
 #include <QDebug>
 
+#if HAVE_BROTLI
+#include <brotli/decode.h>
+#endif
+
+#include <memory>
 #include <stdio.h>
 
 Q_LOGGING_CATEGORY(KIO_HTTP_FILTER, "kf.kio.slaves.http.filter")
@@ -184,4 +189,134 @@ HTTPFilterDeflate::HTTPFilterDeflate()
 {
 }
 
+HTTPFilterZstd::HTTPFilterZstd()
+    : m_firstData(true)
+    , m_finished(false)
+    , m_zstdFilter(KCompressionDevice::filterForCompressionType(KCompressionDevice::Zstd))
+{
+}
+
+HTTPFilterZstd::~HTTPFilterZstd()
+{
+    if (m_zstdFilter) {
+        m_zstdFilter->terminate();
+        delete m_zstdFilter;
+    }
+}
+
+bool HTTPFilterZstd::isSupported()
+{
+    static const bool supported = std::unique_ptr<KFilterBase>(KCompressionDevice::filterForCompressionType(KCompressionDevice::Zstd)) != nullptr;
+    return supported;
+}
+
+void HTTPFilterZstd::slotInput(const QByteArray &d)
+{
+    if (d.isEmpty() || m_finished) {
+        return;
+    }
+
+    if (!m_zstdFilter) {
+        Q_EMIT error(i18n("Receiving data in an unsupported compression format."));
+        m_finished = true;
+        return;
+    }
+
+    if (m_firstData) {
+        m_zstdFilter->init(QIODevice::ReadOnly);
+        m_firstData = false;
+    }
+
+    m_zstdFilter->setInBuffer(d.constData(), d.size());
+
+    // The output buffer is all we hold on to, whatever the size of the stream.
+    // When it was filled up, the decoder may still hold data even though it
+    // consumed all of the input, so keep going until it has room to spare.
+    bool outputFull = false;
+    while ((!m_zstdFilter->inBufferEmpty() || outputFull) && !m_finished) {
+        char buf[8192];
+        m_zstdFilter->setOutBuffer(buf, sizeof(buf));
+        KFilterBase::Result result = m_zstdFilter->uncompress();
+        switch (result) {
+        case KFilterBase::Ok:
+        case KFilterBase::End: {
+            const size_t bytesOut = sizeof(buf) - m_zstdFilter->outBufferAvailable();
+            outputFull = bytesOut == sizeof(buf);
+            if (bytesOut) {
+                Q_EMIT output(QByteArray(buf, bytesOut));
+            }
+            if (result == KFilterBase::End) {
+                Q_EMIT output(QByteArray());
+                m_finished = true;
+            }
+            break;
+        }
+        case KFilterBase::Error:
+            qCDebug(KIO_HTTP_FILTER) << "Error from KZstdFilter";
+            Q_EMIT error(i18n("Receiving corrupt data."));
+            m_finished = true; // exit this while loop
+            break;
+        }
+    }
+}
+
+#if HAVE_BROTLI
+HTTPFilterBrotli::HTTPFilterBrotli()
+    : m_finished(false)
+    , m_state(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr))
+{
+}
+
+HTTPFilterBrotli::~HTTPFilterBrotli()
+{
+    if (m_state) {
+        BrotliDecoderDestroyInstance(m_state);
+    }
+}
+
+void HTTPFilterBrotli::slotInput(const QByteArray &d)
+{
+    if (d.isEmpty() || m_finished) {
+        return;
+    }
+
+    if (!m_state) {
+        qCDebug(KIO_HTTP_FILTER) << "Could not create the brotli decoder";
+        Q_EMIT error(i18n("Not enough memory to decompress the data."));
+        m_finished = true;
+        return;
+    }
+
+    size_t availableIn = d.size();
+    const uint8_t *nextIn = reinterpret_cast<const uint8_t *>(d.constData());
+
+    while (!m_finished) {
+        uint8_t buf[8192];
+        size_t availableOut = sizeof(buf);
+        uint8_t *nextOut = buf;
+        const BrotliDecoderResult result = BrotliDecoderDecompressStream(m_state, &availableIn, &nextIn, &availableOut, &nextOut, nullptr);
+        const size_t bytesOut = sizeof(buf) - availableOut;
+        if (bytesOut) {
+            Q_EMIT output(QByteArray(reinterpret_cast<const char *>(buf), bytesOut));
+        }
+
+        switch (result) {
+        case BROTLI_DECODER_RESULT_SUCCESS:
+            Q_EMIT output(QByteArray());
+            m_finished = true;
+            break;
+        case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+            return;
+        case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+            break;
+        case BROTLI_DECODER_RESULT_ERROR:
+            qCDebug(KIO_HTTP_FILTER) << "Error from the brotli decoder:" << BrotliDecoderErrorString(BrotliDecoderGetErrorCode(m_state));
+            Q_EMIT error(i18n("Receiving corrupt data."));
+            m_finished = true;
+            break;
+        }
+    }
+}
+#endif
+
 #include "moc_httpfilter.cpp"
@@ -9,7 +9,12 @@
 #ifndef _HTTPFILTER_H_
 #define _HTTPFILTER_H_
 
+#include <config-kioslave-http.h>
+
 class KFilterBase;
+#if HAVE_BROTLI
+struct BrotliDecoderStateStruct;
+#endif
 #include <QBuffer>
 
 #include <QCryptographicHash>
@@ -92,4 +97,40 @@ public:
     HTTPFilterDeflate();
 };
 
+class HTTPFilterZstd : public HTTPFilterBase
+{
+    Q_OBJECT
+public:
+    HTTPFilterZstd();
+    ~HTTPFilterZstd() override;
+
+    // KArchive may have been built without zstd
+    static bool isSupported();
+
+public Q_SLOTS:
+    void slotInput(const QByteArray &d) override;
+
+private:
+    bool m_firstData;
+    bool m_finished;
+    KFilterBase *m_zstdFilter;
+};
+
+#if HAVE_BROTLI
+class HTTPFilterBrotli : public HTTPFilterBase
+{
+    Q_OBJECT
+public:
+    HTTPFilterBrotli();
+    ~HTTPFilterBrotli() override;
+
+public Q_SLOTS:
+    void slotInput(const QByteArray &d) override;
+
+private:
+    bool m_finished;
+    BrotliDecoderStateStruct *m_state;
+};
+#endif
+
 #endif
@@ -0,0 +1,180 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "httpmemorycache.h"
+
+#include <KSharedDataCache>
+
+#include <QAtomicInteger>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+
+static const char s_cacheName[] = "kio_http-memory";
+// typical size of small resources like icons and JSON snippets, KSharedDataCache sizes its index by it
+static const uint s_expectedEntrySize = 4 * 1024;
+
+// The vary record of a URL starts with this, anything else means that the URL has no entries.
+// The marker is followed by the nonce of the entries, see entryKey(), and the Vary header.
+static const char s_varyMarker = 'V';
+static const char s_removedMarker = '-';
+static const int s_nonceSize = 16; // hex digits
+
+// Splits a vary record into the nonce of its entries and its Vary header
+static bool parseVaryRecord(const QByteArray &record, QByteArray *nonce, QByteArray *vary)
+{
+    if (!record.startsWith(s_varyMarker) || record.size() < 1 + s_nonceSize) {
+        return false;
+    }
+    *nonce = record.mid(1, s_nonceSize);
+    *vary = record.mid(1 + s_nonceSize);
+    return true;
+}
+
+// Layout of the statistics file; all-zero is a valid initial state
+struct HTTPMemoryCache::SharedStatistics {
+    QBasicAtomicInteger<quint32> hits;
+    QBasicAtomicInteger<quint32> misses;
+    QBasicAtomicInteger<quint32> insertions;
+    QBasicAtomicInteger<quint32> rejections;
+};
+
+HTTPMemoryCache::HTTPMemoryCache(uint cacheSize, uint maxEntrySize)
+    : m_cache(new KSharedDataCache(QLatin1String(s_cacheName), cacheSize, s_expectedEntrySize))
+    , m_maxEntrySize(maxEntrySize)
+    , m_statisticsFile(statisticsFilePath())
+    , m_statistics(nullptr)
+{
+    m_cache->setEvictionPolicy(KSharedDataCache::EvictLeastRecentlyUsed);
+    mapStatistics();
+}
+
+HTTPMemoryCache::~HTTPMemoryCache()
+{
+    if (m_statisticsFile.isOpen()) {
+        m_statisticsFile.unmap(reinterpret_cast<uchar *>(m_statistics));
+    } else {
+        delete m_statistics;
+    }
+}
+
+uint HTTPMemoryCache::maxEntrySize() const
+{
+    return m_maxEntrySize;
+}
+
+bool HTTPMemoryCache::find(const QByteArray &url, const VaryValuesFunction &varyValues, QByteArray *entry)
+{
+    QByteArray record;
+    QByteArray nonce;
+    QByteArray vary;
+    QByteArray values;
+    if (m_cache->find(varyKey(url), &record) && parseVaryRecord(record, &nonce, &vary) && varyValues(vary, &values)
+        && m_cache->find(entryKey(url, nonce, values), entry)) {
+        m_statistics->hits.fetchAndAddRelaxed(1);
+        return true;
+    }
+    m_statistics->misses.fetchAndAddRelaxed(1);
+    return false;
+}
+
+bool HTTPMemoryCache::insert(const QByteArray &url, const QByteArray &vary, const VaryValuesFunction &varyValues, const QByteArray &entry)
+{
+    QByteArrayList names;
+    const QByteArrayList varyList = vary.split(',');
+    for (const QByteArray &name : varyList) {
+        const QByteArray trimmed = name.trimmed().toLower();
+        if (!trimmed.isEmpty()) {
+            names.append(trimmed);
+        }
+    }
+    const QByteArray normalizedVary = names.join(',');
+
+    QByteArray values;
+    if (entry.size() > int(m_maxEntrySize) || !varyValues(normalizedVary, &values)) {
+        m_statistics->rejections.fetchAndAddRelaxed(1);
+        return false;
+    }
+    // The entries stored since the URL got its vary record share its nonce. Without one,
+    // because the URL is new, was removed or its record got evicted, the entries that may
+    // still be around must not become reachable again, so they get a new nonce.
+    QByteArray record;
+    QByteArray nonce;
+    QByteArray oldVary;
+    if (!m_cache->find(varyKey(url), &record) || !parseVaryRecord(record, &nonce, &oldVary)) {
+        nonce = QByteArray::number(QRandomGenerator::global()->generate64(), 16).rightJustified(s_nonceSize, '0');
+    }
+    // the entry first, so that nobody sees a vary record without the entry it leads to
+    if (!m_cache->insert(entryKey(url, nonce, values), entry) || !m_cache->insert(varyKey(url), s_varyMarker + nonce + normalizedVary)) {
+        m_statistics->rejections.fetchAndAddRelaxed(1);
+        return false;
+    }
+    m_statistics->insertions.fetchAndAddRelaxed(1);
+    return true;
+}
+
+void HTTPMemoryCache::remove(const QByteArray &url)
+{
+    // KSharedDataCache can't remove single entries, but a URL without vary record has none,
+    // and the next one gets a new nonce
+    m_cache->insert(varyKey(url), QByteArray(1, s_removedMarker));
+}
+
+HTTPMemoryCache::Statistics HTTPMemoryCache::statistics() const
+{
+    Statistics ret;
+    ret.hits = m_statistics->hits.loadRelaxed();
+    ret.misses = m_statistics->misses.loadRelaxed();
+    ret.insertions = m_statistics->insertions.loadRelaxed();
+    ret.rejections = m_statistics->rejections.loadRelaxed();
+    ret.totalSize = m_cache->totalSize();
+    ret.freeSize = m_cache->freeSize();
+    return ret;
+}
+
+void HTTPMemoryCache::deleteCache()
+{
+    KSharedDataCache::deleteCache(QLatin1String(s_cacheName));
+    QFile::remove(statisticsFilePath());
+}
+
+QString HTTPMemoryCache::statisticsFilePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1Char('/') + QLatin1String(s_cacheName) + QLatin1String(".stats");
+}
+
+QString HTTPMemoryCache::varyKey(const QByteArray &url)
+{
+    return QLatin1Char('v') + QString::fromLatin1(QCryptographicHash::hash(url, QCryptographicHash::Sha1).toHex());
+}
+
+QString HTTPMemoryCache::entryKey(const QByteArray &url, const QByteArray &nonce, const QByteArray &varyValues)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(url);
+    hash.addData(QByteArray(1, '\n'));
+    hash.addData(nonce);
+    hash.addData(QByteArray(1, '\n'));
+    hash.addData(varyValues);
+    return QLatin1Char('e') + QString::fromLatin1(hash.result().toHex());
+}
+
+void HTTPMemoryCache::mapStatistics()
+{
+    QDir().mkpath(QFileInfo(m_statisticsFile).absolutePath());
+    // growing the empty file of a new cache is harmless even if another process does it too
+    if (m_statisticsFile.open(QIODevice::ReadWrite)
+        && (m_statisticsFile.size() >= qint64(sizeof(SharedStatistics)) || m_statisticsFile.resize(sizeof(SharedStatistics)))) {
+        m_statistics = reinterpret_cast<SharedStatistics *>(m_statisticsFile.map(0, sizeof(SharedStatistics)));
+    }
+    if (!m_statistics) {
+        // count for this process only
+        m_statisticsFile.close();
+        m_statistics = new SharedStatistics();
+    }
+}
@@ -0,0 +1,99 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef HTTPMEMORYCACHE_H
+#define HTTPMEMORYCACHE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <functional>
+#include <memory>
+
+class KSharedDataCache;
+
+/**
+ * Shared memory cache of small HTTP cache entries, consulted by kio_http before the
+ * disk cache when "UseMemoryCache" is set in kio_httprc.
+ *
+ * The entries are stored in a KSharedDataCache, which all kio_http workers of the user
+ * map, and which evicts the least recently used entries when it is full. An entry holds
+ * a complete cache file (see HTTPProtocol::CacheTag), so it is parsed just like one read
+ * from disk.
+ *
+ * Responses may vary on request headers. For every URL, the cache keeps the Vary header
+ * of the last response stored for it, and each response is keyed by its URL together
+ * with the values of the request headers named in its Vary header. The key also has a
+ * nonce that changes when the URL is removed, which makes all of its variants
+ * unreachable at once.
+ *
+ * Hit and miss counts of all workers are kept in a small memory-mapped file next to the
+ * cache, updated without locking.
+ */
+class HTTPMemoryCache
+{
+public:
+    struct Statistics {
+        quint32 hits = 0;
+        quint32 misses = 0;
+        quint32 insertions = 0;
+        quint32 rejections = 0; // entries too large to be kept, or varying on unknown values
+        qint64 totalSize = 0; // of the shared cache, in bytes
+        qint64 freeSize = 0;
+    };
+
+    /**
+     * Returns the values of the request headers named in the Vary header @p vary, as the
+     * current request sends them, or false if they cannot be known in advance.
+     */
+    using VaryValuesFunction = std::function<bool(const QByteArray &vary, QByteArray *values)>;
+
+    /**
+     * @p cacheSize only applies when the shared cache is created, later instances use
+     * the size of the existing one.
+     */
+    HTTPMemoryCache(uint cacheSize, uint maxEntrySize);
+    ~HTTPMemoryCache();
+
+    HTTPMemoryCache(const HTTPMemoryCache &) = delete;
+    HTTPMemoryCache &operator=(const HTTPMemoryCache &) = delete;
+
+    uint maxEntrySize() const;
+
+    /**
+     * Looks up the entry of @p url, which should be the encoded URL without password and
+     * fragment, as in the cache files.
+     */
+    bool find(const QByteArray &url, const VaryValuesFunction &varyValues, QByteArray *entry);
+    /**
+     * Stores @p entry, the response to a request for @p url with the Vary header @p vary,
+     * replacing the one stored for the same URL and request header values if any.
+     */
+    bool insert(const QByteArray &url, const QByteArray &vary, const VaryValuesFunction &varyValues, const QByteArray &entry);
+    /// Makes all entries of @p url unreachable
+    void remove(const QByteArray &url);
+
+    Statistics statistics() const;
+
+    /// Deletes the shared cache and the statistics of all workers
+    static void deleteCache();
+
+private:
+    struct SharedStatistics;
+
+    static QString statisticsFilePath();
+    static QString varyKey(const QByteArray &url);
+    static QString entryKey(const QByteArray &url, const QByteArray &nonce, const QByteArray &varyValues);
+    void mapStatistics();
+
+    std::unique_ptr<KSharedDataCache> m_cache;
+    const uint m_maxEntrySize;
+    QFile m_statisticsFile;
+    SharedStatistics *m_statistics;
+};
+
+#endif // HTTPMEMORYCACHE_H
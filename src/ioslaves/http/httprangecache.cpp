@@ -0,0 +1,386 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "httprangecache.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QLockFile>
+#include <QSaveFile>
+
+#include <iterator>
+#include <limits>
+
+static const quint32 s_indexMagic = 0x4b524e47; // "KRNG"
+static const quint32 s_indexVersion = 1;
+
+bool HTTPRangeCache::Validator::isValid() const
+{
+    return !etag.isEmpty() || lastModified > 0;
+}
+
+bool HTTPRangeCache::Validator::operator==(const Validator &other) const
+{
+    return etag == other.etag && lastModified == other.lastModified;
+}
+
+bool HTTPRangeCache::Validator::operator!=(const Validator &other) const
+{
+    return !(*this == other);
+}
+
+HTTPRangeCache::HTTPRangeCache(const QString &cacheDir)
+    : m_dir(directory(cacheDir))
+    , m_indexDirty(false)
+    , m_used(false)
+    , m_totalSize(-1)
+    , m_expireDate(0)
+{
+}
+
+HTTPRangeCache::~HTTPRangeCache()
+{
+    close();
+}
+
+QString HTTPRangeCache::directory(const QString &cacheDir)
+{
+    return cacheDir + QLatin1String("/ranges");
+}
+
+bool HTTPRangeCache::open(const QByteArray &key, bool create)
+{
+    close();
+    const QString baseName = m_dir + QLatin1Char('/') + QString::fromLatin1(key.toHex());
+    if (create) {
+        QDir().mkpath(m_dir);
+    } else if (!QFile::exists(baseName + QLatin1String(".index"))) {
+        return false;
+    }
+
+    m_lock.reset(new QLockFile(baseName + QLatin1String(".lock")));
+    // transfers of large resources take long, only a dead owner should make the lock stale
+    // (0 would disable that check as well)
+    m_lock->setStaleLockTime(std::numeric_limits<int>::max());
+    if (!m_lock->tryLock(0)) {
+        m_lock.reset();
+        return false;
+    }
+
+    m_baseName = baseName;
+    m_data.setFileName(baseName);
+    if (!m_data.open(create ? QIODevice::ReadWrite : QIODevice::ReadWrite | QIODevice::ExistingOnly)) {
+        close();
+        return false;
+    }
+    if (!readIndex()) {
+        if (!create) {
+            remove();
+            return false;
+        }
+        reset();
+        m_data.resize(0);
+        if (!writeIndex()) {
+            remove();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HTTPRangeCache::isOpen() const
+{
+    return m_data.isOpen();
+}
+
+void HTTPRangeCache::close()
+{
+    if (!m_baseName.isEmpty()) {
+        if (m_data.isOpen()) {
+            // the index must not list data that may not be in the file yet
+            m_data.flush();
+            if (m_indexDirty) {
+                writeIndex();
+            } else if (m_used) {
+                // the modification time of the index tells the cleaner when the entry was last used
+                QFile index(m_baseName + QLatin1String(".index"));
+                if (index.open(QIODevice::ReadWrite)) {
+                    index.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+                }
+            }
+        }
+        m_data.close();
+        m_baseName.clear();
+    }
+    m_lock.reset();
+    m_indexDirty = false;
+    m_used = false;
+}
+
+void HTTPRangeCache::remove()
+{
+    if (!m_baseName.isEmpty()) {
+        m_data.close();
+        QFile::remove(m_baseName + QLatin1String(".index"));
+        QFile::remove(m_baseName);
+        m_baseName.clear();
+    }
+    close();
+}
+
+HTTPRangeCache::Validator HTTPRangeCache::validator() const
+{
+    return m_validator;
+}
+
+void HTTPRangeCache::setValidator(const Validator &validator)
+{
+    if (validator == m_validator) {
+        return;
+    }
+    // the cached ranges are of another version of the resource. Forget them before the
+    // data is gone, so that no index ever claims data that isn't there.
+    reset();
+    m_validator = validator;
+    writeIndex();
+    m_data.resize(0);
+}
+
+qint64 HTTPRangeCache::totalSize() const
+{
+    return m_totalSize;
+}
+
+void HTTPRangeCache::setTotalSize(qint64 totalSize)
+{
+    if (totalSize != m_totalSize) {
+        m_totalSize = totalSize;
+        m_indexDirty = true;
+    }
+}
+
+QString HTTPRangeCache::mimeType() const
+{
+    return m_mimeType;
+}
+
+void HTTPRangeCache::setMimeType(const QString &mimeType)
+{
+    if (mimeType != m_mimeType) {
+        m_mimeType = mimeType;
+        m_indexDirty = true;
+    }
+}
+
+qint64 HTTPRangeCache::expireDate() const
+{
+    return m_expireDate;
+}
+
+void HTTPRangeCache::setExpireDate(qint64 expireDate)
+{
+    if (expireDate != m_expireDate) {
+        m_expireDate = expireDate;
+        m_indexDirty = true;
+    }
+}
+
+qint64 HTTPRangeCache::cachedBytes() const
+{
+    qint64 ret = 0;
+    for (auto it = m_ranges.constBegin(); it != m_ranges.constEnd(); ++it) {
+        ret += it.value() - it.key();
+    }
+    return ret;
+}
+
+QList<HTTPRangeCache::Segment> HTTPRangeCache::segments(qint64 start, qint64 end) const
+{
+    QList<Segment> ret;
+    qint64 pos = start;
+    // the first range that ends after start
+    auto it = m_ranges.upperBound(start);
+    if (it != m_ranges.constBegin() && std::prev(it).value() > start) {
+        --it;
+    }
+    for (; it != m_ranges.constEnd() && pos < end; ++it) {
+        if (it.key() > pos) {
+            const qint64 gapEnd = qMin(it.key(), end);
+            ret.append({pos, gapEnd, false});
+            pos = gapEnd;
+        }
+        if (pos < end) {
+            const qint64 cachedEnd = qMin(it.value(), end);
+            ret.append({pos, cachedEnd, true});
+            pos = cachedEnd;
+        }
+    }
+    if (pos < end) {
+        ret.append({pos, end, false});
+    }
+    return ret;
+}
+
+QByteArray HTTPRangeCache::read(qint64 pos, qint64 maxSize)
+{
+    if (!m_data.seek(pos)) {
+        return QByteArray();
+    }
+    m_used = true;
+    return m_data.read(maxSize);
+}
+
+bool HTTPRangeCache::write(qint64 pos, const QByteArray &data)
+{
+    // seeking past the end leaves a hole in the file that takes no disk space
+    if (data.isEmpty() || !m_data.seek(pos) || m_data.write(data) != data.size()) {
+        return false;
+    }
+    addRange(pos, pos + data.size());
+    m_indexDirty = true;
+    return true;
+}
+
+void HTTPRangeCache::addRange(qint64 start, qint64 end)
+{
+    auto it = m_ranges.upperBound(start);
+    if (it != m_ranges.begin()) {
+        const auto prev = std::prev(it);
+        if (prev.value() >= start) {
+            start = prev.key();
+            end = qMax(end, prev.value());
+            it = m_ranges.erase(prev);
+        }
+    }
+    while (it != m_ranges.end() && it.key() <= end) {
+        end = qMax(end, it.value());
+        it = m_ranges.erase(it);
+    }
+    m_ranges.insert(start, end);
+}
+
+bool HTTPRangeCache::parseContentRange(const QByteArray &value, qint64 *first, qint64 *last, qint64 *total)
+{
+    const QByteArray trimmed = value.trimmed();
+    if (!trimmed.toLower().startsWith("bytes ")) {
+        return false;
+    }
+    const QByteArray spec = trimmed.mid(6).trimmed();
+    const int dash = spec.indexOf('-');
+    const int slash = spec.indexOf('/', dash);
+    if (dash <= 0 || slash < 0) {
+        return false;
+    }
+    bool firstOk = false;
+    bool lastOk = false;
+    *first = spec.left(dash).trimmed().toLongLong(&firstOk);
+    *last = spec.mid(dash + 1, slash - dash - 1).trimmed().toLongLong(&lastOk);
+    const QByteArray totalSpec = spec.mid(slash + 1).trimmed();
+    if (totalSpec == "*") {
+        *total = -1;
+    } else {
+        bool totalOk = false;
+        *total = totalSpec.toLongLong(&totalOk);
+        if (!totalOk) {
+            return false;
+        }
+    }
+    return firstOk && lastOk && *first >= 0 && *last >= *first && (*total < 0 || *last < *total);
+}
+
+void HTTPRangeCache::trim(const QString &cacheDir, qint64 maxSize)
+{
+    const QDir dir(directory(cacheDir));
+    // least recently used first
+    const QFileInfoList indexFiles = dir.entryInfoList(QStringList(QStringLiteral("*.index")), QDir::Files, QDir::Time | QDir::Reversed);
+
+    HTTPRangeCache cache(cacheDir);
+    QList<QPair<QByteArray, qint64>> entries;
+    qint64 totalBytes = 0;
+    for (const QFileInfo &indexFile : indexFiles) {
+        const QByteArray key = QByteArray::fromHex(indexFile.completeBaseName().toLatin1());
+        if (cache.open(key, false)) {
+            entries.append(qMakePair(key, cache.cachedBytes()));
+            totalBytes += entries.last().second;
+            cache.close();
+        }
+    }
+
+    for (const auto &entry : std::as_const(entries)) {
+        if (totalBytes <= maxSize) {
+            break;
+        }
+        // entries in use since we looked stay
+        if (cache.open(entry.first, false)) {
+            cache.remove();
+            totalBytes -= entry.second;
+        }
+    }
+}
+
+void HTTPRangeCache::clear(const QString &cacheDir)
+{
+    trim(cacheDir, -1);
+}
+
+bool HTTPRangeCache::readIndex()
+{
+    QFile file(m_baseName + QLatin1String(".index"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != s_indexMagic || version != s_indexVersion) {
+        return false;
+    }
+    quint32 count = 0;
+    stream >> m_validator.etag >> m_validator.lastModified >> m_totalSize >> m_mimeType >> m_expireDate >> count;
+    m_ranges.clear();
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        qint64 start = 0;
+        qint64 end = 0;
+        stream >> start >> end;
+        m_ranges.insert(start, end);
+    }
+    m_indexDirty = false;
+    return stream.status() == QDataStream::Ok;
+}
+
+bool HTTPRangeCache::writeIndex()
+{
+    QSaveFile file(m_baseName + QLatin1String(".index"));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << s_indexMagic << s_indexVersion;
+    stream << m_validator.etag << m_validator.lastModified << m_totalSize << m_mimeType << m_expireDate;
+    stream << quint32(m_ranges.size());
+    for (auto it = m_ranges.constBegin(); it != m_ranges.constEnd(); ++it) {
+        stream << it.key() << it.value();
+    }
+    if (!file.commit()) {
+        return false;
+    }
+    m_indexDirty = false;
+    return true;
+}
+
+void HTTPRangeCache::reset()
+{
+    m_validator = Validator();
+    m_totalSize = -1;
+    m_mimeType.clear();
+    m_expireDate = 0;
+    m_ranges.clear();
+    m_indexDirty = true;
+}
@@ -0,0 +1,127 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef HTTPRANGECACHE_H
+#define HTTPRANGECACHE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+#include <memory>
+
+class QLockFile;
+
+/**
+ * Cache of byte ranges of large HTTP resources, used by kio_http for requests with
+ * "range-start" or "range-end" metadata when "UseRangeCache" is set in kio_httprc.
+ *
+ * The regular cache only stores complete responses. This one stores the bodies of
+ * 206 Partial Content responses at their offsets in a sparse file per resource in the
+ * "ranges" subdirectory of the cache directory, next to an index file that lists the
+ * cached ranges together with the validator (strong entity tag or last modification
+ * date) they belong to. A response with a different validator discards what was
+ * cached before.
+ *
+ * An entry is locked while it is open, so one worker at a time uses it; the others
+ * just don't get to use the cache for that resource.
+ */
+class HTTPRangeCache
+{
+public:
+    struct Validator {
+        QByteArray etag; // strong entity tag including the quotes, or empty
+        qint64 lastModified = 0; // in seconds since the epoch, 0 if unknown
+
+        bool isValid() const;
+        bool operator==(const Validator &other) const;
+        bool operator!=(const Validator &other) const;
+    };
+
+    /// A part of a requested byte range, from @p start to @p end exclusive
+    struct Segment {
+        qint64 start;
+        qint64 end;
+        bool cached;
+    };
+
+    explicit HTTPRangeCache(const QString &cacheDir);
+    ~HTTPRangeCache();
+
+    HTTPRangeCache(const HTTPRangeCache &) = delete;
+    HTTPRangeCache &operator=(const HTTPRangeCache &) = delete;
+
+    /**
+     * Opens the entry of @p key, the binary SHA1 of the URL as in the regular cache.
+     * With @p create, a missing entry is created empty, otherwise opening fails.
+     */
+    bool open(const QByteArray &key, bool create);
+    bool isOpen() const;
+    /// Saves the list of cached ranges and unlocks the entry
+    void close();
+    /// Deletes the open entry
+    void remove();
+
+    Validator validator() const;
+    /// Discards all cached ranges if @p validator differs from the entry's
+    void setValidator(const Validator &validator);
+    /// Total size of the resource, -1 if the server didn't tell
+    qint64 totalSize() const;
+    void setTotalSize(qint64 totalSize);
+    QString mimeType() const;
+    void setMimeType(const QString &mimeType);
+    /// In seconds since the epoch, the entry needs validation after that
+    qint64 expireDate() const;
+    void setExpireDate(qint64 expireDate);
+    qint64 cachedBytes() const;
+
+    /**
+     * Splits the byte range from @p start to @p end exclusive into the parts that are
+     * cached and the ones that are not, in order.
+     */
+    QList<Segment> segments(qint64 start, qint64 end) const;
+    /// Reads up to @p maxSize cached bytes at @p pos
+    QByteArray read(qint64 pos, qint64 maxSize);
+    /// Stores @p data at @p pos and adds it to the cached ranges
+    bool write(qint64 pos, const QByteArray &data);
+
+    /**
+     * Parses the value of a Content-Range header, "bytes first-last/total" with "*" for
+     * an unknown total, which is returned as -1.
+     */
+    static bool parseContentRange(const QByteArray &value, qint64 *first, qint64 *last, qint64 *total);
+
+    // Interface for the cache cleaner
+
+    /// Deletes the least recently used entries until the others take at most @p maxSize bytes
+    static void trim(const QString &cacheDir, qint64 maxSize);
+    /// Deletes all entries that are not in use
+    static void clear(const QString &cacheDir);
+
+private:
+    static QString directory(const QString &cacheDir);
+    void addRange(qint64 start, qint64 end);
+    bool readIndex();
+    bool writeIndex();
+    void reset();
+
+    const QString m_dir;
+    QString m_baseName;
+    std::unique_ptr<QLockFile> m_lock;
+    QFile m_data;
+    bool m_indexDirty;
+    bool m_used; // data was read, which counts as a use for trim()
+
+    Validator m_validator;
+    qint64 m_totalSize;
+    QString m_mimeType;
+    qint64 m_expireDate;
+    QMap<qint64, qint64> m_ranges; // start -> end exclusive, neither overlapping nor adjacent
+};
+
+#endif // HTTPRANGECACHE_H
@@ -9,6 +9,7 @@
 #include "parsinghelpers.h"
 
 #include <ctype.h>
+#include <string.h>
 
 #include <QDebug>
 #include <QDir>
@@ -25,14 +26,25 @@ static void skipSpace(const char input[], int *pos, int end)
     return;
 }
 
+// Return the index of the first CR or LF at or after pos, or end if there is none.
+// memchr() is vectorized in the common C libraries, which makes it a lot faster
+// than looking at each byte in turn.
+static int findLineEnd(const char input[], int pos, int end)
+{
+    if (pos >= end) {
+        return end;
+    }
+    const char *lf = static_cast<const char *>(memchr(input + pos, '\n', end - pos));
+    const int lfIdx = lf ? int(lf - input) : end;
+    const char *cr = static_cast<const char *>(memchr(input + pos, '\r', lfIdx - pos));
+    return cr ? int(cr - input) : lfIdx;
+}
+
 // Advance *pos to start of next line while being forgiving about line endings.
 // Return false if the end of the header has been reached, true otherwise.
 static bool nextLine(const char input[], int *pos, int end)
 {
-    int idx = *pos;
-    while (idx < end && input[idx] != '\r' && input[idx] != '\n') {
-        idx++;
-    }
+    int idx = findLineEnd(input, *pos, end);
     int rCount = 0;
     int nCount = 0;
     while (idx < end && qMax(rCount, nCount) < 2 && (input[idx] == '\r' || input[idx] == '\n')) {
@@ -96,62 +108,86 @@ QByteArray TokenIterator::current() const
 QList<QByteArray> TokenIterator::all() const
 {
     QList<QByteArray> ret;
-    ret.reserve(m_tokens.count());
-    for (int i = 0; i < m_tokens.count(); i++) {
+    ret.reserve(m_count);
+    for (int i = 0; i < m_count; i++) {
         const auto [startIdx, endIdx] = m_tokens[i];
         ret.append(QByteArray(&m_buffer[startIdx], endIdx - startIdx));
     }
     return ret;
 }
 
+namespace
+{
+struct HeaderFieldTemplate {
+    const char *name;
+    bool isMultiValued;
+};
+}
+
+// Information about available headers and whether they have one or multiple,
+// comma-separated values.
+
+// The following response header fields are from RFC 2616 unless otherwise specified.
+// Hint: search the web for e.g. 'http "accept-ranges header"' to find information about
+// a header field.
+static const HeaderFieldTemplate headerFieldTemplates[] = {
+    {"accept-ranges", false},
+    {"age", false},
+    {"cache-control", true},
+    {"connection", true},
+    {"content-disposition", false}, // is multi-valued in a way, but with ";" separator!
+    {"content-encoding", true},
+    {"content-language", true},
+    {"content-length", false},
+    {"content-location", false},
+    {"content-md5", false},
+    {"content-range", false},
+    {"content-type", false},
+    {"date", false},
+    {"dav", true}, // RFC 2518
+    {"etag", false},
+    {"expires", false},
+    {"keep-alive", true}, // RFC 2068
+    {"last-modified", false},
+    {"link", false}, // RFC 2068, multi-valued with ";" separator
+    {"location", false},
+    {"p3p", true}, // http://www.w3.org/TR/P3P/
+    {"pragma", true},
+    {"proxy-authenticate", false}, // complicated multi-valuedness: quoted commas don't separate
+    // multiple values. we handle this at a higher level.
+    {"proxy-connection", true}, // unofficial but well-known; to avoid misunderstandings
+    // when using "connection" when talking to a proxy.
+    {"refresh", false}, // not sure, only found some mailing list posts mentioning it
+    {"set-cookie", false}, // RFC 2109; the multi-valuedness seems to be usually achieved
+    // by sending several instances of this field as opposed to
+    // usually comma-separated lists with maybe multiple instances.
+    {"transfer-encoding", true},
+    {"upgrade", true},
+    {"warning", true},
+    {"www-authenticate", false} // see proxy-authenticate
+};
+
+static const HeaderField s_nullField;
+
 HeaderTokenizer::HeaderTokenizer(char *buffer)
     : m_buffer(buffer)
 {
-    // add information about available headers and whether they have one or multiple,
-    // comma-separated values.
-
-    // The following response header fields are from RFC 2616 unless otherwise specified.
-    // Hint: search the web for e.g. 'http "accept-ranges header"' to find information about
-    // a header field.
-    static const HeaderFieldTemplate headerFieldTemplates[] = {
-        {"accept-ranges", false},
-        {"age", false},
-        {"cache-control", true},
-        {"connection", true},
-        {"content-disposition", false}, // is multi-valued in a way, but with ";" separator!
-        {"content-encoding", true},
-        {"content-language", true},
-        {"content-length", false},
-        {"content-location", false},
-        {"content-md5", false},
-        {"content-type", false},
-        {"date", false},
-        {"dav", true}, // RFC 2518
-        {"etag", false},
-        {"expires", false},
-        {"keep-alive", true}, // RFC 2068
-        {"last-modified", false},
-        {"link", false}, // RFC 2068, multi-valued with ";" separator
-        {"location", false},
-        {"p3p", true}, // http://www.w3.org/TR/P3P/
-        {"pragma", true},
-        {"proxy-authenticate", false}, // complicated multi-valuedness: quoted commas don't separate
-        // multiple values. we handle this at a higher level.
-        {"proxy-connection", true}, // unofficial but well-known; to avoid misunderstandings
-        // when using "connection" when talking to a proxy.
-        {"refresh", false}, // not sure, only found some mailing list posts mentioning it
-        {"set-cookie", false}, // RFC 2109; the multi-valuedness seems to be usually achieved
-        // by sending several instances of this field as opposed to
-        // usually comma-separated lists with maybe multiple instances.
-        {"transfer-encoding", true},
-        {"upgrade", true},
-        {"warning", true},
-        {"www-authenticate", false} // see proxy-authenticate
-    };
-
-    for (const HeaderFieldTemplate &ft : headerFieldTemplates) {
-        insert(QByteArray(ft.name), HeaderField(ft.isMultiValued));
+    static_assert(sizeof(headerFieldTemplates) / sizeof(headerFieldTemplates[0]) == FieldCount, "FieldCount is out of date");
+    for (int i = 0; i < FieldCount; i++) {
+        m_fields[i].isMultiValued = headerFieldTemplates[i].isMultiValued;
+    }
+}
+
+int HeaderTokenizer::fieldIndex(const char *name, int length)
+{
+    for (int i = 0; i < FieldCount; i++) {
+        const char *fieldName = headerFieldTemplates[i].name;
+        // the first character rules out most fields without a function call
+        if (fieldName[0] == name[0] && qstrncmp(fieldName, name, length) == 0 && fieldName[length] == '\0') {
+            return i;
+        }
     }
+    return -1;
 }
 
 int HeaderTokenizer::tokenize(int begin, int end)
@@ -160,11 +196,11 @@ int HeaderTokenizer::tokenize(int begin, int end)
     int idx = begin;
     int startIdx = begin; // multi-purpose start of current token
     bool multiValuedEndedWithComma = false; // did the last multi-valued line end with a comma?
-    QByteArray headerKey;
+    HeaderField *field = nullptr; // the known field of the current line
     do {
         if (buf[idx] == ' ' || buf[idx] == '\t') {
             // line continuation; preserve startIdx except (see below)
-            if (headerKey.isEmpty()) {
+            if (!field) {
                 continue;
             }
             // turn CR/LF into spaces for later parsing convenience
@@ -174,16 +210,16 @@ int HeaderTokenizer::tokenize(int begin, int end)
             }
 
             // multiple values, comma-separated: add new value or continue previous?
-            if (operator[](headerKey).isMultiValued) {
+            if (field->isMultiValued) {
                 if (multiValuedEndedWithComma) {
                     // start new value; this is almost like no line continuation
                     skipSpace(buf, &idx, end);
                     startIdx = idx;
                 } else {
                     // continue previous value; this is tricky. unit tests to the rescue!
-                    if (operator[](headerKey).beginEnd.last().startIndex == startIdx) {
+                    if (!field->beginEnd.isEmpty() && field->beginEnd.last().startIndex == startIdx) {
                         // remove entry, it will be re-added because already idx != startIdx
-                        operator[](headerKey).beginEnd.removeLast();
+                        field->beginEnd.removeLast();
                     } else {
                         // no comma, no entry: the prev line was whitespace only - start new value
                         skipSpace(buf, &idx, end);
@@ -196,21 +232,28 @@ int HeaderTokenizer::tokenize(int begin, int end)
             // new field
             startIdx = idx;
             // also make sure that there is at least one char after the colon
-            while (idx < (end - 1) && buf[idx] != ':' && buf[idx] != '\r' && buf[idx] != '\n') {
-                buf[idx] = tolower(buf[idx]);
-                idx++;
+            const int lineEnd = findLineEnd(buf, idx, end - 1);
+            const int colonSearchEnd = lineEnd == end - 1 ? end : lineEnd;
+            const char *colon = static_cast<const char *>(memchr(buf + idx, ':', colonSearchEnd - idx));
+            idx = colon ? int(colon - buf) : lineEnd;
+            // field names are case-insensitive; not tolower(), which is locale dependent
+            for (int i = startIdx; i < idx; i++) {
+                if (buf[i] >= 'A' && buf[i] <= 'Z') {
+                    buf[i] += 'a' - 'A';
+                }
             }
-            if (buf[idx] != ':') {
+            if (!colon) {
                 // malformed line: no colon
-                headerKey.clear();
+                field = nullptr;
                 continue;
             }
-            headerKey = QByteArray(&buf[startIdx], idx - startIdx);
-            if (!contains(headerKey)) {
+            const int index = fieldIndex(&buf[startIdx], idx - startIdx);
+            if (index < 0) {
                 // we don't recognize this header line
-                headerKey.clear();
+                field = nullptr;
                 continue;
             }
+            field = &m_fields[index];
             // skip colon & leading whitespace
             idx++;
             skipSpace(buf, &idx, end);
@@ -218,38 +261,36 @@ int HeaderTokenizer::tokenize(int begin, int end)
         }
 
         // we have the name/key of the field, now parse the value
-        if (!operator[](headerKey).isMultiValued) {
+        if (!field->isMultiValued) {
             // scan to end of line
-            while (idx < end && buf[idx] != '\r' && buf[idx] != '\n') {
-                idx++;
-            }
-            if (!operator[](headerKey).beginEnd.isEmpty()) {
+            idx = findLineEnd(buf, idx, end);
+            if (!field->beginEnd.isEmpty()) {
                 // there already is an entry; are we just in a line continuation?
-                if (operator[](headerKey).beginEnd.last().startIndex == startIdx) {
+                if (field->beginEnd.last().startIndex == startIdx) {
                     // line continuation: delete previous entry and later insert a new, longer one.
-                    operator[](headerKey).beginEnd.removeLast();
+                    field->beginEnd.removeLast();
                 }
             }
-            operator[](headerKey).beginEnd.append({startIdx, idx});
+            field->beginEnd.append({startIdx, idx});
 
         } else {
             // comma-separated list
+            const int lineEnd = findLineEnd(buf, idx, end);
             while (true) {
                 // skip one value
-                while (idx < end && buf[idx] != '\r' && buf[idx] != '\n' && buf[idx] != ',') {
-                    idx++;
-                }
+                const char *comma = static_cast<const char *>(memchr(buf + idx, ',', lineEnd - idx));
+                idx = comma ? int(comma - buf) : lineEnd;
                 if (idx != startIdx) {
-                    operator[](headerKey).beginEnd.append({startIdx, idx});
+                    field->beginEnd.append({startIdx, idx});
                 }
-                multiValuedEndedWithComma = buf[idx] == ',';
+                multiValuedEndedWithComma = comma != nullptr;
                 // skip comma(s) and leading whitespace, if any respectively
                 while (idx < end && buf[idx] == ',') {
                     idx++;
                 }
                 skipSpace(buf, &idx, end);
                 // next value or end-of-line / end of header?
-                if (buf[idx] >= end || buf[idx] == '\r' || buf[idx] == '\n') {
+                if (idx >= end || buf[idx] == '\r' || buf[idx] == '\n') {
                     break;
                 }
                 // next value
@@ -262,12 +303,24 @@ int HeaderTokenizer::tokenize(int begin, int end)
 
 TokenIterator HeaderTokenizer::iterator(const char *key) const
 {
-    QByteArray keyBa = QByteArray::fromRawData(key, strlen(key));
-    if (contains(keyBa)) {
-        return TokenIterator(value(keyBa).beginEnd, m_buffer);
-    } else {
-        return TokenIterator(m_nullTokens, m_buffer);
-    }
+    const int index = fieldIndex(key, qstrlen(key));
+    return TokenIterator(index < 0 ? s_nullField : m_fields[index], m_buffer);
+}
+
+bool HeaderTokenizer::contains(const QByteArray &key) const
+{
+    return fieldIndex(key.constData(), key.size()) >= 0;
+}
+
+const HeaderField &HeaderTokenizer::value(const QByteArray &key) const
+{
+    const int index = fieldIndex(key.constData(), key.size());
+    return index < 0 ? s_nullField : m_fields[index];
+}
+
+QByteArray HeaderTokenizer::ConstIterator::key() const
+{
+    return QByteArray(headerFieldTemplates[m_index].name);
 }
 
 static void skipLWS(const QString &str, int &pos)
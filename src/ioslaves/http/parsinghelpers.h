@@ -8,35 +8,28 @@
 #ifndef PARSINGHELPERS_H
 #define PARSINGHELPERS_H
 
-#include <QHash>
+#include <QByteArray>
 #include <QList>
+#include <QVarLengthArray>
 
 struct HeaderField {
-    HeaderField(bool multiValued)
-    {
-        isMultiValued = multiValued;
-    }
-    // QHash requires a default constructor
-    HeaderField()
-    {
-        isMultiValued = false;
-    }
-
-    bool isMultiValued;
+    bool isMultiValued = false;
     struct Info {
         int startIndex = 0;
         int endIndex = 0;
     };
-    QList<Info> beginEnd;
+    // most fields have few values, those don't need a heap allocation
+    QVarLengthArray<Info, 4> beginEnd;
 };
 
 class HeaderTokenizer;
+// Note that a TokenIterator refers to its HeaderTokenizer, it must not outlive it.
 class TokenIterator
 {
 public:
     inline bool hasNext() const
     {
-        return m_currentToken < m_tokens.count();
+        return m_currentToken < m_count;
     }
 
     QByteArray next();
@@ -47,38 +40,89 @@ public:
 
 private:
     friend class HeaderTokenizer;
-    QList<HeaderField::Info> m_tokens;
+    const HeaderField::Info *m_tokens;
+    int m_count;
     int m_currentToken;
     const char *m_buffer;
-    TokenIterator(const QList<HeaderField::Info> &tokens, const char *buffer)
-        : m_tokens(tokens)
+    TokenIterator(const HeaderField &field, const char *buffer)
+        : m_tokens(field.beginEnd.constData())
+        , m_count(field.beginEnd.count())
         , m_currentToken(0)
         , m_buffer(buffer)
     {
     }
 };
 
-class HeaderTokenizer : public QHash<QByteArray, HeaderField>
+class HeaderTokenizer
 {
 public:
     explicit HeaderTokenizer(char *buffer);
     // note that buffer is not const - in the parsed area CR/LF will be overwritten
-    // with spaces if there is a line continuation.
+    // with spaces if there is a line continuation, and field names are lowercased.
     /// @return: index of first char after header or end
     int tokenize(int begin, int end);
 
-    // after tokenize() has been called use the QHash part of this class to
-    // ask for a list of begin-end indexes in buffer for header values.
+    // after tokenize() has been called use these to ask for a list of begin-end
+    // indexes in buffer for header values.
 
     TokenIterator iterator(const char *key) const;
 
+    /// @p key is a lowercase field name
+    bool contains(const QByteArray &key) const;
+    /// The values of field @p key, none if the field is not known
+    const HeaderField &value(const QByteArray &key) const;
+
+    /// Iterates over all known fields, with or without values
+    class ConstIterator
+    {
+    public:
+        QByteArray key() const;
+        const HeaderField &value() const
+        {
+            return m_tokenizer->m_fields[m_index];
+        }
+        ConstIterator &operator++()
+        {
+            ++m_index;
+            return *this;
+        }
+        bool operator==(const ConstIterator &other) const
+        {
+            return m_index == other.m_index;
+        }
+        bool operator!=(const ConstIterator &other) const
+        {
+            return m_index != other.m_index;
+        }
+
+    private:
+        friend class HeaderTokenizer;
+        ConstIterator(const HeaderTokenizer *tokenizer, int index)
+            : m_tokenizer(tokenizer)
+            , m_index(index)
+        {
+        }
+        const HeaderTokenizer *m_tokenizer;
+        int m_index;
+    };
+    ConstIterator constBegin() const
+    {
+        return ConstIterator(this, 0);
+    }
+    ConstIterator constEnd() const
+    {
+        return ConstIterator(this, FieldCount);
+    }
+
 private:
-    char *m_buffer;
-    struct HeaderFieldTemplate {
-        const char *name;
-        bool isMultiValued;
+    enum {
+        FieldCount = 30, // the number of fields in headerFieldTemplates in the .cpp file
     };
-    QList<HeaderField::Info> m_nullTokens; // long-lived, allows us to pass out references.
+    static int fieldIndex(const char *name, int length);
+
+    char *m_buffer;
+    // a fixed table instead of a hash, it's filled in for each response
+    HeaderField m_fields[FieldCount];
 };
 
 #endif // PARSINGHELPERS_H
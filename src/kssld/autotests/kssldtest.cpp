@@ -0,0 +1,93 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <kssld.h>
+
+#include <QSslCertificate>
+#include <QStandardPaths>
+#include <QTest>
+
+// Self-signed, CN=www.example.com, valid until 2126
+static const char s_certificate[] =
+    "-----BEGIN CERTIFICATE-----\n"
+    "MIICEjCCAXugAwIBAgIUTxu6whaCl6YyvpoJiZjQCTNJDLAwDQYJKoZIhvcNAQEL\n"
+    "BQAwGjEYMBYGA1UEAwwPd3d3LmV4YW1wbGUuY29tMCAXDTI2MTAxODE2MTY1MloY\n"
+    "DzIxMjYwOTI0MTYxNjUyWjAaMRgwFgYDVQQDDA93d3cuZXhhbXBsZS5jb20wgZ8w\n"
+    "DQYJKoZIhvcNAQEBBQADgY0AMIGJAoGBAL9UFfhy3l7ODMAKnQlkcaAW1kl2gB7d\n"
+    "+nOMySpM5MlN+A5/laQN/D9bdQYi1UDeEiynUcHciIxpGhKL+QkecRhS8JFpTpt9\n"
+    "qd0JAykC3cz9Ay4pLq+lO8ZRdEy73g6EedxAlqsms2g/egx7qsGwZ4WFbZG0Cpx5\n"
+    "CAsohXqHvQslAgMBAAGjUzBRMB0GA1UdDgQWBBTlVyMnXLHZDGUt/92RfjUSiSNa\n"
+    "4zAfBgNVHSMEGDAWgBTlVyMnXLHZDGUt/92RfjUSiSNa4zAPBgNVHRMBAf8EBTAD\n"
+    "AQH/MA0GCSqGSIb3DQEBCwUAA4GBAJKRi32f21s2mhQNjcGV9/Q9lbJp//Sbr9jR\n"
+    "zLI5JIBhi+1Aly3QJCMdUrIoN+MCinXrRCZQ4/wXwHPCqvy+6Nsx6ICzUY7JaHRj\n"
+    "9IKeDutXWfq7iNYPcQ+oG6xwBV09N7Orv10QhAgRDp7GioFylDB03jmn4q04BWzg\n"
+    "Nad33RkZ\n"
+    "-----END CERTIFICATE-----\n";
+
+class KSSLDTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+        m_peerChain = QSslCertificate::fromData(s_certificate, QSsl::Pem);
+        QCOMPARE(m_peerChain.count(), 1);
+    }
+
+    void testTlsSessionRoundTrip()
+    {
+        KSSLD kssld(nullptr, QVariantList());
+        const QByteArray context("ctx");
+        const QByteArray ticket("ticket-data");
+
+        QList<QSslCertificate> chain;
+        QVERIFY(kssld.tlsSession(QStringLiteral("www.example.com"), 443, context, &chain).isEmpty());
+        QVERIFY(chain.isEmpty());
+
+        kssld.setTlsSession(QStringLiteral("www.example.com"), 443, context, ticket, m_peerChain, 300);
+        QCOMPARE(kssld.tlsSession(QStringLiteral("www.example.com"), 443, context, &chain), ticket);
+        QCOMPARE(chain, m_peerChain);
+
+        // an empty ticket forgets the session
+        kssld.setTlsSession(QStringLiteral("www.example.com"), 443, context, QByteArray(), {}, 300);
+        chain.clear();
+        QVERIFY(kssld.tlsSession(QStringLiteral("www.example.com"), 443, context, &chain).isEmpty());
+        QVERIFY(chain.isEmpty());
+
+        // so does a session the server doesn't want resumed
+        kssld.setTlsSession(QStringLiteral("www.example.com"), 443, context, ticket, m_peerChain, 0);
+        QVERIFY(kssld.tlsSession(QStringLiteral("www.example.com"), 443, context, &chain).isEmpty());
+    }
+
+    void testTlsSessionScope()
+    {
+        KSSLD kssld(nullptr, QVariantList());
+        const QByteArray context("ctx");
+        const QByteArray ticket("ticket-data");
+        kssld.setTlsSession(QStringLiteral("www.example.com"), 443, context, ticket, m_peerChain, 300);
+
+        QList<QSslCertificate> chain;
+        // shared by every worker connecting to the same host:port with the same settings
+        QCOMPARE(kssld.tlsSession(QStringLiteral("www.example.com"), 443, context, &chain), ticket);
+        QCOMPARE(kssld.tlsSession(QStringLiteral("WWW.Example.COM"), 443, context, &chain), ticket);
+
+        // but not offered to another host, port or validation setup
+        QVERIFY(kssld.tlsSession(QStringLiteral("example.com"), 443, context, &chain).isEmpty());
+        QVERIFY(kssld.tlsSession(QStringLiteral("www.example.org"), 443, context, &chain).isEmpty());
+        QVERIFY(kssld.tlsSession(QStringLiteral("www.example.com"), 8443, context, &chain).isEmpty());
+        QVERIFY(kssld.tlsSession(QStringLiteral("www.example.com"), 443, QByteArray("other"), &chain).isEmpty());
+        QVERIFY(kssld.tlsSession(QStringLiteral("www.example.com"), 443, QByteArray(), &chain).isEmpty());
+    }
+
+private:
+    QList<QSslCertificate> m_peerChain;
+};
+
+QTEST_GUILESS_MAIN(KSSLDTest)
+
+#include "kssldtest.moc"
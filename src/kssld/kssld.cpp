@@ -16,9 +16,21 @@
 
 #include <KPluginFactory>
 #include <QDate>
+#include <QSslCertificate>
 
 K_PLUGIN_CLASS_WITH_JSON(KSSLD, "kssld.json")
 
+// A handful per host that is in use is plenty
+static const int s_maxTlsSessions = 256;
+// Servers may allow resumption for days, but a stolen ticket would allow it as well
+static const int s_maxTlsSessionLifetime = 24 * 3600;
+
+struct TlsSession {
+    QByteArray ticket;
+    QList<QSslCertificate> peerChain;
+    QDateTime expiryDateTime;
+};
+
 class KSSLDPrivate
 {
 public:
@@ -65,6 +77,8 @@ public:
     KConfig config;
     QHash<QString, QSslError::SslError> stringToSslError;
     QHash<QSslError::SslError, QString> sslErrorToString;
+    // key is "host:port/context"
+    QHash<QString, TlsSession> tlsSessions;
 };
 
 KSSLD::KSSLD(QObject *parent, const QVariantList &)
@@ -261,6 +275,63 @@ KSslCertificateRule KSSLD::rule(const QSslCertificate &cert, const QString &host
     return ret;
 }
 
+static QString tlsSessionKey(const QString &hostName, int port, const QByteArray &context)
+{
+    return hostName.toLower() + QLatin1Char(':') + QString::number(port) + QLatin1Char('/') + QString::fromLatin1(context);
+}
+
+void KSSLD::setTlsSession(const QString &hostName,
+                          int port,
+                          const QByteArray &context,
+                          const QByteArray &ticket,
+                          const QList<QSslCertificate> &peerChain,
+                          int lifetimeHint)
+{
+    const QString key = tlsSessionKey(hostName, port, context);
+    if (ticket.isEmpty() || lifetimeHint <= 0) {
+        d->tlsSessions.remove(key);
+        return;
+    }
+
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    if (d->tlsSessions.size() >= s_maxTlsSessions && !d->tlsSessions.contains(key)) {
+        // make room, expired sessions first, else the one that expires next
+        auto oldest = d->tlsSessions.begin();
+        for (auto it = d->tlsSessions.begin(); it != d->tlsSessions.end();) {
+            if (it->expiryDateTime <= now) {
+                it = d->tlsSessions.erase(it);
+                continue;
+            }
+            if (it->expiryDateTime < oldest->expiryDateTime) {
+                oldest = it;
+            }
+            ++it;
+        }
+        if (d->tlsSessions.size() >= s_maxTlsSessions) {
+            d->tlsSessions.erase(oldest);
+        }
+    }
+
+    TlsSession &session = d->tlsSessions[key];
+    session.ticket = ticket;
+    session.peerChain = peerChain;
+    session.expiryDateTime = now.addSecs(qMin(lifetimeHint, s_maxTlsSessionLifetime));
+}
+
+QByteArray KSSLD::tlsSession(const QString &hostName, int port, const QByteArray &context, QList<QSslCertificate> *peerChain) const
+{
+    const auto it = d->tlsSessions.find(tlsSessionKey(hostName, port, context));
+    if (it == d->tlsSessions.end()) {
+        return QByteArray();
+    }
+    if (it->expiryDateTime <= QDateTime::currentDateTimeUtc()) {
+        d->tlsSessions.erase(it);
+        return QByteArray();
+    }
+    *peerChain = it->peerChain;
+    return it->ticket;
+}
+
 #include "kssld.moc"
 #include "moc_kssld.cpp"
 #include "moc_kssld_adaptor.cpp"
@@ -31,6 +31,22 @@ public:
     void pruneExpiredRules();
     KSslCertificateRule rule(const QSslCertificate &cert, const QString &hostName) const;
 
+    /**
+     * Keeps a TLS session of a worker, so that other workers connecting to @p hostName
+     * and @p port can resume it instead of doing a full handshake. @p context identifies
+     * the settings that @p peerChain was validated with, only workers with the same
+     * context get the session. Sessions are only kept in memory, for @p lifetimeHint
+     * seconds at most; an empty @p ticket forgets the session.
+     */
+    void setTlsSession(const QString &hostName,
+                       int port,
+                       const QByteArray &context,
+                       const QByteArray &ticket,
+                       const QList<QSslCertificate> &peerChain,
+                       int lifetimeHint);
+    /// The ticket of a session to resume, and in @p peerChain the certificates the peer sent for it
+    QByteArray tlsSession(const QString &hostName, int port, const QByteArray &context, QList<QSslCertificate> *peerChain) const;
+
 private:
     // AFAICS we don't need the d-pointer technique here but it makes the code look
     // more like the rest of kdelibs and it can be reused anywhere in kdelibs.
@@ -54,6 +54,21 @@ public Q_SLOTS:
     {
         return p()->rule(cert, hostName);
     }
+
+    inline Q_NOREPLY void setTlsSession(const QString &hostName,
+                                        int port,
+                                        const QByteArray &context,
+                                        const QByteArray &ticket,
+                                        const QList<QSslCertificate> &peerChain,
+                                        int lifetimeHint)
+    {
+        p()->setTlsSession(hostName, port, context, ticket, peerChain, lifetimeHint);
+    }
+
+    inline QByteArray tlsSession(const QString &hostName, int port, const QByteArray &context, QList<QSslCertificate> &peerChain)
+    {
+        return p()->tlsSession(hostName, port, context, &peerChain);
+    }
 };
 
 #endif // KSSLD_ADAPTOR_H
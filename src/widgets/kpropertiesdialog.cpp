@@ -63,6 +63,7 @@
 #include <KDesktopFile>
 #include <KDialogJobUiDelegate>
 #include <KIO/ApplicationLauncherJob>
+#include <KIO/ChecksumJob>
 #include <KIO/FileSystemFreeSpaceJob>
 #include <KIO/OpenFileManagerWindowJob>
 #include <KIconButton>
@@ -101,11 +102,11 @@
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
-#include <QFutureWatcher>
 #include <QLabel>
 #include <QLayout>
 #include <QLocale>
 #include <QMimeDatabase>
+#include <QPointer>
 #include <QProgressBar>
 #include <QPushButton>
 #include <QRegularExpression>
@@ -113,7 +114,6 @@
 #include <QStyle>
 #include <QUrl>
 #include <QVector>
-#include <QtConcurrent>
 
 #include <cerrno>
 extern "C" {
@@ -2746,6 +2746,10 @@ public:
     QString m_sha1;
     QString m_sha256;
     QString m_sha512;
+
+    // Computes all the checksums at once, the callbacks run once it's done
+    QPointer<KIO::ChecksumJob> m_checksumJob;
+    QVector<std::function<void()>> m_pendingCallbacks;
 };
 
 KChecksumsPlugin::KChecksumsPlugin(KPropertiesDialog *dialog)
@@ -2769,7 +2773,10 @@ KChecksumsPlugin::KChecksumsPlugin(KPropertiesDialog *dialog)
     connect(d->m_ui.sha256Button, &QPushButton::clicked, this, &KChecksumsPlugin::slotShowSha256);
     connect(d->m_ui.sha512Button, &QPushButton::clicked, this, &KChecksumsPlugin::slotShowSha512);
 
-    d->fileWatcher.addPath(properties->item().localPath());
+    const QString localPath = properties->item().localPath();
+    if (!localPath.isEmpty()) {
+        d->fileWatcher.addPath(localPath);
+    }
     connect(&d->fileWatcher, &QFileSystemWatcher::fileChanged, this, &KChecksumsPlugin::slotInvalidateCache);
 
     auto clipboard = QApplication::clipboard();
@@ -2805,7 +2812,8 @@ bool KChecksumsPlugin::supports(const KFileItemList &items)
     }
 
     const KFileItem &item = items.first();
-    return item.isFile() && !item.localPath().isEmpty() && item.isReadable() && !item.isDesktopFile() && !item.isLink();
+    // Remote files are hashed by their worker, or downloaded by the checksum job
+    return item.isFile() && item.isReadable() && !item.isDesktopFile() && !item.isLink();
 }
 
 void KChecksumsPlugin::slotInvalidateCache()
@@ -2814,6 +2822,18 @@ void KChecksumsPlugin::slotInvalidateCache()
     d->m_sha1 = QString();
     d->m_sha256 = QString();
     d->m_sha512 = QString();
+
+    // A running job may have read the old contents, start over for whoever waits for it
+    if (d->m_checksumJob) {
+        KIO::ChecksumJob *job = d->m_checksumJob;
+        d->m_checksumJob.clear();
+        job->kill();
+        const auto callbacks = std::move(d->m_pendingCallbacks);
+        d->m_pendingCallbacks.clear();
+        for (const auto &callback : callbacks) {
+            computeChecksums(callback);
+        }
+    }
 }
 
 void KChecksumsPlugin::slotShowMd5()
@@ -2888,13 +2908,11 @@ void KChecksumsPlugin::slotVerifyChecksum(const QString &input)
         return;
     }
 
-    // Calculate checksum in another thread.
-    auto futureWatcher = new QFutureWatcher<QString>(this);
-    connect(futureWatcher, &QFutureWatcher<QString>::finished, this, [=]() {
-        const QString checksum = futureWatcher->result();
-        futureWatcher->deleteLater();
+    // Notify the user about the background computation.
+    setVerifyState();
 
-        cacheChecksum(checksum, algorithm);
+    computeChecksums([=]() {
+        const QString checksum = cachedChecksum(algorithm);
 
         switch (algorithm) {
         case QCryptographicHash::Md5:
@@ -2920,12 +2938,6 @@ void KChecksumsPlugin::slotVerifyChecksum(const QString &input)
             setMismatchState();
         }
     });
-
-    // Notify the user about the background computation.
-    setVerifyState();
-
-    auto future = QtConcurrent::run(&KChecksumsPlugin::computeChecksum, algorithm, properties->item().localPath());
-    futureWatcher->setFuture(future);
 }
 
 bool KChecksumsPlugin::isMd5(const QString &input)
@@ -2952,17 +2964,32 @@ bool KChecksumsPlugin::isSha512(const QString &input)
     return regex.match(input).hasMatch();
 }
 
-QString KChecksumsPlugin::computeChecksum(QCryptographicHash::Algorithm algorithm, const QString &path)
+void KChecksumsPlugin::computeChecksums(const std::function<void()> &callback)
 {
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return QString();
+    d->m_pendingCallbacks.append(callback);
+    if (d->m_checksumJob) {
+        return;
     }
 
-    QCryptographicHash hash(algorithm);
-    hash.addData(&file);
+    // One read of the file for all the algorithms the dialog shows
+    const QList<QCryptographicHash::Algorithm> algorithms{QCryptographicHash::Md5,
+                                                          QCryptographicHash::Sha1,
+                                                          QCryptographicHash::Sha256,
+                                                          QCryptographicHash::Sha512};
+    d->m_checksumJob = KIO::checksums(properties->item().url(), algorithms, KIO::HideProgressInfo);
+    KJobWidgets::setWindow(d->m_checksumJob, properties);
+    connect(d->m_checksumJob, &KJob::result, this, [this, algorithms](KJob *job) {
+        auto checksumJob = static_cast<KIO::ChecksumJob *>(job);
+        for (QCryptographicHash::Algorithm algorithm : algorithms) {
+            cacheChecksum(checksumJob->checksum(algorithm), algorithm);
+        }
 
-    return QString::fromLatin1(hash.result().toHex());
+        const auto callbacks = std::move(d->m_pendingCallbacks);
+        d->m_pendingCallbacks.clear();
+        for (const auto &callback : callbacks) {
+            callback();
+        }
+    });
 }
 
 QCryptographicHash::Algorithm KChecksumsPlugin::detectAlgorithm(const QString &input)
@@ -3063,20 +3090,10 @@ void KChecksumsPlugin::showChecksum(QCryptographicHash::Algorithm algorithm, QLa
         return;
     }
 
-    // Calculate checksum in another thread.
-    auto futureWatcher = new QFutureWatcher<QString>(this);
-    connect(futureWatcher, &QFutureWatcher<QString>::finished, this, [=]() {
-        const QString checksum = futureWatcher->result();
-        futureWatcher->deleteLater();
-
-        label->setText(checksum);
-        cacheChecksum(checksum, algorithm);
-
+    computeChecksums([=]() {
+        label->setText(cachedChecksum(algorithm));
         copyButton->show();
     });
-
-    auto future = QtConcurrent::run(&KChecksumsPlugin::computeChecksum, algorithm, properties->item().localPath());
-    futureWatcher->setFuture(future);
 }
 
 QString KChecksumsPlugin::cachedChecksum(QCryptographicHash::Algorithm algorithm) const
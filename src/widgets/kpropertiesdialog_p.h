@@ -20,6 +20,8 @@
 
 #include <QCryptographicHash>
 
+#include <functional>
+
 class QComboBox;
 class QLabel;
 
@@ -170,7 +172,6 @@ private:
     static bool isSha1(const QString &input);
     static bool isSha256(const QString &input);
     static bool isSha512(const QString &input);
-    static QString computeChecksum(QCryptographicHash::Algorithm algorithm, const QString &path);
     static QCryptographicHash::Algorithm detectAlgorithm(const QString &input);
 
     void setDefaultState();
@@ -179,6 +180,11 @@ private:
     void setMismatchState();
     void setVerifyState();
     void showChecksum(QCryptographicHash::Algorithm algorithm, QLabel *label, QPushButton *copyButton);
+    /**
+     * Computes all the checksums shown in the dialog in one read of the file,
+     * then calls @p callback with the cache filled.
+     */
+    void computeChecksums(const std::function<void()> &callback);
 
     QString cachedChecksum(QCryptographicHash::Algorithm algorithm) const;
     void cacheChecksum(const QString &checksum, QCryptographicHash::Algorithm algorithm);